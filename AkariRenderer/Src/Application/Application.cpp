@@ -14,6 +14,7 @@
 #include "RHI/SwapChain.h"
 #include "RPI/RenderContext.h"
 #include "RPI/RenderPipeline.h"
+#include "SceneComponents/AssetDatabase.h"
 #include "SceneComponents/ModelManager.h"
 #include "SceneComponents/Scene.h"
 #include "SceneComponents/SceneObject.h"
@@ -57,6 +58,8 @@ namespace Akari {
 
 		m_Scene = std::make_shared<Scene>();
 
+		// Cooked assets are tracked across runs
+		AssetDatabase::GetInstance().Init(std::filesystem::current_path() / "AssetDatabase.akdb");
 		ModelManager::GetInstance().Init();
 		
 		m_LogicLayer = std::make_shared<LogicLayer>();
@@ -150,6 +153,7 @@ namespace Akari {
 		m_LogicLayer->OnDetach();
 
 		ModelManager::GetInstance().Shutdown();
+		AssetDatabase::GetInstance().Shutdown();
 		Renderer::GetInstance().ShutDown();
 		
 		m_EventCallbacks.clear();
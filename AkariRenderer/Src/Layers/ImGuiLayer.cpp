@@ -38,8 +38,10 @@
 #include "SceneComponents/Model.h"
 #include "SceneComponents/ModelManager.h"
 #include "SceneComponents/ModelNode.h"
+#include "SceneComponents/SceneSerializer.h"
 #include "SceneComponents/Scene.h"
 #include "SceneComponents/Camera/EditorCamera.h"
+#include "SceneComponents/ScenePicker.h"
 
 //--------------------------------------------------------------------------------------
 // Get surface information for a particular format
@@ -401,6 +403,18 @@ namespace Akari
                 {
                     OpenLoadModelDialog();
                 }
+
+                ImGui::Separator();
+
+                if (ImGui::MenuItem("Open Scene..."))
+                {
+                    OpenSceneFileDialog(false);
+                }
+
+                if (ImGui::MenuItem("Save Scene As..."))
+                {
+                    OpenSceneFileDialog(true);
+                }
                 
                 ImGui::EndMenu();
             }
@@ -412,6 +426,7 @@ namespace Akari
                 ImGui::MenuItem("Show Hierarchy", nullptr, &m_ShowHierarchyWindow);
                 ImGui::MenuItem("Show Browser", nullptr, &m_ShowBrowserWindow);
                 ImGui::MenuItem("Show Property", nullptr, &m_ShowPropertyWindow);
+                ImGui::MenuItem("Show Statistics", nullptr, &m_ShowStatistics);
                 ImGui::EndMenu();
             }
 
@@ -455,6 +470,10 @@ namespace Akari
         {
             DrawBloomSettingsWindow();
         }
+        if (m_ShowStatistics)
+        {
+            DrawStatisticsWindow();
+        }
 
         if (ImGui::BeginViewportSideBar("Status Bar", viewport, ImGuiDir_Down, ImGui::GetFrameHeight(), ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_MenuBar))
         {
@@ -513,10 +532,33 @@ namespace Akari
         m_SceneWindowPosY = vMin.y;
 
         DrawGizmo();
+
+        // Left click selects the closest object under the cursor, unless the gizmo or the camera takes it
+        if (m_IsSceneWindowHovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !ImGuizmo::IsOver() && !ImGuizmo::IsUsing() &&
+            !Input::IsKeyPressed(KeyCode::LeftAlt))
+        {
+            PickSceneObject();
+        }
         
         ImGui::End();
     }
 
+    void ImGuiLayer::PickSceneObject()
+    {
+        auto& scene = Application::Get().GetScene();
+
+        const ImVec2 mouse = ImGui::GetMousePos();
+        const glm::vec2 viewportPoint((mouse.x - m_SceneWindowPosX) / m_SceneWindowWidth, (mouse.y - m_SceneWindowPosY) / m_SceneWindowHeight);
+        if (viewportPoint.x < 0.0f || viewportPoint.x > 1.0f || viewportPoint.y < 0.0f || viewportPoint.y > 1.0f)
+            return;
+
+        glm::vec3 origin, direction;
+        scene.GetCamera()->ScreenPointToRay(viewportPoint, origin, direction);
+
+        const auto pick = ScenePicker(scene).Pick(origin, direction);
+        m_SelectedSceneObject = pick ? pick->Object.GetUUID() : UUID(0);
+    }
+
     void ImGuiLayer::DrawHierarchyWindow()
     {
         ImGuiWindowFlags windowFlags = ImGuiWindowFlags_MenuBar;
@@ -577,6 +619,14 @@ namespace Akari
 
                     m_SelectedSceneObject = dirLight.GetUUID();
                 }
+
+                if (ImGui::MenuItem("Point Light"))
+                {
+                    auto pointLight = scene.CreateSceneObject("Point Light");
+                    pointLight.AddComponent<PointLightComponent>();
+
+                    m_SelectedSceneObject = pointLight.GetUUID();
+                }
                 
                 ImGui::EndMenu();
             }
@@ -584,11 +634,34 @@ namespace Akari
             ImGui::EndMenuBar();
         }
 
-        const auto entities = scene.GetAllSceneObjectsWith<IDComponent, RelationshipComponent>();
-        for (const auto entity : entities)
+        ImGui::InputTextWithHint("##HierarchyFilter", "Filter", m_HierarchyFilter, sizeof(m_HierarchyFilter));
+
+        if (m_HierarchyFilter[0] != '\0')
         {
-            SceneObject obj(entity, &scene);
-            DrawHierarchyNode(obj);
+            // Flat list of prefix matches straight from the scene's name index
+            for (auto obj : scene.FindSceneObjectsWithPrefix(m_HierarchyFilter))
+            {
+                const auto id = obj.GetUUID();
+                ImGui::PushID(static_cast<int>(static_cast<uint32_t>(obj)));
+                if (ImGui::Selectable(obj.Name().c_str(), id == m_SelectedSceneObject))
+                {
+                    m_SelectedSceneObject = id;
+                }
+                ImGui::PopID();
+            }
+        }
+        else
+        {
+            // Children are drawn by their parent's node
+            const auto entities = scene.GetAllSceneObjectsWith<IDComponent, HierarchyComponent>();
+            for (const auto entity : entities)
+            {
+                if (entities.get<HierarchyComponent>(entity).Parent != entt::null)
+                    continue;
+
+                SceneObject obj(entity, &scene);
+                DrawHierarchyNode(obj);
+            }
         }
         
         ImGui::End();
@@ -611,16 +684,14 @@ namespace Akari
             const auto& scene = Application::Get().GetScene();
             auto obj = scene.GetSceneObjectWithUUID(m_SelectedSceneObject);
             
-            auto& nameComp = obj.GetComponent<NameComponent>();
+            const auto& nameComp = obj.GetComponent<NameComponent>();
             constexpr size_t nameBufferSize = 256;
             char nameBuffer[nameBufferSize] = {};
             strcpy_s(nameBuffer, nameComp.Name.c_str());
 
             if (ImGui::InputText("Name", nameBuffer, nameBufferSize, ImGuiInputTextFlags_EnterReturnsTrue))
             {
-                std::string& originalName = nameComp.Name;
-                const std::string newName(nameBuffer);
-                originalName = newName;
+                obj.SetName(nameBuffer);
             }
 
             ImGui::Spacing();
@@ -633,9 +704,11 @@ namespace Akari
             auto& position = transComp.Translation;
             auto& rotation = transComp.Rotation;
             auto& scale = transComp.Scale;
-            ImGui::DragFloat3("Position", value_ptr(position), 0.01f);
-            ImGui::DragFloat3("Rotation", value_ptr(rotation), 0.01f);
-            ImGui::DragFloat3("Scale", value_ptr(scale), 0.01f);
+            bool transformChanged = ImGui::DragFloat3("Position", value_ptr(position), 0.01f);
+            transformChanged |= ImGui::DragFloat3("Rotation", value_ptr(rotation), 0.01f);
+            transformChanged |= ImGui::DragFloat3("Scale", value_ptr(scale), 0.01f);
+            if (transformChanged)
+                transComp.MarkDirty();
 
             if (obj.HasComponent<DirectionalLightComponent>())
             {
@@ -654,6 +727,21 @@ namespace Akari
                 ImGui::DragFloat("Shadow Amount", &dirLightComp.ShadowAmount, 0.1f);
             }
 
+            if (obj.HasComponent<PointLightComponent>())
+            {
+                ImGui::Spacing();
+                ImGui::Separator();
+                ImGui::Spacing();
+                ImGui::Text("Point Light");
+                ImGui::Spacing();
+                
+                auto& pointLightComp = obj.GetComponent<PointLightComponent>();
+                ImGui::ColorEdit3("Radiance", value_ptr(pointLightComp.Radiance));
+                ImGui::DragFloat("Intensity", &pointLightComp.Intensity, 0.1f);
+                ImGui::DragFloat("Radius", &pointLightComp.Radius, 0.1f, 0.0f, FLT_MAX);
+                ImGui::DragFloat("Falloff", &pointLightComp.Falloff, 0.01f, 0.0f, 1.0f);
+            }
+
             if (obj.HasComponent<ModelComponent>())
             {
                 ImGui::Spacing();
@@ -662,6 +750,19 @@ namespace Akari
                 ImGui::Text("Model");
                 ImGui::Spacing();
 
+                // No component leaves the choice to the occlusion culling
+                const char* occluderModes[] = { "Auto", "Always", "Never" };
+                int occluderMode = obj.HasComponent<OccluderComponent>() ? (obj.GetComponent<OccluderComponent>().Enabled ? 1 : 2) : 0;
+                if (ImGui::Combo("Occluder", &occluderMode, occluderModes, IM_ARRAYSIZE(occluderModes)))
+                {
+                    if (occluderMode == 0)
+                        obj.RemoveComponent<OccluderComponent>();
+                    else if (obj.HasComponent<OccluderComponent>())
+                        obj.GetComponent<OccluderComponent>().Enabled = occluderMode == 1;
+                    else
+                        obj.AddComponent<OccluderComponent>().Enabled = occluderMode == 1;
+                }
+
                 const auto& modelComp = obj.GetComponent<ModelComponent>();
                 auto model = ModelManager::GetInstance().GetModelByID(modelComp.ModelID);
                 ModelVisitor visitor;
@@ -752,6 +853,37 @@ namespace Akari
         ImGui::End();
     }
 
+    void ImGuiLayer::DrawStatisticsWindow()
+    {
+        ImGuiWindowFlags windowFlags = 0;
+        ImGui::Begin("Statistics", &m_ShowStatistics, windowFlags);
+
+        const RenderStats& stats = Renderer::GetInstance().GetRenderPipeline()->GetStats();
+
+        ImGui::Text("Frustum Culling");
+        ImGui::Text("Objects culled: %u", stats.Culling.ObjectsCulled);
+        ImGui::Text("Model nodes culled: %u", stats.Culling.NodesCulled);
+        ImGui::Text("Meshes culled: %u, visible: %u", stats.Culling.MeshesCulled, stats.Culling.MeshesVisible);
+
+        ImGui::Separator();
+        ImGui::Text("Cluster Culling");
+        ImGui::Text("Meshlets tested: %u, culled: %u", stats.ClusterCulling.MeshletsTested, stats.ClusterCulling.MeshletsCulled);
+        ImGui::Text("Packets culled: %u", stats.ClusterCulling.PacketsCulled);
+
+        ImGui::Separator();
+        ImGui::Text("Occlusion Culling");
+        ImGui::Text("Occluders: %u (%u triangles)", stats.Occlusion.Occluders, stats.Occlusion.OccluderTriangles);
+        ImGui::Text("Packets culled: %u", stats.Occlusion.PacketsCulled);
+
+        ImGui::Separator();
+        ImGui::Text("Forward Pass");
+        ImGui::Text("Draws: %u (%u instances)", stats.ForwardState.Draws, stats.ForwardState.Instances);
+        ImGui::Text("Pipeline changes: %u", stats.ForwardState.PipelineChanges);
+        ImGui::Text("Material changes: %u", stats.ForwardState.MaterialChanges);
+
+        ImGui::End();
+    }
+
     void ImGuiLayer::DrawHierarchyNode(SceneObject& obj)
     {
         ImGuiTreeNodeFlags flags =
@@ -767,7 +899,7 @@ namespace Akari
             flags |= ImGuiTreeNodeFlags_Selected;
         }
 
-        if (obj.Children().empty())
+        if (!obj.HasChildren())
         {
             flags |= ImGuiTreeNodeFlags_Leaf;
         }
@@ -801,17 +933,15 @@ namespace Akari
 
         if (isOpen)
         {
-            if (obj.Children().empty())
+            if (!obj.HasChildren())
             {
                 ImGui::TreePop();
             }
             else
             {
-                const auto& scene = Application::Get().GetScene();
-                const auto children = obj.Children();
-                for (const auto child : children)
+                // Drag and drop may reparent while drawing, iterate a snapshot
+                for (auto childObj : obj.GetChildren())
                 {
-                    auto childObj = scene.GetSceneObjectWithUUID(child);
                     DrawHierarchyNode(childObj);
                 }
                 ImGui::TreePop();
@@ -864,6 +994,7 @@ namespace Akari
                     entityTransform.Translation = translation;
                     entityTransform.Rotation += deltaRotation;
                     entityTransform.Scale = scale;
+                    entityTransform.MarkDirty();
                 }
                 else
                 {
@@ -874,6 +1005,7 @@ namespace Akari
                     entityTransform.Translation = translation;
                     entityTransform.Rotation += deltaRotation;
                     entityTransform.Scale = scale;
+                    entityTransform.MarkDirty();
                 }
             }
         }
@@ -1023,6 +1155,47 @@ namespace Akari
         }
     }
 
+    void ImGuiLayer::OpenSceneFileDialog(bool save)
+    {
+        static const COMDLG_FILTERSPEC g_FileFilters[] = {
+            { L"Akari Scene", L"*.akscene" },
+            { L"All Files", L"*.*" }
+        };
+
+        ComPtr<IFileDialog> pFileDialog;
+        HRESULT hr = CoCreateInstance( save ? CLSID_FileSaveDialog : CLSID_FileOpenDialog, NULL, CLSCTX_ALL, IID_PPV_ARGS( &pFileDialog ) );
+        if ( FAILED( hr ) )
+            return;
+
+        pFileDialog->SetFileTypes( _countof( g_FileFilters ), g_FileFilters );
+        pFileDialog->SetDefaultExtension( L"akscene" );
+
+        if ( FAILED( pFileDialog->Show( dynamic_cast<WindowsWindow*>(&Application::Get().GetWindow())->GetHandle() ) ) )
+            return;
+
+        ComPtr<IShellItem> pItem;
+        PWSTR pszFilePath;
+        if ( FAILED( pFileDialog->GetResult( &pItem ) ) || FAILED( pItem->GetDisplayName( SIGDN_FILESYSPATH, &pszFilePath ) ) )
+            return;
+
+        const std::filesystem::path path( pszFilePath );
+        CoTaskMemFree( pszFilePath );
+
+        auto& scene = Application::Get().GetScene();
+        SceneSerializer serializer( scene );
+        if ( save )
+        {
+            serializer.Serialize( path );
+        }
+        else
+        {
+            // Models referenced by the file are loaded synchronously
+            scene.Clear();
+            m_SelectedSceneObject = 0;
+            serializer.Deserialize( path );
+        }
+    }
+
     bool ImGuiLayer::LoadModel(const std::wstring path)
     {
         m_IsLoading     = true;
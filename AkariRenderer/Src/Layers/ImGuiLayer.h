@@ -44,6 +44,7 @@ namespace Akari {
         bool m_ShowPropertyWindow = true;
         bool m_ShowToneMappingSettings = false;
         bool m_ShowBloomSettings = false;
+        bool m_ShowStatistics = false;
 
         float m_SceneWindowWidth;
         float m_SceneWindowHeight;
@@ -54,6 +55,7 @@ namespace Akari {
         int m_GizmoMode = 0; // 0 = local
 
         UUID m_SelectedSceneObject{0};
+        char m_HierarchyFilter[128] = {};
 
         ImGuiContext*                        m_pImGuiCtx = nullptr;
         HWND                                 m_hWnd;
@@ -79,12 +81,15 @@ namespace Akari {
         void DrawPropertyWindow();
         void DrawToneMappingSettingsWindow();
         void DrawBloomSettingsWindow();
+        void DrawStatisticsWindow();
 
         void DrawHierarchyNode(SceneObject& obj);
         void DrawGizmo();
+        void PickSceneObject();
         void SetStyle();
 
         void OpenLoadModelDialog();
+        void OpenSceneFileDialog(bool save);
         bool LoadModel(std::wstring path);
 
         bool OnKeyPressedEvent(KeyPressedEvent& e);
@@ -2,6 +2,7 @@
 #include "LogicLayer.h"
 
 #include "ImGuiLayer.h"
+#include "Application/Application.h"
 #include "Input/Input.h"
 #include "RHI/Renderer.h"
 #include "RHI/RenderTarget.h"
@@ -38,6 +39,11 @@ namespace Akari
         const auto height = rt->GetHeight(), width = rt->GetWidth();
         cam->SetViewportSize(width, height);
         cam->OnUpdate(*context.dt);
+
+        {
+            SCOPE_PERF("Scene::OnUpdate");
+            context.scene->OnUpdate(*context.dt);
+        }
     }
 
     void LogicLayer::OnEvent(Event& event)
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "Frustum.h"
+
+#include <emmintrin.h>
+
+namespace Akari
+{
+    Frustum::Frustum(const glm::mat4& viewProjection, bool reversedZ)
+    {
+        // Clip space is [-w, w] in x and y and [0, w] in z, every bound is a combination of matrix rows
+        const glm::mat4 m = glm::transpose(viewProjection);
+
+        const glm::vec4 zMin = m[2];
+        const glm::vec4 zMax = m[3] - m[2];
+
+        m_Planes[Left] = m[3] + m[0];
+        m_Planes[Right] = m[3] - m[0];
+        m_Planes[Bottom] = m[3] + m[1];
+        m_Planes[Top] = m[3] - m[1];
+        m_Planes[Near] = reversedZ ? zMax : zMin;
+        m_Planes[Far] = reversedZ ? zMin : zMax;
+
+        for (auto& plane : m_Planes)
+        {
+            const float length = glm::length(glm::vec3(plane));
+            plane = length > 1e-6f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    FrustumTest Frustum::Test(const DirectX::BoundingBox& box) const
+    {
+        const glm::vec3 center(box.Center.x, box.Center.y, box.Center.z);
+        const glm::vec3 extents(box.Extents.x, box.Extents.y, box.Extents.z);
+
+        FrustumTest result = FrustumTest::Inside;
+        for (const auto& plane : m_Planes)
+        {
+            const glm::vec3 normal(plane);
+            // Signed distance of the center and projected radius of the box on the plane normal
+            const float distance = glm::dot(normal, center) + plane.w;
+            const float radius = glm::dot(glm::abs(normal), extents);
+
+            if (distance < -radius)
+                return FrustumTest::Outside;
+            if (distance < radius)
+                result = FrustumTest::Intersects;
+        }
+
+        return result;
+    }
+
+    FrustumTest Frustum::Test(const glm::vec3& center, float radius) const
+    {
+        FrustumTest result = FrustumTest::Inside;
+        for (const auto& plane : m_Planes)
+        {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            if (distance < -radius)
+                return FrustumTest::Outside;
+            if (distance < radius)
+                result = FrustumTest::Intersects;
+        }
+
+        return result;
+    }
+
+    void Frustum::Cull(const BoundsSoA& boxes, uint8_t* visible) const
+    {
+        const size_t count = boxes.Size();
+        const size_t simdCount = count & ~size_t(3);
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+        // Broadcast the planes once, |n| is what the extents are projected on
+        __m128 nx[PlaneCount], ny[PlaneCount], nz[PlaneCount], nd[PlaneCount];
+        __m128 ax[PlaneCount], ay[PlaneCount], az[PlaneCount];
+        for (int i = 0; i < PlaneCount; ++i)
+        {
+            nx[i] = _mm_set1_ps(m_Planes[i].x);
+            ny[i] = _mm_set1_ps(m_Planes[i].y);
+            nz[i] = _mm_set1_ps(m_Planes[i].z);
+            nd[i] = _mm_set1_ps(m_Planes[i].w);
+            ax[i] = _mm_and_ps(nx[i], signMask);
+            ay[i] = _mm_and_ps(ny[i], signMask);
+            az[i] = _mm_and_ps(nz[i], signMask);
+        }
+
+        // Four boxes against all six planes per iteration
+        for (size_t i = 0; i < simdCount; i += 4)
+        {
+            const __m128 cx = _mm_loadu_ps(&boxes.CenterX[i]);
+            const __m128 cy = _mm_loadu_ps(&boxes.CenterY[i]);
+            const __m128 cz = _mm_loadu_ps(&boxes.CenterZ[i]);
+            const __m128 ex = _mm_loadu_ps(&boxes.ExtentX[i]);
+            const __m128 ey = _mm_loadu_ps(&boxes.ExtentY[i]);
+            const __m128 ez = _mm_loadu_ps(&boxes.ExtentZ[i]);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < PlaneCount; ++p)
+            {
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx[p]), _mm_mul_ps(cy, ny[p])),
+                                                   _mm_add_ps(_mm_mul_ps(cz, nz[p]), nd[p]));
+                const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ax[p]), _mm_mul_ps(ey, ay[p])), _mm_mul_ps(ez, az[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            const int mask = _mm_movemask_ps(inside);
+            visible[i + 0] = static_cast<uint8_t>(mask & 1);
+            visible[i + 1] = static_cast<uint8_t>((mask >> 1) & 1);
+            visible[i + 2] = static_cast<uint8_t>((mask >> 2) & 1);
+            visible[i + 3] = static_cast<uint8_t>((mask >> 3) & 1);
+        }
+
+        CullScalar(boxes, visible, simdCount);
+    }
+
+    void Frustum::CullScalar(const BoundsSoA& boxes, uint8_t* visible, size_t begin) const
+    {
+        for (size_t i = begin; i < boxes.Size(); ++i)
+        {
+            bool inside = true;
+            for (const auto& plane : m_Planes)
+            {
+                const float distance = plane.x * boxes.CenterX[i] + plane.y * boxes.CenterY[i] + plane.z * boxes.CenterZ[i] + plane.w;
+                const float radius = std::abs(plane.x) * boxes.ExtentX[i] + std::abs(plane.y) * boxes.ExtentY[i] + std::abs(plane.z) * boxes.ExtentZ[i];
+                inside &= distance + radius >= 0.0f;
+            }
+            visible[i] = inside ? 1 : 0;
+        }
+    }
+}
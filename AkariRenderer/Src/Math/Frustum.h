@@ -0,0 +1,59 @@
+#pragma once
+#include <DirectXCollision.h>
+
+namespace Akari
+{
+    // World-space AABBs in structure-of-arrays layout, so the culling kernel can load
+    // the same component of several boxes with one instruction.
+    struct BoundsSoA
+    {
+        std::vector<float> CenterX, CenterY, CenterZ;
+        std::vector<float> ExtentX, ExtentY, ExtentZ;
+
+        size_t Size() const { return CenterX.size(); }
+
+        void Clear()
+        {
+            CenterX.clear(); CenterY.clear(); CenterZ.clear();
+            ExtentX.clear(); ExtentY.clear(); ExtentZ.clear();
+        }
+
+        void Add(const DirectX::BoundingBox& box)
+        {
+            CenterX.push_back(box.Center.x); CenterY.push_back(box.Center.y); CenterZ.push_back(box.Center.z);
+            ExtentX.push_back(box.Extents.x); ExtentY.push_back(box.Extents.y); ExtentZ.push_back(box.Extents.z);
+        }
+    };
+
+    enum class FrustumTest : uint8_t
+    {
+        Outside,
+        Intersects,
+        Inside
+    };
+
+    // Six inward facing planes extracted from a view projection matrix, (n, d) with dot(n, p) + d >= 0 inside.
+    class Frustum
+    {
+    public:
+        enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+        Frustum() = default;
+        // With reversed Z the z >= 0 clip plane is the far plane and z <= w the near plane.
+        // Planes that degenerate (infinite far) are replaced by planes that accept everything.
+        explicit Frustum(const glm::mat4& viewProjection, bool reversedZ = true);
+
+        const glm::vec4& GetPlane(Plane plane) const { return m_Planes[plane]; }
+
+        FrustumTest Test(const DirectX::BoundingBox& box) const;
+        FrustumTest Test(const glm::vec3& center, float radius) const;
+
+        // Writes 1 for every box that is at least partially inside, 0 otherwise
+        void Cull(const BoundsSoA& boxes, uint8_t* visible) const;
+        // Reference implementation of Cull, also used for the tail of the SIMD loop
+        void CullScalar(const BoundsSoA& boxes, uint8_t* visible, size_t begin = 0) const;
+
+    private:
+        std::array<glm::vec4, PlaneCount> m_Planes{};
+    };
+}
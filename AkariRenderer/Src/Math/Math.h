@@ -1,9 +1,24 @@
 #pragma once
+#include <DirectXMath.h>
 
 namespace Akari::Math
 {
     bool DecomposeTransform(const glm::mat4& transform, glm::vec3& translation, glm::vec3& rotation, glm::vec3& scale);
 
+    // glm's column-major storage is the row-vector matrix DirectXMath expects
+    inline DirectX::XMMATRIX ToXMMatrix(const glm::mat4& matrix)
+    {
+        return DirectX::XMLoadFloat4x4(reinterpret_cast<const DirectX::XMFLOAT4X4*>(glm::value_ptr(matrix)));
+    }
+
+    // 1 / direction for ray slab tests. Zero components become a huge finite value rather than infinity,
+    // a ray starting on a slab plane then gets 0 instead of 0 * inf = NaN for that plane.
+    inline glm::vec3 SafeInverse(const glm::vec3& direction)
+    {
+        const auto inverse = [](const float value) { return value != 0.0f ? 1.0f / value : std::copysign(1e30f, value); };
+        return { inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+    }
+
     //TODO: Replace with a C++20 concept?
     template<typename T, std::enable_if_t<std::is_integral_v<T>, bool> = true>
     static T DivideAndRoundUp(T dividend, T divisor)
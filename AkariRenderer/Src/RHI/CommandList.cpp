@@ -20,6 +20,7 @@
 #include "RootSignature.h"
 #include "SceneComponents/Model.h"
 #include "SceneComponents/ModelNode.h"
+#include "SceneComponents/TriangleBVH.h"
 #include "ShaderResourceView.h"
 #include "StructuredBuffer.h"
 #include "Texture.h"
@@ -298,13 +299,87 @@ void CommandList::SetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY primitiveTopology
 
 std::shared_ptr<Texture> CommandList::LoadTextureFromFile( const std::wstring& fileName, bool sRGB, bool genMip )
 {
-    std::shared_ptr<Texture> texture;
-    std::filesystem::path                 filePath( fileName );
+    {
+        std::lock_guard<std::mutex> lock( ms_TextureCacheMutex );
+        auto                        iter = ms_TextureCache.find( fileName );
+        if ( iter != ms_TextureCache.end() )
+        {
+            return m_Device.CreateTexture( iter->second );
+        }
+    }
+
+    // Decode outside of the lock, it takes far longer than the upload.
+    ScratchImage scratchImage;
+    DecodeTextureFile( fileName, sRGB, scratchImage );
+
+    return LoadTextureFromImage( fileName, scratchImage, genMip );
+}
+
+void CommandList::DecodeTextureFile( const std::wstring& fileName, bool sRGB, ScratchImage& scratchImage )
+{
+    std::filesystem::path filePath( fileName );
     if ( !std::filesystem::exists( filePath ) )
     {
         throw std::exception( "File not found." );
     }
 
+    TexMetadata metadata;
+
+    if ( filePath.extension() == ".dds" )
+    {
+        ThrowIfFailed( LoadFromDDSFile( fileName.c_str(), DDS_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
+    }
+    else if ( filePath.extension() == ".hdr" )
+    {
+        ThrowIfFailed( LoadFromHDRFile( fileName.c_str(), &metadata, scratchImage ) );
+    }
+    else if ( filePath.extension() == ".tga" )
+    {
+        ThrowIfFailed( LoadFromTGAFile( fileName.c_str(), &metadata, scratchImage ) );
+    }
+    else
+    {
+        ThrowIfFailed( LoadFromWICFile( fileName.c_str(), WIC_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
+    }
+
+    // Force the texture format to be sRGB to convert to linear when sampling the texture in a shader.
+    if ( sRGB && MakeSRGB( metadata.format ) != metadata.format )
+    {
+        scratchImage.OverrideFormat( MakeSRGB( metadata.format ) );
+    }
+}
+
+void CommandList::DecodeTextureMemory( const void* data, size_t size, bool sRGB, ScratchImage& scratchImage )
+{
+    TexMetadata metadata;
+
+    // DDS files start with their magic, WIC recognizes the other container formats by their content.
+    if ( size >= 4 && std::memcmp( data, "DDS ", 4 ) == 0 )
+    {
+        ThrowIfFailed( LoadFromDDSMemory( data, size, DDS_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
+    }
+    else
+    {
+        ThrowIfFailed( LoadFromWICMemory( data, size, WIC_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
+    }
+
+    if ( sRGB && MakeSRGB( metadata.format ) != metadata.format )
+    {
+        scratchImage.OverrideFormat( MakeSRGB( metadata.format ) );
+    }
+}
+
+bool CommandList::IsTextureCached( const std::wstring& fileName )
+{
+    std::lock_guard<std::mutex> lock( ms_TextureCacheMutex );
+    return ms_TextureCache.find( fileName ) != ms_TextureCache.end();
+}
+
+std::shared_ptr<Texture> CommandList::LoadTextureFromImage( const std::wstring& fileName,
+                                                            const ScratchImage& scratchImage, bool genMip )
+{
+    std::shared_ptr<Texture> texture;
+
     std::lock_guard<std::mutex> lock( ms_TextureCacheMutex );
     auto                        iter = ms_TextureCache.find( fileName );
     if ( iter != ms_TextureCache.end() )
@@ -313,31 +388,7 @@ std::shared_ptr<Texture> CommandList::LoadTextureFromFile( const std::wstring& f
     }
     else
     {
-        TexMetadata  metadata;
-        ScratchImage scratchImage;
-
-        if ( filePath.extension() == ".dds" )
-        {
-            ThrowIfFailed( LoadFromDDSFile( fileName.c_str(), DDS_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
-        }
-        else if ( filePath.extension() == ".hdr" )
-        {
-            ThrowIfFailed( LoadFromHDRFile( fileName.c_str(), &metadata, scratchImage ) );
-        }
-        else if ( filePath.extension() == ".tga" )
-        {
-            ThrowIfFailed( LoadFromTGAFile( fileName.c_str(), &metadata, scratchImage ) );
-        }
-        else
-        {
-            ThrowIfFailed( LoadFromWICFile( fileName.c_str(), WIC_FLAGS_FORCE_RGB, &metadata, scratchImage ) );
-        }
-
-        // Force the texture format to be sRGB to convert to linear when sampling the texture in a shader.
-        if ( sRGB )
-        {
-            metadata.format = MakeSRGB( metadata.format );
-        }
+        const TexMetadata& metadata = scratchImage.GetMetadata();
 
         D3D12_RESOURCE_DESC textureDesc = {};
         switch ( metadata.dimension )
@@ -1015,7 +1066,10 @@ std::shared_ptr<Model> CommandList::CreateModel( const VertexCollection& vertice
         return nullptr;
     }
 
-    auto vertexBuffer = CopyVertexBuffer( vertices );
+    // Encode into the compact vertex format the lit and shadow passes read.
+    const std::vector<VertexPositionQTangentTexture> packedVertices( vertices.begin(), vertices.end() );
+
+    auto vertexBuffer = CopyVertexBuffer( packedVertices );
     auto indexBuffer  = CopyIndexBuffer( indices );
 
     auto mesh = std::make_shared<Mesh>();
@@ -1026,6 +1080,17 @@ std::shared_ptr<Model> CommandList::CreateModel( const VertexCollection& vertice
     mesh->SetIndexBuffer( indexBuffer );
     mesh->SetMaterial( material );
 
+    // CPU copy of the geometry for ray queries, its bounds are exact unlike the default AABB.
+    std::vector<glm::vec3> positions( vertices.size() );
+    for ( size_t i = 0; i < vertices.size(); ++i )
+    {
+        positions[i] = { vertices[i].Position.x, vertices[i].Position.y, vertices[i].Position.z };
+    }
+    const std::vector<uint32_t> triangleIndices( indices.begin(), indices.end() );
+    auto triangleBVH = std::make_shared<TriangleBVH>( positions, triangleIndices );
+    mesh->SetAABB( triangleBVH->GetBounds() );
+    mesh->SetTriangleBVH( triangleBVH );
+
     auto node = std::make_shared<ModelNode>();
     node->AddMesh( mesh );
 
@@ -211,6 +211,28 @@ public:
      */
     std::shared_ptr<Texture> LoadTextureFromFile( const std::wstring& fileName, bool sRGB = false, bool genMip = true );
 
+    /**
+     * Decode a texture file into system memory. Doesn't use the device or the texture cache,
+     * so it can run on worker threads. The image is uploaded with LoadTextureFromImage.
+     */
+    static void DecodeTextureFile( const std::wstring& fileName, bool sRGB, DirectX::ScratchImage& scratchImage );
+
+    /**
+     * Decode a texture file that was read into memory, like an image embedded in a model file.
+     */
+    static void DecodeTextureMemory( const void* data, size_t size, bool sRGB, DirectX::ScratchImage& scratchImage );
+
+    /**
+     * Check if a texture file was already loaded, it doesn't need to be decoded again.
+     */
+    static bool IsTextureCached( const std::wstring& fileName );
+
+    /**
+     * Upload a texture decoded from a file. Returns the cached texture if the file was already loaded.
+     */
+    std::shared_ptr<Texture> LoadTextureFromImage( const std::wstring& fileName, const DirectX::ScratchImage& scratchImage,
+                                                   bool genMip = true );
+
     /**
      * Load a scene file.
      *
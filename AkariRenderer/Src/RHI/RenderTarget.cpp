@@ -116,7 +116,7 @@ DXGI_FORMAT RenderTarget::GetDepthStencilFormat() const
     auto depthStencilTexture = m_Textures[AttachmentPoint::DepthStencil];
     if ( depthStencilTexture )
     {
-        dsvFormat = depthStencilTexture->GetD3D12ResourceDesc().Format;
+        dsvFormat = Texture::GetDepthFormat( depthStencilTexture->GetD3D12ResourceDesc().Format );
     }
 
     return dsvFormat;
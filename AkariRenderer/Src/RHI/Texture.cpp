@@ -119,14 +119,26 @@ void Texture::CreateViews()
                                                  m_RenderTargetView.GetDescriptorHandle() );
         }
         // Create DSV
-        if ( ( desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL ) != 0 && CheckDSVSupport() )
+        const DXGI_FORMAT depthFormat = GetDepthFormat( desc.Format );
+        if ( ( desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL ) != 0 && depthFormat != desc.Format )
+        {
+            // Typeless depth resources need an explicit view format.
+            D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+            dsvDesc.Format        = depthFormat;
+            dsvDesc.ViewDimension = desc.SampleDesc.Count > 1 ? D3D12_DSV_DIMENSION_TEXTURE2DMS : D3D12_DSV_DIMENSION_TEXTURE2D;
+
+            m_DepthStencilView = m_Device.AllocateDescriptors( D3D12_DESCRIPTOR_HEAP_TYPE_DSV );
+            d3d12Device->CreateDepthStencilView( m_d3d12Resource.Get(), &dsvDesc,
+                                                 m_DepthStencilView.GetDescriptorHandle() );
+        }
+        else if ( ( desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL ) != 0 && CheckDSVSupport() )
         {
             m_DepthStencilView = m_Device.AllocateDescriptors( D3D12_DESCRIPTOR_HEAP_TYPE_DSV );
             d3d12Device->CreateDepthStencilView( m_d3d12Resource.Get(), nullptr,
                                                  m_DepthStencilView.GetDescriptorHandle() );
         }
-        // Create SRV
-        if ( ( desc.Flags & D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE ) == 0 && CheckSRVSupport() )
+        // Create SRV, sampled typeless depth resources pick their format with an explicit view.
+        if ( ( desc.Flags & D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE ) == 0 && depthFormat == desc.Format && CheckSRVSupport() )
         {
             m_ShaderResourceView = m_Device.AllocateDescriptors( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
             d3d12Device->CreateShaderResourceView( m_d3d12Resource.Get(), nullptr,
@@ -475,3 +487,26 @@ DXGI_FORMAT Texture::GetUAVCompatableFormat( DXGI_FORMAT format )
 
     return uavFormat;
 }
+
+DXGI_FORMAT Texture::GetDepthFormat( DXGI_FORMAT format )
+{
+    DXGI_FORMAT depthFormat = format;
+
+    switch ( format )
+    {
+    case DXGI_FORMAT_R32_TYPELESS:
+        depthFormat = DXGI_FORMAT_D32_FLOAT;
+        break;
+    case DXGI_FORMAT_R16_TYPELESS:
+        depthFormat = DXGI_FORMAT_D16_UNORM;
+        break;
+    case DXGI_FORMAT_R24G8_TYPELESS:
+        depthFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        break;
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+        depthFormat = DXGI_FORMAT_D32_FLOAT_S8X24_UINT;
+        break;
+    }
+
+    return depthFormat;
+}
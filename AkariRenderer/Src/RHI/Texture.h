@@ -109,6 +109,8 @@ public:
     // Return an sRGB format in the same format family.
     static DXGI_FORMAT GetSRGBFormat( DXGI_FORMAT format );
     static DXGI_FORMAT GetUAVCompatableFormat( DXGI_FORMAT format );
+    // Return the depth format to view a typeless depth resource with, so it can also be sampled.
+    static DXGI_FORMAT GetDepthFormat( DXGI_FORMAT format );
 
 protected:
     Texture( Device& device, const D3D12_RESOURCE_DESC& resourceDesc, const D3D12_CLEAR_VALUE* clearValue = nullptr );
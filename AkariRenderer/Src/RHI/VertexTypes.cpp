@@ -3,6 +3,8 @@
 #include "VertexTypes.h"
 
 using namespace Akari;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
 
 // clang-format off
 const D3D12_INPUT_ELEMENT_DESC VertexPosition::InputElements[] = { 
@@ -26,4 +28,76 @@ const D3D12_INPUT_LAYOUT_DESC VertexPositionNormalTangentBitangentTexture::Input
     VertexPositionNormalTangentBitangentTexture::InputElements,
     VertexPositionNormalTangentBitangentTexture::InputElementCount
 };
-// clang-format on
\ No newline at end of file
+const D3D12_INPUT_ELEMENT_DESC VertexPositionQTangentTexture::InputElements[] = {
+    { "POSITION",     0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TANGENTFRAME", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD",     0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+const D3D12_INPUT_LAYOUT_DESC VertexPositionQTangentTexture::InputLayout = {
+    VertexPositionQTangentTexture::InputElements,
+    VertexPositionQTangentTexture::InputElementCount
+};
+// clang-format on
+
+static_assert( sizeof( VertexPositionQTangentTexture ) == 24 );
+
+VertexPositionQTangentTexture::VertexPositionQTangentTexture( const VertexPositionNormalTangentBitangentTexture& vertex )
+: Position( vertex.Position )
+, TexCoord( vertex.TexCoord.x, vertex.TexCoord.y )
+{
+    glm::vec3 normal( vertex.Normal.x, vertex.Normal.y, vertex.Normal.z );
+    normal = glm::length( normal ) > 0.0f ? glm::normalize( normal ) : glm::vec3( 0.0f, 0.0f, 1.0f );
+
+    // Orthogonalize the tangent against the normal, or make one up if it has none.
+    glm::vec3 tangent( vertex.Tangent.x, vertex.Tangent.y, vertex.Tangent.z );
+    tangent -= normal * glm::dot( normal, tangent );
+    if ( glm::length( tangent ) < 1e-6f )
+    {
+        tangent = glm::cross( normal, std::abs( normal.x ) < 0.9f ? glm::vec3( 1.0f, 0.0f, 0.0f ) : glm::vec3( 0.0f, 1.0f, 0.0f ) );
+    }
+    tangent = glm::normalize( tangent );
+    const glm::vec3 bitangent = glm::cross( normal, tangent );
+
+    // The columns tangent, bitangent and normal form a rotation, q and -q are the same rotation.
+    glm::quat q = glm::normalize( glm::quat_cast( glm::mat3( tangent, bitangent, normal ) ) );
+    if ( q.w < 0.0f )
+    {
+        q = -q;
+    }
+
+    // Keep w away from 0 so its sign survives the quantization to 16 bits.
+    constexpr float minW = 1.0f / 32767.0f;
+    if ( q.w < minW )
+    {
+        const float xyzScale = std::sqrt( 1.0f - minW * minW ) / glm::length( glm::vec3( q.x, q.y, q.z ) );
+        q = glm::quat( minW, q.x * xyzScale, q.y * xyzScale, q.z * xyzScale );
+    }
+
+    // A negative w flips the bitangent, for mirrored texture coordinates.
+    if ( glm::dot( bitangent, glm::vec3( vertex.Bitangent.x, vertex.Bitangent.y, vertex.Bitangent.z ) ) < 0.0f )
+    {
+        q = -q;
+    }
+
+    TangentFrame = XMSHORTN4( q.x, q.y, q.z, q.w );
+}
+
+VertexPositionNormalTangentBitangentTexture VertexPositionQTangentTexture::Decode() const
+{
+    XMFLOAT4 frame;
+    XMStoreFloat4( &frame, XMLoadShortN4( &TangentFrame ) );
+    const glm::vec4 q = glm::normalize( glm::vec4( frame.x, frame.y, frame.z, frame.w ) );
+
+    // The quaternion rotating the X and Z axes, negating it gives the same result.
+    const glm::vec3 tangent( 1.0f - 2.0f * ( q.y * q.y + q.z * q.z ), 2.0f * ( q.x * q.y + q.w * q.z ),
+                             2.0f * ( q.x * q.z - q.w * q.y ) );
+    const glm::vec3 normal( 2.0f * ( q.x * q.z + q.w * q.y ), 2.0f * ( q.y * q.z - q.w * q.x ),
+                            1.0f - 2.0f * ( q.x * q.x + q.y * q.y ) );
+    const glm::vec3 bitangent = glm::cross( normal, tangent ) * ( q.w < 0.0f ? -1.0f : 1.0f );
+
+    return VertexPositionNormalTangentBitangentTexture(
+        Position, XMFLOAT3( normal.x, normal.y, normal.z ),
+        XMFLOAT3( XMConvertHalfToFloat( TexCoord.x ), XMConvertHalfToFloat( TexCoord.y ), 0.0f ),
+        XMFLOAT3( tangent.x, tangent.y, tangent.z ), XMFLOAT3( bitangent.x, bitangent.y, bitangent.z ) );
+}
\ No newline at end of file
@@ -30,6 +30,8 @@
  *  @brief Vertex type definitions.
  */
 
+#include <DirectXPackedVector.h>  // For XMSHORTN4 and XMHALF2
+
 namespace Akari
 {
 
@@ -93,4 +95,45 @@ private:
     static const int                      InputElementCount = 5;
     static const D3D12_INPUT_ELEMENT_DESC InputElements[InputElementCount];
 };
+
+/**
+ * Compact vertex of 24 bytes instead of 60, used for all meshes drawn by the lit and shadow passes.
+ * The normal, tangent and bitangent are stored as a quaternion rotating the X and Z axes onto the tangent
+ * and the normal (QTangent), the sign of its w component flips the bitangent for mirrored UVs.
+ * The texture coordinate is stored as half floats, the position is kept at full precision so meshes
+ * sharing edges stay watertight.
+ */
+struct VertexPositionQTangentTexture
+{
+    VertexPositionQTangentTexture() = default;
+
+    /**
+     * Encode a vertex. A missing or degenerate tangent is replaced by an arbitrary one perpendicular to the normal.
+     */
+    explicit VertexPositionQTangentTexture( const VertexPositionNormalTangentBitangentTexture& vertex );
+
+    /**
+     * Decode the vertex the way Lit_VS does, the texture coordinate's z is 0.
+     */
+    VertexPositionNormalTangentBitangentTexture Decode() const;
+
+    DirectX::XMFLOAT3                   Position;
+    DirectX::PackedVector::XMSHORTN4    TangentFrame;
+    DirectX::PackedVector::XMHALF2      TexCoord;
+
+    /**
+     * Largest angle in radians between an encoded unit normal or tangent and its decoded version.
+     */
+    static constexpr float MaxFrameError = 1e-3f;
+
+    /**
+     * Largest texture coordinate error relative to the coordinate's magnitude, with a floor of 1 at 0.
+     */
+    static constexpr float MaxTexCoordError = 1.0f / 2048.0f;
+
+    static const D3D12_INPUT_LAYOUT_DESC InputLayout;
+private:
+    static const int                      InputElementCount = 3;
+    static const D3D12_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+};
 }  // namespace Akari
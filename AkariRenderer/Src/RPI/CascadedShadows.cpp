@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "CascadedShadows.h"
+
+#include <ppl.h>
+
+namespace Akari
+{
+    void CascadedShadows::Update(const glm::mat4& cameraView, float verticalFov, float aspectRatio, float nearClip, float farClip,
+                                 const glm::vec3& lightDirection, uint32_t resolution)
+    {
+        // The slice spheres enclose the frustum corners, a wrong horizontal extent clips the shadows at the edges
+        assert(std::isfinite(aspectRatio) && aspectRatio > 0.0f);
+        m_InverseCameraView = glm::inverse(cameraView);
+        m_TanHalfFovY = std::tan(verticalFov * 0.5f);
+        m_TanHalfFovX = m_TanHalfFovY * aspectRatio;
+        m_NearClip = nearClip;
+        m_ShadowDistance = std::min(farClip, MaxShadowDistance);
+        m_LightDirection = glm::normalize(lightDirection);
+        m_Resolution = resolution;
+
+        float splitNear = nearClip;
+        for (uint32_t i = 0; i < CascadeCount; ++i)
+        {
+            // Practical split scheme, logarithmic splits keep the texel density even over depth
+            // but leave the first cascades tiny, the uniform share keeps them usable
+            const float ratio = static_cast<float>(i + 1) / CascadeCount;
+            const float uniformSplit = nearClip + (m_ShadowDistance - nearClip) * ratio;
+            const float logSplit = nearClip * std::pow(m_ShadowDistance / nearClip, ratio);
+            const float splitFar = glm::mix(uniformSplit, logSplit, SplitLambda);
+
+            ShadowCascade& cascade = m_Cascades[i];
+            cascade.SplitNear = splitNear;
+            cascade.SplitFar = splitFar;
+
+            float centerDepth;
+            GetSliceSphere(splitNear, splitFar, centerDepth, cascade.Radius);
+            cascade.Center = glm::vec3(m_InverseCameraView * glm::vec4(0.0f, 0.0f, centerDepth, 1.0f));
+            cascade.TexelSize = 2.0f * cascade.Radius / static_cast<float>(resolution);
+
+            cascade.View = GetLightView(cascade.Center, cascade.Radius);
+            cascade.Projection = GetProjection(cascade, 0.0f);
+            cascade.ViewProjection = cascade.Projection * cascade.View;
+
+            m_Casters[i].clear();
+            splitNear = splitFar;
+        }
+    }
+
+    void CascadedShadows::CullCasters(const BoundsSoA& casters)
+    {
+        const auto casterCount = static_cast<uint32_t>(casters.Size());
+        const uint32_t chunkCount = (casterCount + CasterChunkSize - 1) / CasterChunkSize;
+        m_CasterMasks.resize(casterCount);
+        m_ChunkNearDepths.resize(chunkCount);
+
+        // The light views of all cascades share their rotation, only their translation differs
+        const glm::mat3 rotation(m_Cascades[0].View);
+        const glm::mat3 absRotation(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+        std::array<glm::vec3, CascadeCount> translations;
+        for (uint32_t i = 0; i < CascadeCount; ++i)
+            translations[i] = glm::vec3(m_Cascades[i].View[3]);
+
+        concurrency::parallel_for(0u, chunkCount, [&](const uint32_t chunk)
+        {
+            auto& nearDepths = m_ChunkNearDepths[chunk];
+            nearDepths.fill(0.0f);
+
+            const uint32_t end = std::min(casterCount, (chunk + 1) * CasterChunkSize);
+            for (uint32_t c = chunk * CasterChunkSize; c < end; ++c)
+            {
+                const glm::vec3 center = rotation * glm::vec3(casters.CenterX[c], casters.CenterY[c], casters.CenterZ[c]);
+                const glm::vec3 extents = absRotation * glm::vec3(casters.ExtentX[c], casters.ExtentY[c], casters.ExtentZ[c]);
+
+                uint8_t mask = 0;
+                for (uint32_t i = 0; i < CascadeCount; ++i)
+                {
+                    const glm::vec3 lightSpaceCenter = center + translations[i];
+                    const float radius = m_Cascades[i].Radius;
+
+                    // Inside the projection sideways and not behind the cascade, any distance towards the light
+                    if (std::abs(lightSpaceCenter.x) - extents.x > radius ||
+                        std::abs(lightSpaceCenter.y) - extents.y > radius ||
+                        lightSpaceCenter.z - extents.z > 2.0f * radius)
+                        continue;
+
+                    mask |= static_cast<uint8_t>(BIT(i));
+                    nearDepths[i] = std::min(nearDepths[i], lightSpaceCenter.z - extents.z);
+                }
+                m_CasterMasks[c] = mask;
+            }
+        });
+
+        for (uint32_t i = 0; i < CascadeCount; ++i)
+        {
+            auto& cascadeCasters = m_Casters[i];
+            cascadeCasters.clear();
+            for (uint32_t c = 0; c < casterCount; ++c)
+            {
+                if (m_CasterMasks[c] & BIT(i))
+                    cascadeCasters.push_back(c);
+            }
+
+            float nearDepth = 0.0f;
+            for (const auto& nearDepths : m_ChunkNearDepths)
+                nearDepth = std::min(nearDepth, nearDepths[i]);
+
+            ShadowCascade& cascade = m_Cascades[i];
+            cascade.Projection = GetProjection(cascade, nearDepth);
+            cascade.ViewProjection = cascade.Projection * cascade.View;
+        }
+    }
+
+    glm::mat4 CascadedShadows::GetCasterViewProjection(const DirectX::BoundingBox& sceneBounds) const
+    {
+        float centerDepth, radius;
+        GetSliceSphere(m_NearClip, m_ShadowDistance, centerDepth, radius);
+        const glm::vec3 center(m_InverseCameraView * glm::vec4(0.0f, 0.0f, centerDepth, 1.0f));
+        const glm::mat4 view = GetLightView(center, radius);
+
+        // The near plane goes back to the scene corner closest to the light
+        DirectX::XMFLOAT3 corners[DirectX::BoundingBox::CORNER_COUNT];
+        sceneBounds.GetCorners(corners);
+        float nearDepth = 0.0f;
+        for (const auto& corner : corners)
+            nearDepth = std::min(nearDepth, (view * glm::vec4(corner.x, corner.y, corner.z, 1.0f)).z);
+
+        return glm::ortho(-radius, radius, -radius, radius, nearDepth, 2.0f * radius) * view;
+    }
+
+    void CascadedShadows::GetSliceSphere(float sliceNear, float sliceFar, float& centerDepth, float& radius) const
+    {
+        // The slice corners are at distance depth * k from the axis, the center is equally far from both rings
+        const float k2 = m_TanHalfFovX * m_TanHalfFovX + m_TanHalfFovY * m_TanHalfFovY;
+        centerDepth = 0.5f * (sliceNear + sliceFar) * (1.0f + k2);
+
+        // Wide slices are bounded by their far ring alone
+        if (centerDepth > sliceFar)
+        {
+            centerDepth = sliceFar;
+            radius = sliceFar * std::sqrt(k2);
+        }
+        else
+        {
+            const float offset = sliceFar - centerDepth;
+            radius = std::sqrt(offset * offset + sliceFar * sliceFar * k2);
+        }
+
+        // Rounded up so floating point noise does not resize the projection from frame to frame
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+    }
+
+    glm::mat4 CascadedShadows::GetLightView(const glm::vec3& center, float radius) const
+    {
+        // The up vector only depends on the light direction, so every cascade shares one rotation
+        const glm::vec3 up = std::abs(m_LightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::lookAt(center - m_LightDirection * radius, center, up);
+    }
+
+    glm::mat4 CascadedShadows::GetProjection(const ShadowCascade& cascade, float nearDepth) const
+    {
+        const float radius = cascade.Radius;
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, nearDepth, 2.0f * radius);
+
+        // Offset so the world origin lands on a texel corner, every other point then keeps its place in the texel grid
+        const glm::vec4 origin = projection * cascade.View * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        const glm::vec2 texel = glm::vec2(origin) * (static_cast<float>(m_Resolution) * 0.5f);
+        const glm::vec2 offset = (glm::round(texel) - texel) * (2.0f / static_cast<float>(m_Resolution));
+        projection[3][0] += offset.x;
+        projection[3][1] += offset.y;
+        return projection;
+    }
+}
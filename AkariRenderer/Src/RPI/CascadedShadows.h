@@ -0,0 +1,76 @@
+#pragma once
+#include <span>
+
+#include "Math/Frustum.h"
+
+namespace Akari
+{
+    struct ShadowCascade
+    {
+        // Camera view depths covered by the cascade
+        float SplitNear = 0.0f;
+        float SplitFar = 0.0f;
+        // Bounding sphere of the camera frustum slice in world space, its radius only depends on the split
+        glm::vec3 Center{ 0.0f };
+        float Radius = 0.0f;
+        // World size of a shadow map texel
+        float TexelSize = 0.0f;
+
+        glm::mat4 View{ 1.0f };
+        // Orthographic, moved in whole texels, depth 0 at the caster nearest to the light
+        glm::mat4 Projection{ 1.0f };
+        glm::mat4 ViewProjection{ 1.0f };
+    };
+
+    // CPU side of cascaded shadow maps for a directional light, independent of the renderer.
+    // Splits blend uniform and logarithmic distributions. Every cascade is fit around the bounding sphere of its
+    // frustum slice, so its projection keeps its size while the camera turns, and only moves in whole texels,
+    // so shadow edges do not shimmer while the camera moves.
+    class CascadedShadows
+    {
+    public:
+        static constexpr uint32_t CascadeCount = 4;
+        // 0 for uniform splits, 1 for logarithmic splits
+        static constexpr float SplitLambda = 0.8f;
+        // Shadows end here even if the camera sees farther
+        static constexpr float MaxShadowDistance = 150.0f;
+        // Casters per CullCasters task
+        static constexpr uint32_t CasterChunkSize = 1024;
+
+        // lightDirection is the direction the light travels in, resolution the shadow map size of one cascade
+        void Update(const glm::mat4& cameraView, float verticalFov, float aspectRatio, float nearClip, float farClip,
+                    const glm::vec3& lightDirection, uint32_t resolution);
+
+        // Sorts the casters into the cascades they can shadow and pulls the near plane of every cascade back to its
+        // caster nearest to the light, casters between the light and a cascade are kept.
+        void CullCasters(const BoundsSoA& casters);
+
+        // Volume of every cascade extended towards the light up to sceneBounds, for gathering caster candidates
+        glm::mat4 GetCasterViewProjection(const DirectX::BoundingBox& sceneBounds) const;
+
+        const std::array<ShadowCascade, CascadeCount>& GetCascades() const { return m_Cascades; }
+        std::span<const uint32_t> GetCasters(uint32_t cascade) const { return m_Casters[cascade]; }
+
+    private:
+        // Bounding sphere of the camera frustum between two view depths, in view space it lies on the z axis
+        void GetSliceSphere(float sliceNear, float sliceFar, float& centerDepth, float& radius) const;
+        glm::mat4 GetLightView(const glm::vec3& center, float radius) const;
+        // Orthographic projection around a sphere, snapped to the texel grid of the cascade's shadow map
+        glm::mat4 GetProjection(const ShadowCascade& cascade, float nearDepth) const;
+
+        glm::mat4 m_InverseCameraView{ 1.0f };
+        float m_TanHalfFovY = 0.0f;
+        float m_TanHalfFovX = 0.0f;
+        float m_NearClip = 0.0f;
+        float m_ShadowDistance = 0.0f;
+        glm::vec3 m_LightDirection{ 0.0f, -1.0f, 0.0f };
+        uint32_t m_Resolution = 1;
+
+        std::array<ShadowCascade, CascadeCount> m_Cascades{};
+        std::array<std::vector<uint32_t>, CascadeCount> m_Casters;
+
+        // Per-frame scratch of CullCasters, a bit per cascade for every caster and the nearest caster per chunk
+        std::vector<uint8_t> m_CasterMasks;
+        std::vector<std::array<float, CascadeCount>> m_ChunkNearDepths;
+    };
+}
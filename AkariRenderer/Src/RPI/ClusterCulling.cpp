@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "ClusterCulling.h"
+
+#include <ppl.h>
+
+#include "Math/Frustum.h"
+#include "SceneComponents/Mesh.h"
+#include "SceneComponents/Meshlets.h"
+#include "SceneComponents/Camera/EditorCamera.h"
+
+namespace Akari
+{
+    void ClusterCulling::Cull(const EditorCamera& camera, DrawPacketList& packets)
+    {
+        m_Stats = {};
+
+        const Frustum frustum(camera.GetViewProjection());
+        const glm::vec3 eye = camera.GetPosition();
+
+        m_Visible.assign(packets.Size(), 1);
+        m_MeshletsTested.assign(packets.Size(), 0);
+        concurrency::parallel_for(size_t(0), packets.Size(), [&](const size_t i)
+        {
+            const MeshletData* meshlets = packets.Meshes[i]->GetMeshlets();
+            if (!meshlets || meshlets->Meshlets.empty())
+                return;
+            if (!m_CullBackfaces && frustum.Test(packets.WorldAABBs[i]) == FrustumTest::Inside)
+                return;
+
+            // Spheres scale with the largest axis of the world matrix, the cone test runs in mesh space
+            // as an affine transform keeps the side of a triangle a point is on
+            const glm::mat4& world = packets.WorldMatrices[i];
+            const float worldScale = std::sqrt(std::max({ glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+                                                          glm::dot(glm::vec3(world[1]), glm::vec3(world[1])),
+                                                          glm::dot(glm::vec3(world[2]), glm::vec3(world[2])) }));
+            const glm::vec3 cameraPosition = glm::vec3(glm::inverse(world) * glm::vec4(eye, 1.0f));
+
+            // One visible meshlet is enough to keep the packet
+            bool visible = false;
+            uint32_t tested = 0;
+            for (const MeshletBounds& bounds : meshlets->Bounds)
+            {
+                tested++;
+                if (IsVisible(bounds, world, worldScale, frustum, cameraPosition, m_CullBackfaces))
+                {
+                    visible = true;
+                    break;
+                }
+            }
+
+            m_MeshletsTested[i] = tested;
+            m_Visible[i] = visible ? 1 : 0;
+        });
+
+        for (size_t i = 0; i < packets.Size(); ++i)
+        {
+            const uint32_t tested = m_MeshletsTested[i];
+            m_Stats.MeshletsTested += tested;
+            m_Stats.MeshletsCulled += m_Visible[i] && tested > 0 ? tested - 1 : tested;
+        }
+
+        m_Stats.PacketsCulled = static_cast<uint32_t>(std::ranges::count(m_Visible, 0));
+        if (m_Stats.PacketsCulled > 0)
+            packets.Compact(m_Visible);
+    }
+
+    bool ClusterCulling::IsVisible(const MeshletBounds& bounds, const glm::mat4& world, float worldScale, const Frustum& frustum,
+                                   const glm::vec3& cameraPosition, bool cullBackfaces)
+    {
+        if (cullBackfaces && IsMeshletBackfacing(bounds, cameraPosition))
+            return false;
+
+        const glm::vec3 center = glm::vec3(world * glm::vec4(bounds.Center, 1.0f));
+        return frustum.Test(center, bounds.Radius * worldScale) != FrustumTest::Outside;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "DrawPacketList.h"
+
+namespace Akari
+{
+    class EditorCamera;
+    class Frustum;
+    struct MeshletBounds;
+
+    struct ClusterCullingStats
+    {
+        // Testing a packet stops at its first visible meshlet
+        uint32_t MeshletsTested = 0;
+        uint32_t MeshletsCulled = 0;
+        uint32_t PacketsCulled = 0;
+    };
+
+    // Culls the packets of meshes split into meshlets per meshlet. A packet whose bounds cross the frustum
+    // is dropped when none of its meshlets' bounding spheres touch the frustum, or face the camera when
+    // back faces are culled. Meshes without meshlets and packets inside the frustum are kept as they are.
+    class ClusterCulling
+    {
+    public:
+        // Removes the packets without a visible meshlet from the list
+        void Cull(const EditorCamera& camera, DrawPacketList& packets);
+
+        // The frustum and backface cone test of one meshlet, cameraPosition is in mesh space
+        static bool IsVisible(const MeshletBounds& bounds, const glm::mat4& world, float worldScale, const Frustum& frustum,
+                              const glm::vec3& cameraPosition, bool cullBackfaces);
+
+        // The passes draw both faces of the triangles, the cone test is off until they cull back faces
+        void SetCullBackfaces(bool cullBackfaces) { m_CullBackfaces = cullBackfaces; }
+        bool GetCullBackfaces() const { return m_CullBackfaces; }
+
+        const ClusterCullingStats& GetStats() const { return m_Stats; }
+
+    private:
+        bool m_CullBackfaces = false;
+
+        // Per-frame scratch for Cull
+        std::vector<uint8_t> m_Visible;
+        std::vector<uint32_t> m_MeshletsTested;
+
+        ClusterCullingStats m_Stats;
+    };
+}
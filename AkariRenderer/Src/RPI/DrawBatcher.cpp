@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "DrawBatcher.h"
+
+namespace Akari
+{
+    void DrawBatcher::Build(const DrawPacketList& packets)
+    {
+        m_Batches.clear();
+        m_MaterialBatches.clear();
+
+        const auto count = static_cast<uint32_t>(packets.Size());
+        m_PacketBatches.resize(count);
+        m_PacketIndices.resize(count);
+        m_Instances.resize(count);
+
+        // Assign every packet a batch and count the instances, the mesh and LOD lookup only spans the current material
+        const Material* material = nullptr;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (packets.Materials[i] != material)
+            {
+                material = packets.Materials[i];
+                m_MaterialBatches.clear();
+            }
+
+            auto [iter, inserted] = m_MaterialBatches.try_emplace(std::pair(packets.Meshes[i], packets.Lods[i]), static_cast<uint32_t>(m_Batches.size()));
+            if (!inserted && m_Batches[iter->second].InstanceCount == MaxInstancesPerBatch)
+            {
+                iter->second = static_cast<uint32_t>(m_Batches.size());
+                inserted = true;
+            }
+
+            if (inserted)
+                m_Batches.push_back({ packets.Meshes[i], packets.Materials[i], 0, 0, packets.Lods[i] });
+
+            m_PacketBatches[i] = iter->second;
+            m_Batches[iter->second].InstanceCount++;
+        }
+
+        uint32_t firstInstance = 0;
+        for (DrawBatch& batch : m_Batches)
+        {
+            batch.FirstInstance = firstInstance;
+            firstInstance += batch.InstanceCount;
+            // Reused as the write cursor below and restored afterwards
+            batch.InstanceCount = 0;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            DrawBatch& batch = m_Batches[m_PacketBatches[i]];
+            const uint32_t instance = batch.FirstInstance + batch.InstanceCount++;
+
+            m_PacketIndices[instance] = i;
+            m_Instances[instance].ModelMatrix = packets.WorldMatrices[i];
+            m_Instances[instance].InverseModelMatrix = glm::inverse(packets.WorldMatrices[i]);
+        }
+    }
+}
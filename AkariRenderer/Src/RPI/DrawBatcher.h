@@ -0,0 +1,59 @@
+#pragma once
+#include "DrawPacketList.h"
+
+namespace Akari
+{
+    class Mesh;
+    class Material;
+
+    // Per-instance data read by the lit vertex shader through SV_InstanceID
+    struct alignas(16) InstanceData
+    {
+        glm::mat4 ModelMatrix;
+        glm::mat4 InverseModelMatrix;
+    };
+
+    // One instanced draw of a mesh, its instances are a contiguous range of the batcher's instance list
+    struct DrawBatch
+    {
+        Mesh* BatchMesh;
+        Material* BatchMaterial;
+        uint32_t FirstInstance;
+        uint32_t InstanceCount;
+        uint32_t Lod;
+    };
+
+    // Groups the packets sharing mesh, level of detail and material into instanced draws.
+    // Packets of a material are expected to be contiguous, as after sorting by their keys, a material
+    // seen again after a different one starts new batches. Batches are ordered by their first packet and
+    // instances keep the packet order, so a front to back list stays front to back.
+    class DrawBatcher
+    {
+    public:
+        void Build(const DrawPacketList& packets);
+
+        const std::vector<DrawBatch>& GetBatches() const { return m_Batches; }
+        const std::vector<InstanceData>& GetInstances() const { return m_Instances; }
+        // Source packet of every instance
+        const std::vector<uint32_t>& GetPacketIndices() const { return m_PacketIndices; }
+
+        // Keeps the instance data of a batch well below the 2MB upload buffer pages
+        static constexpr uint32_t MaxInstancesPerBatch = 8192;
+
+    private:
+        std::vector<DrawBatch> m_Batches;
+        std::vector<InstanceData> m_Instances;
+        std::vector<uint32_t> m_PacketIndices;
+
+        // Per-frame scratch
+        struct MeshLodHash
+        {
+            size_t operator()(const std::pair<const Mesh*, uint8_t>& meshLod) const
+            {
+                return std::hash<const Mesh*>()(meshLod.first) ^ meshLod.second;
+            }
+        };
+        std::unordered_map<std::pair<const Mesh*, uint8_t>, uint32_t, MeshLodHash> m_MaterialBatches;
+        std::vector<uint32_t> m_PacketBatches;
+    };
+}
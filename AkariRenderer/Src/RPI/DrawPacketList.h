@@ -0,0 +1,134 @@
+#pragma once
+#include <bit>
+#include <DirectXCollision.h>
+
+namespace Akari
+{
+    class Mesh;
+    class Material;
+
+    enum DrawPacketFlags : uint8_t
+    {
+        DrawPacketFlag_None = 0,
+        // Always rasterized by the occlusion culling, or never considered as occluder
+        DrawPacketFlag_Occluder = BIT(0),
+        DrawPacketFlag_NeverOccluder = BIT(1),
+    };
+
+    enum DrawPass : uint32_t
+    {
+        DrawPass_Opaque = 0,
+    };
+
+    // Draw sort key fields, most significant first: pass, pipeline state, material and view depth.
+    // Sorting by key groups the draws by state and orders the draws of a material front to back.
+    namespace DrawSortKey
+    {
+        constexpr uint32_t PassBits = 4;
+        constexpr uint32_t PipelineBits = 12;
+        constexpr uint32_t MaterialBits = 24;
+        constexpr uint32_t DepthBits = 24;
+
+        constexpr uint32_t DepthShift = 0;
+        constexpr uint32_t MaterialShift = DepthShift + DepthBits;
+        constexpr uint32_t PipelineShift = MaterialShift + MaterialBits;
+        constexpr uint32_t PassShift = PipelineShift + PipelineBits;
+
+        inline uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, float viewDepth)
+        {
+            assert(pass < BIT(PassBits) && pipeline < BIT(PipelineBits) && material < BIT(MaterialBits));
+
+            // Non-negative floats keep their order when compared as integers, the sign bit is always clear
+            // and the lowest mantissa bits are dropped to fit the field
+            const uint32_t depth = std::bit_cast<uint32_t>(std::max(viewDepth, 0.0f)) >> (31 - DepthBits);
+
+            return static_cast<uint64_t>(pass) << PassShift |
+                   static_cast<uint64_t>(pipeline) << PipelineShift |
+                   static_cast<uint64_t>(material) << MaterialShift |
+                   static_cast<uint64_t>(depth) << DepthShift;
+        }
+
+        inline uint32_t GetPipeline(uint64_t key) { return static_cast<uint32_t>(key >> PipelineShift) & (BIT(PipelineBits) - 1); }
+        inline uint32_t GetMaterial(uint64_t key) { return static_cast<uint32_t>(key >> MaterialShift) & (BIT(MaterialBits) - 1); }
+    }
+
+    // Per-frame draw list in structure-of-arrays layout, one entry per mesh to draw.
+    // Filled by RenderExtraction and read by the passes, the pointers stay valid for the frame.
+    struct DrawPacketList
+    {
+        std::vector<glm::mat4> WorldMatrices;
+        std::vector<DirectX::BoundingBox> WorldAABBs;
+        std::vector<Mesh*> Meshes;
+        std::vector<Material*> Materials;
+        std::vector<uint64_t> SortKeys;
+        std::vector<uint8_t> Flags;
+        // Level of detail of the mesh to draw, chosen by the LodSelector
+        std::vector<uint8_t> Lods;
+
+        size_t Size() const { return Meshes.size(); }
+        bool Empty() const { return Meshes.empty(); }
+
+        void Clear()
+        {
+            WorldMatrices.clear();
+            WorldAABBs.clear();
+            Meshes.clear();
+            Materials.clear();
+            SortKeys.clear();
+            Flags.clear();
+            Lods.clear();
+        }
+
+        void Reserve(size_t count)
+        {
+            WorldMatrices.reserve(count);
+            WorldAABBs.reserve(count);
+            Meshes.reserve(count);
+            Materials.reserve(count);
+            SortKeys.reserve(count);
+            Flags.reserve(count);
+            Lods.reserve(count);
+        }
+
+        void Add(const glm::mat4& world, const DirectX::BoundingBox& worldAABB, Mesh* mesh, Material* material, uint64_t sortKey, uint8_t flags = DrawPacketFlag_None, uint8_t lod = 0)
+        {
+            WorldMatrices.push_back(world);
+            WorldAABBs.push_back(worldAABB);
+            Meshes.push_back(mesh);
+            Materials.push_back(material);
+            SortKeys.push_back(sortKey);
+            Flags.push_back(flags);
+            Lods.push_back(lod);
+        }
+
+        // Keep the packets whose keep entry is non-zero, in their current order
+        void Compact(const std::vector<uint8_t>& keep)
+        {
+            assert(keep.size() == Size());
+
+            size_t count = 0;
+            for (size_t i = 0; i < keep.size(); ++i)
+            {
+                if (!keep[i])
+                    continue;
+
+                WorldMatrices[count] = WorldMatrices[i];
+                WorldAABBs[count] = WorldAABBs[i];
+                Meshes[count] = Meshes[i];
+                Materials[count] = Materials[i];
+                SortKeys[count] = SortKeys[i];
+                Flags[count] = Flags[i];
+                Lods[count] = Lods[i];
+                count++;
+            }
+
+            WorldMatrices.resize(count);
+            WorldAABBs.resize(count);
+            Meshes.resize(count);
+            Materials.resize(count);
+            SortKeys.resize(count);
+            Flags.resize(count);
+            Lods.resize(count);
+        }
+    };
+}
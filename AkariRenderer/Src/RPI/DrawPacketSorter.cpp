@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "DrawPacketSorter.h"
+
+namespace Akari
+{
+    void DrawPacketSorter::Sort(DrawPacketList& packets)
+    {
+        const auto order = SortKeys(packets.SortKeys);
+
+        // Gather into the second list and swap, so both keep their allocations for the next frame
+        m_Sorted.Clear();
+        m_Sorted.Reserve(order.size());
+        for (const uint32_t i : order)
+        {
+            m_Sorted.Add(packets.WorldMatrices[i], packets.WorldAABBs[i], packets.Meshes[i], packets.Materials[i],
+                         packets.SortKeys[i], packets.Flags[i], packets.Lods[i]);
+        }
+
+        std::swap(packets, m_Sorted);
+    }
+
+    std::span<const uint32_t> DrawPacketSorter::SortKeys(std::span<const uint64_t> keys)
+    {
+        const auto count = static_cast<uint32_t>(keys.size());
+        for (int i = 0; i < 2; ++i)
+        {
+            m_Keys[i].resize(count);
+            m_Order[i].resize(count);
+        }
+
+        if (count == 0)
+            return m_Order[0];
+
+        // The histograms of all digits are built in a single read of the keys
+        std::array<std::array<uint32_t, RadixSize>, DigitCount> histograms{};
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint64_t key = keys[i];
+            m_Keys[0][i] = key;
+            m_Order[0][i] = i;
+            for (uint32_t digit = 0; digit < DigitCount; ++digit)
+                histograms[digit][(key >> (digit * RadixBits)) & (RadixSize - 1)]++;
+        }
+
+        uint32_t source = 0;
+        for (uint32_t digit = 0; digit < DigitCount; ++digit)
+        {
+            const uint32_t shift = digit * RadixBits;
+            auto& histogram = histograms[digit];
+
+            // Every key has the same value in this digit, scattering would not change the order
+            if (histogram[(keys[0] >> shift) & (RadixSize - 1)] == count)
+                continue;
+
+            // Histogram to the first output slot of every value
+            uint32_t offset = 0;
+            for (uint32_t& bucket : histogram)
+            {
+                const uint32_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+
+            const uint64_t* sourceKeys = m_Keys[source].data();
+            const uint32_t* sourceOrder = m_Order[source].data();
+            uint64_t* destKeys = m_Keys[source ^ 1].data();
+            uint32_t* destOrder = m_Order[source ^ 1].data();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint64_t key = sourceKeys[i];
+                const uint32_t slot = histogram[(key >> shift) & (RadixSize - 1)]++;
+                destKeys[slot] = key;
+                destOrder[slot] = sourceOrder[i];
+            }
+
+            source ^= 1;
+        }
+
+        return m_Order[source];
+    }
+}
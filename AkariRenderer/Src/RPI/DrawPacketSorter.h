@@ -0,0 +1,30 @@
+#pragma once
+#include <span>
+
+#include "DrawPacketList.h"
+
+namespace Akari
+{
+    // Orders a draw list by its sort keys with a least significant digit radix sort over the key bytes.
+    // Bytes shared by every key, like the pass and pipeline fields of a single pass, cost no pass over the data.
+    class DrawPacketSorter
+    {
+    public:
+        void Sort(DrawPacketList& packets);
+
+        // Indices into keys in ascending key order, equal keys keep their relative order.
+        // The span stays valid until the next call.
+        std::span<const uint32_t> SortKeys(std::span<const uint64_t> keys);
+
+        static constexpr uint32_t RadixBits = 8;
+        static constexpr uint32_t RadixSize = 1u << RadixBits;
+        static constexpr uint32_t DigitCount = 64 / RadixBits;
+
+    private:
+        // Ping-pong buffers, kept to reuse the allocations
+        std::array<std::vector<uint64_t>, 2> m_Keys;
+        std::array<std::vector<uint32_t>, 2> m_Order;
+
+        DrawPacketList m_Sorted;
+    };
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "LightClustering.h"
+
+#include <ppl.h>
+
+namespace Akari
+{
+    void LightClustering::Build(std::span<const PointLight> lights, const glm::mat4& view, float verticalFov, float aspectRatio, float nearClip, float farClip)
+    {
+        // The froxels have to match the projection the pixels were rasterized with
+        assert(std::isfinite(aspectRatio) && aspectRatio > 0.0f);
+        const glm::vec4 projection(verticalFov, aspectRatio, nearClip, farClip);
+        if (projection != m_BoundsProjection || m_ClusterBounds.empty())
+        {
+            BuildClusterBounds(verticalFov, aspectRatio, nearClip, farClip);
+            m_BoundsProjection = projection;
+        }
+
+        const auto lightCount = static_cast<uint32_t>(lights.size());
+        m_LightRanges.resize(lightCount);
+        concurrency::parallel_for(0u, lightCount, [&](const uint32_t i)
+        {
+            const glm::vec3 viewPosition = glm::vec3(view * glm::vec4(lights[i].Trans.Translation, 1.0f));
+            m_LightRanges[i] = GetLightRange(viewPosition, lights[i].Props.Radius);
+        });
+
+        m_ClusterLights.resize(ClusterCount);
+        concurrency::parallel_for(0u, ClusterCountZ, [&](const uint32_t z)
+        {
+            for (uint32_t y = 0; y < ClusterCountY; ++y)
+            {
+                for (uint32_t x = 0; x < ClusterCountX; ++x)
+                    m_ClusterLights[GetClusterIndex(x, y, z)].clear();
+            }
+
+            for (uint32_t i = 0; i < lightCount; ++i)
+            {
+                const LightRange& range = m_LightRanges[i];
+                if (!range.Visible || z < range.MinZ || z > range.MaxZ)
+                    continue;
+
+                for (uint32_t y = range.MinY; y <= range.MaxY; ++y)
+                {
+                    for (uint32_t x = range.MinX; x <= range.MaxX; ++x)
+                    {
+                        const uint32_t cluster = GetClusterIndex(x, y, z);
+                        auto& clusterLights = m_ClusterLights[cluster];
+                        if (clusterLights.size() == MaxLightsPerCluster)
+                            continue;
+
+                        // The ranges are conservative, the sphere is tested against the cluster itself
+                        const ClusterBounds& bounds = m_ClusterBounds[cluster];
+                        const glm::vec3 closest = glm::clamp(range.ViewPosition, bounds.Min, bounds.Max);
+                        const glm::vec3 offset = closest - range.ViewPosition;
+                        if (glm::dot(offset, offset) <= range.Radius * range.Radius)
+                            clusterLights.push_back(i);
+                    }
+                }
+            }
+        });
+
+        m_Clusters.resize(ClusterCount);
+        m_LightIndices.clear();
+        for (uint32_t i = 0; i < ClusterCount; ++i)
+        {
+            m_Clusters[i] = { static_cast<uint32_t>(m_LightIndices.size()), static_cast<uint32_t>(m_ClusterLights[i].size()) };
+            m_LightIndices.insert(m_LightIndices.end(), m_ClusterLights[i].begin(), m_ClusterLights[i].end());
+        }
+    }
+
+    void LightClustering::BuildClusterBounds(float verticalFov, float aspectRatio, float nearClip, float farClip)
+    {
+        m_TanHalfFovY = std::tan(verticalFov * 0.5f);
+        m_TanHalfFovX = m_TanHalfFovY * aspectRatio;
+        m_NearClip = nearClip;
+        m_FarClip = farClip;
+
+        // slice = log(depth / near) / log(far / near) * ClusterCountZ
+        const float logDepthRange = std::log(farClip / nearClip);
+        m_DepthSliceScale = static_cast<float>(ClusterCountZ) / logDepthRange;
+        m_DepthSliceBias = -m_DepthSliceScale * std::log(nearClip);
+
+        m_ClusterBounds.resize(ClusterCount);
+        for (uint32_t z = 0; z < ClusterCountZ; ++z)
+        {
+            const float sliceNear = nearClip * std::pow(farClip / nearClip, static_cast<float>(z) / ClusterCountZ);
+            const float sliceFar = nearClip * std::pow(farClip / nearClip, static_cast<float>(z + 1) / ClusterCountZ);
+
+            for (uint32_t y = 0; y < ClusterCountY; ++y)
+            {
+                // Tiles count down from the top of the screen, NDC y points up
+                const float ndcTop = 1.0f - 2.0f * y / ClusterCountY;
+                const float ndcBottom = 1.0f - 2.0f * (y + 1) / ClusterCountY;
+
+                for (uint32_t x = 0; x < ClusterCountX; ++x)
+                {
+                    const float ndcLeft = -1.0f + 2.0f * x / ClusterCountX;
+                    const float ndcRight = -1.0f + 2.0f * (x + 1) / ClusterCountX;
+
+                    // The cluster is a frustum slice, its bounds enclose the corners on both depth planes
+                    ClusterBounds& bounds = m_ClusterBounds[GetClusterIndex(x, y, z)];
+                    bounds.Min = glm::vec3(FLT_MAX);
+                    bounds.Max = glm::vec3(-FLT_MAX);
+                    for (const float depth : { sliceNear, sliceFar })
+                    {
+                        for (const float ndcX : { ndcLeft, ndcRight })
+                        {
+                            for (const float ndcY : { ndcBottom, ndcTop })
+                            {
+                                const glm::vec3 corner(ndcX * m_TanHalfFovX * depth, ndcY * m_TanHalfFovY * depth, depth);
+                                bounds.Min = glm::min(bounds.Min, corner);
+                                bounds.Max = glm::max(bounds.Max, corner);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    LightClustering::LightRange LightClustering::GetLightRange(const glm::vec3& viewPosition, float radius) const
+    {
+        LightRange range{ viewPosition, radius, 0, ClusterCountX - 1, 0, ClusterCountY - 1, 0, ClusterCountZ - 1, true };
+
+        const float minDepth = viewPosition.z - radius;
+        const float maxDepth = viewPosition.z + radius;
+        if (radius <= 0.0f || maxDepth < m_NearClip || minDepth > m_FarClip)
+        {
+            range.Visible = false;
+            return range;
+        }
+
+        auto slice = [&](const float depth)
+        {
+            const float value = std::log(std::max(depth, m_NearClip)) * m_DepthSliceScale + m_DepthSliceBias;
+            return static_cast<uint32_t>(std::clamp(value, 0.0f, static_cast<float>(ClusterCountZ - 1)));
+        };
+        range.MinZ = slice(minDepth);
+        range.MaxZ = slice(maxDepth);
+
+        // A sphere reaching the near plane can cover any tile
+        if (minDepth <= m_NearClip)
+            return range;
+
+        // Projected extents of the sphere's view space bounds, the extremes lie on the nearest or farthest depth
+        auto tile = [](const float ndc, const uint32_t count)
+        {
+            return static_cast<uint32_t>(std::clamp((ndc + 1.0f) * 0.5f * count, 0.0f, static_cast<float>(count - 1)));
+        };
+
+        const float minX = std::min((viewPosition.x - radius) / minDepth, (viewPosition.x - radius) / maxDepth) / m_TanHalfFovX;
+        const float maxX = std::max((viewPosition.x + radius) / minDepth, (viewPosition.x + radius) / maxDepth) / m_TanHalfFovX;
+        const float minY = std::min((viewPosition.y - radius) / minDepth, (viewPosition.y - radius) / maxDepth) / m_TanHalfFovY;
+        const float maxY = std::max((viewPosition.y + radius) / minDepth, (viewPosition.y + radius) / maxDepth) / m_TanHalfFovY;
+        if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+        {
+            range.Visible = false;
+            return range;
+        }
+
+        range.MinX = tile(minX, ClusterCountX);
+        range.MaxX = tile(maxX, ClusterCountX);
+        // Flipped, tile rows count from the top
+        range.MinY = tile(-maxY, ClusterCountY);
+        range.MaxY = tile(-minY, ClusterCountY);
+        return range;
+    }
+}
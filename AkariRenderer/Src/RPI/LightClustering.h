@@ -0,0 +1,78 @@
+#pragma once
+#include <span>
+
+#include "SceneComponents/Light.h"
+
+namespace Akari
+{
+    // Range of a cluster in the light index list, mirrored by LightCluster in Lit_PS
+    struct LightCluster
+    {
+        uint32_t Offset;
+        uint32_t Count;
+    };
+
+    // Assigns point lights to a froxel grid over the view frustum on the CPU.
+    // Tiles split the screen evenly and depth slices grow exponentially from the near to the far plane,
+    // so a pixel finds its lights from its screen position and view depth without touching the others.
+    class LightClustering
+    {
+    public:
+        // Light positions are in world space, their Radius bounds their influence
+        void Build(std::span<const PointLight> lights, const glm::mat4& view, float verticalFov, float aspectRatio, float nearClip, float farClip);
+
+        const std::vector<LightCluster>& GetClusters() const { return m_Clusters; }
+        const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+
+        // log(viewDepth) * scale + bias is the depth slice of a view depth
+        float GetDepthSliceScale() const { return m_DepthSliceScale; }
+        float GetDepthSliceBias() const { return m_DepthSliceBias; }
+
+        static uint32_t GetClusterIndex(uint32_t x, uint32_t y, uint32_t z) { return (z * ClusterCountY + y) * ClusterCountX + x; }
+
+        static constexpr uint32_t ClusterCountX = 16;
+        static constexpr uint32_t ClusterCountY = 9;
+        static constexpr uint32_t ClusterCountZ = 24;
+        static constexpr uint32_t ClusterCount = ClusterCountX * ClusterCountY * ClusterCountZ;
+        // Keeps the index list of a full grid below the 2MB upload buffer pages
+        static constexpr uint32_t MaxLightsPerCluster = 128;
+
+    private:
+        // View space bounds of a cluster
+        struct ClusterBounds
+        {
+            glm::vec3 Min;
+            glm::vec3 Max;
+        };
+
+        // Clusters a light may touch, tiles count from the top left of the screen
+        struct LightRange
+        {
+            glm::vec3 ViewPosition;
+            float Radius;
+            uint32_t MinX, MaxX, MinY, MaxY, MinZ, MaxZ;
+            bool Visible;
+        };
+
+        void BuildClusterBounds(float verticalFov, float aspectRatio, float nearClip, float farClip);
+        LightRange GetLightRange(const glm::vec3& viewPosition, float radius) const;
+
+        std::vector<ClusterBounds> m_ClusterBounds;
+        // Projection the cluster bounds were built for
+        glm::vec4 m_BoundsProjection{ 0.0f };
+
+        float m_TanHalfFovX = 0.0f;
+        float m_TanHalfFovY = 0.0f;
+        float m_NearClip = 0.0f;
+        float m_FarClip = 0.0f;
+        float m_DepthSliceScale = 0.0f;
+        float m_DepthSliceBias = 0.0f;
+
+        std::vector<LightCluster> m_Clusters;
+        std::vector<uint32_t> m_LightIndices;
+
+        // Per-frame scratch, every cluster list is only written by the task of its depth slice
+        std::vector<LightRange> m_LightRanges;
+        std::vector<std::vector<uint32_t>> m_ClusterLights;
+    };
+}
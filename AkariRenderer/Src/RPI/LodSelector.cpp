@@ -0,0 +1,48 @@
+#include "pch.h"
+#include "LodSelector.h"
+
+#include <ppl.h>
+
+#include "SceneComponents/Mesh.h"
+#include "SceneComponents/Camera/EditorCamera.h"
+
+namespace Akari
+{
+    void LodSelector::Select(const EditorCamera& camera, DrawPacketList& packets) const
+    {
+        // World size at distance 1 to pixels on screen
+        const float pixelsPerUnit = static_cast<float>(camera.GetViewportHeight()) * 0.5f / std::tan(camera.GetVerticalFOV() * 0.5f);
+        const glm::vec3 eye = camera.GetPosition();
+
+        packets.Lods.resize(packets.Size());
+        concurrency::parallel_for(size_t(0), packets.Size(), [&](const size_t i)
+        {
+            const Mesh& mesh = *packets.Meshes[i];
+            packets.Lods[i] = 0;
+            if (mesh.GetLodCount() == 1)
+                return;
+
+            const auto& box = packets.WorldAABBs[i];
+            const glm::vec3 center(box.Center.x, box.Center.y, box.Center.z);
+            const glm::vec3 extents(box.Extents.x, box.Extents.y, box.Extents.z);
+            const float distance = glm::length(glm::max(glm::abs(eye - center) - extents, glm::vec3(0.0f)));
+            if (distance <= 0.0f)
+                return;
+
+            const auto& meshExtents = mesh.GetAABB().Extents;
+            const float meshRadius = glm::length(glm::vec3(meshExtents.x, meshExtents.y, meshExtents.z));
+            if (meshRadius <= 0.0f)
+                return;
+
+            const float errorScale = glm::length(extents) / meshRadius * pixelsPerUnit / distance;
+            for (uint32_t lod = mesh.GetLodCount() - 1; lod > 0; --lod)
+            {
+                if (mesh.GetLodError(lod) * errorScale <= MaxPixelError)
+                {
+                    packets.Lods[i] = static_cast<uint8_t>(lod);
+                    return;
+                }
+            }
+        });
+    }
+}
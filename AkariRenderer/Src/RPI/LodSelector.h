@@ -0,0 +1,19 @@
+#pragma once
+#include "DrawPacketList.h"
+
+namespace Akari
+{
+    class EditorCamera;
+
+    // Picks the level of detail of every packet from the screen size of its simplification error.
+    // A mesh's error is relative to its bounds, so it scales with the packet's world bounds and is projected
+    // at the distance of the nearest point of the bounds, the coarsest level staying under MaxPixelError wins.
+    class LodSelector
+    {
+    public:
+        void Select(const EditorCamera& camera, DrawPacketList& packets) const;
+
+        // Largest error on screen, in pixels of the camera viewport
+        static constexpr float MaxPixelError = 1.0f;
+    };
+}
@@ -0,0 +1,305 @@
+#include "pch.h"
+#include "OcclusionCulling.h"
+
+#include <ppl.h>
+#include <emmintrin.h>
+
+#include "SceneComponents/Mesh.h"
+#include "SceneComponents/TriangleBVH.h"
+#include "SceneComponents/Camera/EditorCamera.h"
+
+namespace Akari
+{
+    // Clip space w below which a vertex counts as behind the camera
+    static constexpr float MinClipW = 1e-5f;
+
+    void OcclusionCulling::Cull(const EditorCamera& camera, DrawPacketList& packets)
+    {
+        BeginFrame(camera.GetViewProjection(), camera.GetAspectRatio());
+
+        // Tagged occluders first, then by bounding radius over distance as a cheap measure of screen coverage
+        const glm::vec3 eye = camera.GetPosition();
+        m_OccluderCandidates.clear();
+        for (uint32_t i = 0; i < packets.Size(); ++i)
+        {
+            if (packets.Flags[i] & DrawPacketFlag_NeverOccluder || !packets.Meshes[i]->GetTriangleBVH())
+                continue;
+
+            const auto& box = packets.WorldAABBs[i];
+            const float radius = glm::length(glm::vec3(box.Extents.x, box.Extents.y, box.Extents.z));
+            const float distance = glm::length(glm::vec3(box.Center.x, box.Center.y, box.Center.z) - eye);
+            const float score = packets.Flags[i] & DrawPacketFlag_Occluder ? FLT_MAX : radius / std::max(distance, 1e-4f);
+            if (score >= OccluderMinScreenRatio)
+                m_OccluderCandidates.emplace_back(score, i);
+        }
+
+        std::ranges::sort(m_OccluderCandidates, std::greater{});
+
+        uint32_t triangleCount = 0;
+        for (const auto& [score, index] : m_OccluderCandidates)
+        {
+            if (m_Occluders.size() >= MaxOccluders)
+                break;
+
+            const TriangleBVH* geometry = packets.Meshes[index]->GetTriangleBVH();
+            if (triangleCount + geometry->GetTriangleCount() > MaxOccluderTriangles)
+                continue;
+
+            AddOccluder(packets.WorldMatrices[index], geometry->GetPositions(), geometry->GetIndices());
+            triangleCount += static_cast<uint32_t>(geometry->GetTriangleCount());
+        }
+
+        RasterizeOccluders();
+
+        m_Visible.resize(packets.Size());
+        concurrency::parallel_for(size_t(0), packets.Size(), [&](const size_t i)
+        {
+            m_Visible[i] = IsVisible(packets.WorldAABBs[i]) ? 1 : 0;
+        });
+
+        m_Stats.PacketsCulled = static_cast<uint32_t>(std::ranges::count(m_Visible, 0));
+        if (m_Stats.PacketsCulled > 0)
+            packets.Compact(m_Visible);
+    }
+
+    void OcclusionCulling::BeginFrame(const glm::mat4& viewProjection, float aspectRatio)
+    {
+        m_ViewProjection = viewProjection;
+
+        // Clamped before the conversion, a collapsed viewport gives an infinite or NaN ratio
+        float rows = DepthBufferWidth / aspectRatio;
+        if (!(rows >= TileSize))
+            rows = float(TileSize);
+        rows = std::min(rows, float(DepthBufferWidth * 4));
+        const auto height = Math::AlignUp(static_cast<uint32_t>(rows), TileSize);
+        if (m_Width != DepthBufferWidth || m_Height != height)
+        {
+            m_Width = DepthBufferWidth;
+            m_Height = height;
+            m_TilesX = m_Width / TileSize;
+            m_TilesY = m_Height / TileSize;
+            m_DepthBuffer.resize(size_t(m_Width) * m_Height);
+            m_TileDepth.resize(size_t(m_TilesX) * m_TilesY);
+        }
+
+        std::ranges::fill(m_DepthBuffer, 0.0f);
+        std::ranges::fill(m_TileDepth, 0.0f);
+        m_Occluders.clear();
+        m_Triangles.clear();
+        m_Stats = {};
+    }
+
+    void OcclusionCulling::AddOccluder(const glm::mat4& world, std::span<const glm::vec3> positions, std::span<const uint32_t> indices)
+    {
+        m_Occluders.push_back({ world, positions, indices });
+        m_Stats.Occluders++;
+        m_Stats.OccluderTriangles += static_cast<uint32_t>(indices.size() / 3);
+    }
+
+    void OcclusionCulling::RasterizeOccluders()
+    {
+        SetupTriangles();
+        if (m_Triangles.empty())
+            return;
+
+        // Bands own disjoint rows of the depth buffer and the tiles inside them
+        const uint32_t bandCount = Math::DivideAndRoundUp(m_Height, BandHeight);
+        concurrency::parallel_for(uint32_t(0), bandCount, [&](const uint32_t band)
+        {
+            const uint32_t begin = band * BandHeight;
+            const uint32_t end = std::min(begin + BandHeight, m_Height);
+
+            for (const auto& triangle : m_Triangles)
+            {
+                if (triangle.MaxY >= static_cast<float>(begin) && triangle.MinY < static_cast<float>(end))
+                    RasterizeTriangle(triangle, begin, end);
+            }
+
+            for (uint32_t tileY = begin / TileSize; tileY < end / TileSize; ++tileY)
+            {
+                for (uint32_t tileX = 0; tileX < m_TilesX; ++tileX)
+                {
+                    float farthest = FLT_MAX;
+                    for (uint32_t y = tileY * TileSize; y < (tileY + 1) * TileSize; ++y)
+                    {
+                        const float* row = &m_DepthBuffer[size_t(y) * m_Width + tileX * TileSize];
+                        for (uint32_t x = 0; x < TileSize; ++x)
+                            farthest = std::min(farthest, row[x]);
+                    }
+                    m_TileDepth[size_t(tileY) * m_TilesX + tileX] = farthest;
+                }
+            }
+        });
+    }
+
+    void OcclusionCulling::SetupTriangles()
+    {
+        m_OccluderTriangles.resize(m_Occluders.size());
+
+        concurrency::parallel_for(size_t(0), m_Occluders.size(), [&](const size_t i)
+        {
+            const Occluder& occluder = m_Occluders[i];
+            const glm::mat4 worldViewProjection = m_ViewProjection * occluder.World;
+            const float width = static_cast<float>(m_Width);
+            const float height = static_cast<float>(m_Height);
+
+            // Screen x, y, depth and 1, or a negative w for vertices behind the camera
+            std::vector<glm::vec4> vertices(occluder.Positions.size());
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                const glm::vec4 clip = worldViewProjection * glm::vec4(occluder.Positions[v], 1.0f);
+                if (clip.w <= MinClipW)
+                {
+                    vertices[v] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                    continue;
+                }
+
+                const float invW = 1.0f / clip.w;
+                vertices[v] = glm::vec4((clip.x * invW * 0.5f + 0.5f) * width, (0.5f - clip.y * invW * 0.5f) * height, clip.z * invW, 1.0f);
+            }
+
+            auto& triangles = m_OccluderTriangles[i];
+            triangles.clear();
+            for (size_t t = 0; t + 2 < occluder.Indices.size(); t += 3)
+            {
+                const glm::vec4& v0 = vertices[occluder.Indices[t + 0]];
+                const glm::vec4& v1 = vertices[occluder.Indices[t + 1]];
+                const glm::vec4& v2 = vertices[occluder.Indices[t + 2]];
+
+                // Triangles crossing the near plane are dropped, rasterizing less occluder area is always safe
+                if (v0.w < 0.0f || v1.w < 0.0f || v2.w < 0.0f)
+                    continue;
+
+                const float minX = std::min({ v0.x, v1.x, v2.x });
+                const float maxX = std::max({ v0.x, v1.x, v2.x });
+                const float minY = std::min({ v0.y, v1.y, v2.y });
+                const float maxY = std::max({ v0.y, v1.y, v2.y });
+                if (maxX < 0.0f || minX >= width || maxY < 0.0f || minY >= height)
+                    continue;
+
+                triangles.push_back({ glm::vec3(v0), glm::vec3(v1), glm::vec3(v2), minY, maxY });
+            }
+        });
+
+        for (const auto& triangles : m_OccluderTriangles)
+            m_Triangles.insert(m_Triangles.end(), triangles.begin(), triangles.end());
+    }
+
+    void OcclusionCulling::RasterizeTriangle(const ScreenTriangle& triangle, uint32_t bandBegin, uint32_t bandEnd)
+    {
+        glm::vec3 v0 = triangle.V0, v1 = triangle.V1, v2 = triangle.V2;
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (area == 0.0f)
+            return;
+
+        // Occluders are rasterized from both sides, flip to a positive area
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Edge functions A x + B y + C, non-negative inside, each one is the weight of the opposite vertex
+        auto edge = [](const glm::vec3& a, const glm::vec3& b)
+        {
+            const float stepX = a.y - b.y;
+            const float stepY = b.x - a.x;
+            return glm::vec3(stepX, stepY, -stepX * a.x - stepY * a.y);
+        };
+
+        const glm::vec3 e0 = edge(v1, v2);
+        const glm::vec3 e1 = edge(v2, v0);
+        const glm::vec3 e2 = edge(v0, v1);
+
+        // Depth is linear in screen space
+        const glm::vec3 depthPlane = (e0 * v0.z + e1 * v1.z + e2 * v2.z) / area;
+
+        const int minX = std::max(static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))), 0) & ~3;
+        const int maxX = std::min(static_cast<int>(std::floor(std::max({ v0.x, v1.x, v2.x }))), static_cast<int>(m_Width) - 1);
+        const int minY = std::max(static_cast<int>(std::floor(triangle.MinY)), static_cast<int>(bandBegin));
+        const int maxY = std::min(static_cast<int>(std::floor(triangle.MaxY)), static_cast<int>(bandEnd) - 1);
+
+        // Four pixel centers per step, the buffer width is a multiple of four so rows never run over
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 startX = _mm_add_ps(_mm_set1_ps(static_cast<float>(minX)), laneOffsets);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float centerY = static_cast<float>(y) + 0.5f;
+
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0.x), startX), _mm_set1_ps(e0.y * centerY + e0.z));
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.x), startX), _mm_set1_ps(e1.y * centerY + e1.z));
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2.x), startX), _mm_set1_ps(e2.y * centerY + e2.z));
+            __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthPlane.x), startX), _mm_set1_ps(depthPlane.y * centerY + depthPlane.z));
+
+            const __m128 w0Step = _mm_set1_ps(e0.x * 4.0f);
+            const __m128 w1Step = _mm_set1_ps(e1.x * 4.0f);
+            const __m128 w2Step = _mm_set1_ps(e2.x * 4.0f);
+            const __m128 depthStep = _mm_set1_ps(depthPlane.x * 4.0f);
+
+            float* row = &m_DepthBuffer[size_t(y) * m_Width];
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+                if (_mm_movemask_ps(inside))
+                {
+                    const __m128 previous = _mm_loadu_ps(row + x);
+                    const __m128 closest = _mm_max_ps(previous, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, previous)));
+                }
+
+                w0 = _mm_add_ps(w0, w0Step);
+                w1 = _mm_add_ps(w1, w1Step);
+                w2 = _mm_add_ps(w2, w2Step);
+                depth = _mm_add_ps(depth, depthStep);
+            }
+        }
+    }
+
+    bool OcclusionCulling::IsVisible(const DirectX::BoundingBox& worldAABB) const
+    {
+        if (m_Triangles.empty())
+            return true;
+
+        const glm::vec3 center(worldAABB.Center.x, worldAABB.Center.y, worldAABB.Center.z);
+        const glm::vec3 extents(worldAABB.Extents.x, worldAABB.Extents.y, worldAABB.Extents.z);
+
+        // Screen rectangle and nearest depth of the corners, the nearest point of a box is always a corner
+        glm::vec2 minScreen(FLT_MAX), maxScreen(-FLT_MAX);
+        float nearest = 0.0f;
+        for (int i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner = center + extents * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+            const glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w <= MinClipW)
+                return true;
+
+            const float invW = 1.0f / clip.w;
+            const glm::vec2 screen((clip.x * invW * 0.5f + 0.5f) * m_Width, (0.5f - clip.y * invW * 0.5f) * m_Height);
+            minScreen = glm::min(minScreen, screen);
+            maxScreen = glm::max(maxScreen, screen);
+            nearest = std::max(nearest, clip.z * invW);
+        }
+
+        if (maxScreen.x < 0.0f || minScreen.x >= m_Width || maxScreen.y < 0.0f || minScreen.y >= m_Height)
+            return true;
+
+        const uint32_t tileMinX = static_cast<uint32_t>(std::max(minScreen.x, 0.0f)) / TileSize;
+        const uint32_t tileMinY = static_cast<uint32_t>(std::max(minScreen.y, 0.0f)) / TileSize;
+        const uint32_t tileMaxX = std::min(static_cast<uint32_t>(maxScreen.x) / TileSize, m_TilesX - 1);
+        const uint32_t tileMaxY = std::min(static_cast<uint32_t>(maxScreen.y) / TileSize, m_TilesY - 1);
+
+        // Hidden only if the box is behind the farthest occluder depth of every tile it touches
+        for (uint32_t tileY = tileMinY; tileY <= tileMaxY; ++tileY)
+        {
+            for (uint32_t tileX = tileMinX; tileX <= tileMaxX; ++tileX)
+            {
+                if (nearest >= m_TileDepth[size_t(tileY) * m_TilesX + tileX])
+                    return true;
+            }
+        }
+
+        return false;
+    }
+}
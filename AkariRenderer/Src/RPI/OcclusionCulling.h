@@ -0,0 +1,89 @@
+#pragma once
+#include <span>
+
+#include "DrawPacketList.h"
+
+namespace Akari
+{
+    class EditorCamera;
+
+    struct OcclusionStats
+    {
+        uint32_t Occluders = 0;
+        uint32_t OccluderTriangles = 0;
+        uint32_t PacketsCulled = 0;
+    };
+
+    // CPU occlusion culling against a low resolution depth buffer.
+    // Tagged packets and the packets covering the most screen are rasterized as occluders in horizontal bands
+    // in parallel, then every packet's bounds are tested against the farthest depth of the tiles they cover.
+    // Depth follows the reversed-Z convention of the renderer: 1 at the near plane, 0 at the far plane and cleared.
+    //
+    // This is a simplification of masked occlusion culling, which keeps a coverage mask and two depth layers per tile.
+    // Here every pixel stores a float depth and a single level of tile depths is reduced from them after rasterizing.
+    // The buffer is 16 times larger than a masked tile (256 against 16 bytes per 8x8 tile), every covered pixel is
+    // written, and a box is tested against each tile it touches, without a coarser level to reject large boxes early.
+    class OcclusionCulling
+    {
+    public:
+        // Removes the packets hidden behind the occluders from the list
+        void Cull(const EditorCamera& camera, DrawPacketList& packets);
+
+        // The steps of Cull, usable without a camera or a draw list
+        void BeginFrame(const glm::mat4& viewProjection, float aspectRatio);
+        void AddOccluder(const glm::mat4& world, std::span<const glm::vec3> positions, std::span<const uint32_t> indices);
+        void RasterizeOccluders();
+        bool IsVisible(const DirectX::BoundingBox& worldAABB) const;
+
+        const OcclusionStats& GetStats() const { return m_Stats; }
+        std::span<const float> GetDepthBuffer() const { return m_DepthBuffer; }
+        uint32_t GetWidth() const { return m_Width; }
+        uint32_t GetHeight() const { return m_Height; }
+
+        static constexpr uint32_t DepthBufferWidth = 320;
+        static constexpr uint32_t TileSize = 8;
+        // Rows per rasterization task, a multiple of TileSize
+        static constexpr uint32_t BandHeight = 32;
+        static constexpr uint32_t MaxOccluders = 64;
+        static constexpr uint32_t MaxOccluderTriangles = 128 * 1024;
+        // Bounding radius over distance above which a packet is picked as occluder automatically
+        static constexpr float OccluderMinScreenRatio = 0.15f;
+
+    private:
+        struct ScreenTriangle
+        {
+            glm::vec3 V0, V1, V2; // Screen x, y and depth
+            float MinY, MaxY;
+        };
+
+        struct Occluder
+        {
+            glm::mat4 World;
+            std::span<const glm::vec3> Positions;
+            std::span<const uint32_t> Indices;
+        };
+
+        void SetupTriangles();
+        void RasterizeTriangle(const ScreenTriangle& triangle, uint32_t bandBegin, uint32_t bandEnd);
+
+        glm::mat4 m_ViewProjection{ 1.0f };
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_TilesX = 0;
+        uint32_t m_TilesY = 0;
+
+        std::vector<float> m_DepthBuffer;
+        // Farthest depth of every TileSize x TileSize tile
+        std::vector<float> m_TileDepth;
+
+        std::vector<Occluder> m_Occluders;
+        std::vector<std::vector<ScreenTriangle>> m_OccluderTriangles;
+        std::vector<ScreenTriangle> m_Triangles;
+
+        // Per-frame scratch for Cull
+        std::vector<std::pair<float, uint32_t>> m_OccluderCandidates;
+        std::vector<uint8_t> m_Visible;
+
+        OcclusionStats m_Stats;
+    };
+}
@@ -4,11 +4,18 @@ namespace Akari
 {
     class Scene;
     class DeltaTime;
+    struct DrawPacketList;
+    class CascadedShadows;
     
     struct RenderContext
     {
         std::shared_ptr<Scene> scene;
 
         DeltaTime* dt;
+
+        // Filled by the render pipeline's extraction stage before any pass records
+        const DrawPacketList* drawPackets = nullptr;
+        // Filled by the shadow pass, null when no light casts shadows this frame
+        const CascadedShadows* shadows = nullptr;
     };
 }
@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "RenderExtraction.h"
+
+#include "SceneComponents/Mesh.h"
+#include "SceneComponents/Model.h"
+#include "SceneComponents/ModelManager.h"
+#include "SceneComponents/Scene.h"
+#include "SceneComponents/SceneObject.h"
+#include "SceneComponents/Camera/EditorCamera.h"
+
+namespace Akari
+{
+    void RenderExtraction::Extract(Scene& scene, const EditorCamera& camera, DrawPacketList& packets)
+    {
+        Extract(scene, Frustum(camera.GetViewProjection()), camera.GetViewMatrix(), packets);
+    }
+
+    void RenderExtraction::Extract(Scene& scene, const Frustum& frustum, const glm::mat4& view, DrawPacketList& packets)
+    {
+        packets.Clear();
+        m_MaterialIndices.clear();
+        m_Stats = {};
+
+        auto& modelManager = ModelManager::GetInstance();
+
+        // Object level, the scene BVH rejects whole groups of objects and reports the ones fully inside
+        m_Objects.clear();
+        scene.GetBVH().QueryFrustum(frustum, [&](const entt::entity entity, const bool inside)
+        {
+            SceneObject object(entity, &scene);
+            const auto model = modelManager.GetModelByID(object.GetComponent<ModelComponent>().ModelID);
+            if (!model || model->GetFlattenedNodes().empty())
+                return;
+
+            uint8_t flags = DrawPacketFlag_None;
+            if (object.HasComponent<OccluderComponent>())
+                flags = object.GetComponent<OccluderComponent>().Enabled ? DrawPacketFlag_Occluder : DrawPacketFlag_NeverOccluder;
+
+            m_Objects.push_back({ model.get(), scene.GetWorldSpaceTransformMatrix(object), inside, flags });
+        });
+        m_Stats.ObjectsCulled = static_cast<uint32_t>(scene.GetBVH().Size() - m_Objects.size());
+
+        for (const auto& [model, world, inside, flags] : m_Objects)
+        {
+            const auto& nodes = model->GetFlattenedNodes();
+            const auto& meshes = model->GetFlattenedMeshes();
+
+            const DirectX::XMMATRIX xmWorld = Math::ToXMMatrix(world);
+
+            m_CandidateMeshes.clear();
+            m_CandidateAABBs.clear();
+            m_CandidateBounds.Clear();
+
+            // Node level, whole subtrees are skipped or accepted without testing their meshes
+            for (uint32_t nodeIndex = 0; nodeIndex < nodes.size();)
+            {
+                const auto& node = nodes[nodeIndex];
+
+                // The root bounds were already tested with the object
+                FrustumTest test = inside ? FrustumTest::Inside : FrustumTest::Intersects;
+                if (nodeIndex != 0 && node.MeshBegin != node.MeshEnd)
+                {
+                    DirectX::BoundingBox nodeAABB;
+                    node.SubtreeAABB.Transform(nodeAABB, xmWorld);
+                    test = frustum.Test(nodeAABB);
+                }
+
+                if (test == FrustumTest::Outside)
+                {
+                    m_Stats.NodesCulled++;
+                    m_Stats.MeshesCulled += node.MeshEnd - node.MeshBegin;
+                    nodeIndex = node.SubtreeEnd;
+                    continue;
+                }
+
+                const uint32_t meshEnd = test == FrustumTest::Inside ? node.MeshEnd : node.OwnMeshEnd;
+                for (uint32_t meshIndex = node.MeshBegin; meshIndex < meshEnd; ++meshIndex)
+                {
+                    DirectX::BoundingBox worldAABB;
+                    meshes[meshIndex]->GetAABB().Transform(worldAABB, xmWorld);
+
+                    if (test == FrustumTest::Inside)
+                    {
+                        AddPacket(packets, view, world, worldAABB, meshes[meshIndex], flags);
+                        continue;
+                    }
+
+                    m_CandidateMeshes.push_back(meshes[meshIndex]);
+                    m_CandidateAABBs.push_back(worldAABB);
+                    m_CandidateBounds.Add(worldAABB);
+                }
+
+                nodeIndex = test == FrustumTest::Inside ? node.SubtreeEnd : nodeIndex + 1;
+            }
+
+            // Mesh level, the meshes of intersecting nodes are culled in one batch
+            m_CandidateVisibility.resize(m_CandidateMeshes.size());
+            frustum.Cull(m_CandidateBounds, m_CandidateVisibility.data());
+
+            for (size_t i = 0; i < m_CandidateMeshes.size(); ++i)
+            {
+                if (m_CandidateVisibility[i])
+                    AddPacket(packets, view, world, m_CandidateAABBs[i], m_CandidateMeshes[i], flags);
+                else
+                    m_Stats.MeshesCulled++;
+            }
+        }
+
+        m_Stats.MeshesVisible = static_cast<uint32_t>(packets.Size());
+    }
+
+    void RenderExtraction::AddPacket(DrawPacketList& packets, const glm::mat4& view, const glm::mat4& world, const DirectX::BoundingBox& worldAABB, Mesh* mesh, uint8_t flags)
+    {
+        Material* material = mesh->GetMaterial().get();
+        const auto [iter, inserted] = m_MaterialIndices.try_emplace(material, static_cast<uint32_t>(m_MaterialIndices.size()));
+
+        // Every opaque mesh uses the lit pipeline, view depth of the bounds center for front to back order
+        const float depth = (view * glm::vec4(worldAABB.Center.x, worldAABB.Center.y, worldAABB.Center.z, 1.0f)).z;
+        const uint64_t sortKey = DrawSortKey::Make(DrawPass_Opaque, 0, iter->second, depth);
+
+        packets.Add(world, worldAABB, mesh, material, sortKey, flags);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "DrawPacketList.h"
+#include "Math/Frustum.h"
+
+namespace Akari
+{
+    class Scene;
+    class Mesh;
+    class Model;
+    class Material;
+    class EditorCamera;
+
+    struct CullingStats
+    {
+        uint32_t ObjectsCulled = 0;
+        // Model nodes and meshes are only counted for objects that passed the object test
+        uint32_t NodesCulled = 0;
+        uint32_t MeshesCulled = 0;
+        uint32_t MeshesVisible = 0;
+    };
+
+    // Flattens every ModelComponent of a scene into draw packets in one linear pass,
+    // so the passes no longer walk model node graphs through virtual visitor calls.
+    // Meshes outside the camera frustum are culled per scene BVH node, per model node subtree and per mesh.
+    class RenderExtraction
+    {
+    public:
+        void Extract(Scene& scene, const EditorCamera& camera, DrawPacketList& packets);
+        // Extraction for any view, e.g. a light, view only orders the packets by their depth
+        void Extract(Scene& scene, const Frustum& frustum, const glm::mat4& view, DrawPacketList& packets);
+
+        const CullingStats& GetCullingStats() const { return m_Stats; }
+
+    private:
+        struct ExtractedObject
+        {
+            Model* SourceModel;
+            glm::mat4 World;
+            bool Inside;
+            uint8_t Flags;
+        };
+
+        void AddPacket(DrawPacketList& packets, const glm::mat4& view, const glm::mat4& world, const DirectX::BoundingBox& worldAABB, Mesh* mesh, uint8_t flags);
+
+        // Dense per-frame material indices for the sort keys
+        std::unordered_map<const Material*, uint32_t> m_MaterialIndices;
+
+        // Per-frame scratch, kept to reuse the allocations
+        std::vector<ExtractedObject> m_Objects;
+
+        std::vector<Mesh*> m_CandidateMeshes;
+        std::vector<DirectX::BoundingBox> m_CandidateAABBs;
+        BoundsSoA m_CandidateBounds;
+        std::vector<uint8_t> m_CandidateVisibility;
+
+        CullingStats m_Stats;
+    };
+}
@@ -1,4 +1,8 @@
 #pragma once
+#include "RPI/ClusterCulling.h"
+#include "RPI/OcclusionCulling.h"
+#include "RPI/RenderExtraction.h"
+#include "RPI/RenderStateObject.h"
 
 namespace Akari
 {
@@ -9,6 +13,18 @@ namespace Akari
     class Texture;
     class Event;
 
+    // Counters of the last rendered frame, shown in the statistics window
+    struct RenderStats
+    {
+        // Frustum culling of the camera's extraction
+        CullingStats Culling;
+        // Meshlet and occlusion culling of the extracted packets
+        ClusterCullingStats ClusterCulling;
+        OcclusionStats Occlusion;
+        // Draws and state changes of the forward pass
+        RenderStateObject::Stats ForwardState;
+    };
+
     // Render pipelines focus on rendering scene window only.
     class RenderPipeline
     {
@@ -22,8 +38,11 @@ namespace Akari
         virtual bool OnSceneResize(SceneWindowResizeEvent& event) const;
         
         [[nodiscard]] virtual std::shared_ptr<RenderTarget> GetSceneSDRRenderTarget() const;
+        const RenderStats& GetStats() const { return m_Stats; }
 
     protected:
+        RenderStats m_Stats;
+
         std::shared_ptr<Texture> m_SceneHDRFrameBuffer = nullptr;
         std::shared_ptr<Texture> m_SceneSDRFrameBuffer = nullptr;
         std::shared_ptr<Texture> m_SceneDepth = nullptr;
@@ -5,6 +5,8 @@
 #include "RHI/Device.h"
 #include "RHI/RenderTarget.h"
 #include "RHI/RootSignature.h"
+#include "RPI/DrawBatcher.h"
+#include "RPI/LightClustering.h"
 #include "SceneComponents/Material.h"
 
 namespace Akari
@@ -22,23 +24,32 @@ namespace Akari
         const CD3DX12_DESCRIPTOR_RANGE1 descriptorRage(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, static_cast<UINT>(Material::TextureType::NumTypes), 3);
         const CD3DX12_DESCRIPTOR_RANGE1 cubeMapRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 3 + static_cast<UINT>(Material::TextureType::NumTypes));
         const CD3DX12_DESCRIPTOR_RANGE1 LUTsRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2 + 3 + static_cast<UINT>(Material::TextureType::NumTypes));
+        const CD3DX12_DESCRIPTOR_RANGE1 shadowMapRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3 + 3 + static_cast<UINT>(Material::TextureType::NumTypes));
 
         CD3DX12_ROOT_PARAMETER1 rootParameters[NumRootParameters];
         rootParameters[MatricesCB].InitAsConstantBufferView( 0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL );
+        rootParameters[Instances].InitAsShaderResourceView( 0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX );
         rootParameters[MaterialCB].InitAsConstantBufferView( 0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[LightPropertiesCB].InitAsConstants( sizeof( LightProperties ) / 4, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[PointLights].InitAsShaderResourceView( 0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[SpotLights].InitAsShaderResourceView( 1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[DirectionalLights].InitAsShaderResourceView( 2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
+        rootParameters[LightClusters].InitAsShaderResourceView( 0, 2, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
+        rootParameters[LightIndices].InitAsShaderResourceView( 1, 2, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[Textures].InitAsDescriptorTable( 1, &descriptorRage, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[CubeMaps].InitAsDescriptorTable( 1, &cubeMapRange, D3D12_SHADER_VISIBILITY_PIXEL );
         rootParameters[LUTs].InitAsDescriptorTable( 1, &LUTsRange, D3D12_SHADER_VISIBILITY_PIXEL );
+        rootParameters[ShadowCB].InitAsConstantBufferView( 2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL );
+        rootParameters[ShadowMap].InitAsDescriptorTable( 1, &shadowMapRange, D3D12_SHADER_VISIBILITY_PIXEL );
 
-        constexpr int numSamplers = 2;
+        constexpr int numSamplers = 3;
         CD3DX12_STATIC_SAMPLER_DESC samplers[numSamplers] = {
             {0, D3D12_FILTER_ANISOTROPIC},
             {1, D3D12_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
-            D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP}
+            D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP},
+            // Shadow map comparisons, bilinear over the four nearest depth tests
+            {2, D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+            D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, 0.0f, 1, D3D12_COMPARISON_FUNC_LESS_EQUAL}
         };
 
         CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
@@ -63,19 +74,19 @@ namespace Akari
     {
     }
 
-    void RenderStateObject::SetModelMatrix(glm::mat4 modelMat)
+    void RenderStateObject::SetInstances(std::span<const InstanceData> instances)
     {
-        m_MVP.Model = modelMat;
+        m_Instances = instances;
     }
 
     void RenderStateObject::SetViewMatrix(glm::mat4 viewMat)
     {
-        m_MVP.View = viewMat;
+        m_Matrices.View = viewMat;
     }
 
     void RenderStateObject::SetProjMatrix(glm::mat4 projMat)
     {
-        m_MVP.Proj = projMat;
+        m_Matrices.Proj = projMat;
     }
 
     void RenderStateObject::SetDirectionalLights(const std::vector<DirectionalLight>& dirLights)
@@ -83,6 +94,12 @@ namespace Akari
         m_DirLights = dirLights;
     }
 
+    void RenderStateObject::SetPointLights(const std::vector<PointLight>& pointLights, const LightClustering& clustering)
+    {
+        m_PointLights = &pointLights;
+        m_LightClustering = &clustering;
+    }
+
     void RenderStateObject::SetCubeMaps(const std::shared_ptr<ShaderResourceView>& skyboxSRV,
         std::shared_ptr<ShaderResourceView> skyboxIrrSRV)
     {
@@ -95,7 +112,17 @@ namespace Akari
         m_IBLTextureSRV = IBLTextureSRV;
     }
 
-    void RenderStateObject::SetMaterial(const std::shared_ptr<Material>& mat)
+    void RenderStateObject::SetShadowMap(const std::shared_ptr<ShaderResourceView>& shadowMapSRV)
+    {
+        m_ShadowMapSRV = shadowMapSRV;
+    }
+
+    void RenderStateObject::SetShadows(const ShadowProperties& shadows)
+    {
+        m_Shadows = shadows;
+    }
+
+    void RenderStateObject::SetMaterial(const Material* mat)
     {
         m_Material = mat;
     }
@@ -145,7 +172,7 @@ namespace Akari
         pipelineStateStream.VS                    = {VSByteCode, VSLength};
         pipelineStateStream.PS                    = {PSByteCode, PSLength};
         pipelineStateStream.RasterizerState       = CD3DX12_RASTERIZER_DESC(rasterizerDesc);
-        pipelineStateStream.InputLayout           = VertexPositionNormalTangentBitangentTexture::InputLayout;
+        pipelineStateStream.InputLayout           = VertexPositionQTangentTexture::InputLayout;
         pipelineStateStream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
         pipelineStateStream.DSVFormat             = m_RenderTarget->GetDepthStencilFormat();
         pipelineStateStream.RTVFormats            = m_RenderTarget->GetRenderTargetFormats();
@@ -155,25 +182,60 @@ namespace Akari
         m_PipelineStateObject = m_Device->CreatePipelineStateObject( pipelineStateStream );
     }
 
-    void RenderStateObject::Apply(CommandList& cmd)
+    void RenderStateObject::ApplyPassState(CommandList& cmd)
     {
-        m_MVP.Mvp = m_MVP.Proj * m_MVP.View * m_MVP.Model;
-        m_MVP.InvModel = inverse(m_MVP.Model);
-        m_MVP.InvView = inverse(m_MVP.View);
-        
-        const auto& materialProps = m_Material->GetMaterialProperties();
+        m_Matrices.ViewProj = m_Matrices.Proj * m_Matrices.View;
+        m_Matrices.InvView = inverse(m_Matrices.View);
+
+        assert(m_PointLights && m_LightClustering);
+
+        const D3D12_VIEWPORT viewport = m_RenderTarget->GetViewport();
+
         LightProperties lightProps;
+        lightProps.NumPointLights = static_cast<uint32_t>(m_PointLights->size());
         lightProps.NumDirectionalLights = static_cast<uint32_t>(m_DirLights.size());
-        
+        lightProps.ClusterCountX = LightClustering::ClusterCountX;
+        lightProps.ClusterCountY = LightClustering::ClusterCountY;
+        lightProps.ClusterCountZ = LightClustering::ClusterCountZ;
+        lightProps.ClusterDepthScale = m_LightClustering->GetDepthSliceScale();
+        lightProps.ClusterDepthBias = m_LightClustering->GetDepthSliceBias();
+        lightProps.ClusterTileScale = glm::vec2(LightClustering::ClusterCountX / viewport.Width, LightClustering::ClusterCountY / viewport.Height);
+
+        // Root arguments persist across draws on the command list, so these are only set once per pass
         cmd.SetPipelineState(m_PipelineStateObject);
         cmd.SetGraphicsRootSignature(m_RootSig);
-        cmd.SetGraphicsDynamicConstantBuffer(MatricesCB, m_MVP);
-        cmd.SetGraphicsDynamicConstantBuffer(MaterialCB, materialProps);
+        cmd.SetGraphicsDynamicConstantBuffer(MatricesCB, m_Matrices);
         cmd.SetGraphics32BitConstants(LightPropertiesCB, lightProps);
         cmd.SetGraphicsDynamicStructuredBuffer(DirectionalLights, m_DirLights);
+        cmd.SetGraphicsDynamicStructuredBuffer(PointLights, *m_PointLights);
+        cmd.SetGraphicsDynamicStructuredBuffer(LightClusters, m_LightClustering->GetClusters());
+        cmd.SetGraphicsDynamicStructuredBuffer(LightIndices, m_LightClustering->GetLightIndices());
         cmd.SetShaderResourceView(CubeMaps, 0, m_SkyboxSRV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
         cmd.SetShaderResourceView(CubeMaps, 1, m_SkyboxIrrSRV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
         cmd.SetShaderResourceView(LUTs, 0, m_IBLTextureSRV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        cmd.SetGraphicsDynamicConstantBuffer(ShadowCB, m_Shadows);
+        cmd.SetShaderResourceView(ShadowMap, 0, m_ShadowMapSRV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+        m_BoundMaterial = nullptr;
+        m_Stats = {};
+        m_Stats.PipelineChanges++;
+    }
+
+    void RenderStateObject::ApplyDrawState(CommandList& cmd)
+    {
+        assert(!m_Instances.empty());
+
+        cmd.SetGraphicsDynamicStructuredBuffer(Instances, m_Instances.size(), sizeof(InstanceData), m_Instances.data());
+        m_Stats.Draws++;
+        m_Stats.Instances += static_cast<uint32_t>(m_Instances.size());
+
+        if (m_Material == m_BoundMaterial)
+            return;
+
+        m_BoundMaterial = m_Material;
+        m_Stats.MaterialChanges++;
+
+        cmd.SetGraphicsDynamicConstantBuffer(MaterialCB, m_Material->GetMaterialProperties());
 
         using TextureType = Material::TextureType;
 
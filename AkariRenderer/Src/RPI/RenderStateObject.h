@@ -1,5 +1,7 @@
 #pragma once
+#include <span>
 
+#include "RPI/CascadedShadows.h"
 #include "SceneComponents/Light.h"
 
 namespace Akari
@@ -12,6 +14,8 @@ namespace Akari
     class RootSignature;
     class PipelineStateObject;
     class ShaderResourceView;
+    class LightClustering;
+    struct InstanceData;
 
     class RenderStateObject
     {
@@ -21,8 +25,9 @@ namespace Akari
         // to use these as root indices in the root signature.
         enum RootParameters
         {
-            // Vertex shader parameter
+            // Vertex shader parameters
             MatricesCB,  // ConstantBuffer<Matrices> MatCB : register(b0);
+            Instances,   // StructuredBuffer<InstanceData> Instances : register( t0, space1 );
 
             // Pixel shader parameters
             MaterialCB,         // ConstantBuffer<Material> MaterialCB : register( b0, space1 );
@@ -31,6 +36,8 @@ namespace Akari
             PointLights,        // StructuredBuffer<PointLight> PointLights : register( t0 );
             SpotLights,         // StructuredBuffer<SpotLight> SpotLights : register( t1 );
             DirectionalLights,  // StructuredBuffer<DirectionalLight> DirectionalLights : register( t2 )
+            LightClusters,      // StructuredBuffer<LightCluster> LightClusters : register( t0, space2 );
+            LightIndices,       // StructuredBuffer<uint> LightIndices : register( t1, space2 );
 
             Textures,  // Texture2D BaseColor : register( t3 );
                        // Texture2D Metallic : register( t4 );
@@ -43,6 +50,8 @@ namespace Akari
             CubeMaps,  // TextureCube<float4> Skybox : register( t11 );
                        // TextureCube<float4> SkyboxIrr : register( t12 );
             LUTs,      // Texture2D IBLTexture : register( t13 );
+            ShadowCB,  // ConstantBuffer<ShadowProperties> ShadowCB : register( b2 );
+            ShadowMap, // Texture2D ShadowMap : register( t14 );
             NumRootParameters
         };
 
@@ -52,54 +61,97 @@ namespace Akari
             uint32_t NumPointLights{0};
             uint32_t NumSpotLights{0};
             uint32_t NumDirectionalLights{0};
+
+            // Point light clusters, see LightClustering
+            uint32_t ClusterCountX{0};
+            uint32_t ClusterCountY{0};
+            uint32_t ClusterCountZ{0};
+            float ClusterDepthScale{0.0f};
+            float ClusterDepthBias{0.0f};
+            glm::vec2 ClusterTileScale{0.0f}; // Clusters per pixel
+        };
+
+        // Cascaded shadows of one directional light, see CascadedShadows and ShadowPass.
+        struct alignas(16) ShadowProperties
+        {
+            // World space to shadow atlas texture coordinates and depth, per cascade
+            std::array<glm::mat4, CascadedShadows::CascadeCount> ShadowMatrices{};
+            glm::vec4 SplitDepths{0.0f}; // Far view depth of every cascade
+            glm::vec4 TexelSizes{0.0f};  // World size of a shadow map texel, scales the normal offset
+            uint32_t CascadeCount{0};    // 0 when no light casts shadows
+            uint32_t LightIndex{0};      // The shadowed light in DirectionalLights, its ShadowAmount and SoftShadows apply
+        };
+
+        // State changes recorded since the last ApplyPassState.
+        struct Stats
+        {
+            uint32_t Draws{0};
+            uint32_t Instances{0};
+            uint32_t PipelineChanges{0};
+            uint32_t MaterialChanges{0};
         };
         
         RenderStateObject(std::shared_ptr<Device> device);
         ~RenderStateObject();
 
-        void SetModelMatrix(glm::mat4 modelMat);
+        // Instances of the next draw, the data must stay alive until ApplyDrawState
+        void SetInstances(std::span<const InstanceData> instances);
         void SetViewMatrix(glm::mat4 viewMat);
         void SetProjMatrix(glm::mat4 projMat);
 
         void SetDirectionalLights(const std::vector<DirectionalLight>& dirLights);
+        // The point lights and their clusters are read by ApplyPassState, both must stay alive until then
+        void SetPointLights(const std::vector<PointLight>& pointLights, const LightClustering& clustering);
         void SetCubeMaps(const std::shared_ptr<ShaderResourceView>& skyboxSRV, std::shared_ptr<ShaderResourceView> skyboxIrrSRV);
         void SetLUTs(const std::shared_ptr<ShaderResourceView>& IBLTextureSRV);
-        void SetMaterial(const std::shared_ptr<Material>& mat);
+        void SetShadowMap(const std::shared_ptr<ShaderResourceView>& shadowMapSRV);
+        void SetShadows(const ShadowProperties& shadows);
+        void SetMaterial(const Material* mat);
         void SetRenderTarget(const std::shared_ptr<RenderTarget>& rt);
         void SetShader(const unsigned char* VSByteCode, size_t VSLength, const unsigned char* PSByteCode, size_t PSLength);
 
-        void Apply(CommandList& cmd);
+        // Binds everything shared by the draws of a pass: pipeline, root signature, lights and environment maps.
+        void ApplyPassState(CommandList& cmd);
+        // Binds the instances, and the material constants and textures when the material changed since the last draw.
+        void ApplyDrawState(CommandList& cmd);
+
+        const Stats& GetStats() const { return m_Stats; }
 
     private:
-        struct alignas(16) MVP
+        // The model matrices are per instance
+        struct alignas(16) Matrices
         {
-            glm::mat4 Model = glm::mat4(1.0);
             glm::mat4 View = glm::mat4(1.0);
             glm::mat4 Proj = glm::mat4(1.0);
-            glm::mat4 Mvp = glm::mat4(1.0);
-            glm::mat4 InvModel = glm::mat4(1.0);
+            glm::mat4 ViewProj = glm::mat4(1.0);
             glm::mat4 InvView = glm::mat4(1.0);
-
-            glm::mat4 operator() () const {return Proj * View * Model;}
-            operator glm::mat4() const {return Proj * View * Model;}
         };
 
         inline void BindTexture(CommandList& cmd, uint32_t offset, const std::shared_ptr<Texture>& tex) const;
 
-        MVP m_MVP;
+        Matrices m_Matrices;
+        std::span<const InstanceData> m_Instances;
         
         std::shared_ptr<Device> m_Device;
-        std::shared_ptr<Material> m_Material;
+        const Material* m_Material = nullptr;
+        const Material* m_BoundMaterial = nullptr;
         std::shared_ptr<RenderTarget> m_RenderTarget;
         std::shared_ptr<RootSignature> m_RootSig;
         std::shared_ptr<ShaderResourceView> m_DefaultSRV;
         std::shared_ptr<PipelineStateObject> m_PipelineStateObject;
 
         std::vector<DirectionalLight> m_DirLights;
+        const std::vector<PointLight>* m_PointLights = nullptr;
+        const LightClustering* m_LightClustering = nullptr;
 
         std::shared_ptr<ShaderResourceView> m_SkyboxSRV;
         std::shared_ptr<ShaderResourceView> m_SkyboxIrrSRV;
         std::shared_ptr<ShaderResourceView> m_IBLTextureSRV;
+
+        ShadowProperties m_Shadows;
+        std::shared_ptr<ShaderResourceView> m_ShadowMapSRV;
+
+        Stats m_Stats;
     };
     
 }
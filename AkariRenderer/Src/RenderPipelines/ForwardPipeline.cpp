@@ -8,7 +8,10 @@
 #include "RHI/Texture.h"
 #include "RHI/CommandList.h"
 #include "RHI/Device.h"
+#include "RHI/RenderTarget.h"
 #include "RPI/RenderContext.h"
+#include "Application/Application.h"
+#include "SceneComponents/Scene.h"
 
 namespace Akari
 {
@@ -78,10 +81,38 @@ namespace Akari
         m_SkyboxIrrSRV = Renderer::GetInstance().GetDevice()->CreateShaderResourceView(m_SkyboxIrrCubemap, &cubeMapSRVDesc);
         m_IBLTextureSRV = Renderer::GetInstance().GetDevice()->CreateShaderResourceView(m_IBLTexture, &IBLSRVDesc);
 
+        // Typeless so the atlas is written as depth and sampled as float
+        auto shadowMapDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            DXGI_FORMAT_R32_TYPELESS,
+            ShadowPass::AtlasSize, ShadowPass::AtlasSize,
+            1, 1);
+        shadowMapDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+        D3D12_CLEAR_VALUE shadowClearValue;
+        shadowClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+        shadowClearValue.DepthStencil = {1.0f, 0};
+
+        m_ShadowMap = Renderer::GetInstance().GetDevice()->CreateTexture(shadowMapDesc, &shadowClearValue);
+        m_ShadowMap->SetName(L"Shadow Map Atlas");
+        m_ShadowRenderTarget = std::make_shared<RenderTarget>();
+        m_ShadowRenderTarget->AttachTexture(DepthStencil, m_ShadowMap);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC shadowMapSRVDesc = {};
+        shadowMapSRVDesc.Format                        = DXGI_FORMAT_R32_FLOAT;
+        shadowMapSRVDesc.ViewDimension                 = D3D12_SRV_DIMENSION_TEXTURE2D;
+        shadowMapSRVDesc.Texture2D.MostDetailedMip     = 0;
+        shadowMapSRVDesc.Texture2D.MipLevels           = 1;
+        shadowMapSRVDesc.Texture2D.PlaneSlice          = 0;
+        shadowMapSRVDesc.Texture2D.ResourceMinLODClamp = 0;
+        shadowMapSRVDesc.Shader4ComponentMapping       = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+        m_ShadowMapSRV = Renderer::GetInstance().GetDevice()->CreateShaderResourceView(m_ShadowMap, &shadowMapSRVDesc);
+
         spdlog::info("\tSetting up passes...");
+        m_ShadowPass = std::make_unique<ShadowPass>(m_ShadowRenderTarget);
         m_SkyboxPass = std::make_unique<SkyboxPass>(m_SceneMsaaRenderTarget, m_SkyboxSRV);
         m_GroundGridPass = std::make_unique<GroundGridPass>(m_SceneMsaaRenderTarget);
-        m_ForwardOpaquePass = std::make_unique<ForwardOpaquePass>(m_SceneMsaaRenderTarget, m_SkyboxSRV, m_SkyboxIrrSRV, m_IBLTextureSRV);
+        m_ForwardOpaquePass = std::make_unique<ForwardOpaquePass>(m_SceneMsaaRenderTarget, m_SkyboxSRV, m_SkyboxIrrSRV, m_IBLTextureSRV, m_ShadowMapSRV);
         m_BloomPass = std::make_unique<BloomPass>(m_SceneMsaaRenderTarget, m_SceneHDRFrameBuffer);
         m_ToneMappingPass = std::make_unique<ToneMappingPass>(m_SceneSDRRenderTarget, m_SceneHDRFrameBuffer);
     }
@@ -99,10 +130,47 @@ namespace Akari
             Renderer::GetInstance().ExecuteCommandList(cmd);
         }
 
-        m_SkyboxPass->Record(context);
-        m_GroundGridPass->Record(context);
-        m_ForwardOpaquePass->Record(context);
+        RenderContext frameContext = context;
+        if (context.scene)
+        {
+            {
+                SCOPE_PERF("Render Extraction");
+                m_Extraction.Extract(*context.scene, *context.scene->GetCamera(), m_DrawPackets);
+                m_Stats.Culling = m_Extraction.GetCullingStats();
+            }
+            {
+                SCOPE_PERF("Cluster Culling");
+                m_ClusterCulling.Cull(*context.scene->GetCamera(), m_DrawPackets);
+                m_Stats.ClusterCulling = m_ClusterCulling.GetStats();
+            }
+            {
+                SCOPE_PERF("Occlusion Culling");
+                m_OcclusionCulling.Cull(*context.scene->GetCamera(), m_DrawPackets);
+                m_Stats.Occlusion = m_OcclusionCulling.GetStats();
+            }
+            {
+                SCOPE_PERF("LOD Selection");
+                m_LodSelector.Select(*context.scene->GetCamera(), m_DrawPackets);
+            }
+            {
+                SCOPE_PERF("Draw Sorting");
+                m_DrawSorter.Sort(m_DrawPackets);
+            }
+            frameContext.drawPackets = &m_DrawPackets;
+        }
+
+        {
+            SCOPE_PERF("Shadow Casters");
+            m_ShadowPass->Record(frameContext);
+        }
+        frameContext.shadows = m_ShadowPass->GetShadows();
+
+        m_SkyboxPass->Record(frameContext);
+        m_GroundGridPass->Record(frameContext);
+        m_ForwardOpaquePass->Record(frameContext);
+        m_Stats.ForwardState = m_ForwardOpaquePass->GetStateStats();
         
+        m_ShadowPass->Execute();
         m_SkyboxPass->Execute();
         m_GroundGridPass->Execute();
         m_ForwardOpaquePass->Execute();
@@ -114,8 +182,8 @@ namespace Akari
             Renderer::GetInstance().ExecuteCommandList(cmd);
         }
 
-        m_BloomPass->Record(context);
-        m_ToneMappingPass->Record(context);
+        m_BloomPass->Record(frameContext);
+        m_ToneMappingPass->Record(frameContext);
         
         m_BloomPass->Execute();
         m_ToneMappingPass->Execute();
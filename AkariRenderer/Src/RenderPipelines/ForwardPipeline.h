@@ -1,8 +1,14 @@
 #pragma once
 #include "RPI/RenderPipeline.h"
+#include "RPI/RenderExtraction.h"
+#include "RPI/ClusterCulling.h"
+#include "RPI/OcclusionCulling.h"
+#include "RPI/LodSelector.h"
+#include "RPI/DrawPacketSorter.h"
 #include "Pass/ForwardOpaquePass.h"
 #include "Pass/GroundGridPass.h"
 #include "Pass/SkyboxPass.h"
+#include "Pass/ShadowPass.h"
 #include "Pass/BloomPass/BloomPass.h"
 #include "Pass/ToneMappingPass/ToneMappingPass.h"
 
@@ -19,12 +25,20 @@ namespace Akari
         void Render(const RenderContext& context) override;
 
     private:
+        std::unique_ptr<ShadowPass> m_ShadowPass = nullptr;
         std::unique_ptr<SkyboxPass> m_SkyboxPass = nullptr;
         std::unique_ptr<GroundGridPass> m_GroundGridPass = nullptr;
         std::unique_ptr<ForwardOpaquePass> m_ForwardOpaquePass = nullptr;
         std::unique_ptr<BloomPass> m_BloomPass = nullptr;
         std::unique_ptr<ToneMappingPass> m_ToneMappingPass = nullptr;
 
+        RenderExtraction m_Extraction;
+        ClusterCulling m_ClusterCulling;
+        OcclusionCulling m_OcclusionCulling;
+        LodSelector m_LodSelector;
+        DrawPacketSorter m_DrawSorter;
+        DrawPacketList m_DrawPackets;
+
         std::shared_ptr<Texture> m_SkyboxPano;
         std::shared_ptr<Texture> m_SkyboxCubemap;
         std::shared_ptr<ShaderResourceView> m_SkyboxSRV;
@@ -35,5 +49,10 @@ namespace Akari
 
         std::shared_ptr<Texture> m_IBLTexture;
         std::shared_ptr<ShaderResourceView> m_IBLTextureSRV;
+
+        // Depth atlas of the shadow cascades, see ShadowPass
+        std::shared_ptr<Texture> m_ShadowMap;
+        std::shared_ptr<RenderTarget> m_ShadowRenderTarget;
+        std::shared_ptr<ShaderResourceView> m_ShadowMapSRV;
     };
 }
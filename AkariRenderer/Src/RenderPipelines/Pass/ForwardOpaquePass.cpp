@@ -1,14 +1,14 @@
 #include "pch.h"
 #include "ForwardOpaquePass.h"
+#include "ShadowPass.h"
 #include "RHI/CommandList.h"
 #include "RHI/Renderer.h"
 #include "RHI/RenderTarget.h"
+#include "RPI/DrawPacketList.h"
 #include "RPI/RenderStateObject.h"
 #include "SceneComponents/Mesh.h"
 #include "SceneComponents/Light.h"
-#include "SceneComponents/ModelNode.h"
 #include "SceneComponents/Scene.h"
-#include "SceneComponents/SceneObject.h"
 #include "SceneComponents/Camera/EditorCamera.h"
 
 #include "Shaders/Generated/Lit_VS.h"
@@ -20,7 +20,8 @@ namespace Akari
         std::shared_ptr<RenderTarget> renderTarget,
         std::shared_ptr<ShaderResourceView> skyboxSRV,
         std::shared_ptr<ShaderResourceView> skyboxIrrSRV,
-        std::shared_ptr<ShaderResourceView> IBLTextureSRV)
+        std::shared_ptr<ShaderResourceView> IBLTextureSRV,
+        std::shared_ptr<ShaderResourceView> shadowMapSRV)
     : RenderPass(renderTarget), m_SkyboxSRV(skyboxSRV), m_SkyboxIrrSRV(skyboxIrrSRV), m_IBLTextureSRV(IBLTextureSRV)
     {
         m_RenderState = std::make_shared<RenderStateObject>(Renderer::GetInstance().GetDevice());
@@ -28,6 +29,7 @@ namespace Akari
         m_RenderState->SetShader(g_Lit_VS, sizeof g_Lit_VS, g_Lit_PS, sizeof g_Lit_PS);
         m_RenderState->SetCubeMaps(m_SkyboxSRV, m_SkyboxIrrSRV);
         m_RenderState->SetLUTs(m_IBLTextureSRV);
+        m_RenderState->SetShadowMap(shadowMapSRV);
     }
 
     void ForwardOpaquePass::Record(const RenderContext& context)
@@ -38,64 +40,88 @@ namespace Akari
         m_Cmd->SetViewport(m_RenderTarget->GetViewport());
         m_Cmd->SetScissorRect(CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX));
 
-        ForwardOpaqueVisitor visitor(*m_Cmd, context, *m_RenderState);
-        if (context.scene)
+        if (!context.scene || !context.drawPackets)
+            return;
+
+        auto& scene = *context.scene;
+        const auto& camera = *scene.GetCamera();
+
+        const auto dirLights = scene.GetAllSceneObjectsWith<TransformComponent, DirectionalLightComponent>();
+        std::vector<DirectionalLight> dirLightComps;
+        for (const auto entity : dirLights)
         {
-            context.scene->Accept(visitor);
+            const auto& [transform, light] = dirLights.get<TransformComponent, DirectionalLightComponent>(entity);
+            dirLightComps.push_back({transform, light});
         }
-    }
 
-    void ForwardOpaquePass::Execute()
-    {
-        if (m_Cmd)
+        // The shadow pass rendered the first directional light casting shadows
+        RenderStateObject::ShadowProperties shadowProps;
+        if (context.shadows)
         {
-            Renderer::GetInstance().ExecuteCommandList(m_Cmd);
+            const auto shadowLight = std::find_if(dirLightComps.begin(), dirLightComps.end(), [](const DirectionalLight& light)
+            {
+                return light.Props.CastShadows;
+            });
+            assert(shadowLight != dirLightComps.end());
+
+            const auto& cascades = context.shadows->GetCascades();
+            for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+            {
+                shadowProps.ShadowMatrices[i] = ShadowPass::GetAtlasMatrix(i) * cascades[i].ViewProjection;
+                shadowProps.SplitDepths[i] = cascades[i].SplitFar;
+                shadowProps.TexelSizes[i] = cascades[i].TexelSize;
+            }
+            shadowProps.CascadeCount = CascadedShadows::CascadeCount;
+            shadowProps.LightIndex = static_cast<uint32_t>(shadowLight - dirLightComps.begin());
         }
-        else
+
+        // Point lights are clustered at their world position
+        const auto pointLights = scene.GetAllSceneObjectsWith<TransformComponent, PointLightComponent, HierarchyComponent>();
+        const auto& worldMatrices = scene.GetWorldMatrices();
+        m_PointLights.clear();
+        for (const auto entity : pointLights)
         {
-            spdlog::error("Pass executed with null command list!");
+            const auto& [transform, light, hierarchy] = pointLights.get<TransformComponent, PointLightComponent, HierarchyComponent>(entity);
+            PointLight& pointLight = m_PointLights.emplace_back(PointLight{ transform, light });
+            pointLight.Trans.Translation = glm::vec3(worldMatrices[hierarchy.FlattenedIndex][3]);
         }
-    }
 
-    ForwardOpaqueVisitor::ForwardOpaqueVisitor(CommandList& commandList, const RenderContext& context, RenderStateObject& state)
-    : m_Cmd(commandList), m_RenderState(state), m_Camera(*context.scene->GetCamera())
-    {
-        
-    }
+        m_LightClustering.Build(m_PointLights, camera.GetViewMatrix(), camera.GetVerticalFOV(), camera.GetAspectRatio(), camera.GetNearClip(), camera.GetFarClip());
 
-    void ForwardOpaqueVisitor::Visit(Scene& scene)
-    {
-        const auto& dirLights = scene.GetAllSceneObjectsWith<DirectionalLightComponent>();
-        std::vector<DirectionalLight> dirLightComps;
+        m_RenderState->SetDirectionalLights(dirLightComps);
+        m_RenderState->SetShadows(shadowProps);
+        m_RenderState->SetPointLights(m_PointLights, m_LightClustering);
+        m_RenderState->SetViewMatrix(camera.GetViewMatrix());
+        m_RenderState->SetProjMatrix(camera.GetProjectionMatrix());
+
+        // The packets arrive sorted by material and front to back, consecutive draws mostly share their material
+        m_RenderState->ApplyPassState(*m_Cmd);
 
-        for (const auto& dirLight : dirLights)
+        m_Batcher.Build(*context.drawPackets);
+        const std::span<const InstanceData> instances = m_Batcher.GetInstances();
+        for (const DrawBatch& batch : m_Batcher.GetBatches())
         {
-            SceneObject obj(dirLight, &scene);
-            DirectionalLight light{obj.GetComponent<TransformComponent>(), obj.GetComponent<DirectionalLightComponent>()};
-            dirLightComps.push_back(light);
+            m_RenderState->SetInstances(instances.subspan(batch.FirstInstance, batch.InstanceCount));
+            m_RenderState->SetMaterial(batch.BatchMaterial);
+            m_RenderState->ApplyDrawState(*m_Cmd);
+            batch.BatchMesh->Draw(*m_Cmd, batch.InstanceCount, 0, batch.Lod);
         }
-
-        m_RenderState.SetDirectionalLights(dirLightComps);
-        m_RenderState.SetViewMatrix(m_Camera.GetViewMatrix());
-        m_RenderState.SetProjMatrix(m_Camera.GetProjectionMatrix());
-    }
-
-    void ForwardOpaqueVisitor::Visit(SceneObject& model)
-    {
-        const auto& trans = model.GetComponent<TransformComponent>();
-        m_RenderState.SetModelMatrix(trans.GetTransform());
     }
 
-    void ForwardOpaqueVisitor::Visit(ModelNode& modelNode)
+    const RenderStateObject::Stats& ForwardOpaquePass::GetStateStats() const
     {
-        // m_RenderState.SetModelMatrix(modelNode.GetWorldTransform());
+        return m_RenderState->GetStats();
     }
 
-    void ForwardOpaqueVisitor::Visit(Mesh& mesh)
+    void ForwardOpaquePass::Execute()
     {
-        const auto material = mesh.GetMaterial();
-        m_RenderState.SetMaterial(material);
-        m_RenderState.Apply(m_Cmd);
-        mesh.Draw(m_Cmd);
+        if (m_Cmd)
+        {
+            Renderer::GetInstance().ExecuteCommandList(m_Cmd);
+        }
+        else
+        {
+            spdlog::error("Pass executed with null command list!");
+        }
     }
 }
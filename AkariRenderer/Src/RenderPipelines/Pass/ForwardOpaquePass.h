@@ -1,14 +1,11 @@
 #pragma once
 #include "RPI/RenderPass.h"
-#include "SceneComponents/Visitor.h"
+#include "RPI/DrawBatcher.h"
+#include "RPI/LightClustering.h"
+#include "RPI/RenderStateObject.h"
 
 namespace Akari
 {
-    class Scene;
-    class CommandList;
-    class EditorCamera;
-    class RenderStateObject;
-    class SceneObject;
     class ShaderResourceView;
 
     class ForwardOpaquePass : public RenderPass
@@ -18,32 +15,23 @@ namespace Akari
             std::shared_ptr<RenderTarget> renderTarget,
             std::shared_ptr<ShaderResourceView> skyboxSRV,
             std::shared_ptr<ShaderResourceView> skyboxIrrSRV,
-            std::shared_ptr<ShaderResourceView> IBLTextureSRV);
+            std::shared_ptr<ShaderResourceView> IBLTextureSRV,
+            std::shared_ptr<ShaderResourceView> shadowMapSRV);
 
         void Record(const RenderContext& context) override;
         void Execute() override;
 
+        // State changes of the last recorded frame
+        const RenderStateObject::Stats& GetStateStats() const;
+
     private:
         std::shared_ptr<RenderStateObject> m_RenderState;
+        DrawBatcher m_Batcher;
+        LightClustering m_LightClustering;
+        std::vector<PointLight> m_PointLights;
         
         std::shared_ptr<ShaderResourceView> m_SkyboxSRV;
         std::shared_ptr<ShaderResourceView> m_SkyboxIrrSRV;
         std::shared_ptr<ShaderResourceView> m_IBLTextureSRV;
     };
-
-    class ForwardOpaqueVisitor : public Visitor
-    {
-    public:
-        ForwardOpaqueVisitor(CommandList& commandList, const RenderContext& context, RenderStateObject& state);
-
-        void Visit(Scene& scene) override;
-        void Visit(SceneObject& model) override;
-        void Visit(ModelNode& modelNode) override;
-        void Visit(Mesh& mesh) override;
-
-    private:
-        CommandList& m_Cmd;
-        RenderStateObject& m_RenderState;
-        EditorCamera& m_Camera;
-    };
 }
@@ -1,2 +1,168 @@
 #include "pch.h"
 #include "ShadowPass.h"
+
+#include "RHI/CommandList.h"
+#include "RHI/Renderer.h"
+#include "RHI/RootSignature.h"
+#include "RHI/Device.h"
+#include "RHI/RenderTarget.h"
+#include "SceneComponents/Mesh.h"
+#include "SceneComponents/Light.h"
+#include "SceneComponents/Scene.h"
+#include "SceneComponents/Camera/EditorCamera.h"
+#include "Shaders/Generated/Shadow_VS.h"
+
+namespace Akari
+{
+    ShadowPass::ShadowPass(std::shared_ptr<RenderTarget> renderTarget) : RenderPass(renderTarget)
+    {
+        // Allow input layout and deny unnecessary access to certain pipeline stages.
+        D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+                                                        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+                                                        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+                                                        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
+                                                        D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+
+        CD3DX12_ROOT_PARAMETER1 rootParameters[NumRootParams];
+        rootParameters[ShadowViewCB].InitAsConstants( sizeof( glm::mat4 ) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX );
+        rootParameters[Instances].InitAsShaderResourceView( 0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX );
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+        rootSignatureDescription.Init_1_1( NumRootParams, rootParameters, 0, nullptr, rootSignatureFlags );
+
+        m_RootSig = Renderer::GetInstance().GetDevice()->CreateRootSignature( rootSignatureDescription.Desc_1_1 );
+
+        // Regular depth, the atlas is cleared to the far plane
+        D3D12_DEPTH_STENCIL_DESC depthStencilDesc = {};
+        depthStencilDesc.DepthEnable = true;
+        depthStencilDesc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+        depthStencilDesc.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+        depthStencilDesc.StencilEnable = false;
+
+        // Casters in front of the near plane are clamped onto it instead of clipped,
+        // the slope scaled bias keeps lit surfaces from shadowing themselves
+        D3D12_RASTERIZER_DESC rasterizerDesc = {};
+        rasterizerDesc.FillMode = D3D12_FILL_MODE_SOLID;
+        rasterizerDesc.CullMode = D3D12_CULL_MODE_NONE;
+        rasterizerDesc.FrontCounterClockwise = FALSE;
+        rasterizerDesc.DepthBias = 1000;
+        rasterizerDesc.DepthBiasClamp = 0.01f;
+        rasterizerDesc.SlopeScaledDepthBias = 2.0f;
+        rasterizerDesc.DepthClipEnable = false;
+        rasterizerDesc.MultisampleEnable = false;
+        rasterizerDesc.AntialiasedLineEnable = FALSE;
+        rasterizerDesc.ForcedSampleCount = 0;
+        rasterizerDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+
+        // Setup the shadow pipeline state.
+        struct ShadowPipelineState
+        {
+            CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE        pRootSignature;
+            CD3DX12_PIPELINE_STATE_STREAM_INPUT_LAYOUT          InputLayout;
+            CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY    PrimitiveTopologyType;
+            CD3DX12_PIPELINE_STATE_STREAM_VS                    VS;
+            CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL_FORMAT  DSVFormat;
+            CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS RTVFormats;
+            CD3DX12_PIPELINE_STATE_STREAM_SAMPLE_DESC           SampleDesc;
+            CD3DX12_PIPELINE_STATE_STREAM_RASTERIZER            RasterizerState;
+            CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL         DepthStencilState;
+        } shadowPipelineStateStream {};
+
+        shadowPipelineStateStream.pRootSignature        = m_RootSig->GetD3D12RootSignature().Get();
+        shadowPipelineStateStream.InputLayout           = VertexPositionQTangentTexture::InputLayout;
+        shadowPipelineStateStream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        shadowPipelineStateStream.VS                    = {g_Shadow_VS, sizeof g_Shadow_VS};
+        shadowPipelineStateStream.DSVFormat             = m_RenderTarget->GetDepthStencilFormat();
+        shadowPipelineStateStream.RTVFormats            = m_RenderTarget->GetRenderTargetFormats();
+        shadowPipelineStateStream.SampleDesc            = m_RenderTarget->GetSampleDesc();
+        shadowPipelineStateStream.RasterizerState       = CD3DX12_RASTERIZER_DESC(rasterizerDesc);
+        shadowPipelineStateStream.DepthStencilState     = CD3DX12_DEPTH_STENCIL_DESC(depthStencilDesc);
+
+        m_PipelineState = Renderer::GetInstance().GetDevice()->CreatePipelineStateObject( shadowPipelineStateStream );
+    }
+
+    void ShadowPass::Record(const RenderContext& context)
+    {
+        m_Cmd = Renderer::GetInstance().GetCommandListDirect();
+        m_Active = false;
+
+        m_Cmd->SetRenderTarget(*m_RenderTarget);
+        m_Cmd->ClearDepthStencilTexture(m_RenderTarget->GetTexture(DepthStencil), D3D12_CLEAR_FLAG_DEPTH, 1.0f);
+
+        if (!context.scene)
+            return;
+
+        auto& scene = *context.scene;
+        const auto& camera = *scene.GetCamera();
+
+        // The first directional light casting shadows, the lit pass picks the same one
+        const auto dirLights = scene.GetAllSceneObjectsWith<TransformComponent, DirectionalLightComponent>();
+        const auto shadowLight = std::find_if(dirLights.begin(), dirLights.end(), [&](const entt::entity entity)
+        {
+            return dirLights.get<DirectionalLightComponent>(entity).CastShadows;
+        });
+        if (shadowLight == dirLights.end())
+            return;
+
+        const glm::vec3 lightDirection = -GetDirectionToLight(dirLights.get<TransformComponent>(*shadowLight).Rotation);
+        m_Shadows.Update(camera.GetViewMatrix(), camera.GetVerticalFOV(), camera.GetAspectRatio(), camera.GetNearClip(), camera.GetFarClip(),
+                         lightDirection, CascadeResolution);
+        m_Active = true;
+
+        // Candidates come from the volume between the cascades and the light, then each cascade keeps its own casters
+        const Frustum casterFrustum(m_Shadows.GetCasterViewProjection(scene.GetBVH().GetBounds()), false);
+        m_Extraction.Extract(scene, casterFrustum, glm::mat4(1.0f), m_Candidates);
+        // Casters use the level of detail the camera sees them with, so their shadows match the lit surfaces
+        m_LodSelector.Select(camera, m_Candidates);
+
+        m_CandidateBounds.Clear();
+        for (const auto& aabb : m_Candidates.WorldAABBs)
+            m_CandidateBounds.Add(aabb);
+        m_Shadows.CullCasters(m_CandidateBounds);
+
+        m_Cmd->SetPipelineState(m_PipelineState);
+        m_Cmd->SetGraphicsRootSignature(m_RootSig);
+
+        for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+        {
+            // Depth only, so draws only differ by mesh and LOD and are batched across materials
+            m_CascadePackets.Clear();
+            for (const uint32_t caster : m_Shadows.GetCasters(i))
+            {
+                m_CascadePackets.Add(m_Candidates.WorldMatrices[caster], m_Candidates.WorldAABBs[caster], m_Candidates.Meshes[caster],
+                                     nullptr, m_Candidates.SortKeys[caster], DrawPacketFlag_None, m_Candidates.Lods[caster]);
+            }
+
+            const auto x = static_cast<float>(i % 2 * CascadeResolution);
+            const auto y = static_cast<float>(i / 2 * CascadeResolution);
+            const auto size = static_cast<float>(CascadeResolution);
+            m_Cmd->SetViewport(CD3DX12_VIEWPORT(x, y, size, size));
+            m_Cmd->SetScissorRect(CD3DX12_RECT(static_cast<LONG>(x), static_cast<LONG>(y), static_cast<LONG>(x + size), static_cast<LONG>(y + size)));
+            m_Cmd->SetGraphics32BitConstants(ShadowViewCB, m_Shadows.GetCascades()[i].ViewProjection);
+
+            m_Batcher.Build(m_CascadePackets);
+            const std::span<const InstanceData> instances = m_Batcher.GetInstances();
+            for (const DrawBatch& batch : m_Batcher.GetBatches())
+            {
+                m_Cmd->SetGraphicsDynamicStructuredBuffer(Instances, batch.InstanceCount, sizeof(InstanceData), instances.data() + batch.FirstInstance);
+                batch.BatchMesh->Draw(*m_Cmd, batch.InstanceCount, 0, batch.Lod);
+            }
+        }
+    }
+
+    void ShadowPass::Execute()
+    {
+        Renderer::GetInstance().ExecuteCommandList(m_Cmd);
+    }
+
+    glm::mat4 ShadowPass::GetAtlasMatrix(uint32_t cascade)
+    {
+        // Clip space x and y in [-1, 1] with y up, to the cascade's quarter of the atlas with v down
+        glm::mat4 atlas(1.0f);
+        atlas[0][0] = 0.25f;
+        atlas[1][1] = -0.25f;
+        atlas[3][0] = 0.25f + 0.5f * static_cast<float>(cascade % 2);
+        atlas[3][1] = 0.25f + 0.5f * static_cast<float>(cascade / 2);
+        return atlas;
+    }
+}
@@ -1,7 +1,51 @@
 #pragma once
+#include "RPI/RenderPass.h"
+#include "RPI/CascadedShadows.h"
+#include "RPI/DrawBatcher.h"
+#include "RPI/LodSelector.h"
+#include "RPI/RenderExtraction.h"
 
-class ShadowPass
+namespace Akari
 {
-public:
-    
-};
+    // Renders the casters of every shadow cascade of the first shadow casting directional light
+    // into one depth atlas, cascade i in tile (i % 2, i / 2).
+    class ShadowPass : public RenderPass
+    {
+    public:
+        // renderTarget holds only the depth atlas, AtlasSize x AtlasSize
+        ShadowPass(std::shared_ptr<RenderTarget> renderTarget);
+
+        void Record(const RenderContext& context) override;
+        void Execute() override;
+
+        // Null when no light casts shadows in the recorded frame
+        const CascadedShadows* GetShadows() const { return m_Active ? &m_Shadows : nullptr; }
+
+        // Maps a cascade's clip space to its tile in atlas texture coordinates
+        static glm::mat4 GetAtlasMatrix(uint32_t cascade);
+
+        static constexpr uint32_t CascadeResolution = 2048;
+        static constexpr uint32_t AtlasSize = CascadeResolution * 2;
+
+    private:
+        enum RootParams
+        {
+            // cbuffer ShadowViewCB : register(b0)
+            ShadowViewCB,
+            // StructuredBuffer<InstanceData> Instances : register(t0, space1)
+            Instances,
+            NumRootParams
+        };
+
+        CascadedShadows m_Shadows;
+        bool m_Active = false;
+
+        RenderExtraction m_Extraction;
+        LodSelector m_LodSelector;
+        DrawBatcher m_Batcher;
+        // Everything that may cast into some cascade, and the casters of the cascade being recorded
+        DrawPacketList m_Candidates;
+        BoundsSoA m_CandidateBounds;
+        DrawPacketList m_CascadePackets;
+    };
+}
@@ -0,0 +1,425 @@
+#include "pch.h"
+#include "AssetDatabase.h"
+
+#include <ppl.h>
+#include <unordered_set>
+
+#include "MappedFile.h"
+
+namespace Akari
+{
+    namespace
+    {
+        constexpr uint32_t DatabaseMagic = 'A' | ('K' << 8) | ('D' << 16) | ('B' << 24);
+
+        class DatabaseWriter
+        {
+        public:
+            template<typename T>
+            void Write(const T& value)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                const char* bytes = reinterpret_cast<const char*>(&value);
+                m_Data.insert(m_Data.end(), bytes, bytes + sizeof(T));
+            }
+
+            void Write(const std::string& string)
+            {
+                Write(static_cast<uint32_t>(string.size()));
+                m_Data.insert(m_Data.end(), string.begin(), string.end());
+            }
+
+            const std::vector<char>& GetData() const { return m_Data; }
+
+        private:
+            std::vector<char> m_Data;
+        };
+
+        // Every read fails once the data runs out
+        class DatabaseReader
+        {
+        public:
+            DatabaseReader(const char* data, uint64_t size) : m_Data(data), m_Size(size) {}
+
+            template<typename T>
+            bool Read(T& value)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                if (m_Size - m_Offset < sizeof(T))
+                    return false;
+
+                std::memcpy(&value, m_Data + m_Offset, sizeof(T));
+                m_Offset += sizeof(T);
+                return true;
+            }
+
+            bool Read(std::string& string)
+            {
+                uint32_t length = 0;
+                if (!Read(length) || m_Size - m_Offset < length)
+                    return false;
+
+                string.assign(m_Data + m_Offset, length);
+                m_Offset += length;
+                return true;
+            }
+
+        private:
+            const char* m_Data;
+            uint64_t m_Size;
+            uint64_t m_Offset = 0;
+        };
+
+        std::filesystem::path GetPath(const std::string& key)
+        {
+            return std::u8string(reinterpret_cast<const char8_t*>(key.data()), key.size());
+        }
+
+        uint64_t RotateLeft(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        uint64_t Read64(const uint8_t* data)
+        {
+            uint64_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        uint32_t Read32(const uint8_t* data)
+        {
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    }
+
+    void AssetDatabase::Init(const std::filesystem::path& databasePath)
+    {
+        std::scoped_lock lock(m_Mutex);
+
+        m_DatabasePath = databasePath;
+        if (!Load())
+        {
+            m_Files.clear();
+            m_Artifacts.clear();
+        }
+        m_Dirty = false;
+
+        spdlog::info("Asset database {0}: {1} artifacts, {2} files", m_DatabasePath.string(), m_Artifacts.size(), m_Files.size());
+    }
+
+    void AssetDatabase::Shutdown()
+    {
+        if (m_Dirty && !Save())
+            spdlog::warn("Failed to save the asset database {0}", m_DatabasePath.string());
+    }
+
+    bool AssetDatabase::Save()
+    {
+        std::scoped_lock lock(m_Mutex);
+        if (m_DatabasePath.empty())
+            return false;
+
+        // Only the files some artifact depends on are kept
+        std::unordered_set<std::string_view> dependencies;
+        for (const auto& [path, record] : m_Artifacts)
+        {
+            for (const auto& dependency : record.Dependencies)
+                dependencies.insert(dependency.Path);
+        }
+
+        const auto fileCount = static_cast<uint32_t>(std::ranges::count_if(m_Files, [&](const auto& file) { return dependencies.contains(file.first); }));
+
+        DatabaseWriter writer;
+        writer.Write(DatabaseMagic);
+        writer.Write(Version);
+        writer.Write(fileCount);
+        writer.Write(static_cast<uint32_t>(m_Artifacts.size()));
+
+        for (const auto& [path, state] : m_Files)
+        {
+            if (!dependencies.contains(path))
+                continue;
+
+            writer.Write(path);
+            writer.Write(state);
+        }
+
+        for (const auto& [path, record] : m_Artifacts)
+        {
+            writer.Write(path);
+            writer.Write(record.SettingsHash);
+            writer.Write(record.Artifact);
+            writer.Write(static_cast<uint32_t>(record.Dependencies.size()));
+            for (const auto& dependency : record.Dependencies)
+            {
+                writer.Write(dependency.Path);
+                writer.Write(dependency.Hash);
+            }
+        }
+
+        // Replace the database only once the new one is complete
+        std::error_code error;
+        std::filesystem::path tempPath = m_DatabasePath;
+        tempPath += L".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            file.write(writer.GetData().data(), static_cast<std::streamsize>(writer.GetData().size()));
+            if (!file.good())
+            {
+                file.close();
+                std::filesystem::remove(tempPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, m_DatabasePath, error);
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+        m_Dirty = false;
+        return true;
+    }
+
+    bool AssetDatabase::Load()
+    {
+        const MappedFile file(m_DatabasePath);
+        if (file.GetData() == nullptr)
+            return false;
+
+        DatabaseReader reader(file.GetData(), file.GetSize());
+
+        uint32_t magic = 0, version = 0, fileCount = 0, artifactCount = 0;
+        if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(fileCount) || !reader.Read(artifactCount))
+            return false;
+        if (magic != DatabaseMagic || version != Version)
+            return false;
+
+        for (uint32_t i = 0; i < fileCount; ++i)
+        {
+            std::string path;
+            FileState state;
+            if (!reader.Read(path) || !reader.Read(state))
+                return false;
+
+            m_Files[path] = state;
+        }
+
+        for (uint32_t i = 0; i < artifactCount; ++i)
+        {
+            std::string path;
+            ArtifactRecord record;
+            uint32_t dependencyCount = 0;
+            if (!reader.Read(path) || !reader.Read(record.SettingsHash) || !reader.Read(record.Artifact) || !reader.Read(dependencyCount))
+                return false;
+
+            for (uint32_t j = 0; j < dependencyCount; ++j)
+            {
+                Dependency dependency;
+                if (!reader.Read(dependency.Path) || !reader.Read(dependency.Hash))
+                    return false;
+
+                record.Dependencies.push_back(std::move(dependency));
+            }
+
+            m_Artifacts[path] = std::move(record);
+        }
+
+        return true;
+    }
+
+    bool AssetDatabase::IsUpToDate(const std::filesystem::path& artifact, uint64_t settingsHash)
+    {
+        ArtifactRecord record;
+        {
+            std::scoped_lock lock(m_Mutex);
+            const auto iter = m_Artifacts.find(GetKey(artifact));
+            if (iter == m_Artifacts.end())
+                return false;
+
+            record = iter->second;
+        }
+
+        // An artifact written by anyone else than the recorded cook is not trusted
+        FileState artifactState;
+        if (record.SettingsHash != settingsHash || !GetFileState(artifact, artifactState) ||
+            artifactState.Size != record.Artifact.Size || artifactState.WriteTime != record.Artifact.WriteTime)
+            return false;
+
+        return std::ranges::all_of(record.Dependencies, [this](const Dependency& dependency)
+        {
+            return GetContentHash(GetPath(dependency.Path)) == dependency.Hash;
+        });
+    }
+
+    void AssetDatabase::Record(const std::filesystem::path& artifact, uint64_t settingsHash, std::span<const std::filesystem::path> dependencies)
+    {
+        ArtifactRecord record;
+        record.SettingsHash = settingsHash;
+        if (!GetFileState(artifact, record.Artifact))
+            return;
+
+        // Materials share textures, every file is hashed and stored once
+        std::vector<std::string> keys;
+        keys.reserve(dependencies.size());
+        for (const auto& dependency : dependencies)
+            keys.push_back(GetKey(dependency));
+        std::ranges::sort(keys);
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        record.Dependencies.reserve(keys.size());
+        for (auto& key : keys)
+        {
+            const uint64_t hash = GetContentHash(GetPath(key));
+            record.Dependencies.push_back({ std::move(key), hash });
+        }
+
+        std::scoped_lock lock(m_Mutex);
+        m_Artifacts[GetKey(artifact)] = std::move(record);
+        m_Dirty = true;
+    }
+
+    uint64_t AssetDatabase::GetContentHash(const std::filesystem::path& file)
+    {
+        FileState state;
+        if (!GetFileState(file, state))
+            return 0;
+
+        const std::string key = GetKey(file);
+        {
+            std::scoped_lock lock(m_Mutex);
+            const auto iter = m_Files.find(key);
+            if (iter != m_Files.end() && iter->second.Size == state.Size && iter->second.WriteTime == state.WriteTime)
+                return iter->second.Hash;
+        }
+
+        // Hashed without holding the lock, other threads may check their own files meanwhile
+        state.Hash = HashFile(file);
+        if (state.Hash == 0)
+            return 0;
+
+        std::scoped_lock lock(m_Mutex);
+        m_Files[key] = state;
+        m_Dirty = true;
+        return state.Hash;
+    }
+
+    std::string AssetDatabase::GetKey(const std::filesystem::path& path)
+    {
+        std::error_code error;
+        const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+        const std::u8string key = (error ? path : absolute).lexically_normal().generic_u8string();
+        return { reinterpret_cast<const char*>(key.data()), key.size() };
+    }
+
+    bool AssetDatabase::GetFileState(const std::filesystem::path& path, FileState& state)
+    {
+        std::error_code error;
+        state.Size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+
+        state.WriteTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        return !error;
+    }
+
+    uint64_t AssetDatabase::HashFile(const std::filesystem::path& path)
+    {
+        const MappedFile file(path);
+        if (file.GetData() == nullptr)
+        {
+            // Empty files can't be mapped
+            std::error_code error;
+            return std::filesystem::file_size(path, error) == 0 && !error ? Hash(nullptr, 0) : 0;
+        }
+
+        // Chunks are hashed in parallel, large textures are read at the speed of the disk
+        const uint64_t size = file.GetSize();
+        std::vector<uint64_t> chunkHashes(static_cast<size_t>((size + HashChunkSize - 1) / HashChunkSize));
+        concurrency::parallel_for(size_t(0), chunkHashes.size(), [&](const size_t i)
+        {
+            const uint64_t offset = i * HashChunkSize;
+            chunkHashes[i] = Hash(file.GetData() + offset, static_cast<size_t>(std::min(HashChunkSize, size - offset)));
+        });
+
+        return Hash(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), size);
+    }
+
+    uint64_t AssetDatabase::Hash(const void* data, size_t size, uint64_t seed)
+    {
+        constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+        auto round = [](uint64_t accumulator, uint64_t input)
+        {
+            accumulator += input * Prime2;
+            return RotateLeft(accumulator, 31) * Prime1;
+        };
+        auto mergeRound = [&round](uint64_t accumulator, uint64_t value)
+        {
+            accumulator ^= round(0, value);
+            return accumulator * Prime1 + Prime4;
+        };
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        const uint8_t* end = bytes + size;
+
+        uint64_t hash;
+        if (size >= 32)
+        {
+            // Four independent lanes over 32 byte stripes
+            uint64_t v1 = seed + Prime1 + Prime2;
+            uint64_t v2 = seed + Prime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - Prime1;
+            for (; end - bytes >= 32; bytes += 32)
+            {
+                v1 = round(v1, Read64(bytes));
+                v2 = round(v2, Read64(bytes + 8));
+                v3 = round(v3, Read64(bytes + 16));
+                v4 = round(v4, Read64(bytes + 24));
+            }
+
+            hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+            hash = mergeRound(hash, v1);
+            hash = mergeRound(hash, v2);
+            hash = mergeRound(hash, v3);
+            hash = mergeRound(hash, v4);
+        }
+        else
+        {
+            hash = seed + Prime5;
+        }
+
+        hash += size;
+
+        for (; end - bytes >= 8; bytes += 8)
+            hash = RotateLeft(hash ^ round(0, Read64(bytes)), 27) * Prime1 + Prime4;
+        if (end - bytes >= 4)
+        {
+            hash = RotateLeft(hash ^ (Read32(bytes) * Prime1), 23) * Prime2 + Prime3;
+            bytes += 4;
+        }
+        for (; bytes < end; ++bytes)
+            hash = RotateLeft(hash ^ (*bytes * Prime5), 11) * Prime1;
+
+        // Avalanche
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
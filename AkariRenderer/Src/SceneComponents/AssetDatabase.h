@@ -0,0 +1,86 @@
+#pragma once
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+namespace Akari
+{
+    // Records what every cooked artifact was built from: the content hash of each file it depends on and a hash of the
+    // importer settings. An artifact is reused exactly as long as neither changed, so caches stay valid across builds
+    // and only the artifacts of changed sources are cooked again. Content hashes are cached per file with the size and
+    // write time it had when hashed, a file is only read again after either changes.
+    class AssetDatabase
+    {
+    public:
+        static AssetDatabase& GetInstance()
+        {
+            static AssetDatabase instance;
+            return instance;
+        }
+
+        ~AssetDatabase() = default;
+        AssetDatabase(AssetDatabase const&) = delete;
+        AssetDatabase(AssetDatabase const&&) = delete;
+        void operator=(AssetDatabase const&) = delete;
+        void operator=(AssetDatabase const&&) = delete;
+
+        // Loads the records of earlier runs from databasePath, starts empty when there are none
+        void Init(const std::filesystem::path& databasePath);
+        // Saves the records for the next run
+        void Shutdown();
+        bool Save();
+
+        // True when the artifact is unchanged since it was recorded with the same settings hash
+        // and the content of all its dependencies is unchanged as well
+        bool IsUpToDate(const std::filesystem::path& artifact, uint64_t settingsHash);
+        // Records an artifact that was just cooked from the dependencies, replacing an earlier record
+        void Record(const std::filesystem::path& artifact, uint64_t settingsHash, std::span<const std::filesystem::path> dependencies);
+
+        // Content hash of a file, 0 when it can't be read
+        uint64_t GetContentHash(const std::filesystem::path& file);
+
+        // Absolute, normalized UTF-8 path that identifies a file in the records
+        static std::string GetKey(const std::filesystem::path& path);
+        // XXH64 of the bytes
+        static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+        static constexpr uint32_t Version = 1;
+        // Files are hashed in chunks of this size, the content hash is the hash of the chunk hashes
+        static constexpr uint64_t HashChunkSize = 1 << 20;
+
+    private:
+        AssetDatabase() = default;
+
+        struct FileState
+        {
+            uint64_t Size = 0;
+            int64_t WriteTime = 0;
+            uint64_t Hash = 0;
+        };
+
+        struct Dependency
+        {
+            std::string Path;
+            uint64_t Hash = 0;
+        };
+
+        struct ArtifactRecord
+        {
+            uint64_t SettingsHash = 0;
+            // Size and write time of the artifact when it was recorded, Hash is unused
+            FileState Artifact;
+            std::vector<Dependency> Dependencies;
+        };
+
+        static bool GetFileState(const std::filesystem::path& path, FileState& state);
+        static uint64_t HashFile(const std::filesystem::path& path);
+
+        bool Load();
+
+        std::filesystem::path m_DatabasePath;
+        std::unordered_map<std::string, FileState> m_Files;
+        std::unordered_map<std::string, ArtifactRecord> m_Artifacts;
+        bool m_Dirty = false;
+        mutable std::mutex m_Mutex;
+    };
+}
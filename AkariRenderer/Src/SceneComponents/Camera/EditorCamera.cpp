@@ -19,7 +19,8 @@ namespace Akari
               glm::perspectiveFov(glm::radians(degFov), width, height, farP, nearP),
               glm::perspectiveFov(glm::radians(degFov), width, height, nearP, farP)),
           m_FocalPoint({0, 1, -1}),
-          m_VerticalFOV(glm::radians(degFov)), m_NearClip(nearP), m_FarClip(farP)
+          m_VerticalFOV(glm::radians(degFov)), m_AspectRatio(width / height), m_NearClip(nearP), m_FarClip(farP),
+          m_ViewportWidth(static_cast<uint32_t>(width)), m_ViewportHeight(static_cast<uint32_t>(height))
     {
         Init();
     }
@@ -272,4 +273,16 @@ namespace Akari
     {
         return glm::quat(glm::vec3(-m_Pitch - m_PitchDelta, m_Yaw + m_YawDelta, 0.0f));
     }
+
+    void EditorCamera::ScreenPointToRay(const glm::vec2& viewportPoint, glm::vec3& origin, glm::vec3& direction) const
+    {
+        // Unproject onto the near and far plane, the unreversed projection keeps near at depth 0
+        const glm::mat4 inverseViewProjection = glm::inverse(GetUnReversedViewProjection());
+        const glm::vec2 ndc(viewportPoint.x * 2.0f - 1.0f, 1.0f - viewportPoint.y * 2.0f);
+        const glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+        const glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+
+        origin = glm::vec3(nearPoint) / nearPoint.w;
+        direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    }
 }
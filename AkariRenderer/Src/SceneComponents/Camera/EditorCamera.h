@@ -42,6 +42,7 @@ namespace Akari
             SetPerspectiveProjectionMatrix(m_VerticalFOV, (float)width, (float)height, m_NearClip, m_FarClip);
             m_ViewportWidth = width;
             m_ViewportHeight = height;
+            m_AspectRatio = (float)width / (float)height;
         }
 
         const glm::mat4& GetViewMatrix() const { return m_ViewMatrix; }
@@ -56,10 +57,14 @@ namespace Akari
 
         glm::quat GetOrientation() const;
 
+        // World space ray through a viewport point, (0, 0) is the top left and (1, 1) the bottom right corner
+        void ScreenPointToRay(const glm::vec2& viewportPoint, glm::vec3& origin, glm::vec3& direction) const;
+
         [[nodiscard]] float GetVerticalFOV() const { return m_VerticalFOV; }
         [[nodiscard]] float GetAspectRatio() const { return m_AspectRatio; }
         [[nodiscard]] float GetNearClip() const { return m_NearClip; }
         [[nodiscard]] float GetFarClip() const { return m_FarClip; }
+        [[nodiscard]] uint32_t GetViewportHeight() const { return m_ViewportHeight; }
         [[nodiscard]] float GetPitch() const { return m_Pitch; }
         [[nodiscard]] float GetYaw() const { return m_Yaw; }
         [[nodiscard]] float GetCameraSpeed() const;
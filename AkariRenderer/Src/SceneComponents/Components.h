@@ -1,4 +1,5 @@
 #pragma once
+#include <entt/entt.hpp>
 #include "Math/Math.h"
 
 #include "UUID.h"
@@ -18,6 +19,7 @@ namespace Akari
         UUID ID = 0;
     };
 
+    // Rename through SceneObject::SetName, the scene's name index only sees changes made with registry.patch
     struct NameComponent
     {
         std::string Name;
@@ -30,14 +32,13 @@ namespace Akari
         {
         }
 
-        operator std::string&() { return Name; }
         operator const std::string&() const { return Name; }
     };
 
+    // Persistent parent link, the runtime hierarchy lives in HierarchyComponent
     struct RelationshipComponent
     {
         UUID ParentHandle = 0;
-        std::vector<UUID> Children{};
 
         RelationshipComponent() = default;
         RelationshipComponent(const RelationshipComponent& other) = default;
@@ -48,13 +49,33 @@ namespace Akari
         }
     };
 
+    // Intrusive runtime hierarchy, children of a parent form a doubly linked sibling list in child order.
+    // Only Scene edits the links so they always mirror RelationshipComponent::ParentHandle.
+    struct HierarchyComponent
+    {
+        entt::entity Parent = entt::null;
+        entt::entity FirstChild = entt::null;
+        entt::entity LastChild = entt::null;
+        entt::entity PrevSibling = entt::null;
+        entt::entity NextSibling = entt::null;
+        uint32_t ChildCount = 0;
+        // Number of ancestors, kept up to date on reparenting
+        uint32_t Depth = 0;
+        // Position in the depth-first flattened hierarchy, rebuilt by Scene::SortSceneObjects
+        uint32_t FlattenedIndex = 0;
+        // Increases with every scene object the scene creates, unlike entity ids it is never reused
+        uint64_t CreationIndex = 0;
+    };
+
     struct alignas(16) TransformComponent
     {
         glm::vec3 Translation = { 0.0f, 0.0f, 0.0f };
         glm::vec3 Rotation = { 0.0f, 0.0f, 0.0f };
         glm::vec3 Scale = { 1.0f, 1.0f, 1.0f };
         // ----36byte
-        char padding[12] = {0};
+        // Set whenever the local transform changes, cleared by Scene::UpdateWorldTransforms
+        bool Dirty = true;
+        char padding[11] = {0};
         // ----48byte
 
         TransformComponent() = default;
@@ -62,6 +83,11 @@ namespace Akari
         TransformComponent(const glm::vec3& translation)
             : Translation(translation) {}
 
+        void SetTranslation(const glm::vec3& translation) { Translation = translation; Dirty = true; }
+        void SetRotation(const glm::vec3& rotation) { Rotation = rotation; Dirty = true; }
+        void SetScale(const glm::vec3& scale) { Scale = scale; Dirty = true; }
+        void MarkDirty() { Dirty = true; }
+
         [[nodiscard]] glm::mat4 GetTransform() const
         {
             return glm::translate(glm::mat4(1.0f), Translation)
@@ -72,6 +98,7 @@ namespace Akari
         void SetTransform(const glm::mat4& transform)
         {
             Math::DecomposeTransform(transform, Translation, Rotation, Scale);
+            Dirty = true;
         }
     };
 
@@ -109,4 +136,11 @@ namespace Akari
     {
         UUID ModelID;
     };
+
+    // Overrides the automatic occluder selection of the software occlusion culling,
+    // without it large meshes on screen are picked as occluders
+    struct OccluderComponent
+    {
+        bool Enabled = true;
+    };
 }
@@ -0,0 +1,544 @@
+#include "pch.h"
+#include "Gltf.h"
+
+#include "Json.h"
+#include "MappedFile.h"
+
+#include <charconv>
+
+namespace Akari::Gltf
+{
+    namespace
+    {
+        // "glTF", "JSON" and "BIN\0" little endian
+        constexpr uint32_t GlbMagic = 0x46546c67;
+        constexpr uint32_t GlbChunkJson = 0x4e4f534a;
+        constexpr uint32_t GlbChunkBin = 0x004e4942;
+
+        struct GlbHeader
+        {
+            uint32_t Magic;
+            uint32_t Version;
+            uint32_t Length;
+        };
+
+        struct GlbChunkHeader
+        {
+            uint32_t Length;
+            uint32_t Type;
+        };
+
+        uint32_t GetComponentSize(ComponentType component)
+        {
+            switch (component)
+            {
+            case ComponentType::Byte:
+            case ComponentType::UnsignedByte:
+                return 1;
+            case ComponentType::Short:
+            case ComponentType::UnsignedShort:
+                return 2;
+            case ComponentType::UnsignedInt:
+            case ComponentType::Float:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+
+        uint32_t GetComponentCount(std::string_view type)
+        {
+            if (type == "SCALAR") return 1;
+            if (type == "VEC2") return 2;
+            if (type == "VEC3") return 3;
+            if (type == "VEC4") return 4;
+            if (type == "MAT2") return 4;
+            if (type == "MAT3") return 9;
+            if (type == "MAT4") return 16;
+            return 0;
+        }
+
+        // URIs are percent-encoded UTF-8
+        std::filesystem::path DecodeUri(std::string_view uri)
+        {
+            std::string decoded;
+            decoded.reserve(uri.size());
+            for (size_t i = 0; i < uri.size(); ++i)
+            {
+                unsigned int value;
+                if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16).ptr == uri.data() + i + 3)
+                {
+                    decoded += static_cast<char>(value);
+                    i += 2;
+                }
+                else
+                {
+                    decoded += uri[i];
+                }
+            }
+
+            return std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(decoded.data()), decoded.size()));
+        }
+
+        // Image index of a textureInfo, -1 when there is none
+        int32_t GetImage(const JsonValue& json, const JsonValue& textureInfo)
+        {
+            const int64_t texture = textureInfo["index"].GetInt();
+            if (texture < 0)
+                return -1;
+
+            const int64_t image = json["textures"][static_cast<size_t>(texture)]["source"].GetInt();
+            return image >= 0 && image < static_cast<int64_t>(json["images"].GetSize()) ? static_cast<int32_t>(image) : -1;
+        }
+
+        template <typename T>
+        float Normalize(T value)
+        {
+            if constexpr (std::is_signed_v<T>)
+                return std::max(static_cast<float>(value) / std::numeric_limits<T>::max(), -1.0f);
+            else
+                return static_cast<float>(value) / std::numeric_limits<T>::max();
+        }
+    }
+
+    void Accessor::ReadFloats(std::span<float> output, uint32_t count) const
+    {
+        assert(output.size() >= static_cast<size_t>(Count) * count);
+
+        const uint32_t components = std::min(count, Components);
+        if (!Data)
+        {
+            for (uint32_t i = 0; i < Count; ++i)
+                std::fill_n(output.data() + static_cast<size_t>(i) * count, components, 0.0f);
+            return;
+        }
+
+        if (Component == ComponentType::Float && Components == count && Stride == count * sizeof(float))
+        {
+            std::memcpy(output.data(), Data, static_cast<size_t>(Count) * count * sizeof(float));
+            return;
+        }
+
+        auto read = [&]<typename T>(T)
+        {
+            for (uint32_t i = 0; i < Count; ++i)
+            {
+                T element[16];
+                std::memcpy(element, Data + static_cast<size_t>(i) * Stride, components * sizeof(T));
+
+                float* out = output.data() + static_cast<size_t>(i) * count;
+                for (uint32_t c = 0; c < components; ++c)
+                {
+                    if constexpr (std::is_same_v<T, float>)
+                        out[c] = element[c];
+                    else
+                        out[c] = Normalized ? Normalize(element[c]) : static_cast<float>(element[c]);
+                }
+            }
+        };
+
+        switch (Component)
+        {
+        case ComponentType::Byte: read(int8_t()); break;
+        case ComponentType::UnsignedByte: read(uint8_t()); break;
+        case ComponentType::Short: read(int16_t()); break;
+        case ComponentType::UnsignedShort: read(uint16_t()); break;
+        case ComponentType::UnsignedInt: read(uint32_t()); break;
+        case ComponentType::Float: read(float()); break;
+        }
+    }
+
+    void Accessor::ReadIndices(std::span<uint32_t> output) const
+    {
+        assert(output.size() >= Count && Data);
+
+        if (Component == ComponentType::UnsignedInt && Stride == sizeof(uint32_t))
+        {
+            std::memcpy(output.data(), Data, static_cast<size_t>(Count) * sizeof(uint32_t));
+            return;
+        }
+
+        auto read = [&]<typename T>(T)
+        {
+            for (uint32_t i = 0; i < Count; ++i)
+            {
+                T index;
+                std::memcpy(&index, Data + static_cast<size_t>(i) * Stride, sizeof(T));
+                output[i] = index;
+            }
+        };
+
+        switch (Component)
+        {
+        case ComponentType::UnsignedByte: read(uint8_t()); break;
+        case ComponentType::UnsignedShort: read(uint16_t()); break;
+        case ComponentType::UnsignedInt: read(uint32_t()); break;
+        default: assert(false); break;
+        }
+    }
+
+    Asset::Asset() = default;
+
+    Asset::~Asset() = default;
+
+    bool Asset::Open(const std::filesystem::path& path)
+    {
+        m_Directory = path.parent_path();
+
+        const MappedFile& file = MapFile(path);
+        const auto* data = reinterpret_cast<const std::byte*>(file.GetData());
+        const uint64_t size = file.GetSize();
+        if (!data)
+        {
+            spdlog::error("glTF {0}: can't read the file", path.string());
+            return false;
+        }
+
+        // A .glb file is the JSON chunk followed by an optional binary chunk, a .gltf file is only the JSON
+        std::string_view text(reinterpret_cast<const char*>(data), size);
+        std::span<const std::byte> binaryChunk;
+
+        GlbHeader header{};
+        if (size >= sizeof(GlbHeader))
+            std::memcpy(&header, data, sizeof(GlbHeader));
+
+        if (header.Magic == GlbMagic)
+        {
+            GlbChunkHeader json{};
+            if (header.Version != 2 || header.Length > size || header.Length < sizeof(GlbHeader) + sizeof(GlbChunkHeader))
+            {
+                spdlog::error("glTF {0}: invalid GLB header", path.string());
+                return false;
+            }
+
+            std::memcpy(&json, data + sizeof(GlbHeader), sizeof(GlbChunkHeader));
+            uint64_t offset = sizeof(GlbHeader) + sizeof(GlbChunkHeader);
+            if (json.Type != GlbChunkJson || json.Length > header.Length - offset)
+            {
+                spdlog::error("glTF {0}: invalid JSON chunk", path.string());
+                return false;
+            }
+
+            text = std::string_view(reinterpret_cast<const char*>(data + offset), json.Length);
+            offset += json.Length;
+
+            GlbChunkHeader bin{};
+            if (header.Length - offset >= sizeof(GlbChunkHeader))
+            {
+                std::memcpy(&bin, data + offset, sizeof(GlbChunkHeader));
+                offset += sizeof(GlbChunkHeader);
+                if (bin.Type == GlbChunkBin && bin.Length <= header.Length - offset)
+                    binaryChunk = { data + offset, bin.Length };
+            }
+        }
+
+        JsonValue json;
+        std::string error;
+        if (!JsonValue::Parse(text, json, error))
+        {
+            spdlog::error("glTF {0}: {1}", path.string(), error);
+            return false;
+        }
+
+        if (!Load(json, binaryChunk))
+        {
+            spdlog::error("glTF {0}: {1}", path.string(), "invalid or unsupported asset");
+            return false;
+        }
+
+        return true;
+    }
+
+    const MappedFile& Asset::MapFile(const std::filesystem::path& path)
+    {
+        m_FilePaths.push_back(path);
+        return *m_Files.emplace_back(std::make_unique<MappedFile>(path));
+    }
+
+    bool Asset::Load(const JsonValue& json, std::span<const std::byte> binaryChunk)
+    {
+        if (!json["asset"]["version"].GetString().starts_with("2."))
+            return false;
+
+        // None is supported. KHR_mesh_quantization for one relies on the node transforms to dequantize positions,
+        // which culling, picking and the model bounds don't apply.
+        if (const JsonValue& required = json["extensionsRequired"]; required.GetSize() > 0)
+        {
+            spdlog::error("glTF: required extension {0} is not supported", required[0].GetString());
+            return false;
+        }
+
+        // Buffers, the first one without a URI is the binary chunk of a .glb file
+        std::vector<std::span<const std::byte>> buffers;
+        for (const auto& buffer : json["buffers"].GetElements())
+        {
+            const uint64_t length = buffer["byteLength"].GetInt(0);
+            const std::string_view uri = buffer["uri"].GetString();
+
+            std::span<const std::byte> data;
+            if (uri.empty())
+            {
+                data = binaryChunk;
+            }
+            else if (uri.starts_with("data:"))
+            {
+                spdlog::error("glTF: buffers in data URIs are not supported");
+                return false;
+            }
+            else
+            {
+                const MappedFile& file = MapFile(m_Directory / DecodeUri(uri));
+                data = { reinterpret_cast<const std::byte*>(file.GetData()), static_cast<size_t>(file.GetSize()) };
+            }
+
+            if (data.size() < length)
+            {
+                spdlog::error("glTF: buffer {0} is missing or too short", uri);
+                return false;
+            }
+
+            buffers.push_back(data.first(static_cast<size_t>(length)));
+        }
+
+        struct BufferView
+        {
+            std::span<const std::byte> Data;
+            uint32_t Stride;
+        };
+
+        std::vector<BufferView> bufferViews;
+        for (const auto& view : json["bufferViews"].GetElements())
+        {
+            const int64_t buffer = view["buffer"].GetInt();
+            const int64_t offset = view["byteOffset"].GetInt(0);
+            const int64_t length = view["byteLength"].GetInt(0);
+            if (buffer < 0 || buffer >= static_cast<int64_t>(buffers.size()) || offset < 0 || length < 0 ||
+                static_cast<uint64_t>(offset) + length > buffers[buffer].size())
+                return false;
+
+            bufferViews.push_back({ buffers[buffer].subspan(static_cast<size_t>(offset), static_cast<size_t>(length)),
+                                    static_cast<uint32_t>(view["byteStride"].GetInt(0)) });
+        }
+
+        for (const auto& accessorJson : json["accessors"].GetElements())
+        {
+            if (accessorJson.Contains("sparse"))
+            {
+                spdlog::error("glTF: sparse accessors are not supported");
+                return false;
+            }
+
+            Accessor& accessor = m_Accessors.emplace_back();
+            accessor.Component = static_cast<ComponentType>(accessorJson["componentType"].GetInt(0));
+            accessor.Components = GetComponentCount(accessorJson["type"].GetString());
+            accessor.Normalized = accessorJson["normalized"].GetBool();
+
+            const int64_t count = accessorJson["count"].GetInt(0);
+            const uint32_t elementSize = GetComponentSize(accessor.Component) * accessor.Components;
+            if (elementSize == 0 || count < 0 || count > std::numeric_limits<uint32_t>::max())
+                return false;
+            accessor.Count = static_cast<uint32_t>(count);
+
+            const int64_t view = accessorJson["bufferView"].GetInt();
+            if (view < 0)
+                continue;
+            if (view >= static_cast<int64_t>(bufferViews.size()))
+                return false;
+
+            const BufferView& bufferView = bufferViews[view];
+            const int64_t offset = accessorJson["byteOffset"].GetInt(0);
+            accessor.Stride = bufferView.Stride > 0 ? bufferView.Stride : elementSize;
+            if (offset < 0 || static_cast<uint64_t>(offset) > bufferView.Data.size() ||
+                (accessor.Count > 0 && static_cast<uint64_t>(offset) + static_cast<uint64_t>(accessor.Stride) * (accessor.Count - 1) + elementSize > bufferView.Data.size()))
+                return false;
+
+            accessor.Data = bufferView.Data.data() + offset;
+        }
+
+        auto isAccessor = [this](int64_t index) { return index >= -1 && index < static_cast<int64_t>(m_Accessors.size()); };
+
+        const int64_t materialCount = static_cast<int64_t>(json["materials"].GetSize());
+        for (const auto& meshJson : json["meshes"].GetElements())
+        {
+            Mesh& mesh = m_Meshes.emplace_back();
+            mesh.Name = meshJson["name"].GetString();
+
+            for (const auto& primitiveJson : meshJson["primitives"].GetElements())
+            {
+                const JsonValue& attributes = primitiveJson["attributes"];
+
+                Primitive primitive;
+                primitive.Position = static_cast<int32_t>(attributes["POSITION"].GetInt());
+                primitive.Normal = static_cast<int32_t>(attributes["NORMAL"].GetInt());
+                primitive.Tangent = static_cast<int32_t>(attributes["TANGENT"].GetInt());
+                primitive.TexCoord = static_cast<int32_t>(attributes["TEXCOORD_0"].GetInt());
+                primitive.Indices = static_cast<int32_t>(primitiveJson["indices"].GetInt());
+                primitive.Material = static_cast<int32_t>(primitiveJson["material"].GetInt());
+                primitive.Mode = static_cast<uint32_t>(primitiveJson["mode"].GetInt(4));
+
+                if (!isAccessor(primitive.Position) || !isAccessor(primitive.Normal) || !isAccessor(primitive.Tangent) ||
+                    !isAccessor(primitive.TexCoord) || !isAccessor(primitive.Indices) || primitive.Material >= materialCount)
+                    return false;
+
+                // Indices are unsigned integer scalars and always stored in a buffer view
+                if (primitive.Indices >= 0)
+                {
+                    const Accessor& indices = m_Accessors[primitive.Indices];
+                    if (!indices.Data || indices.Components != 1 || (indices.Component != ComponentType::UnsignedByte &&
+                        indices.Component != ComponentType::UnsignedShort && indices.Component != ComponentType::UnsignedInt))
+                    {
+                        spdlog::error("glTF: index accessor {0} is not unsigned integers in a buffer view", primitive.Indices);
+                        return false;
+                    }
+                }
+
+                mesh.Primitives.push_back(primitive);
+            }
+        }
+
+        for (const auto& materialJson : json["materials"].GetElements())
+        {
+            const JsonValue& pbr = materialJson["pbrMetallicRoughness"];
+
+            Material& material = m_Materials.emplace_back();
+            const JsonValue& baseColor = pbr["baseColorFactor"];
+            if (baseColor.GetSize() == 4)
+                material.BaseColorFactor = { baseColor[0].GetFloat(), baseColor[1].GetFloat(), baseColor[2].GetFloat(), baseColor[3].GetFloat() };
+            const JsonValue& emissive = materialJson["emissiveFactor"];
+            if (emissive.GetSize() == 3)
+                material.EmissiveFactor = { emissive[0].GetFloat(), emissive[1].GetFloat(), emissive[2].GetFloat() };
+
+            material.MetallicFactor = pbr["metallicFactor"].GetFloat(1.0f);
+            material.RoughnessFactor = pbr["roughnessFactor"].GetFloat(1.0f);
+            material.NormalScale = materialJson["normalTexture"]["scale"].GetFloat(1.0f);
+
+            const std::string_view alphaMode = materialJson["alphaMode"].GetString("OPAQUE");
+            material.Alpha = alphaMode == "BLEND" ? AlphaMode::Blend : alphaMode == "MASK" ? AlphaMode::Mask : AlphaMode::Opaque;
+
+            material.BaseColorTexture = GetImage(json, pbr["baseColorTexture"]);
+            material.MetallicRoughnessTexture = GetImage(json, pbr["metallicRoughnessTexture"]);
+            material.NormalTexture = GetImage(json, materialJson["normalTexture"]);
+            material.OcclusionTexture = GetImage(json, materialJson["occlusionTexture"]);
+            material.EmissiveTexture = GetImage(json, materialJson["emissiveTexture"]);
+        }
+
+        for (const auto& imageJson : json["images"].GetElements())
+        {
+            Image& image = m_Images.emplace_back();
+
+            const std::string_view uri = imageJson["uri"].GetString();
+            if (uri.starts_with("data:"))
+            {
+                spdlog::warn("glTF: images in data URIs are not supported");
+            }
+            else if (!uri.empty())
+            {
+                image.Path = DecodeUri(uri);
+            }
+            else
+            {
+                const int64_t view = imageJson["bufferView"].GetInt();
+                if (view < 0 || view >= static_cast<int64_t>(bufferViews.size()))
+                    return false;
+
+                image.Data = bufferViews[view].Data;
+            }
+        }
+
+        // Every node has at most one parent, cycles are rejected once all nodes are read
+        std::vector<uint32_t> parentCount(json["nodes"].GetSize());
+        for (const auto& nodeJson : json["nodes"].GetElements())
+        {
+            Node& node = m_Nodes.emplace_back();
+            node.Name = nodeJson["name"].GetString();
+            node.Mesh = static_cast<int32_t>(nodeJson["mesh"].GetInt());
+            if (node.Mesh >= static_cast<int64_t>(m_Meshes.size()))
+                return false;
+
+            for (const auto& child : nodeJson["children"].GetElements())
+            {
+                const int64_t index = child.GetInt();
+                if (index < 0 || index >= static_cast<int64_t>(parentCount.size()) || ++parentCount[index] > 1)
+                    return false;
+
+                node.Children.push_back(static_cast<uint32_t>(index));
+            }
+
+            // Column-major with column vectors, read in order it gives the row vector matrix
+            const JsonValue& matrix = nodeJson["matrix"];
+            if (matrix.GetSize() == 16)
+            {
+                float values[16];
+                for (size_t i = 0; i < 16; ++i)
+                    values[i] = matrix[i].GetFloat();
+                node.LocalTransform = DirectX::XMFLOAT4X4(values);
+                continue;
+            }
+
+            const JsonValue& t = nodeJson["translation"];
+            const JsonValue& r = nodeJson["rotation"];
+            const JsonValue& s = nodeJson["scale"];
+            const DirectX::XMMATRIX scale = s.GetSize() == 3 ? DirectX::XMMatrixScaling(s[0].GetFloat(), s[1].GetFloat(), s[2].GetFloat())
+                                                             : DirectX::XMMatrixIdentity();
+            const DirectX::XMMATRIX rotation = r.GetSize() == 4 ? DirectX::XMMatrixRotationQuaternion(DirectX::XMQuaternionNormalize(
+                                                                      DirectX::XMVectorSet(r[0].GetFloat(), r[1].GetFloat(), r[2].GetFloat(), r[3].GetFloat())))
+                                                                : DirectX::XMMatrixIdentity();
+            const DirectX::XMMATRIX translation = t.GetSize() == 3 ? DirectX::XMMatrixTranslation(t[0].GetFloat(), t[1].GetFloat(), t[2].GetFloat())
+                                                                   : DirectX::XMMatrixIdentity();
+            DirectX::XMStoreFloat4x4(&node.LocalTransform, scale * rotation * translation);
+        }
+
+        // The default scene, or every node without a parent when there are no scenes
+        const JsonValue& scenes = json["scenes"];
+        if (scenes.GetSize() > 0)
+        {
+            const int64_t scene = json["scene"].GetInt(0);
+            if (scene < 0 || scene >= static_cast<int64_t>(scenes.GetSize()))
+            {
+                spdlog::error("glTF: scene {0} doesn't exist", scene);
+                return false;
+            }
+
+            for (const auto& node : scenes[static_cast<size_t>(scene)]["nodes"].GetElements())
+            {
+                const int64_t index = node.GetInt();
+                if (index < 0 || index >= static_cast<int64_t>(m_Nodes.size()) || parentCount[index] != 0)
+                    return false;
+
+                m_RootNodes.push_back(static_cast<uint32_t>(index));
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < m_Nodes.size(); ++i)
+            {
+                if (parentCount[i] == 0)
+                    m_RootNodes.push_back(i);
+            }
+        }
+
+        // A node that can't be reached from a node without a parent is part of a cycle or hangs below one,
+        // the importer recurses down the hierarchy and would never return
+        std::vector<uint32_t> stack;
+        size_t reachedCount = 0;
+        for (uint32_t i = 0; i < m_Nodes.size(); ++i)
+        {
+            if (parentCount[i] == 0)
+                stack.push_back(i);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            ++reachedCount;
+            stack.insert(stack.end(), m_Nodes[index].Children.begin(), m_Nodes[index].Children.end());
+        }
+        if (reachedCount != m_Nodes.size())
+            return false;
+
+        // A scene listing a node twice would import it twice
+        std::vector<uint32_t> sortedRoots = m_RootNodes;
+        std::ranges::sort(sortedRoots);
+        return std::ranges::adjacent_find(sortedRoots) == sortedRoots.end();
+    }
+}
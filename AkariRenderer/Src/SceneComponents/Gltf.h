@@ -0,0 +1,149 @@
+#pragma once
+#include <span>
+#include <string_view>
+#include <DirectXMath.h>
+
+namespace Akari
+{
+    class JsonValue;
+    class MappedFile;
+}
+
+// glTF 2.0 assets, .gltf with external or embedded .bin buffers and binary .glb files.
+// The files are memory mapped and accessors point into the mapping, so vertex and index data is read in place
+// and only converted where its layout differs from what the reader asks for. Images are referenced the same way,
+// either as files next to the asset or as byte ranges of a buffer.
+namespace Akari::Gltf
+{
+    enum class ComponentType : uint32_t
+    {
+        Byte = 5120,
+        UnsignedByte = 5121,
+        Short = 5122,
+        UnsignedShort = 5123,
+        UnsignedInt = 5125,
+        Float = 5126
+    };
+
+    struct Accessor
+    {
+        // Null for accessors without a buffer view, which are all zeros
+        const std::byte* Data = nullptr;
+        uint32_t Count = 0;
+        // Bytes between elements
+        uint32_t Stride = 0;
+        ComponentType Component = ComponentType::Float;
+        // 1 for SCALAR up to 16 for MAT4
+        uint32_t Components = 1;
+        bool Normalized = false;
+
+        // Reads up to count components of every element as floats, normalized integers are mapped to [0, 1] or [-1, 1].
+        // Components the accessor doesn't have are left unchanged, so the output carries the defaults.
+        // A tightly packed FLOAT accessor with exactly count components is copied at once.
+        void ReadFloats(std::span<float> output, uint32_t count) const;
+        // Reads an index accessor, which Load checked to be unsigned integers in a buffer view.
+        // A tightly packed UNSIGNED_INT accessor is copied at once.
+        void ReadIndices(std::span<uint32_t> output) const;
+    };
+
+    struct Primitive
+    {
+        // Accessor indices, -1 when missing
+        int32_t Position = -1;
+        int32_t Normal = -1;
+        int32_t Tangent = -1;
+        int32_t TexCoord = -1;
+        int32_t Indices = -1;
+        int32_t Material = -1;
+        // 4 for triangle lists
+        uint32_t Mode = 4;
+    };
+
+    struct Mesh
+    {
+        std::string Name;
+        std::vector<Primitive> Primitives;
+    };
+
+    enum class AlphaMode
+    {
+        Opaque,
+        Mask,
+        Blend
+    };
+
+    struct Material
+    {
+        glm::vec4 BaseColorFactor = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glm::vec3 EmissiveFactor = { 0.0f, 0.0f, 0.0f };
+        float MetallicFactor = 1.0f;
+        float RoughnessFactor = 1.0f;
+        float NormalScale = 1.0f;
+        AlphaMode Alpha = AlphaMode::Opaque;
+
+        // Image indices, -1 when the material doesn't have the texture
+        int32_t BaseColorTexture = -1;
+        // Roughness in green, metallic in blue
+        int32_t MetallicRoughnessTexture = -1;
+        int32_t NormalTexture = -1;
+        // Occlusion in red
+        int32_t OcclusionTexture = -1;
+        int32_t EmissiveTexture = -1;
+    };
+
+    struct Image
+    {
+        // A file relative to the directory of the asset, empty for images stored in a buffer
+        std::filesystem::path Path;
+        std::span<const std::byte> Data;
+    };
+
+    struct Node
+    {
+        std::string Name;
+        // Row vectors in the asset's right-handed space, like DirectXMath
+        DirectX::XMFLOAT4X4 LocalTransform;
+        int32_t Mesh = -1;
+        std::vector<uint32_t> Children;
+    };
+
+    class Asset
+    {
+    public:
+        Asset();
+        ~Asset();
+
+        Asset(const Asset&) = delete;
+        Asset& operator=(const Asset&) = delete;
+
+        // Maps the asset and the buffers it references and validates every byte range, logs why it fails.
+        // Sparse accessors, data URIs and extensions that are required are not supported.
+        bool Open(const std::filesystem::path& path);
+
+        const std::vector<Accessor>& GetAccessors() const { return m_Accessors; }
+        const std::vector<Mesh>& GetMeshes() const { return m_Meshes; }
+        const std::vector<Material>& GetMaterials() const { return m_Materials; }
+        const std::vector<Image>& GetImages() const { return m_Images; }
+        const std::vector<Node>& GetNodes() const { return m_Nodes; }
+        // The root nodes of the default scene
+        const std::vector<uint32_t>& GetRootNodes() const { return m_RootNodes; }
+        // The asset and the buffer files it references, image files are not included
+        const std::vector<std::filesystem::path>& GetFilePaths() const { return m_FilePaths; }
+
+    private:
+        bool Load(const JsonValue& json, std::span<const std::byte> binaryChunk);
+
+        const MappedFile& MapFile(const std::filesystem::path& path);
+
+        std::filesystem::path m_Directory;
+        std::vector<std::unique_ptr<MappedFile>> m_Files;
+        std::vector<std::filesystem::path> m_FilePaths;
+
+        std::vector<Accessor> m_Accessors;
+        std::vector<Mesh> m_Meshes;
+        std::vector<Material> m_Materials;
+        std::vector<Image> m_Images;
+        std::vector<Node> m_Nodes;
+        std::vector<uint32_t> m_RootNodes;
+    };
+}
@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "Json.h"
+
+#include <charconv>
+
+namespace Akari
+{
+    // Recursive descent over the text, values are built in place
+    class JsonParser
+    {
+    public:
+        explicit JsonParser(std::string_view text)
+            : m_Text(text) {}
+
+        bool Parse(JsonValue& value, std::string& error)
+        {
+            if (!ParseValue(value, 0))
+            {
+                error = m_Error + " at offset " + std::to_string(m_Pos);
+                return false;
+            }
+
+            SkipWhitespace();
+            if (m_Pos != m_Text.size())
+            {
+                error = "Trailing characters at offset " + std::to_string(m_Pos);
+                return false;
+            }
+
+            return true;
+        }
+
+    private:
+        // Deeper documents are rejected instead of overflowing the stack
+        static constexpr uint32_t MaxDepth = 256;
+
+        bool Fail(const char* error)
+        {
+            m_Error = error;
+            return false;
+        }
+
+        void SkipWhitespace()
+        {
+            while (m_Pos < m_Text.size() && (m_Text[m_Pos] == ' ' || m_Text[m_Pos] == '\t' || m_Text[m_Pos] == '\n' || m_Text[m_Pos] == '\r'))
+                ++m_Pos;
+        }
+
+        bool Consume(char c)
+        {
+            SkipWhitespace();
+            if (m_Pos < m_Text.size() && m_Text[m_Pos] == c)
+            {
+                ++m_Pos;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool ConsumeLiteral(std::string_view literal)
+        {
+            if (m_Text.substr(m_Pos, literal.size()) != literal)
+                return Fail("Invalid literal");
+
+            m_Pos += literal.size();
+            return true;
+        }
+
+        bool ParseValue(JsonValue& value, uint32_t depth)
+        {
+            if (depth > MaxDepth)
+                return Fail("Nesting too deep");
+
+            SkipWhitespace();
+            if (m_Pos >= m_Text.size())
+                return Fail("Unexpected end");
+
+            switch (m_Text[m_Pos])
+            {
+            case '{':
+                return ParseObject(value, depth);
+            case '[':
+                return ParseArray(value, depth);
+            case '"':
+                value.m_Type = JsonValue::Type::String;
+                return ParseString(value.m_String);
+            case 't':
+                value.m_Type = JsonValue::Type::Bool;
+                value.m_Bool = true;
+                return ConsumeLiteral("true");
+            case 'f':
+                value.m_Type = JsonValue::Type::Bool;
+                value.m_Bool = false;
+                return ConsumeLiteral("false");
+            case 'n':
+                value.m_Type = JsonValue::Type::Null;
+                return ConsumeLiteral("null");
+            default:
+                value.m_Type = JsonValue::Type::Number;
+                return ParseNumber(value.m_Number);
+            }
+        }
+
+        bool ParseObject(JsonValue& value, uint32_t depth)
+        {
+            value.m_Type = JsonValue::Type::Object;
+            ++m_Pos;
+
+            if (Consume('}'))
+                return true;
+
+            do
+            {
+                SkipWhitespace();
+                if (m_Pos >= m_Text.size() || m_Text[m_Pos] != '"')
+                    return Fail("Expected a member name");
+
+                JsonValue::Member& member = value.m_Members.emplace_back();
+                if (!ParseString(member.first))
+                    return false;
+                if (!Consume(':'))
+                    return Fail("Expected ':'");
+                if (!ParseValue(member.second, depth + 1))
+                    return false;
+            } while (Consume(','));
+
+            return Consume('}') || Fail("Expected '}'");
+        }
+
+        bool ParseArray(JsonValue& value, uint32_t depth)
+        {
+            value.m_Type = JsonValue::Type::Array;
+            ++m_Pos;
+
+            if (Consume(']'))
+                return true;
+
+            do
+            {
+                if (!ParseValue(value.m_Elements.emplace_back(), depth + 1))
+                    return false;
+            } while (Consume(','));
+
+            return Consume(']') || Fail("Expected ']'");
+        }
+
+        bool ParseNumber(double& number)
+        {
+            const char* begin = m_Text.data() + m_Pos;
+            const char* end = m_Text.data() + m_Text.size();
+
+            // from_chars doesn't take the leading '+' JSON forbids anyway, but does take "inf" and "nan"
+            if (*begin != '-' && (*begin < '0' || *begin > '9'))
+                return Fail("Unexpected character");
+
+            const auto [ptr, error] = std::from_chars(begin, end, number);
+            if (error != std::errc())
+                return Fail("Invalid number");
+
+            m_Pos += ptr - begin;
+            return true;
+        }
+
+        static void AppendUtf8(std::string& string, uint32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                string += static_cast<char>(codePoint);
+            }
+            else if (codePoint < 0x800)
+            {
+                string += static_cast<char>(0xc0 | (codePoint >> 6));
+                string += static_cast<char>(0x80 | (codePoint & 0x3f));
+            }
+            else if (codePoint < 0x10000)
+            {
+                string += static_cast<char>(0xe0 | (codePoint >> 12));
+                string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+                string += static_cast<char>(0x80 | (codePoint & 0x3f));
+            }
+            else
+            {
+                string += static_cast<char>(0xf0 | (codePoint >> 18));
+                string += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+                string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+                string += static_cast<char>(0x80 | (codePoint & 0x3f));
+            }
+        }
+
+        bool ParseHex4(uint32_t& value)
+        {
+            if (m_Text.size() - m_Pos < 4)
+                return Fail("Invalid escape");
+
+            const char* begin = m_Text.data() + m_Pos;
+            const auto [ptr, error] = std::from_chars(begin, begin + 4, value, 16);
+            if (error != std::errc() || ptr != begin + 4)
+                return Fail("Invalid escape");
+
+            m_Pos += 4;
+            return true;
+        }
+
+        bool ParseString(std::string& string)
+        {
+            // Skip the opening quote
+            ++m_Pos;
+
+            while (m_Pos < m_Text.size())
+            {
+                // Copy the run up to the next quote or escape at once
+                const size_t runEnd = m_Text.find_first_of("\"\\", m_Pos);
+                if (runEnd == std::string_view::npos)
+                    break;
+
+                string.append(m_Text.substr(m_Pos, runEnd - m_Pos));
+                m_Pos = runEnd + 1;
+
+                if (m_Text[runEnd] == '"')
+                    return true;
+
+                if (m_Pos >= m_Text.size())
+                    break;
+
+                const char escape = m_Text[m_Pos++];
+                switch (escape)
+                {
+                case '"': string += '"'; break;
+                case '\\': string += '\\'; break;
+                case '/': string += '/'; break;
+                case 'b': string += '\b'; break;
+                case 'f': string += '\f'; break;
+                case 'n': string += '\n'; break;
+                case 'r': string += '\r'; break;
+                case 't': string += '\t'; break;
+                case 'u':
+                {
+                    uint32_t codePoint;
+                    if (!ParseHex4(codePoint))
+                        return false;
+
+                    // A high surrogate is followed by the low one of the pair
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00)
+                    {
+                        uint32_t low;
+                        if (m_Text.substr(m_Pos, 2) != "\\u")
+                            return Fail("Unpaired surrogate");
+                        m_Pos += 2;
+                        if (!ParseHex4(low))
+                            return false;
+                        if (low < 0xdc00 || low >= 0xe000)
+                            return Fail("Unpaired surrogate");
+
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+
+                    AppendUtf8(string, codePoint);
+                    break;
+                }
+                default:
+                    return Fail("Invalid escape");
+                }
+            }
+
+            return Fail("Unterminated string");
+        }
+
+        std::string_view m_Text;
+        size_t m_Pos = 0;
+        std::string m_Error;
+    };
+
+    bool JsonValue::Parse(std::string_view text, JsonValue& value, std::string& error)
+    {
+        value = JsonValue();
+        return JsonParser(text).Parse(value, error);
+    }
+
+    const JsonValue& JsonValue::operator[](size_t index) const
+    {
+        static const JsonValue null;
+        return index < m_Elements.size() ? m_Elements[index] : null;
+    }
+
+    const JsonValue& JsonValue::operator[](std::string_view key) const
+    {
+        static const JsonValue null;
+        for (const auto& [name, value] : m_Members)
+        {
+            if (name == key)
+                return value;
+        }
+
+        return null;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <span>
+#include <string_view>
+
+namespace Akari
+{
+    // A parsed JSON document. Reading a missing member or element gives a null value instead of failing,
+    // so optional parts of a document are read with the defaults of the getters.
+    class JsonValue
+    {
+    public:
+        enum class Type
+        {
+            Null,
+            Bool,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        using Member = std::pair<std::string, JsonValue>;
+
+        // Fails on malformed text, error then holds the reason and the offset it was found at
+        static bool Parse(std::string_view text, JsonValue& value, std::string& error);
+
+        Type GetType() const { return m_Type; }
+        bool IsNull() const { return m_Type == Type::Null; }
+        bool IsNumber() const { return m_Type == Type::Number; }
+        bool IsString() const { return m_Type == Type::String; }
+        bool IsArray() const { return m_Type == Type::Array; }
+        bool IsObject() const { return m_Type == Type::Object; }
+
+        bool GetBool(bool defaultValue = false) const { return m_Type == Type::Bool ? m_Bool : defaultValue; }
+        double GetNumber(double defaultValue = 0.0) const { return m_Type == Type::Number ? m_Number : defaultValue; }
+        float GetFloat(float defaultValue = 0.0f) const { return static_cast<float>(GetNumber(defaultValue)); }
+        // Indices and counts, -1 by default marks a missing index
+        int64_t GetInt(int64_t defaultValue = -1) const { return m_Type == Type::Number ? static_cast<int64_t>(m_Number) : defaultValue; }
+        std::string_view GetString(std::string_view defaultValue = {}) const { return m_Type == Type::String ? std::string_view(m_String) : defaultValue; }
+
+        // Elements of an array, empty for other types
+        std::span<const JsonValue> GetElements() const { return m_Elements; }
+        // Members of an object in document order, empty for other types
+        std::span<const Member> GetMembers() const { return m_Members; }
+        size_t GetSize() const { return m_Type == Type::Object ? m_Members.size() : m_Elements.size(); }
+
+        const JsonValue& operator[](size_t index) const;
+        const JsonValue& operator[](std::string_view key) const;
+        bool Contains(std::string_view key) const { return !(*this)[key].IsNull(); }
+
+    private:
+        friend class JsonParser;
+
+        Type m_Type = Type::Null;
+        bool m_Bool = false;
+        double m_Number = 0.0;
+        std::string m_String;
+        std::vector<JsonValue> m_Elements;
+        std::vector<Member> m_Members;
+    };
+}
@@ -9,6 +9,14 @@ namespace Akari
         DirectionalLightComponent Props;
     };
 
+    // Unit direction towards a directional light, from its rotation the same way the lit pixel shader does
+    inline glm::vec3 GetDirectionToLight(const glm::vec3& rotation)
+    {
+        const float pitch = rotation.x;
+        const float yaw = rotation.z;
+        return glm::normalize(glm::vec3(-std::sin(yaw), std::cos(pitch) * std::cos(yaw), std::sin(pitch) * std::cos(yaw)));
+    }
+
     struct alignas(16) PointLight
     {
         TransformComponent Trans;
@@ -0,0 +1,50 @@
+#pragma once
+
+namespace Akari
+{
+    // Read-only view of a whole file, unmapped on destruction. Missing and empty files have no data.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::filesystem::path& path)
+        {
+            m_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_File == INVALID_HANDLE_VALUE)
+                return;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+                return;
+
+            m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_Mapping == nullptr)
+                return;
+
+            m_Data = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+            if (m_Data != nullptr)
+                m_Size = static_cast<uint64_t>(size.QuadPart);
+        }
+
+        ~MappedFile()
+        {
+            if (m_Data != nullptr)
+                UnmapViewOfFile(m_Data);
+            if (m_Mapping != nullptr)
+                CloseHandle(m_Mapping);
+            if (m_File != INVALID_HANDLE_VALUE)
+                CloseHandle(m_File);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* GetData() const { return m_Data; }
+        uint64_t GetSize() const { return m_Size; }
+
+    private:
+        HANDLE m_File = INVALID_HANDLE_VALUE;
+        HANDLE m_Mapping = nullptr;
+        const char* m_Data = nullptr;
+        uint64_t m_Size = 0;
+    };
+}
@@ -4,6 +4,8 @@
 #include "RHI/IndexBuffer.h"
 #include "RHI/VertexBuffer.h"
 #include "Mesh.h"
+#include "Meshlets.h"
+#include "TriangleBVH.h"
 #include "Visitor.h"
 
 using namespace Akari;
@@ -80,7 +82,23 @@ std::shared_ptr<Material> Mesh::GetMaterial() const
     return m_Material;
 }
 
-void Mesh::Draw( CommandList& commandList, uint32_t instanceCount, uint32_t startInstance )
+void Mesh::AddLod( const std::shared_ptr<IndexBuffer>& indexBuffer, float error )
+{
+    m_LodIndexBuffers.push_back( indexBuffer );
+    m_LodErrors.push_back( error );
+}
+
+uint32_t Mesh::GetLodCount() const
+{
+    return static_cast<uint32_t>( m_LodIndexBuffers.size() ) + 1;
+}
+
+float Mesh::GetLodError( uint32_t lod ) const
+{
+    return lod > 0 && lod <= m_LodErrors.size() ? m_LodErrors[lod - 1] : 0.0f;
+}
+
+void Mesh::Draw( CommandList& commandList, uint32_t instanceCount, uint32_t startInstance, uint32_t lod )
 {
     commandList.SetPrimitiveTopology( GetPrimitiveTopology() );
 
@@ -89,12 +107,16 @@ void Mesh::Draw( CommandList& commandList, uint32_t instanceCount, uint32_t star
         commandList.SetVertexBuffer( vertexBuffer.first, vertexBuffer.second );
     }
 
-    const auto indexCount = static_cast<uint32_t>(GetIndexCount());
+    // The levels of detail share the vertex buffers and only swap the index buffer
+    lod = std::min( lod, GetLodCount() - 1 );
+    const auto& indexBuffer = lod > 0 ? m_LodIndexBuffers[lod - 1] : m_IndexBuffer;
+
+    const auto indexCount = static_cast<uint32_t>( indexBuffer ? indexBuffer->GetNumIndices() : 0 );
     const auto vertexCount = static_cast<uint32_t>(GetVertexCount());
 
     if ( indexCount > 0 )
     {
-        commandList.SetIndexBuffer( m_IndexBuffer );
+        commandList.SetIndexBuffer( indexBuffer );
         commandList.DrawIndexed( indexCount, instanceCount, 0u, 0u, startInstance );
     }
     else if ( vertexCount > 0 )
@@ -116,3 +138,18 @@ const DirectX::BoundingBox& Akari::Mesh::GetAABB() const {
     return m_AABB;
 }
 
+void Mesh::SetTriangleBVH( std::shared_ptr<const TriangleBVH> triangleBVH )
+{
+    m_TriangleBVH = std::move( triangleBVH );
+}
+
+void Mesh::SetMeshlets( std::shared_ptr<const MeshletData> meshlets )
+{
+    m_Meshlets = std::move( meshlets );
+}
+
+const MeshletData* Mesh::GetMeshlets() const
+{
+    return m_Meshlets.get();
+}
+
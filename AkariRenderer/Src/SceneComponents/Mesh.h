@@ -38,6 +38,8 @@ namespace Akari
 class CommandList;
 class IndexBuffer;
 class Material;
+struct MeshletData;
+class TriangleBVH;
 class VertexBuffer;
 class Visitor;
 
@@ -83,14 +85,51 @@ public:
     void                        SetAABB( const DirectX::BoundingBox& aabb );
     const DirectX::BoundingBox& GetAABB() const;
 
+    /**
+     * Set the triangle BVH built from the vertex and index data the mesh was created from.
+     * It answers CPU ray queries such as editor picking, meshes without one can't be picked.
+     */
+    void               SetTriangleBVH( std::shared_ptr<const TriangleBVH> triangleBVH );
+    const TriangleBVH* GetTriangleBVH() const
+    {
+        return m_TriangleBVH.get();
+    }
+
+    /**
+     * Set the meshlets of the full detail triangles, used to cull the mesh per cluster.
+     * Meshes without them are culled as a whole.
+     */
+    void               SetMeshlets( std::shared_ptr<const MeshletData> meshlets );
+    const MeshletData* GetMeshlets() const;
+
+    /**
+     * Add a simplified level of detail after the ones already added.
+     * Its indices refer to the same vertex buffers as the full detail index buffer.
+     *
+     * @param indexBuffer The index buffer of the level.
+     * @param error The largest distance of the level to the full detail surface, in mesh space.
+     */
+    void AddLod( const std::shared_ptr<IndexBuffer>& indexBuffer, float error );
+
+    /**
+     * Get the number of levels of detail, including the full detail one.
+     */
+    uint32_t GetLodCount() const;
+
+    /**
+     * Get the mesh space error of a level of detail, 0 for the full detail one.
+     */
+    float GetLodError( uint32_t lod ) const;
+
     /**
      * Draw the mesh to a CommandList.
      *
      * @param commandList The command list to draw to.
      * @param instanceCount The number of instances to draw.
      * @param startInstance The offset added to the instance ID when reading from the instance buffers.
+     * @param lod The level of detail to draw, clamped to the levels the mesh has.
      */
-    void Draw( CommandList& commandList, uint32_t instanceCount = 1, uint32_t startInstance = 0 );
+    void Draw( CommandList& commandList, uint32_t instanceCount = 1, uint32_t startInstance = 0, uint32_t lod = 0 );
 
     /**
      * Accept a visitor.
@@ -100,8 +139,14 @@ public:
 private:
     BufferMap                    m_VertexBuffers;
     std::shared_ptr<IndexBuffer> m_IndexBuffer;
+    // Levels of detail 1 and up
+    std::vector<std::shared_ptr<IndexBuffer>> m_LodIndexBuffers;
+    std::vector<float>                        m_LodErrors;
     std::shared_ptr<Material>    m_Material;
     D3D12_PRIMITIVE_TOPOLOGY     m_PrimitiveTopology;
     DirectX::BoundingBox         m_AABB;
+
+    std::shared_ptr<const TriangleBVH> m_TriangleBVH;
+    std::shared_ptr<const MeshletData> m_Meshlets;
 };
 }  // namespace Akari
\ No newline at end of file
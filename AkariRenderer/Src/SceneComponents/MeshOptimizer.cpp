@@ -0,0 +1,267 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <numeric>
+
+namespace Akari::MeshOptimizer
+{
+    namespace
+    {
+        // FIFO post-transform cache, a vertex hits while fewer than CacheSize misses happened since it was added
+        struct VertexCache
+        {
+            std::vector<uint32_t> Times;
+            uint32_t Time = CacheSize + 1;
+
+            explicit VertexCache(size_t vertexCount) : Times(vertexCount, 0) {}
+
+            // 1 when the vertex has to be transformed
+            uint32_t Access(uint32_t vertex)
+            {
+                if (Time - Times[vertex] <= CacheSize)
+                    return 0;
+
+                Times[vertex] = Time++;
+                return 1;
+            }
+
+            void Flush() { Time += CacheSize + 1; }
+        };
+
+        // Triangles around every vertex, in index order
+        void BuildAdjacency(std::span<const uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+        {
+            offsets.assign(vertexCount + 1, 0);
+            for (const uint32_t index : indices)
+                offsets[index + 1]++;
+            for (size_t i = 0; i < vertexCount; ++i)
+                offsets[i + 1] += offsets[i];
+
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            triangles.resize(indices.size());
+            for (size_t i = 0; i < indices.size(); ++i)
+                triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    VertexCacheStats AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount)
+    {
+        VertexCacheStats stats;
+        stats.Triangles = static_cast<uint32_t>(indices.size() / 3);
+
+        VertexCache cache(vertexCount);
+        std::vector<uint8_t> used(vertexCount);
+        for (const uint32_t index : indices)
+        {
+            stats.TransformedVertices += cache.Access(index);
+            stats.Vertices += used[index] ? 0 : 1;
+            used[index] = 1;
+        }
+
+        return stats;
+    }
+
+    void OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        std::vector<uint32_t> offsets, adjacency;
+        BuildAdjacency(indices, vertexCount, offsets, adjacency);
+
+        // Triangles not emitted yet around every vertex
+        std::vector<uint32_t> live(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            live[v] = offsets[v + 1] - offsets[v];
+
+        std::vector<uint32_t> cacheTimes(vertexCount, 0);
+        std::vector<uint8_t> emitted(triangleCount);
+        std::vector<uint32_t> deadEnd, candidates, result;
+        deadEnd.reserve(indices.size());
+        result.reserve(indices.size());
+        uint32_t time = CacheSize + 1;
+        uint32_t cursor = 0;
+
+        auto nextLiveVertex = [&]()
+        {
+            while (cursor < vertexCount && live[cursor] == 0)
+                cursor++;
+            return cursor < vertexCount ? cursor : ~0u;
+        };
+
+        // Emits all remaining triangles around a fanning vertex, then fans around the vertex among their corners
+        // that stays in the cache longest after its own remaining triangles, or restarts from a recent vertex
+        uint32_t fan = nextLiveVertex();
+        while (fan != ~0u)
+        {
+            candidates.clear();
+            for (uint32_t i = offsets[fan]; i < offsets[fan + 1]; ++i)
+            {
+                const uint32_t triangle = adjacency[i];
+                if (emitted[triangle])
+                    continue;
+
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    const uint32_t v = indices[triangle * 3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTimes[v] > CacheSize)
+                        cacheTimes[v] = time++;
+                }
+                emitted[triangle] = 1;
+            }
+
+            fan = ~0u;
+            int64_t bestPriority = -1;
+            for (const uint32_t v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+
+                // Vertices that would be evicted before their triangles are emitted rank lowest
+                int64_t priority = 0;
+                if (time - cacheTimes[v] + 2 * live[v] <= CacheSize)
+                    priority = time - cacheTimes[v];
+
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    fan = v;
+                }
+            }
+
+            while (fan == ~0u && !deadEnd.empty())
+            {
+                const uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    fan = v;
+            }
+
+            if (fan == ~0u)
+                fan = nextLiveVertex();
+        }
+
+        std::ranges::copy(result, indices.begin());
+    }
+
+    void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions)
+    {
+        const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        if (triangleCount == 0)
+            return;
+
+        VertexCache cache(positions.size());
+        auto triangleMisses = [&](uint32_t triangle)
+        {
+            return cache.Access(indices[triangle * 3 + 0]) + cache.Access(indices[triangle * 3 + 1]) + cache.Access(indices[triangle * 3 + 2]);
+        };
+
+        // Hard boundaries where the cache order starts over anyway, a triangle missing all its vertices
+        std::vector<uint32_t> hardClusters;
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            if (triangleMisses(t) == 3 || t == 0)
+                hardClusters.push_back(t);
+        }
+        hardClusters.push_back(triangleCount);
+
+        // Soft boundaries inside them, as soon as the triangles since the last boundary miss little enough
+        std::vector<uint32_t> clusters;
+        for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+        {
+            const uint32_t begin = hardClusters[c];
+            const uint32_t end = hardClusters[c + 1];
+
+            cache.Flush();
+            uint32_t misses = 0;
+            for (uint32_t t = begin; t < end; ++t)
+                misses += triangleMisses(t);
+            const float maxAcmr = static_cast<float>(misses) / static_cast<float>(end - begin) * OverdrawThreshold;
+
+            cache.Flush();
+            clusters.push_back(begin);
+            misses = 0;
+            uint32_t count = 0;
+            for (uint32_t t = begin; t + 1 < end; ++t)
+            {
+                misses += triangleMisses(t);
+                count++;
+                if (static_cast<float>(misses) <= maxAcmr * static_cast<float>(count))
+                {
+                    clusters.push_back(t + 1);
+                    cache.Flush();
+                    misses = 0;
+                    count = 0;
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+
+        // Area weighted centroids and normals, of the mesh and of every cluster
+        const size_t clusterCount = clusters.size() - 1;
+        std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            float clusterArea = 0.0f;
+            for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+            {
+                const glm::vec3& p0 = positions[indices[t * 3 + 0]];
+                const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+                const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+                const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                const float area = glm::length(normal);
+
+                clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+                clusterNormals[c] += normal;
+                clusterArea += area;
+            }
+
+            meshCentroid += clusterCentroids[c];
+            meshArea += clusterArea;
+            clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : positions[indices[clusters[c] * 3]];
+        }
+        meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+        // Clusters far out along their normal are likely in front of the others
+        std::vector<float> sortKeys(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            const float normalLength = glm::length(clusterNormals[c]);
+            sortKeys[c] = normalLength > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength) : 0.0f;
+        }
+
+        std::vector<uint32_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0u);
+        std::ranges::stable_sort(order, [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (const uint32_t c : order)
+            result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+        std::ranges::copy(result, indices.begin());
+    }
+
+    std::vector<uint32_t> OptimizeVertexFetchRemap(std::span<uint32_t> indices, size_t& vertexCount)
+    {
+        std::vector<uint32_t> remap(vertexCount, ~0u);
+        uint32_t next = 0;
+        for (uint32_t& index : indices)
+        {
+            if (remap[index] == ~0u)
+                remap[index] = next++;
+            index = remap[index];
+        }
+
+        vertexCount = next;
+        return remap;
+    }
+}
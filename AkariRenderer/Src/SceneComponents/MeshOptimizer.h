@@ -0,0 +1,63 @@
+#pragma once
+#include <span>
+
+// Reorders triangle lists and their vertices for the GPU, applied to every mesh at import.
+// All functions are deterministic, the same input always gives the same output.
+namespace Akari::MeshOptimizer
+{
+    // Post-transform cache size assumed by the optimization and the statistics
+    constexpr uint32_t CacheSize = 16;
+    // Overdraw ordering may make the cache miss ratio worse by this factor
+    constexpr float OverdrawThreshold = 1.05f;
+
+    // Vertex shader invocations of a triangle list through a FIFO post-transform cache
+    struct VertexCacheStats
+    {
+        uint32_t TransformedVertices = 0;
+        uint32_t Triangles = 0;
+        uint32_t Vertices = 0;
+
+        // Average cache miss ratio, transformed vertices per triangle, 0.5 at best and 3 at worst
+        float GetAcmr() const { return Triangles > 0 ? static_cast<float>(TransformedVertices) / Triangles : 0.0f; }
+        // Average transform to vertex ratio, 1 at best
+        float GetAtvr() const { return Vertices > 0 ? static_cast<float>(TransformedVertices) / Vertices : 0.0f; }
+
+        void Add(const VertexCacheStats& other)
+        {
+            TransformedVertices += other.TransformedVertices;
+            Triangles += other.Triangles;
+            Vertices += other.Vertices;
+        }
+    };
+
+    VertexCacheStats AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount);
+
+    // Reorders the triangles so consecutive triangles reuse transformed vertices, following Tipsify
+    // (Sander et al., Fast Triangle Reordering for Vertex Locality and Reduced Overdraw)
+    void OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+    // Splits cache optimized triangles into clusters and draws the clusters facing out of the mesh first,
+    // so they occlude the rest from most view directions. Only splits where the cache miss ratio of a
+    // cluster stays within OverdrawThreshold of the cluster it was cut from.
+    void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions);
+
+    // New index of every vertex in the order the triangles first use them, ~0u for unused vertices.
+    // Rewrites the indices to the new order and returns the number of used vertices in vertexCount.
+    std::vector<uint32_t> OptimizeVertexFetchRemap(std::span<uint32_t> indices, size_t& vertexCount);
+
+    // Reorders the vertices in the order the triangles first use them and drops unused ones
+    template<typename Vertex>
+    void OptimizeVertexFetch(std::span<uint32_t> indices, std::vector<Vertex>& vertices)
+    {
+        size_t vertexCount = vertices.size();
+        const std::vector<uint32_t> remap = OptimizeVertexFetchRemap(indices, vertexCount);
+
+        std::vector<Vertex> reordered(vertexCount);
+        for (size_t i = 0; i < remap.size(); ++i)
+        {
+            if (remap[i] != ~0u)
+                reordered[remap[i]] = vertices[i];
+        }
+        vertices = std::move(reordered);
+    }
+}
@@ -0,0 +1,485 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include <bit>
+#include <numeric>
+
+namespace Akari
+{
+    namespace
+    {
+        enum VertexKind : uint8_t
+        {
+            // Collapses onto any neighbour
+            Manifold,
+            // On an open border, collapses along the border only
+            Border,
+            // One of two vertices sharing a position on a UV or normal seam, collapses along the seam with its twin
+            Seam,
+            // Corners, seam ends and everything else that would tear the surface when moved
+            Locked
+        };
+
+        // Weight of the planes through open edges that keep borders and seams in place, relative to triangle areas
+        constexpr double EdgeWeight = 10.0;
+        // Cosine between the old and new triangle normal below which a collapse counts as flipping the triangle
+        constexpr float MinNormalCosine = 0.2f;
+
+        // Symmetric 4x4 quadric of weighted planes, in double as it sums squares of mesh space coordinates
+        struct Quadric
+        {
+            double A00 = 0.0, A11 = 0.0, A22 = 0.0, A01 = 0.0, A02 = 0.0, A12 = 0.0;
+            double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+            double C = 0.0;
+            double Weight = 0.0;
+
+            // Plane dot(n, p) + d = 0 with unit n
+            void AddPlane(const glm::vec3& n, float d, double weight)
+            {
+                A00 += weight * n.x * n.x; A11 += weight * n.y * n.y; A22 += weight * n.z * n.z;
+                A01 += weight * n.x * n.y; A02 += weight * n.x * n.z; A12 += weight * n.y * n.z;
+                B0 += weight * n.x * d; B1 += weight * n.y * d; B2 += weight * n.z * d;
+                C += weight * d * d;
+                Weight += weight;
+            }
+
+            void Add(const Quadric& other)
+            {
+                A00 += other.A00; A11 += other.A11; A22 += other.A22;
+                A01 += other.A01; A02 += other.A02; A12 += other.A12;
+                B0 += other.B0; B1 += other.B1; B2 += other.B2;
+                C += other.C;
+                Weight += other.Weight;
+            }
+
+            // Weighted mean of the squared distances to the planes
+            double Error(const glm::vec3& p) const
+            {
+                if (Weight <= 0.0)
+                    return 0.0;
+
+                const double x = p.x, y = p.y, z = p.z;
+                const double error = x * (A00 * x + A01 * y + A02 * z) +
+                                     y * (A01 * x + A11 * y + A12 * z) +
+                                     z * (A02 * x + A12 * y + A22 * z) +
+                                     2.0 * (B0 * x + B1 * y + B2 * z) + C;
+                return std::max(error, 0.0) / Weight;
+            }
+        };
+
+        // Triangles around every vertex
+        struct Adjacency
+        {
+            std::vector<uint32_t> Offsets;
+            std::vector<uint32_t> Triangles;
+
+            void Build(std::span<const uint32_t> indices, size_t vertexCount)
+            {
+                Offsets.assign(vertexCount + 1, 0);
+                for (const uint32_t index : indices)
+                    Offsets[index + 1]++;
+                for (size_t i = 0; i < vertexCount; ++i)
+                    Offsets[i + 1] += Offsets[i];
+
+                std::vector<uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+                Triangles.resize(indices.size());
+                for (size_t i = 0; i < indices.size(); ++i)
+                    Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            std::span<const uint32_t> Get(uint32_t vertex) const
+            {
+                return { Triangles.data() + Offsets[vertex], Offsets[vertex + 1] - Offsets[vertex] };
+            }
+        };
+
+        // The corner after and before vertex in a triangle's winding
+        uint32_t Next(std::span<const uint32_t> indices, uint32_t triangle, uint32_t vertex)
+        {
+            const uint32_t* corners = &indices[triangle * 3];
+            return corners[0] == vertex ? corners[1] : corners[1] == vertex ? corners[2] : corners[0];
+        }
+
+        uint32_t Prev(std::span<const uint32_t> indices, uint32_t triangle, uint32_t vertex)
+        {
+            const uint32_t* corners = &indices[triangle * 3];
+            return corners[0] == vertex ? corners[2] : corners[1] == vertex ? corners[0] : corners[1];
+        }
+
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3& p) const
+            {
+                // Adding zero turns -0 into +0, which compares equal
+                const uint64_t x = std::bit_cast<uint32_t>(p.x + 0.0f);
+                const uint64_t y = std::bit_cast<uint32_t>(p.y + 0.0f);
+                const uint64_t z = std::bit_cast<uint32_t>(p.z + 0.0f);
+                return std::hash<uint64_t>()((x * 73856093) ^ (y * 19349663) ^ (z * 83492791));
+            }
+        };
+    }
+
+    MeshSimplifier::MeshSimplifier(std::span<const glm::vec3> positions)
+        : m_Positions(positions.begin(), positions.end())
+    {
+        const auto vertexCount = static_cast<uint32_t>(m_Positions.size());
+        m_Remap.resize(vertexCount);
+        m_Wedges.resize(vertexCount);
+
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> firstVertices;
+        firstVertices.reserve(vertexCount);
+
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            const auto [iter, inserted] = firstVertices.try_emplace(m_Positions[v], v);
+            const uint32_t first = iter->second;
+            m_Remap[v] = first;
+
+            // Insert into the ring of the first vertex
+            m_Wedges[v] = inserted ? v : m_Wedges[first];
+            m_Wedges[first] = v;
+
+            min = glm::min(min, m_Positions[v]);
+            max = glm::max(max, m_Positions[v]);
+        }
+
+        m_Radius = vertexCount > 0 ? glm::length(max - min) * 0.5f : 0.0f;
+    }
+
+    std::vector<uint32_t> MeshSimplifier::Simplify(std::span<const uint32_t> indices, size_t targetIndexCount, float maxError, float& error) const
+    {
+        std::vector<uint32_t> result(indices.begin(), indices.end());
+        error = 0.0f;
+
+        const auto vertexCount = static_cast<uint32_t>(m_Positions.size());
+        const double maxErrorSq = static_cast<double>(maxError) * maxError;
+        double resultErrorSq = 0.0;
+
+        Adjacency adjacency;
+
+        auto hasEdge = [&](const uint32_t from, const uint32_t to)
+        {
+            for (const uint32_t triangle : adjacency.Get(from))
+            {
+                if (Next(result, triangle, from) == to)
+                    return true;
+            }
+            return false;
+        };
+
+        // The edge between the positions, connected across seams
+        auto hasPositionEdge = [&](const uint32_t from, const uint32_t to)
+        {
+            uint32_t wedge = from;
+            do
+            {
+                for (const uint32_t triangle : adjacency.Get(wedge))
+                {
+                    if (m_Remap[Next(result, triangle, wedge)] == m_Remap[to])
+                        return true;
+                }
+                wedge = m_Wedges[wedge];
+            } while (wedge != from);
+            return false;
+        };
+
+        // The other wedge of a seam vertex still used by triangles
+        auto getTwin = [&](const uint32_t vertex)
+        {
+            for (uint32_t wedge = m_Wedges[vertex]; wedge != vertex; wedge = m_Wedges[wedge])
+            {
+                if (!adjacency.Get(wedge).empty())
+                    return wedge;
+            }
+            return vertex;
+        };
+
+        std::vector<uint8_t> kinds(vertexCount);
+        auto classify = [&]()
+        {
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                kinds[v] = Locked;
+                if (adjacency.Get(v).empty())
+                    continue;
+
+                uint32_t wedgeCount = 1;
+                for (uint32_t wedge = m_Wedges[v]; wedge != v; wedge = m_Wedges[wedge])
+                    wedgeCount += adjacency.Get(wedge).empty() ? 0 : 1;
+
+                uint32_t openOut = 0, openIn = 0, positionOpen = 0;
+                for (const uint32_t triangle : adjacency.Get(v))
+                {
+                    const uint32_t next = Next(result, triangle, v);
+                    const uint32_t prev = Prev(result, triangle, v);
+                    if (!hasEdge(next, v))
+                    {
+                        openOut++;
+                        positionOpen += hasPositionEdge(next, v) ? 0 : 1;
+                    }
+                    if (!hasEdge(v, prev))
+                    {
+                        openIn++;
+                        positionOpen += hasPositionEdge(v, prev) ? 0 : 1;
+                    }
+                }
+
+                if (openOut == 0 && openIn == 0)
+                    kinds[v] = wedgeCount == 1 ? Manifold : Locked;
+                else if (openOut == 1 && openIn == 1 && wedgeCount == 1 && positionOpen == 2)
+                    kinds[v] = Border;
+                else if (openOut == 1 && openIn == 1 && wedgeCount == 2 && positionOpen == 0)
+                    kinds[v] = Seam;
+            }
+
+            // Both sides of a seam have to be able to follow it
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                if (kinds[v] == Seam && kinds[getTwin(v)] != Seam)
+                    kinds[v] = Locked;
+            }
+        };
+
+        // Quadrics are per position, so both sides of a seam accumulate the same error
+        std::vector<Quadric> quadrics(vertexCount);
+        adjacency.Build(result, vertexCount);
+        classify();
+
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const glm::vec3& p0 = m_Positions[result[i + 0]];
+            glm::vec3 normal = glm::cross(m_Positions[result[i + 1]] - p0, m_Positions[result[i + 2]] - p0);
+            const float doubleArea = glm::length(normal);
+            if (doubleArea == 0.0f)
+                continue;
+
+            normal /= doubleArea;
+            for (uint32_t k = 0; k < 3; ++k)
+                quadrics[m_Remap[result[i + k]]].AddPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+
+            // Planes perpendicular to the triangle through its open edges hold borders and seams in shape
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t a = result[i + k];
+                const uint32_t b = result[i + (k + 1) % 3];
+                if (hasEdge(b, a))
+                    continue;
+
+                const glm::vec3 edge = m_Positions[b] - m_Positions[a];
+                const float edgeLength = glm::length(edge);
+                if (edgeLength == 0.0f)
+                    continue;
+
+                const glm::vec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+                const float d = -glm::dot(edgeNormal, m_Positions[a]);
+                quadrics[m_Remap[a]].AddPlane(edgeNormal, d, EdgeWeight * edgeLength * edgeLength);
+                quadrics[m_Remap[b]].AddPlane(edgeNormal, d, EdgeWeight * edgeLength * edgeLength);
+            }
+        }
+
+        struct Collapse
+        {
+            uint32_t From;
+            uint32_t To;
+            double Error;
+        };
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> collapseRemap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+
+        // Moving from onto to must not turn any remaining triangle around from over, nor against the surface
+        // around from, as slivers turning a little each pass would end up facing inwards
+        auto flips = [&](const uint32_t from, const uint32_t to)
+        {
+            glm::vec3 ringNormal(0.0f);
+            for (const uint32_t triangle : adjacency.Get(from))
+            {
+                const uint32_t* corners = &result[triangle * 3];
+                ringNormal += glm::cross(m_Positions[corners[1]] - m_Positions[corners[0]], m_Positions[corners[2]] - m_Positions[corners[0]]);
+            }
+
+            for (const uint32_t triangle : adjacency.Get(from))
+            {
+                const uint32_t* corners = &result[triangle * 3];
+                if (m_Remap[corners[0]] == m_Remap[to] || m_Remap[corners[1]] == m_Remap[to] || m_Remap[corners[2]] == m_Remap[to])
+                    continue;
+
+                const glm::vec3& p0 = m_Positions[corners[0]];
+                const glm::vec3& p1 = m_Positions[corners[1]];
+                const glm::vec3& p2 = m_Positions[corners[2]];
+                const glm::vec3 oldNormal = glm::cross(p1 - p0, p2 - p0);
+
+                const glm::vec3& q0 = corners[0] == from ? m_Positions[to] : p0;
+                const glm::vec3& q1 = corners[1] == from ? m_Positions[to] : p1;
+                const glm::vec3& q2 = corners[2] == from ? m_Positions[to] : p2;
+                const glm::vec3 newNormal = glm::cross(q1 - q0, q2 - q0);
+
+                if (glm::dot(oldNormal, newNormal) <= MinNormalCosine * glm::length(oldNormal) * glm::length(newNormal) ||
+                    glm::dot(ringNormal, newNormal) <= 0.0f)
+                    return true;
+            }
+            return false;
+        };
+
+        auto countShared = [&](const uint32_t from, const uint32_t to)
+        {
+            uint32_t count = 0;
+            for (const uint32_t triangle : adjacency.Get(from))
+            {
+                const uint32_t* corners = &result[triangle * 3];
+                count += corners[0] == to || corners[1] == to || corners[2] == to ? 1 : 0;
+            }
+            return count;
+        };
+
+        // Collapses in passes, each pass takes the cheapest collapses whose neighbourhoods do not overlap
+        size_t triangleCount = result.size() / 3;
+        const size_t targetTriangleCount = targetIndexCount / 3;
+        bool first = true;
+        while (triangleCount > targetTriangleCount)
+        {
+            if (!first)
+            {
+                adjacency.Build(result, vertexCount);
+                classify();
+            }
+            first = false;
+
+            collapses.clear();
+            for (uint32_t i = 0; i < result.size(); ++i)
+            {
+                const uint32_t a = result[i];
+                const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+                const bool open = !hasEdge(b, a);
+
+                // Interior edges are seen from both of their triangles
+                if (!open && a > b)
+                    continue;
+
+                for (const auto [from, to] : { std::pair(a, b), std::pair(b, a) })
+                {
+                    if (m_Remap[from] == m_Remap[to] || kinds[from] == Locked || (kinds[from] != Manifold && !open))
+                        continue;
+
+                    Quadric quadric = quadrics[m_Remap[from]];
+                    quadric.Add(quadrics[m_Remap[to]]);
+                    collapses.push_back({ from, to, quadric.Error(m_Positions[to]) });
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+            std::iota(collapseRemap.begin(), collapseRemap.end(), 0u);
+            std::fill(touched.begin(), touched.end(), uint8_t(0));
+
+            size_t collapseCount = 0;
+            for (const auto& [from, to, collapseError] : collapses)
+            {
+                if (triangleCount <= targetTriangleCount || collapseError > maxErrorSq)
+                    break;
+
+                if (touched[m_Remap[from]] || touched[m_Remap[to]])
+                    continue;
+
+                // A seam collapses on both sides, its twin follows the seam edge into the same target position
+                uint32_t twinFrom = from, twinTo = to;
+                if (kinds[from] == Seam)
+                {
+                    twinFrom = getTwin(from);
+                    twinTo = ~0u;
+                    uint32_t wedge = to;
+                    do
+                    {
+                        const bool forward = hasEdge(twinFrom, wedge);
+                        if (forward != hasEdge(wedge, twinFrom))
+                        {
+                            twinTo = wedge;
+                            break;
+                        }
+                        wedge = m_Wedges[wedge];
+                    } while (wedge != to);
+
+                    if (twinTo == ~0u)
+                        continue;
+                }
+
+                if (flips(from, to) || (twinFrom != from && flips(twinFrom, twinTo)))
+                    continue;
+
+                // The flip tests assumed the neighbourhood stays in place for this pass
+                for (const uint32_t vertex : { from, twinFrom })
+                {
+                    for (const uint32_t triangle : adjacency.Get(vertex))
+                    {
+                        for (uint32_t k = 0; k < 3; ++k)
+                            touched[m_Remap[result[triangle * 3 + k]]] = 1;
+                    }
+                }
+
+                collapseRemap[from] = to;
+                triangleCount -= countShared(from, to);
+                if (twinFrom != from)
+                {
+                    collapseRemap[twinFrom] = twinTo;
+                    triangleCount -= countShared(twinFrom, twinTo);
+                }
+
+                quadrics[m_Remap[to]].Add(quadrics[m_Remap[from]]);
+                resultErrorSq = std::max(resultErrorSq, collapseError);
+                collapseCount++;
+            }
+
+            if (collapseCount == 0)
+                break;
+
+            // Drop the triangles that collapsed to lines
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                const uint32_t a = collapseRemap[result[i + 0]];
+                const uint32_t b = collapseRemap[result[i + 1]];
+                const uint32_t c = collapseRemap[result[i + 2]];
+                if (a == b || b == c || c == a)
+                    continue;
+
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+            triangleCount = result.size() / 3;
+        }
+
+        error = static_cast<float>(std::sqrt(resultErrorSq));
+        return result;
+    }
+
+    std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(std::span<const uint32_t> indices) const
+    {
+        std::vector<Lod> chain;
+        chain.reserve(MaxLodCount - 1);
+
+        std::span<const uint32_t> source = indices;
+        float error = 0.0f;
+        for (uint32_t lod = 1; lod < MaxLodCount; ++lod)
+        {
+            const size_t targetIndexCount = static_cast<size_t>(static_cast<float>(source.size() / 3) * LodReduction) * 3;
+            const float maxError = MaxLodError * m_Radius - error;
+            if (targetIndexCount < MinLodIndexCount || maxError <= 0.0f)
+                break;
+
+            float lodError;
+            std::vector<uint32_t> simplified = Simplify(source, targetIndexCount, maxError, lodError);
+            if (static_cast<float>(simplified.size()) > static_cast<float>(source.size()) * MinLodShrink)
+                break;
+
+            // Each level is simplified from the previous one, so the errors add up
+            error += lodError;
+            chain.push_back({ std::move(simplified), error });
+            source = chain.back().Indices;
+        }
+
+        return chain;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <span>
+
+namespace Akari
+{
+    // Quadric error edge collapse simplification of indexed triangle lists, for generating levels of detail.
+    // Vertices only ever collapse onto other vertices, so every simplified index list still indexes the
+    // original vertex buffer. Vertices sharing a position but not their attributes form UV and normal seams,
+    // they only collapse along their seam together with their twin, and open borders only along the border.
+    class MeshSimplifier
+    {
+    public:
+        struct Lod
+        {
+            std::vector<uint32_t> Indices;
+            // Largest distance to the full detail surface in mesh space, estimated from the quadrics
+            float Error;
+        };
+
+        MeshSimplifier(std::span<const glm::vec3> positions);
+
+        // Collapses edges in order of their error until at most targetIndexCount indices are left,
+        // or the next collapse would move the surface farther than maxError
+        std::vector<uint32_t> Simplify(std::span<const uint32_t> indices, size_t targetIndexCount, float maxError, float& error) const;
+
+        // Levels 1 and up, each simplified from the previous one to LodReduction of its indices.
+        // The chain ends early once a level no longer shrinks or the error exceeds MaxLodError of the mesh size.
+        std::vector<Lod> BuildLodChain(std::span<const uint32_t> indices) const;
+
+        // Levels including the full detail one
+        static constexpr uint32_t MaxLodCount = 4;
+        static constexpr float LodReduction = 0.5f;
+        // A level keeping more than this share of the previous level's indices is not worth storing
+        static constexpr float MinLodShrink = 0.85f;
+        static constexpr size_t MinLodIndexCount = 3 * 32;
+        // Relative to the radius of the mesh bounds
+        static constexpr float MaxLodError = 0.05f;
+
+    private:
+        std::vector<glm::vec3> m_Positions;
+        // Lowest vertex index with the same position, and the next vertex with the same position in a ring
+        std::vector<uint32_t> m_Remap;
+        std::vector<uint32_t> m_Wedges;
+        float m_Radius = 0.0f;
+    };
+}
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "Meshlets.h"
+
+namespace Akari
+{
+    namespace
+    {
+        MeshletBounds ComputeBounds(const MeshletData& data, const Meshlet& meshlet, std::span<const glm::vec3> positions)
+        {
+            MeshletBounds bounds{};
+
+            // Sphere around the center of the box, close enough to the smallest sphere for culling
+            glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+            for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+            {
+                const glm::vec3& p = positions[data.Vertices[meshlet.VertexOffset + i]];
+                min = glm::min(min, p);
+                max = glm::max(max, p);
+            }
+            bounds.Center = (min + max) * 0.5f;
+            for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+                bounds.Radius = std::max(bounds.Radius, glm::length(positions[data.Vertices[meshlet.VertexOffset + i]] - bounds.Center));
+
+            // Cone around the mean triangle normal through the normal farthest from it
+            std::array<glm::vec3, Meshlet::MaxTriangles> normals;
+            uint32_t normalCount = 0;
+            glm::vec3 normalSum(0.0f);
+            for (uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+            {
+                const uint8_t* corners = &data.Triangles[meshlet.TriangleOffset + t * 3];
+                const glm::vec3& p0 = positions[data.Vertices[meshlet.VertexOffset + corners[0]]];
+                const glm::vec3& p1 = positions[data.Vertices[meshlet.VertexOffset + corners[1]]];
+                const glm::vec3& p2 = positions[data.Vertices[meshlet.VertexOffset + corners[2]]];
+
+                const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                const float length = glm::length(normal);
+                if (length == 0.0f)
+                    continue;
+
+                normals[normalCount++] = normal / length;
+                normalSum += normal / length;
+            }
+
+            bounds.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+            bounds.ConeSin = 1.0f;
+            const float sumLength = glm::length(normalSum);
+            if (normalCount == 0 || sumLength < 1e-6f)
+                return bounds;
+
+            bounds.ConeAxis = normalSum / sumLength;
+            float coneCos = 1.0f;
+            for (uint32_t i = 0; i < normalCount; ++i)
+                coneCos = std::min(coneCos, glm::dot(bounds.ConeAxis, normals[i]));
+
+            if (coneCos > 0.0f)
+            {
+                bounds.ConeCos = coneCos;
+                bounds.ConeSin = std::sqrt(std::max(1.0f - coneCos * coneCos, 0.0f));
+            }
+
+            return bounds;
+        }
+    }
+
+    MeshletData BuildMeshlets(std::span<const uint32_t> indices, std::span<const glm::vec3> positions)
+    {
+        MeshletData data;
+        data.Meshlets.reserve(indices.size() / 3 / Meshlet::MaxTriangles + 1);
+
+        // Meshlet vertex index of every mesh vertex in the current meshlet, 0xff for none
+        std::vector<uint8_t> localIndices(positions.size(), 0xff);
+        Meshlet meshlet{ 0, 0, 0, 0 };
+
+        auto flush = [&]()
+        {
+            if (meshlet.TriangleCount == 0)
+                return;
+
+            for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+                localIndices[data.Vertices[meshlet.VertexOffset + i]] = 0xff;
+
+            data.Meshlets.push_back(meshlet);
+            meshlet = { static_cast<uint32_t>(data.Vertices.size()), static_cast<uint32_t>(data.Triangles.size()), 0, 0 };
+        };
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const uint32_t newVertices = (localIndices[indices[i + 0]] == 0xff ? 1 : 0) +
+                                         (localIndices[indices[i + 1]] == 0xff && indices[i + 1] != indices[i + 0] ? 1 : 0) +
+                                         (localIndices[indices[i + 2]] == 0xff && indices[i + 2] != indices[i + 0] && indices[i + 2] != indices[i + 1] ? 1 : 0);
+            if (meshlet.VertexCount + newVertices > Meshlet::MaxVertices || meshlet.TriangleCount == Meshlet::MaxTriangles)
+                flush();
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                uint8_t& local = localIndices[indices[i + k]];
+                if (local == 0xff)
+                {
+                    local = static_cast<uint8_t>(meshlet.VertexCount++);
+                    data.Vertices.push_back(indices[i + k]);
+                }
+                data.Triangles.push_back(local);
+            }
+            meshlet.TriangleCount++;
+        }
+        flush();
+
+        data.Bounds.reserve(data.Meshlets.size());
+        for (const Meshlet& m : data.Meshlets)
+            data.Bounds.push_back(ComputeBounds(data, m, positions));
+
+        return data;
+    }
+
+    bool IsMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& cameraPosition)
+    {
+        if (bounds.ConeCos <= 0.0f)
+            return false;
+
+        // Every normal n in the cone and point p in the sphere must satisfy dot(n, p - camera) > 0. The smallest
+        // dot(n, center - camera) is at the angle between the axis and the view direction plus the cone angle.
+        const glm::vec3 view = bounds.Center - cameraPosition;
+        const float distance = glm::length(view);
+        if (distance <= bounds.Radius)
+            return false;
+
+        const float viewCos = glm::dot(view, bounds.ConeAxis) / distance;
+        const float viewSin = std::sqrt(std::max(1.0f - viewCos * viewCos, 0.0f));
+        return distance * (viewCos * bounds.ConeCos - viewSin * bounds.ConeSin) > bounds.Radius;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <span>
+
+namespace Akari
+{
+    // A cluster of a mesh's triangles, the unit of mesh shaders and cluster culling.
+    // Its vertices index the mesh's vertex buffer and its triangles index the meshlet's vertices.
+    struct Meshlet
+    {
+        uint32_t VertexOffset;
+        uint32_t TriangleOffset;
+        uint32_t VertexCount;
+        uint32_t TriangleCount;
+
+        static constexpr uint32_t MaxVertices = 64;
+        static constexpr uint32_t MaxTriangles = 124;
+    };
+
+    // Mesh space bounding sphere and cone of triangle normals of a meshlet
+    struct MeshletBounds
+    {
+        glm::vec3 Center;
+        float Radius;
+        glm::vec3 ConeAxis;
+        // Cosine and sine of the cone's half angle, cones of 90 degrees and wider have a cosine of 0
+        float ConeCos;
+        float ConeSin;
+    };
+
+    struct MeshletData
+    {
+        std::vector<Meshlet> Meshlets;
+        std::vector<MeshletBounds> Bounds;
+        std::vector<uint32_t> Vertices;
+        // Three meshlet vertex indices per triangle
+        std::vector<uint8_t> Triangles;
+    };
+
+    // Splits a triangle list into meshlets in triangle order, cache optimized triangles give compact meshlets
+    MeshletData BuildMeshlets(std::span<const uint32_t> indices, std::span<const glm::vec3> positions);
+
+    // True when all triangles of the meshlet face away from a camera position in the same space as the bounds.
+    // Triangles are front facing when clockwise, as in the rasterizer state of the passes.
+    bool IsMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& cameraPosition);
+}
@@ -6,12 +6,18 @@
 #include "RHI/Device.h"
 #include "RHI/Texture.h"
 #include "RHI/VertexTypes.h"
+#include "AssetDatabase.h"
+#include "Gltf.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "ModelCache.h"
 #include "ModelNode.h"
+#include "Obj.h"
+#include "TriangleBVH.h"
 #include "Visitor.h"
+#include "Timing/Timer.h"
 
-#include <assimp/Exporter.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/ProgressHandler.hpp>
 #include <assimp/anim.h>
@@ -19,6 +25,10 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <bit>
+#include <numeric>
+#include <ppl.h>
+
 using namespace Akari;
 using namespace DirectX;
 
@@ -47,24 +57,148 @@ private:
     std::function<bool( float )> m_ProgressCallback;
 };
 
-// Helper function to create an DirectX::BoundingBox from an aiAABB.
-inline DirectX::BoundingBox CreateBoundingBox( const aiAABB& aabb )
+// An Assimp file system that records the files the importer reads, like the material library of an OBJ file.
+class RecordingIOSystem : public Assimp::DefaultIOSystem
 {
-    DirectX::XMVECTOR min = XMVectorSet( aabb.mMin.x, aabb.mMin.y, aabb.mMin.z, 1.0f );
-    DirectX::XMVECTOR max = XMVectorSet( aabb.mMax.x, aabb.mMax.y, aabb.mMax.z, 1.0f );
+public:
+    Assimp::IOStream* Open( const char* file, const char* mode = "rb" ) override
+    {
+        Assimp::IOStream* stream = DefaultIOSystem::Open( file, mode );
+        if ( stream )
+        {
+            m_OpenedFiles.emplace_back( std::u8string( reinterpret_cast<const char8_t*>( file ) ) );
+        }
+
+        return stream;
+    }
+
+    const std::vector<std::filesystem::path>& GetOpenedFiles() const
+    {
+        return m_OpenedFiles;
+    }
+
+private:
+    std::vector<std::filesystem::path> m_OpenedFiles;
+};
+
+// Import settings shared by all model files.
+constexpr float        MaxSmoothingAngle     = 80.0f;
+constexpr unsigned int RemovedPrimitiveTypes = aiPrimitiveType_POINT | aiPrimitiveType_LINE;
+
+// The texture files of a model, decoded on worker threads and then uploaded with the command list.
+// Every file is decoded once however many materials use it, and not at all when it was loaded before.
+class TextureBatch
+{
+public:
+    // An image embedded in a model file is named after the file and the image index, data holds its bytes.
+    uint32_t Add( const std::filesystem::path& filePath, bool sRGB, int32_t image = -1,
+                  std::span<const std::byte> data = {} )
+    {
+        std::wstring fileName = filePath.wstring();
+        if ( image >= 0 )
+        {
+            fileName += L"#" + std::to_wstring( image );
+        }
+
+        auto [iter, inserted] = m_Indices.try_emplace( fileName, static_cast<uint32_t>( m_Textures.size() ) );
+        if ( inserted )
+        {
+            m_Textures.push_back( { iter->first, sRGB, data } );
+        }
+
+        return iter->second;
+    }
 
-    DirectX::BoundingBox bb;
-    BoundingBox::CreateFromPoints( bb, min, max );
+    void Decode()
+    {
+        concurrency::parallel_for( size_t( 0 ), m_Textures.size(), [&]( size_t i ) {
+            auto& texture = m_Textures[i];
+            if ( CommandList::IsTextureCached( texture.FileName ) )
+            {
+                return;
+            }
+
+            if ( texture.Data.empty() )
+            {
+                CommandList::DecodeTextureFile( texture.FileName, texture.SRGB, texture.Image );
+            }
+            else
+            {
+                CommandList::DecodeTextureMemory( texture.Data.data(), texture.Data.size(), texture.SRGB,
+                                                  texture.Image );
+            }
+        } );
+    }
+
+    void Upload( CommandList& commandList )
+    {
+        for ( auto& texture: m_Textures )
+        {
+            texture.Texture = texture.Image.GetImageCount() > 0
+                                  ? commandList.LoadTextureFromImage( texture.FileName, texture.Image )
+                                  : commandList.LoadTextureFromFile( texture.FileName, texture.SRGB );
+
+            // The pixels were copied to the upload heap.
+            texture.Image.Release();
+        }
+    }
+
+    size_t GetSize() const
+    {
+        return m_Textures.size();
+    }
+
+    const std::shared_ptr<Texture>& Get( uint32_t index ) const
+    {
+        return m_Textures[index].Texture;
+    }
+
+private:
+    struct Entry
+    {
+        std::wstring               FileName;
+        bool                       SRGB;
+        std::span<const std::byte> Data;
+        ScratchImage               Image;
+        std::shared_ptr<Texture>   Texture;
+    };
+
+    std::vector<Entry>               m_Textures;
+    std::map<std::wstring, uint32_t> m_Indices;
+};
 
-    return bb;
+// Helper function to extract the triangle list of an aiMesh.
+inline std::vector<unsigned int> GetTriangleIndices( const aiMesh& aiMesh )
+{
+    std::vector<unsigned int> indices;
+    if ( aiMesh.HasFaces() )
+    {
+        indices.reserve( aiMesh.mNumFaces * 3 );
+        for ( unsigned int i = 0; i < aiMesh.mNumFaces; ++i )
+        {
+            const aiFace& face = aiMesh.mFaces[i];
+
+            // Only extract triangular faces
+            if ( face.mNumIndices == 3 )
+            {
+                indices.push_back( face.mIndices[0] );
+                indices.push_back( face.mIndices[1] );
+                indices.push_back( face.mIndices[2] );
+            }
+        }
+    }
+
+    return indices;
 }
 
 bool Model::LoadModelFromFile( CommandList& commandList, const std::wstring& fileName,
                                const std::function<bool( float )>& loadingProgress )
 {
 
-    std::filesystem::path filePath   = fileName;
-    std::filesystem::path exportPath = std::filesystem::path( filePath ).replace_extension( "assbin" );
+    std::filesystem::path filePath = fileName;
+    // The source extension stays in the name, scene.gltf and scene.glb in one folder are cooked side by side.
+    std::filesystem::path cookedPath = filePath;
+    cookedPath += ModelCache::Extension;
 
     std::filesystem::path parentPath;
     if ( filePath.has_parent_path() )
@@ -76,40 +210,101 @@ bool Model::LoadModelFromFile( CommandList& commandList, const std::wstring& fil
         parentPath = std::filesystem::current_path();
     }
 
-    Assimp::Importer importer;
-    const aiScene*   scene;
+    // The triangle order is optimized by the MeshOptimizer on every import instead
+    unsigned int preprocessFlags = ( aiProcessPreset_TargetRealtime_MaxQuality & ~aiProcess_ImproveCacheLocality ) |
+                                   aiProcess_OptimizeGraph |
+                                   aiProcess_ConvertToLeftHanded | aiProcess_GenBoundingBoxes;
+
+    // glTF and OBJ files are read from their mapped files, everything else goes through Assimp.
+    const bool isGltf = filePath.extension() == ".gltf" || filePath.extension() == ".glb";
+    const bool isObj  = filePath.extension() == ".obj";
+
+    // Besides the files it was imported from, a cooked model depends on the importer, the settings of the import
+    // and the source file it was cooked for.
+    const std::array<uint64_t, 6> importSettings = { ModelCache::Version,
+                                                     preprocessFlags,
+                                                     std::bit_cast<uint32_t>( MaxSmoothingAngle ),
+                                                     RemovedPrimitiveTypes,
+                                                     m_GenerateMeshlets ? 1u : 0u,
+                                                     isGltf ? 1u : isObj ? 2u : 0u };
+    const std::string sourcePath   = AssetDatabase::GetKey( filePath );
+    const uint64_t    settingsHash = AssetDatabase::Hash( importSettings.data(), sizeof( importSettings ),
+                                                          AssetDatabase::Hash( sourcePath.data(), sourcePath.size() ) );
+
+    AssetDatabase& assetDatabase = AssetDatabase::GetInstance();
+    Timer          loadTimer;
+
+    // Check if the cooked model is up to date with the file and everything it references.
+    if ( assetDatabase.IsUpToDate( cookedPath, settingsHash ) && LoadCookedModel( commandList, cookedPath, parentPath ) )
+    {
+        spdlog::info( "Model {0}: loaded cooked model in {1:.2f} ms", filePath.filename().string(),
+                      loadTimer.ElapsedMillis() );
+        return true;
+    }
 
-    importer.SetProgressHandler( new ProgressHandler( *this, loadingProgress ) );
+    // The model has not been cooked yet or is out of date. Import and process the file.
+    ModelCache::Writer                 cacheWriter;
+    std::vector<std::filesystem::path> dependencies;
 
-    // Check if a preprocessed file exists.
-    if ( std::filesystem::exists( exportPath ) && std::filesystem::is_regular_file( exportPath ) )
+    if ( isGltf )
     {
-        scene = importer.ReadFile( exportPath.string(), aiProcess_GenBoundingBoxes );
+        Gltf::Asset asset;
+        if ( !asset.Open( filePath ) )
+        {
+            return false;
+        }
+
+        ImportGltf( commandList, asset, filePath, &cacheWriter );
+        dependencies = asset.GetFilePaths();
+    }
+    else if ( isObj )
+    {
+        Obj::Asset asset;
+        if ( !asset.Open( filePath ) )
+        {
+            return false;
+        }
+
+        ImportObj( commandList, asset, filePath, &cacheWriter );
+        dependencies = asset.GetFilePaths();
     }
     else
     {
-        // File has not been preprocessed yet. Import and processes the file.
-        importer.SetPropertyFloat( AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f );
-        importer.SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE );
+        Assimp::Importer   importer;
+        RecordingIOSystem* ioSystem = new RecordingIOSystem();
+        importer.SetIOHandler( ioSystem );
+        importer.SetProgressHandler( new ProgressHandler( *this, loadingProgress ) );
+        importer.SetPropertyFloat( AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, MaxSmoothingAngle );
+        importer.SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, RemovedPrimitiveTypes );
 
-        unsigned int preprocessFlags = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_OptimizeGraph |
-                                       aiProcess_ConvertToLeftHanded | aiProcess_GenBoundingBoxes;
-        scene = importer.ReadFile( filePath.string(), preprocessFlags );
+        const aiScene* scene = importer.ReadFile( filePath.string(), preprocessFlags );
 
-        if ( scene )
+        if ( !scene )
         {
-            // Export the preprocessed model file for faster loading next time.
-            Assimp::Exporter exporter;
-            exporter.Export( scene, "assbin", exportPath.string(), 0 );
+            return false;
         }
+
+        ImportModel( commandList, *scene, parentPath, &cacheWriter );
+        dependencies = ioSystem->GetOpenedFiles();
     }
 
-    if ( !scene )
+    spdlog::info( "Model {0}: imported in {1:.2f} ms", filePath.filename().string(), loadTimer.ElapsedMillis() );
+
+    // Cook the imported model for faster loading next time.
+    if ( !cacheWriter.Save( cookedPath ) )
     {
-        return false;
+        spdlog::warn( "Model {0}: failed to write the cooked model {1}", filePath.filename().string(),
+                      cookedPath.string() );
+        return true;
     }
 
-    ImportModel( commandList, *scene, parentPath );
+    // It depends on the source file, every other file the importer read and the textures of the materials.
+    dependencies.push_back( filePath );
+    for ( const auto& texturePath: cacheWriter.GetTexturePaths() )
+    {
+        dependencies.push_back( parentPath / texturePath );
+    }
+    assetDatabase.Record( cookedPath, settingsHash, dependencies );
 
     return true;
 }
@@ -119,11 +314,11 @@ bool Model::LoadModelFromString( CommandList& commandList, const std::string& sc
     Assimp::Importer importer;
     const aiScene*   scene = nullptr;
 
-    importer.SetPropertyFloat( AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f );
-    importer.SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE );
+    importer.SetPropertyFloat( AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, MaxSmoothingAngle );
+    importer.SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, RemovedPrimitiveTypes );
 
-    unsigned int preprocessFlags =
-        aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_ConvertToLeftHanded | aiProcess_GenBoundingBoxes;
+    unsigned int preprocessFlags = ( aiProcessPreset_TargetRealtime_MaxQuality & ~aiProcess_ImproveCacheLocality ) |
+                                   aiProcess_ConvertToLeftHanded | aiProcess_GenBoundingBoxes;
 
     scene = importer.ReadFileFromMemory( sceneStr.data(), sceneStr.size(), preprocessFlags, format.c_str() );
 
@@ -137,9 +332,8 @@ bool Model::LoadModelFromString( CommandList& commandList, const std::string& sc
     return true;
 }
 
-void Model::ImportModel( CommandList& commandList, const aiScene& scene, std::filesystem::path parentPath )
+void Model::Clear()
 {
-
     if ( m_RootNode )
     {
         m_RootNode.reset();
@@ -148,23 +342,377 @@ void Model::ImportModel( CommandList& commandList, const aiScene& scene, std::fi
     m_MaterialMap.clear();
     m_Materials.clear();
     m_Meshes.clear();
+    m_FlattenedMeshesValid = false;
+}
 
-    // Import model materials.
-    for ( unsigned int i = 0; i < scene.mNumMaterials; ++i )
+bool Model::LoadCookedModel( CommandList& commandList, const std::filesystem::path& cookedPath,
+                             const std::filesystem::path& parentPath )
+{
+    ModelCache::MappedModel cookedModel;
+    if ( !cookedModel.Open( cookedPath ) )
     {
-        ImportMaterial( commandList, *( scene.mMaterials[i] ), parentPath );
+        return false;
     }
-    // Import meshes
-    for ( unsigned int i = 0; i < scene.mNumMeshes; ++i )
+
+    Clear();
+
+    const ModelCache::Header& header = cookedModel.GetHeader();
+
+    // Load the materials, with their textures from the same files as the import.
+    // The texture files are decoded in parallel before they are uploaded.
+    const auto            textures = cookedModel.Get<ModelCache::TextureRecord>( header.Textures );
+    TextureBatch          textureBatch;
+    std::vector<uint32_t> textureIndices( textures.size() );
+    // Images embedded in a glTF file are read from the mapped file.
+    std::unique_ptr<Gltf::Asset> gltfAsset;
+    for ( size_t i = 0; i < textures.size(); ++i )
     {
-        ImportMesh( commandList, *( scene.mMeshes[i] ) );
+        const std::string_view      path = cookedModel.GetString( textures[i].Path );
+        const std::filesystem::path texturePath(
+            std::u8string( reinterpret_cast<const char8_t*>( path.data() ), path.size() ) );
+
+        std::span<const std::byte> data;
+        if ( textures[i].Image >= 0 )
+        {
+            if ( !gltfAsset )
+            {
+                gltfAsset = std::make_unique<Gltf::Asset>();
+                if ( !gltfAsset->Open( parentPath / texturePath ) )
+                {
+                    return false;
+                }
+            }
+
+            const auto& images = gltfAsset->GetImages();
+            if ( textures[i].Image >= static_cast<int32_t>( images.size() ) || images[textures[i].Image].Data.empty() )
+            {
+                return false;
+            }
+            data = images[textures[i].Image].Data;
+        }
+
+        textureIndices[i] = textureBatch.Add( parentPath / texturePath, textures[i].SRGB != 0, textures[i].Image, data );
     }
+    textureBatch.Decode();
+    textureBatch.Upload( commandList );
+
+    for ( const auto& record: cookedModel.Get<ModelCache::MaterialRecord>( header.Materials ) )
+    {
+        auto pMaterial = std::make_shared<Material>( record.Properties );
+        for ( uint32_t i = record.TextureBegin; i < record.TextureBegin + record.TextureCount; ++i )
+        {
+            pMaterial->SetTexture( textures[i].Type, textureBatch.Get( textureIndices[i] ) );
+        }
+
+        m_Materials.push_back( pMaterial );
+    }
+
+    // Load the meshes. The buffers are uploaded straight from the mapped file.
+    const auto lods = cookedModel.Get<ModelCache::LodRecord>( header.Lods );
+    for ( const auto& record: cookedModel.Get<ModelCache::MeshRecord>( header.Meshes ) )
+    {
+        auto mesh = std::make_shared<Mesh>();
+        mesh->SetMaterial( m_Materials[record.Material] );
+
+        const auto vertices = cookedModel.Get<VertexPositionQTangentTexture>( record.Vertices );
+        mesh->SetVertexBuffer( 0, commandList.CopyVertexBuffer( vertices.size(), sizeof( VertexPositionQTangentTexture ),
+                                                                vertices.data() ) );
+
+        const auto indices = cookedModel.Get<uint32_t>( record.Indices );
+        if ( !indices.empty() )
+        {
+            mesh->SetIndexBuffer( commandList.CopyIndexBuffer( indices.size(), DXGI_FORMAT_R32_UINT, indices.data() ) );
+
+            for ( const auto& lod: lods.subspan( record.LodBegin, record.LodCount ) )
+            {
+                const auto lodIndices = cookedModel.Get<uint32_t>( lod.Indices );
+                mesh->AddLod( commandList.CopyIndexBuffer( lodIndices.size(), DXGI_FORMAT_R32_UINT, lodIndices.data() ),
+                              lod.Error );
+            }
+        }
+
+        mesh->SetAABB( BoundingBox( record.AABBCenter, record.AABBExtents ) );
+
+        // The triangle BVH and the meshlets are restored, not rebuilt.
+        const auto positions = cookedModel.Get<glm::vec3>( record.Positions );
+        if ( !positions.empty() )
+        {
+            mesh->SetTriangleBVH( std::make_shared<TriangleBVH>(
+                positions, indices, cookedModel.Get<TriangleBVH::Node>( record.BVHNodes ),
+                cookedModel.Get<uint32_t>( record.BVHTriangleOrder ) ) );
+        }
+
+        const auto meshlets = cookedModel.Get<Meshlet>( record.Meshlets );
+        if ( !meshlets.empty() )
+        {
+            const auto bounds           = cookedModel.Get<MeshletBounds>( record.MeshletBounds );
+            const auto meshletVertices  = cookedModel.Get<uint32_t>( record.MeshletVertices );
+            const auto meshletTriangles = cookedModel.Get<uint8_t>( record.MeshletTriangles );
+
+            auto meshletData = std::make_shared<MeshletData>();
+            meshletData->Meshlets.assign( meshlets.begin(), meshlets.end() );
+            meshletData->Bounds.assign( bounds.begin(), bounds.end() );
+            meshletData->Vertices.assign( meshletVertices.begin(), meshletVertices.end() );
+            meshletData->Triangles.assign( meshletTriangles.begin(), meshletTriangles.end() );
+            mesh->SetMeshlets( meshletData );
+        }
+
+        m_Meshes.push_back( mesh );
+    }
+
+    // Rebuild the node hierarchy, parents come before their children.
+    const auto nodeMeshes = cookedModel.Get<uint32_t>( header.NodeMeshes );
+    std::vector<std::shared_ptr<ModelNode>> nodes;
+    for ( const auto& record: cookedModel.Get<ModelCache::NodeRecord>( header.Nodes ) )
+    {
+        const XMMATRIX localTransform = XMLoadFloat4x4( &record.LocalTransform );
+
+        auto node = std::make_shared<ModelNode>( localTransform );
+        node->SetName( std::string( cookedModel.GetString( record.Name ) ) );
+        if ( record.Parent >= 0 )
+        {
+            // Adding a child keeps its world transform, restore the local one.
+            node->SetParent( nodes[record.Parent] );
+            node->SetLocalTransform( localTransform );
+        }
+
+        for ( const uint32_t meshIndex: nodeMeshes.subspan( record.MeshBegin, record.MeshCount ) )
+        {
+            node->AddMesh( m_Meshes[meshIndex] );
+        }
+
+        nodes.push_back( node );
+    }
+
+    m_RootNode = nodes.front();
+
+    return true;
+}
+
+void Model::ImportModel( CommandList& commandList, const aiScene& scene, std::filesystem::path parentPath,
+                         ModelCache::Writer* cacheWriter )
+{
+    Clear();
+
+    std::vector<MaterialData> materialData( scene.mNumMaterials );
+    concurrency::parallel_for( 0u, scene.mNumMaterials, [&]( unsigned int i ) {
+        materialData[i] = PrepareMaterial( *( scene.mMaterials[i] ) );
+    } );
+
+    ImportMaterialsAndMeshes(
+        commandList, parentPath, materialData, scene.mNumMeshes,
+        [&]( size_t i ) { return PrepareMesh( *( scene.mMeshes[i] ), m_GenerateMeshlets ); }, cacheWriter,
+        scene.mRootNode ? scene.mRootNode->mName.C_Str() : "" );
 
     // Import the root node.
     m_RootNode = ImportSceneNode( commandList, nullptr, scene.mRootNode );
+
+    if ( cacheWriter && m_RootNode )
+    {
+        CookNodes( *cacheWriter );
+    }
+}
+
+void Model::ImportGltf( CommandList& commandList, const Gltf::Asset& asset, const std::filesystem::path& filePath,
+                        ModelCache::Writer* cacheWriter )
+{
+    Clear();
+
+    // Primitives without a material use the last one, which has the default properties.
+    std::vector<MaterialData> materialData;
+    for ( const auto& material: asset.GetMaterials() )
+    {
+        materialData.push_back( PrepareMaterial( material, asset.GetImages(), filePath.filename() ) );
+    }
+    const auto defaultMaterial = static_cast<uint32_t>( materialData.size() );
+    materialData.emplace_back();
+
+    // Every triangle primitive becomes a mesh, the nodes reference them through their glTF mesh.
+    std::vector<const Gltf::Primitive*> primitives;
+    std::vector<std::vector<uint32_t>>  meshPrimitives( asset.GetMeshes().size() );
+    for ( size_t i = 0; i < asset.GetMeshes().size(); ++i )
+    {
+        for ( const auto& primitive: asset.GetMeshes()[i].Primitives )
+        {
+            if ( primitive.Mode == 4 && primitive.Position >= 0 )
+            {
+                meshPrimitives[i].push_back( static_cast<uint32_t>( primitives.size() ) );
+                primitives.push_back( &primitive );
+            }
+        }
+    }
+
+    ImportMaterialsAndMeshes(
+        commandList, filePath.parent_path(), materialData, primitives.size(),
+        [&]( size_t i ) {
+            const Gltf::Primitive& primitive = *primitives[i];
+            return PrepareMesh( asset, primitive,
+                                primitive.Material >= 0 ? static_cast<uint32_t>( primitive.Material ) : defaultMaterial,
+                                m_GenerateMeshlets );
+        },
+        cacheWriter, filePath.filename().string() );
+
+    // The scene's root nodes are the children of the model's root node.
+    m_RootNode = std::make_shared<ModelNode>();
+    m_RootNode->SetName( filePath.stem().string() );
+    for ( const uint32_t root: asset.GetRootNodes() )
+    {
+        ImportGltfNode( asset, root, m_RootNode, meshPrimitives );
+    }
+
+    if ( cacheWriter )
+    {
+        CookNodes( *cacheWriter );
+    }
 }
 
-void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material, std::filesystem::path parentPath )
+void Model::ImportObj( CommandList& commandList, const Obj::Asset& asset, const std::filesystem::path& filePath,
+                       ModelCache::Writer* cacheWriter )
+{
+    Clear();
+
+    // Meshes without a known material use the last one, which has the default properties.
+    std::vector<MaterialData> materialData;
+    for ( const auto& material: asset.GetMaterials() )
+    {
+        materialData.push_back( PrepareMaterial( material ) );
+    }
+    const auto defaultMaterial = static_cast<uint32_t>( materialData.size() );
+    materialData.emplace_back();
+
+    const auto& meshes = asset.GetMeshes();
+    ImportMaterialsAndMeshes(
+        commandList, filePath.parent_path(), materialData, meshes.size(),
+        [&]( size_t i ) {
+            return PrepareMesh( meshes[i],
+                                meshes[i].Material >= 0 ? static_cast<uint32_t>( meshes[i].Material ) : defaultMaterial,
+                                m_GenerateMeshlets );
+        },
+        cacheWriter, filePath.filename().string() );
+
+    // A node for every group below the root node, like the Assimp import.
+    m_RootNode = std::make_shared<ModelNode>();
+    m_RootNode->SetName( filePath.stem().string() );
+
+    std::map<std::string, std::shared_ptr<ModelNode>> groupNodes;
+    for ( size_t i = 0; i < meshes.size(); ++i )
+    {
+        auto& node = groupNodes[meshes[i].Name];
+        if ( !node )
+        {
+            node = std::make_shared<ModelNode>();
+            node->SetName( meshes[i].Name );
+            node->SetParent( m_RootNode );
+        }
+
+        node->AddMesh( m_Meshes[i] );
+    }
+
+    if ( cacheWriter )
+    {
+        CookNodes( *cacheWriter );
+    }
+}
+
+void Model::ImportMaterialsAndMeshes( CommandList& commandList, const std::filesystem::path& parentPath,
+                                      std::span<const MaterialData> materialData, size_t meshCount,
+                                      const std::function<MeshData( size_t )>& prepareMesh,
+                                      ModelCache::Writer* cacheWriter, const std::string& name )
+{
+    // Everything that doesn't need the command list runs on worker threads first: the texture files
+    // are decoded while the meshes are optimized and simplified. The results are uploaded in one batch afterwards.
+    Timer importTimer;
+
+    TextureBatch                       textureBatch;
+    std::vector<std::vector<uint32_t>> textureIndices( materialData.size() );
+    for ( size_t i = 0; i < materialData.size(); ++i )
+    {
+        for ( const auto& slot: materialData[i].Textures )
+        {
+            textureIndices[i].push_back( textureBatch.Add( parentPath / slot.Path, slot.SRGB, slot.Image, slot.Data ) );
+        }
+    }
+
+    std::vector<MeshData> meshData( meshCount );
+    float                 textureMillis = 0.0f;
+    float                 meshMillis    = 0.0f;
+    concurrency::parallel_invoke(
+        [&] {
+            Timer timer;
+            textureBatch.Decode();
+            textureMillis = timer.ElapsedMillis();
+        },
+        [&] {
+            Timer timer;
+            concurrency::parallel_for( size_t( 0 ), meshCount, [&]( size_t i ) { meshData[i] = prepareMesh( i ); } );
+            meshMillis = timer.ElapsedMillis();
+        } );
+
+    const float prepareMillis = importTimer.ElapsedMillis();
+    importTimer.Reset();
+
+    // Upload the textures and assemble the materials.
+    textureBatch.Upload( commandList );
+    for ( size_t i = 0; i < materialData.size(); ++i )
+    {
+        auto pMaterial = std::make_shared<Material>( materialData[i].Properties );
+
+        // The texture file of every slot, for the cooked model.
+        std::map<Material::TextureType, ModelCache::TextureSource> textureSources;
+        for ( size_t j = 0; j < materialData[i].Textures.size(); ++j )
+        {
+            const auto& slot    = materialData[i].Textures[j];
+            const auto& texture = textureBatch.Get( textureIndices[i][j] );
+
+            // Some materials actually store normal maps in the bump map slot. Assimp can't tell the difference between
+            // these two texture types, so we try to make an assumption about whether the texture is a normal map or a
+            // bump map based on its pixel depth. Bump maps are usually 8 BPP (grayscale) and normal maps are usually
+            // 24 BPP or higher.
+            Material::TextureType textureType = slot.Type;
+            if ( slot.NormalOrBump )
+            {
+                textureType =
+                    ( texture->BitsPerPixel() >= 24 ) ? Material::TextureType::Normal : Material::TextureType::Bump;
+            }
+
+            pMaterial->SetTexture( textureType, texture );
+            textureSources[textureType] = { slot.Path, slot.SRGB, slot.Image };
+        }
+
+        // m_MaterialMap.insert( MaterialMap::value_type( materialName.C_Str(), pMaterial ) );
+        m_Materials.push_back( pMaterial );
+
+        if ( cacheWriter )
+        {
+            cacheWriter->AddMaterial( pMaterial->GetMaterialProperties(), textureSources );
+        }
+    }
+
+    // Import meshes
+    MeshOptimizer::VertexCacheStats sourceStats, optimizedStats;
+    for ( const auto& mesh: meshData )
+    {
+        ImportMesh( commandList, mesh );
+        sourceStats.Add( mesh.SourceStats );
+        optimizedStats.Add( mesh.OptimizedStats );
+
+        if ( cacheWriter )
+        {
+            cacheWriter->AddMesh( mesh.Material, mesh.AABB, std::as_bytes( std::span( mesh.Vertices ) ), mesh.Indices,
+                                  mesh.Lods, mesh.BVH.get(), mesh.Meshlets.get() );
+        }
+    }
+
+    spdlog::info( "Model {0}: prepared {1} materials, {2} textures and {3} meshes in {4:.2f} ms "
+                  "(textures {5:.2f} ms, meshes {6:.2f} ms), uploaded in {7:.2f} ms",
+                  name, materialData.size(), textureBatch.GetSize(), meshData.size(), prepareMillis, textureMillis,
+                  meshMillis, importTimer.ElapsedMillis() );
+    spdlog::info( "Model {0}: {1} triangles, ACMR {2:.3f} -> {3:.3f}, ATVR {4:.3f} -> {5:.3f}", name,
+                  optimizedStats.Triangles, sourceStats.GetAcmr(), optimizedStats.GetAcmr(), sourceStats.GetAtvr(),
+                  optimizedStats.GetAtvr() );
+}
+
+Model::MaterialData Model::PrepareMaterial( const aiMaterial& material )
 {
     aiString    materialName;
     aiString    aiTexturePath;
@@ -178,7 +726,13 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
     float       shininess;
     float       bumpIntensity;
 
-    std::shared_ptr<Material> pMaterial = std::make_shared<Material>();
+    MaterialData materialData;
+    auto         pMaterial = std::make_shared<Material>();
+
+    // The textures are loaded later, with those of the other materials.
+    auto loadTexture = [&]( Material::TextureType type, const aiString& path, bool sRGB ) {
+        materialData.Textures.push_back( { type, std::filesystem::path( path.C_Str() ), sRGB, false } );
+    };
 
     if ( material.Get( AI_MATKEY_COLOR_AMBIENT, ambientColor ) == aiReturn_SUCCESS )
     {
@@ -214,9 +768,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_AMBIENT, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::BaseColor, texture );
+        loadTexture( Material::TextureType::BaseColor, aiTexturePath, true );
     }
 
     // Load emissive textures.
@@ -224,9 +776,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_EMISSIVE, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::Emissive, texture );
+        loadTexture( Material::TextureType::Emissive, aiTexturePath, true );
     }
 
     // Load diffuse textures.
@@ -234,9 +784,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_DIFFUSE, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::BaseColor, texture );
+        loadTexture( Material::TextureType::BaseColor, aiTexturePath, true );
     }
 
     // Load specular texture.
@@ -244,9 +792,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_SPECULAR, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::Roughness, texture );
+        loadTexture( Material::TextureType::Roughness, aiTexturePath, true );
     }
 
     // Load specular power texture.
@@ -254,51 +800,35 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_SHININESS, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, false );
-        pMaterial->SetTexture( Material::TextureType::Roughness, texture );
+        loadTexture( Material::TextureType::Roughness, aiTexturePath, false );
     }
 
     if ( material.GetTextureCount( aiTextureType_OPACITY ) > 0 &&
          material.GetTexture( aiTextureType_OPACITY, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, false );
-        pMaterial->SetTexture( Material::TextureType::Opacity, texture );
+        loadTexture( Material::TextureType::Opacity, aiTexturePath, false );
     }
 
     // Load normal map texture.
     if ( material.GetTextureCount( aiTextureType_NORMALS ) > 0 &&
          material.GetTexture( aiTextureType_NORMALS, 0, &aiTexturePath ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, false );
-        pMaterial->SetTexture( Material::TextureType::Normal, texture );
+        loadTexture( Material::TextureType::Normal, aiTexturePath, false );
     }
     if ( material.GetTextureCount( aiTextureType_HEIGHT ) > 0 &&
          material.GetTexture( aiTextureType_HEIGHT, 0, &aiTexturePath ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, false );
-        pMaterial->SetTexture( Material::TextureType::Normal, texture );
+        loadTexture( Material::TextureType::Normal, aiTexturePath, false );
     }
     // Load bump map (only if there is no normal map).
     else if ( material.GetTextureCount( aiTextureType_HEIGHT ) > 0 &&
               material.GetTexture( aiTextureType_HEIGHT, 0, &aiTexturePath, nullptr, nullptr, &blendFactor ) ==
                   aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, false );
-
-        // Some materials actually store normal maps in the bump map slot. Assimp can't tell the difference between
-        // these two texture types, so we try to make an assumption about whether the texture is a normal map or a bump
-        // map based on its pixel depth. Bump maps are usually 8 BPP (grayscale) and normal maps are usually 24 BPP or
-        // higher.
-        Material::TextureType textureType =
-            ( texture->BitsPerPixel() >= 24 ) ? Material::TextureType::Normal : Material::TextureType::Bump;
-
-        pMaterial->SetTexture( textureType, texture );
+        // Told apart from a normal map once the texture is loaded.
+        materialData.Textures.push_back(
+            { Material::TextureType::Bump, std::filesystem::path( aiTexturePath.C_Str() ), false, true } );
     }
 
     // Load base color textures.
@@ -306,9 +836,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_BASE_COLOR, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::BaseColor, texture );
+        loadTexture( Material::TextureType::BaseColor, aiTexturePath, true );
     }
 
     // Load metallic textures.
@@ -316,9 +844,7 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_METALNESS, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::Metallic, texture );
+        loadTexture( Material::TextureType::Metallic, aiTexturePath, true );
     }
 
     // Load roughness textures.
@@ -326,23 +852,104 @@ void Model::ImportMaterial( CommandList& commandList, const aiMaterial& material
          material.GetTexture( aiTextureType_DIFFUSE_ROUGHNESS, 0, &aiTexturePath, nullptr, nullptr, &blendFactor,
                               &aiBlendOperation ) == aiReturn_SUCCESS )
     {
-        std::filesystem::path texturePath( aiTexturePath.C_Str() );
-        auto     texture = commandList.LoadTextureFromFile( parentPath / texturePath, true );
-        pMaterial->SetTexture( Material::TextureType::Roughness, texture );
+        loadTexture( Material::TextureType::Roughness, aiTexturePath, true );
     }
 
-    // m_MaterialMap.insert( MaterialMap::value_type( materialName.C_Str(), pMaterial ) );
-    m_Materials.push_back( pMaterial );
+    materialData.Properties = pMaterial->GetMaterialProperties();
+
+    return materialData;
 }
 
-void Model::ImportMesh( CommandList& commandList, const aiMesh& aiMesh )
+Model::MaterialData Model::PrepareMaterial( const Gltf::Material& material, std::span<const Gltf::Image> images,
+                                            const std::filesystem::path& assetPath )
 {
-    auto mesh = std::make_shared<Mesh>();
+    MaterialData materialData;
+
+    MaterialProperties& properties = materialData.Properties;
+    properties.BaseColor           = material.BaseColorFactor;
+    properties.Emissive            = glm::vec4( material.EmissiveFactor, 1.0f );
+    properties.Metallic            = material.MetallicFactor;
+    properties.Roughness           = material.RoughnessFactor;
+    properties.NormalScale         = material.NormalScale;
+    properties.Opacity             = material.Alpha == Gltf::AlphaMode::Blend ? material.BaseColorFactor.a : 1.0f;
+
+    auto addTexture = [&]( Material::TextureType type, int32_t image, bool sRGB ) {
+        if ( image < 0 )
+        {
+            return;
+        }
 
-    std::vector<VertexPositionNormalTangentBitangentTexture> vertexData( aiMesh.mNumVertices );
+        const Gltf::Image& source = images[image];
+        if ( !source.Data.empty() )
+        {
+            materialData.Textures.push_back( { type, assetPath, sRGB, false, image, source.Data } );
+        }
+        else if ( !source.Path.empty() )
+        {
+            materialData.Textures.push_back( { type, source.Path, sRGB, false } );
+        }
+    };
 
-    assert( aiMesh.mMaterialIndex < m_Materials.size() );
-    mesh->SetMaterial( m_Materials[aiMesh.mMaterialIndex] );
+    addTexture( Material::TextureType::BaseColor, material.BaseColorTexture, true );
+    // The lit shader reads roughness from green and metallic from blue when both slots hold the same texture.
+    addTexture( Material::TextureType::Metallic, material.MetallicRoughnessTexture, false );
+    addTexture( Material::TextureType::Roughness, material.MetallicRoughnessTexture, false );
+    addTexture( Material::TextureType::Normal, material.NormalTexture, false );
+    addTexture( Material::TextureType::Occlusion, material.OcclusionTexture, false );
+    addTexture( Material::TextureType::Emissive, material.EmissiveTexture, true );
+
+    return materialData;
+}
+
+Model::MaterialData Model::PrepareMaterial( const Obj::Material& material )
+{
+    // The same properties and texture slots the Assimp import gives OBJ materials.
+    MaterialData materialData;
+    auto         pMaterial = std::make_shared<Material>();
+
+    pMaterial->SetBaseColor( glm::vec4( material.Ambient, 1.0f ) );
+    pMaterial->SetEmissiveColor( glm::vec4( material.Emissive, 1.0f ) );
+    pMaterial->SetBaseColor( glm::vec4( material.Diffuse, 1.0f ) );
+    pMaterial->SetRoughness( material.Roughness >= 0.0f ? material.Roughness : material.Shininess );
+    pMaterial->SetOpacity( material.Opacity );
+    pMaterial->SetNormalScale( material.BumpScale );
+    if ( material.Metallic >= 0.0f )
+    {
+        pMaterial->SetMetallic( material.Metallic );
+    }
+
+    auto loadTexture = [&]( Material::TextureType type, const std::filesystem::path& path, bool sRGB ) {
+        if ( !path.empty() )
+        {
+            materialData.Textures.push_back( { type, path, sRGB, false } );
+        }
+    };
+
+    loadTexture( Material::TextureType::BaseColor, material.AmbientTexture, true );
+    loadTexture( Material::TextureType::Emissive, material.EmissiveTexture, true );
+    loadTexture( Material::TextureType::BaseColor, material.DiffuseTexture, true );
+    loadTexture( Material::TextureType::Roughness, material.SpecularTexture, true );
+    loadTexture( Material::TextureType::Roughness, material.ShininessTexture, false );
+    loadTexture( Material::TextureType::Opacity, material.OpacityTexture, false );
+    loadTexture( Material::TextureType::Normal, material.NormalTexture, false );
+
+    // map_bump holds height maps as often as normal maps, told apart once the texture is loaded.
+    if ( material.NormalTexture.empty() && !material.BumpTexture.empty() )
+    {
+        materialData.Textures.push_back( { Material::TextureType::Bump, material.BumpTexture, false, true } );
+    }
+
+    loadTexture( Material::TextureType::Metallic, material.MetallicTexture, true );
+    loadTexture( Material::TextureType::Roughness, material.RoughnessTexture, true );
+
+    materialData.Properties = pMaterial->GetMaterialProperties();
+
+    return materialData;
+}
+
+Model::MeshData Model::PrepareMesh( const aiMesh& aiMesh, bool generateMeshlets )
+{
+    std::vector<VertexPositionNormalTangentBitangentTexture> vertexData( aiMesh.mNumVertices );
 
     unsigned int i;
     if ( aiMesh.HasPositions() )
@@ -379,35 +986,300 @@ void Model::ImportMesh( CommandList& commandList, const aiMesh& aiMesh )
         }
     }
 
-    auto vertexBuffer = commandList.CopyVertexBuffer( vertexData );
-    mesh->SetVertexBuffer( 0, vertexBuffer );
+    // Extract the index buffer. Without positions there is nothing to optimize.
+    if ( !aiMesh.HasPositions() )
+    {
+        MeshData meshData;
+        meshData.Material = aiMesh.mMaterialIndex;
+        meshData.Vertices.assign( vertexData.begin(), vertexData.end() );
+        meshData.Indices = GetTriangleIndices( aiMesh );
+        return meshData;
+    }
 
-    // Extract the index buffer.
-    if ( aiMesh.HasFaces() )
+    return PrepareMesh( vertexData, GetTriangleIndices( aiMesh ), aiMesh.mMaterialIndex, generateMeshlets );
+}
+
+Model::MeshData Model::PrepareMesh( const Gltf::Asset& asset, const Gltf::Primitive& primitive, uint32_t material,
+                                    bool generateMeshlets )
+{
+    const auto&           accessors   = asset.GetAccessors();
+    const Gltf::Accessor& position    = accessors[primitive.Position];
+    const uint32_t        vertexCount = position.Count;
+
+    // Attributes with a different element count than the positions are ignored.
+    auto getAttribute = [&]( int32_t accessor ) -> const Gltf::Accessor* {
+        return accessor >= 0 && accessors[accessor].Count == vertexCount ? &accessors[accessor] : nullptr;
+    };
+    const Gltf::Accessor* normal   = getAttribute( primitive.Normal );
+    const Gltf::Accessor* tangent  = getAttribute( primitive.Tangent );
+    const Gltf::Accessor* texCoord = getAttribute( primitive.TexCoord );
+
+    // Read every attribute from the mapped buffers into a tightly packed array of floats.
+    RightHandedMesh mesh;
+    mesh.Positions.resize( vertexCount * 3 );
+    position.ReadFloats( mesh.Positions, 3 );
+    if ( normal )
     {
-        std::vector<unsigned int> indices;
-        for ( i = 0; i < aiMesh.mNumFaces; ++i )
+        mesh.Normals.resize( vertexCount * 3 );
+        normal->ReadFloats( mesh.Normals, 3 );
+    }
+    if ( tangent )
+    {
+        mesh.Tangents.resize( vertexCount * 4 );
+        tangent->ReadFloats( mesh.Tangents, 4 );
+    }
+    if ( texCoord )
+    {
+        mesh.TexCoords.resize( vertexCount * 2 );
+        texCoord->ReadFloats( mesh.TexCoords, 2 );
+    }
+
+    if ( primitive.Indices >= 0 )
+    {
+        mesh.Indices.resize( accessors[primitive.Indices].Count );
+        accessors[primitive.Indices].ReadIndices( mesh.Indices );
+    }
+    else
+    {
+        mesh.Indices.resize( vertexCount );
+        std::iota( mesh.Indices.begin(), mesh.Indices.end(), 0u );
+    }
+
+    return PrepareMesh( std::move( mesh ), material, generateMeshlets );
+}
+
+Model::MeshData Model::PrepareMesh( const Obj::Mesh& objMesh, uint32_t material, bool generateMeshlets )
+{
+    RightHandedMesh mesh;
+    mesh.Positions = objMesh.Positions;
+    mesh.Normals   = objMesh.Normals;
+    mesh.TexCoords = objMesh.TexCoords;
+    mesh.Indices   = objMesh.Indices;
+
+    // OBJ texture coordinates have their origin at the bottom left.
+    for ( size_t i = 1; i < mesh.TexCoords.size(); i += 2 )
+    {
+        mesh.TexCoords[i] = 1.0f - mesh.TexCoords[i];
+    }
+
+    return PrepareMesh( std::move( mesh ), material, generateMeshlets );
+}
+
+Model::MeshData Model::PrepareMesh( RightHandedMesh mesh, uint32_t material, bool generateMeshlets )
+{
+    auto& positions = mesh.Positions;
+    auto& normals   = mesh.Normals;
+    auto& tangents  = mesh.Tangents;
+    auto& texCoords = mesh.TexCoords;
+    auto& indices   = mesh.Indices;
+
+    const uint32_t vertexCount = static_cast<uint32_t>( positions.size() / 3 );
+    indices.resize( indices.size() - indices.size() % 3 );
+
+    if ( std::ranges::any_of( indices, [vertexCount]( uint32_t index ) { return index >= vertexCount; } ) )
+    {
+        spdlog::warn( "Mesh has indices out of range, its triangles are dropped" );
+        indices.clear();
+    }
+
+    auto getVec3 = []( const std::vector<float>& values, uint32_t i ) {
+        return glm::vec3( values[i * 3], values[i * 3 + 1], values[i * 3 + 2] );
+    };
+
+    // Without normals every triangle gets its own vertices with the flat normal, as glTF asks for.
+    if ( normals.empty() )
+    {
+        normals.resize( indices.size() * 3 );
+        for ( size_t i = 0; i < indices.size(); i += 3 )
         {
-            const aiFace& face = aiMesh.mFaces[i];
+            const glm::vec3 p0 = getVec3( positions, indices[i] );
+            const glm::vec3 n =
+                glm::cross( getVec3( positions, indices[i + 1] ) - p0, getVec3( positions, indices[i + 2] ) - p0 );
+            const glm::vec3 flatNormal = glm::length( n ) > 0.0f ? glm::normalize( n ) : glm::vec3( 0.0f, 1.0f, 0.0f );
+            for ( size_t j = i; j < i + 3; ++j )
+            {
+                std::copy_n( &flatNormal.x, 3, &normals[j * 3] );
+            }
+        }
 
-            // Only extract triangular faces
-            if ( face.mNumIndices == 3 )
+        auto unweld = [&]( std::vector<float>& values, uint32_t components ) {
+            if ( values.empty() )
             {
-                indices.push_back( face.mIndices[0] );
-                indices.push_back( face.mIndices[1] );
-                indices.push_back( face.mIndices[2] );
+                return;
+            }
+
+            std::vector<float> unwelded( indices.size() * components );
+            for ( size_t j = 0; j < indices.size(); ++j )
+            {
+                std::copy_n( &values[indices[j] * components], components, &unwelded[j * components] );
+            }
+            values = std::move( unwelded );
+        };
+        unweld( positions, 3 );
+        unweld( tangents, 4 );
+        unweld( texCoords, 2 );
+        std::iota( indices.begin(), indices.end(), 0u );
+    }
+
+    const uint32_t count = static_cast<uint32_t>( positions.size() / 3 );
+    texCoords.resize( count * 2 );
+
+    // Without tangents they are generated from the texture coordinates, like Assimp's CalcTangentSpace.
+    if ( tangents.empty() )
+    {
+        tangents.resize( count * 4 );
+
+        std::vector<glm::vec3> uTangents( count ), vTangents( count );
+        for ( size_t i = 0; i < indices.size(); i += 3 )
+        {
+            const uint32_t  i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+            const glm::vec3 e1  = getVec3( positions, i1 ) - getVec3( positions, i0 );
+            const glm::vec3 e2  = getVec3( positions, i2 ) - getVec3( positions, i0 );
+            const float     du1 = texCoords[i1 * 2] - texCoords[i0 * 2], dv1 = texCoords[i1 * 2 + 1] - texCoords[i0 * 2 + 1];
+            const float     du2 = texCoords[i2 * 2] - texCoords[i0 * 2], dv2 = texCoords[i2 * 2 + 1] - texCoords[i0 * 2 + 1];
+
+            const float determinant = du1 * dv2 - du2 * dv1;
+            if ( std::abs( determinant ) < 1e-12f )
+            {
+                continue;
+            }
+
+            const glm::vec3 u = ( e1 * dv2 - e2 * dv1 ) / determinant;
+            const glm::vec3 v = ( e2 * du1 - e1 * du2 ) / determinant;
+            for ( const uint32_t index: { i0, i1, i2 } )
+            {
+                uTangents[index] += u;
+                vTangents[index] += v;
+            }
+        }
+
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            const glm::vec3 n = getVec3( normals, i );
+            const glm::vec3 t = uTangents[i] - n * glm::dot( n, uTangents[i] );
+            if ( glm::length( t ) > 0.0f )
+            {
+                const glm::vec3 unitTangent = glm::normalize( t );
+                std::copy_n( &unitTangent.x, 3, &tangents[i * 4] );
+                tangents[i * 4 + 3] = glm::dot( glm::cross( n, unitTangent ), vTangents[i] ) < 0.0f ? -1.0f : 1.0f;
             }
         }
+    }
+
+    // Mirror z into the left-handed space, with the bitangent taken from the right-handed frame.
+    std::vector<VertexPositionNormalTangentBitangentTexture> vertexData( count );
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        const glm::vec3 n         = getVec3( normals, i );
+        const glm::vec3 t         = glm::vec3( tangents[i * 4], tangents[i * 4 + 1], tangents[i * 4 + 2] );
+        const glm::vec3 bitangent = glm::cross( n, t ) * ( tangents[i * 4 + 3] < 0.0f ? -1.0f : 1.0f );
+
+        auto& vertex     = vertexData[i];
+        vertex.Position  = { positions[i * 3], positions[i * 3 + 1], -positions[i * 3 + 2] };
+        vertex.Normal    = { n.x, n.y, -n.z };
+        vertex.Tangent   = { t.x, t.y, -t.z };
+        vertex.Bitangent = { bitangent.x, bitangent.y, -bitangent.z };
+        vertex.TexCoord  = { texCoords[i * 2], texCoords[i * 2 + 1], 0.0f };
+    }
+
+    // Mirroring turns the triangles around, keep the winding of the Assimp import.
+    for ( size_t i = 0; i < indices.size(); i += 3 )
+    {
+        std::swap( indices[i + 1], indices[i + 2] );
+    }
+
+    return PrepareMesh( vertexData, std::move( indices ), material, generateMeshlets );
+}
+
+Model::MeshData Model::PrepareMesh( std::span<const VertexPositionNormalTangentBitangentTexture> vertexData,
+                                    std::vector<uint32_t> triangleIndices, uint32_t material, bool generateMeshlets )
+{
+    MeshData meshData;
+    meshData.Material = material;
+
+    // Encode into the compact vertex format the lit and shadow passes read.
+    meshData.Vertices.assign( vertexData.begin(), vertexData.end() );
+    meshData.Indices = std::move( triangleIndices );
+
+    std::vector<glm::vec3> positions( vertexData.size() );
+    for ( size_t i = 0; i < vertexData.size(); ++i )
+    {
+        positions[i] = { vertexData[i].Position.x, vertexData[i].Position.y, vertexData[i].Position.z };
+    }
+
+    if ( !vertexData.empty() )
+    {
+        BoundingBox::CreateFromPoints( meshData.AABB, vertexData.size(), &vertexData[0].Position,
+                                       sizeof( VertexPositionNormalTangentBitangentTexture ) );
+    }
+
+    if ( meshData.Indices.empty() )
+    {
+        return meshData;
+    }
+
+    // Optimize the triangle order for the post-transform cache, then for overdraw, and the vertex order for fetching.
+    auto& vertices = meshData.Vertices;
+    auto& indices  = meshData.Indices;
+    meshData.SourceStats = MeshOptimizer::AnalyzeVertexCache( indices, vertices.size() );
+
+    MeshOptimizer::OptimizeVertexCache( indices, vertices.size() );
+    MeshOptimizer::OptimizeOverdraw( indices, positions );
+    MeshOptimizer::OptimizeVertexFetch( std::span<uint32_t>( indices ), vertices );
+
+    meshData.OptimizedStats = MeshOptimizer::AnalyzeVertexCache( indices, vertices.size() );
+
+    // Simplify into the levels of detail from the optimized vertices, which the levels share.
+    positions.resize( vertices.size() );
+    for ( size_t i = 0; i < vertices.size(); ++i )
+    {
+        positions[i] = { vertices[i].Position.x, vertices[i].Position.y, vertices[i].Position.z };
+    }
+
+    meshData.Lods = MeshSimplifier( positions ).BuildLodChain( indices );
+    for ( auto& lod: meshData.Lods )
+    {
+        MeshOptimizer::OptimizeVertexCache( lod.Indices, vertices.size() );
+    }
+
+    // Cluster the full detail triangles, in their cache optimized order.
+    if ( generateMeshlets )
+    {
+        meshData.Meshlets = std::make_shared<MeshletData>( BuildMeshlets( indices, positions ) );
+    }
+
+    // Build the triangle BVH for CPU ray queries from the same data.
+    meshData.BVH = std::make_shared<TriangleBVH>( positions, indices );
+
+    return meshData;
+}
+
+void Model::ImportMesh( CommandList& commandList, const MeshData& meshData )
+{
+    auto mesh = std::make_shared<Mesh>();
+
+    assert( meshData.Material < m_Materials.size() );
+    mesh->SetMaterial( m_Materials[meshData.Material] );
+
+    auto vertexBuffer = commandList.CopyVertexBuffer( meshData.Vertices );
+    mesh->SetVertexBuffer( 0, vertexBuffer );
 
-        if ( indices.size() > 0 )
+    const auto& indices = meshData.Indices;
+    if ( !indices.empty() )
+    {
+        auto indexBuffer = commandList.CopyIndexBuffer( indices );
+        mesh->SetIndexBuffer( indexBuffer );
+
+        // The simplified levels index into the same vertex buffer.
+        for ( const auto& lod: meshData.Lods )
         {
-            auto indexBuffer = commandList.CopyIndexBuffer( indices );
-            mesh->SetIndexBuffer( indexBuffer );
+            mesh->AddLod( commandList.CopyIndexBuffer( lod.Indices ), lod.Error );
         }
     }
 
-    // Set the AABB from the AI Mesh's AABB.
-    mesh->SetAABB( CreateBoundingBox( aiMesh.mAABB ) );
+    mesh->SetAABB( meshData.AABB );
+    mesh->SetTriangleBVH( meshData.BVH );
+    mesh->SetMeshlets( meshData.Meshlets );
 
     m_Meshes.push_back( mesh );
 }
@@ -446,6 +1318,46 @@ std::shared_ptr<ModelNode> Model::ImportSceneNode( CommandList& commandList, std
     return node;
 }
 
+void Model::ImportGltfNode( const Gltf::Asset& asset, uint32_t index, const std::shared_ptr<ModelNode>& parent,
+                            const std::vector<std::vector<uint32_t>>& meshPrimitives )
+{
+    const Gltf::Node& gltfNode = asset.GetNodes()[index];
+
+    // Mirror z of the transform like the vertices, the entries that mix z with x, y or w change sign.
+    XMFLOAT4X4 localTransform = gltfNode.LocalTransform;
+    for ( int i = 0; i < 4; ++i )
+    {
+        if ( i != 2 )
+        {
+            localTransform.m[i][2] = -localTransform.m[i][2];
+            localTransform.m[2][i] = -localTransform.m[2][i];
+        }
+    }
+
+    auto node = std::make_shared<ModelNode>( XMLoadFloat4x4( &localTransform ) );
+    if ( !gltfNode.Name.empty() )
+    {
+        node->SetName( gltfNode.Name );
+    }
+
+    // Adding a child keeps its world transform, restore the local one.
+    node->SetParent( parent );
+    node->SetLocalTransform( XMLoadFloat4x4( &localTransform ) );
+
+    if ( gltfNode.Mesh >= 0 )
+    {
+        for ( const uint32_t mesh: meshPrimitives[gltfNode.Mesh] )
+        {
+            node->AddMesh( m_Meshes[mesh] );
+        }
+    }
+
+    for ( const uint32_t child: gltfNode.Children )
+    {
+        ImportGltfNode( asset, child, node, meshPrimitives );
+    }
+}
+
 void Model::Accept( Visitor& visitor )
 {
     // visitor.Visit( *this );
@@ -455,6 +1367,83 @@ void Model::Accept( Visitor& visitor )
     }
 }
 
+const std::vector<Mesh*>& Model::GetFlattenedMeshes()
+{
+    if ( !m_FlattenedMeshesValid )
+    {
+        m_FlattenedMeshes.clear();
+        m_FlattenedNodes.clear();
+
+        if ( m_RootNode )
+            FlattenNode( *m_RootNode );
+
+        m_FlattenedMeshesValid = true;
+    }
+
+    return m_FlattenedMeshes;
+}
+
+const std::vector<Model::FlattenedNode>& Model::GetFlattenedNodes()
+{
+    GetFlattenedMeshes();
+    return m_FlattenedNodes;
+}
+
+void Model::FlattenNode( const ModelNode& node )
+{
+    const size_t nodeIndex = m_FlattenedNodes.size();
+    m_FlattenedNodes.push_back( {} );
+
+    const uint32_t meshBegin = static_cast<uint32_t>( m_FlattenedMeshes.size() );
+    for ( const auto& mesh: node.GetMeshes() )
+        m_FlattenedMeshes.push_back( mesh.get() );
+    const uint32_t ownMeshEnd = static_cast<uint32_t>( m_FlattenedMeshes.size() );
+
+    for ( const auto& child: node.GetChildren() )
+        FlattenNode( *child );
+
+    // Merge the bounds of the whole subtree, an empty subtree keeps a zero sized box.
+    FlattenedNode& flattened = m_FlattenedNodes[nodeIndex];
+    flattened.SubtreeAABB    = BoundingBox( { 0, 0, 0 }, { 0, 0, 0 } );
+    flattened.MeshBegin      = meshBegin;
+    flattened.OwnMeshEnd     = ownMeshEnd;
+    flattened.MeshEnd        = static_cast<uint32_t>( m_FlattenedMeshes.size() );
+    flattened.SubtreeEnd     = static_cast<uint32_t>( m_FlattenedNodes.size() );
+
+    for ( uint32_t i = meshBegin; i < flattened.MeshEnd; ++i )
+    {
+        if ( i == meshBegin )
+            flattened.SubtreeAABB = m_FlattenedMeshes[i]->GetAABB();
+        else
+            BoundingBox::CreateMerged( flattened.SubtreeAABB, flattened.SubtreeAABB, m_FlattenedMeshes[i]->GetAABB() );
+    }
+}
+
+void Model::CookNode( ModelCache::Writer& cacheWriter, const ModelNode& node, int32_t parent,
+                      const std::unordered_map<const Mesh*, uint32_t>& meshIndices ) const
+{
+    std::vector<uint32_t> meshes;
+    for ( const auto& mesh: node.GetMeshes() )
+    {
+        const auto iter = meshIndices.find( mesh.get() );
+        assert( iter != meshIndices.end() );
+        meshes.push_back( iter->second );
+    }
+
+    const auto index = static_cast<int32_t>( cacheWriter.AddNode( node.GetLocalTransform(), node.GetName(), parent, meshes ) );
+    for ( const auto& child: node.GetChildren() )
+        CookNode( cacheWriter, *child, index, meshIndices );
+}
+
+void Model::CookNodes( ModelCache::Writer& cacheWriter ) const
+{
+    std::unordered_map<const Mesh*, uint32_t> meshIndices;
+    for ( uint32_t i = 0; i < m_Meshes.size(); ++i )
+        meshIndices[m_Meshes[i].get()] = i;
+
+    CookNode( cacheWriter, *m_RootNode, -1, meshIndices );
+}
+
 DirectX::BoundingBox Model::GetAABB() const
 {
     DirectX::BoundingBox aabb { { 0, 0, 0 }, { 0, 0, 0 } };
@@ -30,6 +30,12 @@
  *  @brief Model file for storing scene data.
  */
 
+#include "RHI/VertexTypes.h"
+#include "Material.h"
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
 #include <DirectXCollision.h> // For DirectX::BoundingBox
 #include <map>
 
@@ -44,18 +50,68 @@ class CommandList;
 class Device;
 class ModelNode;
 class Mesh;
-class Material;
+class TriangleBVH;
 class Visitor;
 
+namespace Gltf
+{
+class Asset;
+struct Image;
+struct Material;
+struct Primitive;
+}  // namespace Gltf
+
+namespace Obj
+{
+class Asset;
+struct Material;
+struct Mesh;
+}  // namespace Obj
+
+namespace ModelCache
+{
+class Writer;
+}
+
 class Model
 {
 public:
+    /**
+     * A model node in depth-first order. The meshes of the node's subtree are the
+     * contiguous range [MeshBegin, MeshEnd) of the flattened meshes, the node's own
+     * meshes come first and end at OwnMeshEnd. SubtreeEnd is the index of the
+     * first node after the subtree, so a culled subtree is skipped with one jump.
+     */
+    struct FlattenedNode
+    {
+        DirectX::BoundingBox SubtreeAABB;
+        uint32_t             MeshBegin;
+        uint32_t             OwnMeshEnd;
+        uint32_t             MeshEnd;
+        uint32_t             SubtreeEnd;
+    };
+
     Model()  = default;
     ~Model() = default;
 
+    /**
+     * Split the meshes of the next loaded models into meshlets for cluster culling, enabled by default.
+     */
+    void SetGenerateMeshlets( bool generateMeshlets )
+    {
+        m_GenerateMeshlets = generateMeshlets;
+    }
+    bool GetGenerateMeshlets() const
+    {
+        return m_GenerateMeshlets;
+    }
+
     void SetRootNode( std::shared_ptr<ModelNode> node )
     {
         m_RootNode = node;
+        m_FlattenedMeshes.clear();
+        m_FlattenedNodes.clear();
+        m_FlattenedMeshesValid = false;
     }
 
     std::shared_ptr<ModelNode> GetRootNode() const
@@ -69,6 +125,20 @@ public:
      */
     DirectX::BoundingBox GetAABB() const;
 
+    /**
+     * Get the meshes of all model nodes in depth-first order, matching the order
+     * in which Accept visits them. A mesh referenced by several nodes appears once per node.
+     * The list is built on first use and rebuilt after the root node changes.
+     */
+    const std::vector<Mesh*>& GetFlattenedMeshes();
+
+    /**
+     * Get the model nodes in the same depth-first order as GetFlattenedMeshes.
+     * The subtree AABBs are merged from the mesh AABBs in mesh space, which is the
+     * space the meshes are drawn in.
+     */
+    const std::vector<FlattenedNode>& GetFlattenedNodes();
+
     /**
      * Accept a visitor.
      * This will first visit the scene, then it will visit the root node of the scene.
@@ -79,7 +149,9 @@ protected:
     friend class CommandList;
 
     /**
-     * Load a scene from a file on disc.
+     * Load a scene from a file on disc. glTF and OBJ files are read directly, other formats are imported with Assimp.
+     * The imported model is cooked next to the file, later loads read the cooked model as long as
+     * the AssetDatabase finds the file, the files it references and the import settings unchanged.
      */
     bool LoadModelFromFile( CommandList& commandList, const std::wstring& fileName,
                             const std::function<bool( float )>& loadingProgress );
@@ -95,11 +167,121 @@ protected:
     bool LoadModelFromString( CommandList& commandList, const std::string& sceneStr, const std::string& format );
 
 private:
-    void ImportModel( CommandList& commandList, const aiScene& scene, std::filesystem::path parentPath );
-    void ImportMaterial( CommandList& commandList, const aiMaterial& material, std::filesystem::path parentPath );
-    void ImportMesh( CommandList& commandList, const aiMesh& mesh );
+    void Clear();
+    /**
+     * Load a cooked model, fails without changing the model when there is none or it is invalid.
+     * Whether it is up to date is checked by the AssetDatabase.
+     */
+    bool LoadCookedModel( CommandList& commandList, const std::filesystem::path& cookedPath,
+                          const std::filesystem::path& parentPath );
+
+    /**
+     * Import an Assimp scene, cacheWriter collects the imported model for the model cache when not null.
+     */
+    void ImportModel( CommandList& commandList, const aiScene& scene, std::filesystem::path parentPath,
+                      ModelCache::Writer* cacheWriter = nullptr );
+    /**
+     * Import a glTF asset without going through Assimp. Every triangle primitive becomes a mesh,
+     * the model is converted to the left-handed coordinates the Assimp import produces.
+     */
+    void ImportGltf( CommandList& commandList, const Gltf::Asset& asset, const std::filesystem::path& filePath,
+                     ModelCache::Writer* cacheWriter );
+    /**
+     * Import a Wavefront OBJ file without going through Assimp. Every group and material becomes a mesh.
+     */
+    void ImportObj( CommandList& commandList, const Obj::Asset& asset, const std::filesystem::path& filePath,
+                    ModelCache::Writer* cacheWriter );
+    /**
+     * The properties of a material and the texture files of its slots. Prepared on worker threads,
+     * the textures are loaded for all materials together so every file is decoded only once.
+     */
+    struct MaterialData
+    {
+        struct TextureSlot
+        {
+            Material::TextureType Type;
+            // Relative to the directory of the model
+            std::filesystem::path Path;
+            bool                  SRGB;
+            // The texture is a normal map or a bump map, told apart by its bits per pixel
+            bool NormalOrBump;
+            // An image embedded in the glTF file at Path, -1 for image files
+            int32_t                    Image = -1;
+            std::span<const std::byte> Data;
+        };
+
+        MaterialProperties Properties;
+        // Later slots of the same type replace earlier ones
+        std::vector<TextureSlot> Textures;
+    };
+
+    static MaterialData PrepareMaterial( const aiMaterial& material );
+    static MaterialData PrepareMaterial( const Gltf::Material& material, std::span<const Gltf::Image> images,
+                                         const std::filesystem::path& assetPath );
+    static MaterialData PrepareMaterial( const Obj::Material& material );
+    /**
+     * Vertex and index data of a mesh, optimized for the GPU with its levels of detail.
+     * Prepared on worker threads as it doesn't need the command list.
+     */
+    struct MeshData
+    {
+        std::vector<VertexPositionQTangentTexture> Vertices;
+        std::vector<uint32_t>                      Indices;
+        std::vector<MeshSimplifier::Lod>           Lods;
+        uint32_t                                   Material = 0;
+        DirectX::BoundingBox                       AABB;
+        // Triangle BVH over the vertex positions for the CPU side, null for meshes without triangles
+        std::shared_ptr<TriangleBVH> BVH;
+        // Null when meshlets aren't generated
+        std::shared_ptr<const MeshletData> Meshlets;
+
+        // Post-transform cache statistics of the imported and of the optimized triangle order
+        MeshOptimizer::VertexCacheStats SourceStats;
+        MeshOptimizer::VertexCacheStats OptimizedStats;
+    };
+
+    static MeshData PrepareMesh( const aiMesh& mesh, bool generateMeshlets );
+    static MeshData PrepareMesh( const Gltf::Asset& asset, const Gltf::Primitive& primitive, uint32_t material,
+                                 bool generateMeshlets );
+    static MeshData PrepareMesh( const Obj::Mesh& mesh, uint32_t material, bool generateMeshlets );
+    /**
+     * Tightly packed attributes of a triangle list in a right-handed space, as glTF and OBJ files store them,
+     * with the texture origin at the top left. Normals, tangents and texture coordinates are empty when missing.
+     */
+    struct RightHandedMesh
+    {
+        std::vector<float>    Positions;
+        std::vector<float>    Normals;
+        std::vector<float>    Tangents;
+        std::vector<float>    TexCoords;
+        std::vector<uint32_t> Indices;
+    };
+    /**
+     * Generate the missing normals and tangents, then mirror the mesh into the left-handed space.
+     */
+    static MeshData PrepareMesh( RightHandedMesh mesh, uint32_t material, bool generateMeshlets );
+    /**
+     * Encode, optimize and simplify a triangle list, the common part of every import.
+     */
+    static MeshData PrepareMesh( std::span<const VertexPositionNormalTangentBitangentTexture> vertices,
+                                 std::vector<uint32_t> indices, uint32_t material, bool generateMeshlets );
+    /**
+     * Decode the textures of the materials while prepareMesh runs for every mesh on worker threads,
+     * then upload the textures, materials and meshes in order.
+     */
+    void ImportMaterialsAndMeshes( CommandList& commandList, const std::filesystem::path& parentPath,
+                                   std::span<const MaterialData> materialData, size_t meshCount,
+                                   const std::function<MeshData( size_t )>& prepareMesh,
+                                   ModelCache::Writer* cacheWriter, const std::string& name );
+    void ImportMesh( CommandList& commandList, const MeshData& meshData );
     std::shared_ptr<ModelNode> ImportSceneNode( CommandList& commandList, std::shared_ptr<ModelNode> parent,
                                                 const aiNode* aiNode );
+    void ImportGltfNode( const Gltf::Asset& asset, uint32_t index, const std::shared_ptr<ModelNode>& parent,
+                         const std::vector<std::vector<uint32_t>>& meshPrimitives );
+    void FlattenNode( const ModelNode& node );
+    void CookNode( ModelCache::Writer& cacheWriter, const ModelNode& node, int32_t parent,
+                   const std::unordered_map<const Mesh*, uint32_t>& meshIndices ) const;
+    void CookNodes( ModelCache::Writer& cacheWriter ) const;
 
     using MaterialMap  = std::map<std::string, std::shared_ptr<Material>>;
     using MaterialList = std::vector<std::shared_ptr<Material>>;
@@ -111,6 +293,12 @@ private:
 
     std::shared_ptr<ModelNode> m_RootNode;
 
+    std::vector<Mesh*>         m_FlattenedMeshes;
+    std::vector<FlattenedNode> m_FlattenedNodes;
+    bool                       m_FlattenedMeshesValid = false;
+
+    bool m_GenerateMeshlets = true;
+
     std::wstring m_SceneFile;
 };
 }  // namespace Akari
\ No newline at end of file
@@ -0,0 +1,385 @@
+#include "pch.h"
+#include "ModelCache.h"
+
+#include "RHI/VertexTypes.h"
+#include "MappedFile.h"
+#include "Meshlets.h"
+#include "TriangleBVH.h"
+
+namespace Akari::ModelCache
+{
+    namespace
+    {
+        bool AllBelow(std::span<const uint32_t> values, uint64_t count)
+        {
+            return std::ranges::all_of(values, [count](const uint32_t value) { return value < count; });
+        }
+
+        // Every node is reached once from the root, children come after their parent, leaves stay inside the triangle
+        // order and no path is deeper than the traversal stack of TriangleBVH::Intersect
+        bool IsValidBVH(std::span<const TriangleBVH::Node> nodes, uint64_t triangleCount)
+        {
+            if (nodes.empty())
+                return true;
+
+            std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0u, 0u } };
+            size_t visited = 0;
+            while (!stack.empty())
+            {
+                const auto [index, depth] = stack.back();
+                stack.pop_back();
+                if (++visited > nodes.size() || depth >= TriangleBVH::MaxDepth)
+                    return false;
+
+                const TriangleBVH::Node& node = nodes[index];
+                if (node.Count > 0)
+                {
+                    if (static_cast<uint64_t>(node.LeftOrFirst) + node.Count > triangleCount)
+                        return false;
+                    continue;
+                }
+
+                if (node.LeftOrFirst <= index || static_cast<uint64_t>(node.LeftOrFirst) + 1 >= nodes.size())
+                    return false;
+
+                stack.emplace_back(node.LeftOrFirst, depth + 1);
+                stack.emplace_back(node.LeftOrFirst + 1, depth + 1);
+            }
+
+            return true;
+        }
+
+        bool IsValidMeshlets(std::span<const Meshlet> meshlets, std::span<const uint32_t> vertices,
+                             std::span<const uint8_t> triangles, uint64_t vertexCount)
+        {
+            if (!AllBelow(vertices, vertexCount))
+                return false;
+
+            for (const Meshlet& meshlet : meshlets)
+            {
+                if (meshlet.VertexCount > Meshlet::MaxVertices || meshlet.TriangleCount > Meshlet::MaxTriangles ||
+                    static_cast<uint64_t>(meshlet.VertexOffset) + meshlet.VertexCount > vertices.size() ||
+                    static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount * 3ull > triangles.size())
+                    return false;
+
+                const auto corners = triangles.subspan(meshlet.TriangleOffset, meshlet.TriangleCount * 3ull);
+                if (!std::ranges::all_of(corners, [&](const uint8_t corner) { return corner < meshlet.VertexCount; }))
+                    return false;
+            }
+
+            return true;
+        }
+    }
+
+    template <typename T>
+    Blob Writer::AddBlob(std::span<const T> data)
+    {
+        if (data.empty())
+            return {};
+
+        const uint64_t offset = (m_Data.size() + Alignment - 1) & ~(Alignment - 1);
+        m_Data.resize(offset + data.size_bytes());
+        std::memcpy(m_Data.data() + offset, data.data(), data.size_bytes());
+
+        return { offset, data.size_bytes() };
+    }
+
+    StringRef Writer::AddString(std::string_view string)
+    {
+        const StringRef ref{ static_cast<uint32_t>(m_Strings.size()), static_cast<uint32_t>(string.size()) };
+        m_Strings.append(string);
+        return ref;
+    }
+
+    void Writer::AddMaterial(const MaterialProperties& properties, const std::map<Material::TextureType, TextureSource>& textures)
+    {
+        MaterialRecord& material = m_Materials.emplace_back();
+        material.Properties = properties;
+        material.TextureBegin = static_cast<uint32_t>(m_Textures.size());
+        material.TextureCount = static_cast<uint32_t>(textures.size());
+
+        for (const auto& [type, source] : textures)
+        {
+            m_TexturePaths.push_back(source.Path);
+
+            const std::u8string path = source.Path.generic_u8string();
+            m_Textures.push_back({ type, source.SRGB ? 1u : 0u,
+                                   AddString({ reinterpret_cast<const char*>(path.data()), path.size() }), source.Image });
+        }
+    }
+
+    void Writer::AddMesh(uint32_t material, const DirectX::BoundingBox& aabb, std::span<const std::byte> vertices,
+                         std::span<const uint32_t> indices, std::span<const MeshSimplifier::Lod> lods,
+                         const TriangleBVH* bvh, const MeshletData* meshlets)
+    {
+        MeshRecord mesh{};
+        mesh.Material = material;
+        mesh.AABBCenter = aabb.Center;
+        mesh.AABBExtents = aabb.Extents;
+        mesh.Vertices = AddBlob(vertices);
+        mesh.Indices = AddBlob(indices);
+
+        mesh.LodBegin = static_cast<uint32_t>(m_Lods.size());
+        mesh.LodCount = static_cast<uint32_t>(lods.size());
+        for (const auto& lod : lods)
+            m_Lods.push_back({ AddBlob(std::span<const uint32_t>(lod.Indices)), lod.Error });
+
+        if (bvh)
+        {
+            mesh.Positions = AddBlob(bvh->GetPositions());
+            mesh.BVHNodes = AddBlob(bvh->GetNodes());
+            mesh.BVHTriangleOrder = AddBlob(bvh->GetTriangleOrder());
+        }
+
+        if (meshlets)
+        {
+            mesh.Meshlets = AddBlob(std::span<const Meshlet>(meshlets->Meshlets));
+            mesh.MeshletBounds = AddBlob(std::span<const MeshletBounds>(meshlets->Bounds));
+            mesh.MeshletVertices = AddBlob(std::span<const uint32_t>(meshlets->Vertices));
+            mesh.MeshletTriangles = AddBlob(std::span<const uint8_t>(meshlets->Triangles));
+        }
+
+        m_Meshes.push_back(mesh);
+    }
+
+    uint32_t Writer::AddNode(const DirectX::XMMATRIX& localTransform, std::string_view name, int32_t parent, std::span<const uint32_t> meshes)
+    {
+        assert(parent < static_cast<int32_t>(m_Nodes.size()));
+
+        NodeRecord record{};
+        DirectX::XMStoreFloat4x4(&record.LocalTransform, localTransform);
+        record.Parent = parent;
+        record.Name = AddString(name);
+        record.MeshBegin = static_cast<uint32_t>(m_NodeMeshes.size());
+        record.MeshCount = static_cast<uint32_t>(meshes.size());
+        m_NodeMeshes.insert(m_NodeMeshes.end(), meshes.begin(), meshes.end());
+        m_Nodes.push_back(record);
+
+        return static_cast<uint32_t>(m_Nodes.size()) - 1;
+    }
+
+    bool Writer::Save(const std::filesystem::path& path) const
+    {
+        // The record tables follow the array data, the header goes in front of it
+        uint64_t end = m_Data.size();
+        auto placeTable = [&end](const auto& table)
+        {
+            const Blob blob{ (end + Alignment - 1) & ~(Alignment - 1), table.size() * sizeof(table[0]) };
+            if (blob.Size == 0)
+                return Blob{};
+
+            end = blob.Offset + blob.Size;
+            return blob;
+        };
+
+        Header header{};
+        header.Magic = Magic;
+        header.Version = Version;
+        header.VertexStride = sizeof(VertexPositionQTangentTexture);
+        header.Materials = placeTable(m_Materials);
+        header.Textures = placeTable(m_Textures);
+        header.Meshes = placeTable(m_Meshes);
+        header.Lods = placeTable(m_Lods);
+        header.Nodes = placeTable(m_Nodes);
+        header.NodeMeshes = placeTable(m_NodeMeshes);
+        header.Strings = placeTable(m_Strings);
+
+        std::error_code error;
+        std::filesystem::path tempPath = path;
+        tempPath += L".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            auto write = [&file](const void* data, uint64_t size)
+            {
+                file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            };
+            auto writeTable = [&](const Blob& blob, const void* data)
+            {
+                if (blob.Size == 0)
+                    return;
+
+                static constexpr std::array<char, Alignment> padding{};
+                write(padding.data(), blob.Offset - static_cast<uint64_t>(file.tellp()));
+                write(data, blob.Size);
+            };
+
+            write(&header, sizeof(Header));
+            write(m_Data.data() + sizeof(Header), m_Data.size() - sizeof(Header));
+            writeTable(header.Materials, m_Materials.data());
+            writeTable(header.Textures, m_Textures.data());
+            writeTable(header.Meshes, m_Meshes.data());
+            writeTable(header.Lods, m_Lods.data());
+            writeTable(header.Nodes, m_Nodes.data());
+            writeTable(header.NodeMeshes, m_NodeMeshes.data());
+            writeTable(header.Strings, m_Strings.data());
+
+            if (!file)
+            {
+                file.close();
+                std::filesystem::remove(tempPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+        return true;
+    }
+
+    MappedModel::MappedModel() = default;
+
+    MappedModel::~MappedModel() = default;
+
+    bool MappedModel::Open(const std::filesystem::path& path)
+    {
+        m_File = std::make_unique<MappedFile>(path);
+        m_Data = reinterpret_cast<const std::byte*>(m_File->GetData());
+        m_Size = m_File->GetSize();
+
+        if (!m_Data || m_Size < sizeof(Header) || !Validate())
+        {
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void MappedModel::Close()
+    {
+        m_File.reset();
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+    std::string_view MappedModel::GetString(const StringRef& string) const
+    {
+        const auto strings = Get<char>(GetHeader().Strings);
+        return { strings.data() + string.Offset, string.Length };
+    }
+
+    template <typename T>
+    bool MappedModel::IsValid(const Blob& blob) const
+    {
+        if (blob.Size == 0)
+            return true;
+
+        return blob.Offset % Alignment == 0 && blob.Size % sizeof(T) == 0 && blob.Offset <= m_Size && blob.Size <= m_Size - blob.Offset;
+    }
+
+    bool MappedModel::IsValid(const StringRef& string) const
+    {
+        return static_cast<uint64_t>(string.Offset) + string.Length <= GetHeader().Strings.Size;
+    }
+
+    bool MappedModel::IsValidMesh(const MeshRecord& mesh, std::span<const LodRecord> lods) const
+    {
+        const uint64_t vertexCount = mesh.Vertices.Size / sizeof(VertexPositionQTangentTexture);
+        const auto indices = Get<uint32_t>(mesh.Indices);
+        if (indices.size() % 3 != 0 || !AllBelow(indices, vertexCount))
+            return false;
+
+        for (const auto& lod : lods.subspan(mesh.LodBegin, mesh.LodCount))
+        {
+            const auto lodIndices = Get<uint32_t>(lod.Indices);
+            if (lodIndices.size() % 3 != 0 || !AllBelow(lodIndices, vertexCount))
+                return false;
+        }
+
+        // The BVH indexes its positions with the mesh's indices
+        if (mesh.Positions.Size > 0)
+        {
+            const uint64_t triangleCount = indices.size() / 3;
+            if (mesh.Positions.Size / sizeof(glm::vec3) != vertexCount ||
+                !AllBelow(Get<uint32_t>(mesh.BVHTriangleOrder), triangleCount) ||
+                !IsValidBVH(Get<TriangleBVH::Node>(mesh.BVHNodes), triangleCount))
+                return false;
+        }
+
+        return IsValidMeshlets(Get<Meshlet>(mesh.Meshlets), Get<uint32_t>(mesh.MeshletVertices),
+                               Get<uint8_t>(mesh.MeshletTriangles), vertexCount);
+    }
+
+    bool MappedModel::Validate() const
+    {
+        const Header& header = GetHeader();
+        if (header.Magic != Magic || header.Version != Version || header.VertexStride != sizeof(VertexPositionQTangentTexture))
+            return false;
+
+        if (!IsValid<MaterialRecord>(header.Materials) || !IsValid<TextureRecord>(header.Textures) ||
+            !IsValid<MeshRecord>(header.Meshes) || !IsValid<LodRecord>(header.Lods) || !IsValid<NodeRecord>(header.Nodes) ||
+            !IsValid<uint32_t>(header.NodeMeshes) || !IsValid<char>(header.Strings))
+            return false;
+
+        const auto materials = Get<MaterialRecord>(header.Materials);
+        const auto textures = Get<TextureRecord>(header.Textures);
+        const auto meshes = Get<MeshRecord>(header.Meshes);
+        const auto lods = Get<LodRecord>(header.Lods);
+        const auto nodes = Get<NodeRecord>(header.Nodes);
+        const auto nodeMeshes = Get<uint32_t>(header.NodeMeshes);
+
+        for (const auto& material : materials)
+        {
+            if (static_cast<uint64_t>(material.TextureBegin) + material.TextureCount > textures.size())
+                return false;
+        }
+
+        for (const auto& texture : textures)
+        {
+            if (texture.Type >= Material::TextureType::NumTypes || !IsValid(texture.Path) || texture.Image < -1)
+                return false;
+        }
+
+        for (const auto& mesh : meshes)
+        {
+            if (mesh.Material >= materials.size() || static_cast<uint64_t>(mesh.LodBegin) + mesh.LodCount > lods.size())
+                return false;
+
+            if (!IsValid<VertexPositionQTangentTexture>(mesh.Vertices) || !IsValid<uint32_t>(mesh.Indices) ||
+                !IsValid<glm::vec3>(mesh.Positions) || !IsValid<TriangleBVH::Node>(mesh.BVHNodes) ||
+                !IsValid<uint32_t>(mesh.BVHTriangleOrder) || !IsValid<Meshlet>(mesh.Meshlets) ||
+                !IsValid<MeshletBounds>(mesh.MeshletBounds) || !IsValid<uint32_t>(mesh.MeshletVertices) ||
+                !IsValid<uint8_t>(mesh.MeshletTriangles))
+                return false;
+
+            if (mesh.Meshlets.Size / sizeof(Meshlet) != mesh.MeshletBounds.Size / sizeof(MeshletBounds) ||
+                mesh.BVHTriangleOrder.Size / sizeof(uint32_t) != (mesh.Positions.Size > 0 ? mesh.Indices.Size / sizeof(uint32_t) / 3 : 0))
+                return false;
+        }
+
+        for (const auto& lod : lods)
+        {
+            if (!IsValid<uint32_t>(lod.Indices))
+                return false;
+        }
+
+        // The blobs fit in the file, now every index has to stay inside what it indexes. A cache is derived from the
+        // source file and can be stale or damaged, so nothing it stores is trusted by the GPU upload or the BVH.
+        for (const auto& mesh : meshes)
+        {
+            if (!IsValidMesh(mesh, lods))
+                return false;
+        }
+
+        if (nodes.empty())
+            return false;
+
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const NodeRecord& node = nodes[i];
+            if ((i == 0) != (node.Parent < 0) || node.Parent >= static_cast<int64_t>(i) || !IsValid(node.Name) ||
+                static_cast<uint64_t>(node.MeshBegin) + node.MeshCount > nodeMeshes.size())
+                return false;
+        }
+
+        return std::ranges::all_of(nodeMeshes, [&](const uint32_t mesh) { return mesh < meshes.size(); });
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <map>
+#include <span>
+#include <string_view>
+#include <DirectXCollision.h>
+
+#include "Material.h"
+#include "MeshSimplifier.h"
+
+namespace Akari
+{
+    class MappedFile;
+    class TriangleBVH;
+    struct MeshletData;
+}
+
+// Engine-native cooked model: the vertex and index buffers of every mesh in their final GPU format with the levels
+// of detail, meshlets and triangle BVH, the node hierarchy and the materials with the texture files they use.
+// Whether a cooked model is still current is tracked by the AssetDatabase.
+// Every array is stored at a 16 byte aligned offset from the start of the file, so a memory mapped file is read in place
+// and the buffers are handed to the upload without touching the vertices.
+namespace Akari::ModelCache
+{
+    // "AKMC"
+    constexpr uint32_t Magic = 0x434d4b41;
+    // Bump when the layout of the file or of any stored type changes, or the import gives different results.
+    // The version is part of the import settings, so cooked models of other versions are rebuilt.
+    constexpr uint32_t Version = 3;
+    constexpr uint64_t Alignment = 16;
+    constexpr const wchar_t* Extension = L".akmodel";
+
+    // Byte range of an array, relative to the start of the file
+    struct Blob
+    {
+        uint64_t Offset = 0;
+        uint64_t Size = 0;
+    };
+
+    // UTF-8 characters in the string table
+    struct StringRef
+    {
+        uint32_t Offset = 0;
+        uint32_t Length = 0;
+    };
+
+    struct Header
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        // Size of the stored vertex type, detects a changed vertex format
+        uint32_t VertexStride;
+        uint32_t Padding;
+
+        Blob Materials;   // MaterialRecord
+        Blob Textures;    // TextureRecord
+        Blob Meshes;      // MeshRecord
+        Blob Lods;        // LodRecord
+        Blob Nodes;       // NodeRecord in depth-first order, parents before their children
+        Blob NodeMeshes;  // uint32_t mesh index
+        Blob Strings;     // char
+    };
+
+    struct MaterialRecord
+    {
+        MaterialProperties Properties;
+        uint32_t TextureBegin;
+        uint32_t TextureCount;
+    };
+
+    struct TextureRecord
+    {
+        Material::TextureType Type;
+        uint32_t SRGB;
+        // Relative to the directory of the model
+        StringRef Path;
+        // Index of an image embedded in the glTF file at Path, -1 for image files
+        int32_t Image;
+    };
+
+    struct MeshRecord
+    {
+        uint32_t Material;
+        uint32_t LodBegin;
+        uint32_t LodCount;
+        DirectX::XMFLOAT3 AABBCenter;
+        DirectX::XMFLOAT3 AABBExtents;
+
+        Blob Vertices;          // VertexPositionQTangentTexture
+        Blob Indices;           // uint32_t
+        // The CPU side copy of the vertex positions and the triangle BVH built over them, empty without triangles
+        Blob Positions;         // glm::vec3
+        Blob BVHNodes;          // TriangleBVH::Node
+        Blob BVHTriangleOrder;  // uint32_t
+        // Empty when meshlets weren't generated
+        Blob Meshlets;          // Meshlet
+        Blob MeshletBounds;     // MeshletBounds
+        Blob MeshletVertices;   // uint32_t
+        Blob MeshletTriangles;  // uint8_t
+    };
+
+    struct LodRecord
+    {
+        Blob Indices;  // uint32_t
+        float Error;
+    };
+
+    struct NodeRecord
+    {
+        DirectX::XMFLOAT4X4 LocalTransform;
+        // -1 for the root
+        int32_t Parent;
+        StringRef Name;
+        uint32_t MeshBegin;
+        uint32_t MeshCount;
+    };
+
+    // A texture file of a material slot, relative to the directory of the model
+    struct TextureSource
+    {
+        std::filesystem::path Path;
+        bool SRGB = false;
+        // Index of an image embedded in the glTF file at Path, -1 for image files
+        int32_t Image = -1;
+    };
+
+    // Collects a model while it is imported and writes it as a cooked model
+    class Writer
+    {
+    public:
+        void AddMaterial(const MaterialProperties& properties, const std::map<Material::TextureType, TextureSource>& textures);
+        // vertices are VertexPositionQTangentTexture, bvh and meshlets may be null
+        void AddMesh(uint32_t material, const DirectX::BoundingBox& aabb, std::span<const std::byte> vertices,
+                     std::span<const uint32_t> indices, std::span<const MeshSimplifier::Lod> lods,
+                     const TriangleBVH* bvh, const MeshletData* meshlets);
+        // Nodes are added depth-first, parents before their children. meshes index the meshes in the order they were added
+        uint32_t AddNode(const DirectX::XMMATRIX& localTransform, std::string_view name, int32_t parent, std::span<const uint32_t> meshes);
+
+        // The texture files of the materials, relative to the directory of the model
+        const std::vector<std::filesystem::path>& GetTexturePaths() const { return m_TexturePaths; }
+
+        // Writes to a temporary file first, so a failed or interrupted write never leaves a broken cache behind
+        bool Save(const std::filesystem::path& path) const;
+
+    private:
+        template <typename T>
+        Blob AddBlob(std::span<const T> data);
+        StringRef AddString(std::string_view string);
+
+        // Array data, the header is written in front of it
+        std::vector<std::byte> m_Data = std::vector<std::byte>(sizeof(Header));
+        std::vector<MaterialRecord> m_Materials;
+        std::vector<TextureRecord> m_Textures;
+        std::vector<MeshRecord> m_Meshes;
+        std::vector<LodRecord> m_Lods;
+        std::vector<NodeRecord> m_Nodes;
+        std::vector<uint32_t> m_NodeMeshes;
+        std::string m_Strings;
+        std::vector<std::filesystem::path> m_TexturePaths;
+    };
+
+    // A cooked model file mapped into memory, read only
+    class MappedModel
+    {
+    public:
+        MappedModel();
+        ~MappedModel();
+
+        MappedModel(const MappedModel&) = delete;
+        MappedModel& operator=(const MappedModel&) = delete;
+
+        // Fails for missing files, other versions and files whose arrays don't fit in the file.
+        // A valid file is fully checked, so reading it afterwards needs no more bounds checks.
+        bool Open(const std::filesystem::path& path);
+        void Close();
+
+        const Header& GetHeader() const { return *reinterpret_cast<const Header*>(m_Data); }
+
+        template <typename T>
+        std::span<const T> Get(const Blob& blob) const
+        {
+            return { reinterpret_cast<const T*>(m_Data + blob.Offset), static_cast<size_t>(blob.Size / sizeof(T)) };
+        }
+
+        std::string_view GetString(const StringRef& string) const;
+
+    private:
+        template <typename T>
+        bool IsValid(const Blob& blob) const;
+        bool IsValid(const StringRef& string) const;
+        // Index ranges of a mesh whose blobs are already known to fit in the file
+        bool IsValidMesh(const MeshRecord& mesh, std::span<const LodRecord> lods) const;
+        bool Validate() const;
+
+        std::unique_ptr<MappedFile> m_File;
+        const std::byte* m_Data = nullptr;
+        uint64_t m_Size = 0;
+    };
+}
@@ -54,6 +54,9 @@ namespace Akari
         if (model != nullptr)
         {
             m_ModelRegistry[id] = model;
+
+            std::scoped_lock lock(m_PathMutex);
+            m_ModelPaths[id] = path;
         }
         else
         {
@@ -64,7 +67,26 @@ namespace Akari
 
     std::shared_ptr<Model> ModelManager::GetModelByID(UUID id)
     {
-        return m_ModelRegistry[id];
+        const auto iter = m_ModelRegistry.find(id);
+        return iter != m_ModelRegistry.end() ? iter->second : nullptr;
+    }
+
+    std::wstring ModelManager::GetModelPath(UUID id) const
+    {
+        std::scoped_lock lock(m_PathMutex);
+        const auto iter = m_ModelPaths.find(id);
+        return iter != m_ModelPaths.end() ? iter->second : std::wstring{};
+    }
+
+    UUID ModelManager::FindModelByPath(const std::wstring& path) const
+    {
+        std::scoped_lock lock(m_PathMutex);
+        for (const auto& [id, modelPath] : m_ModelPaths)
+        {
+            if (modelPath == path)
+                return id;
+        }
+        return 0;
     }
 
     UUID ModelManager::GetCubeID()
@@ -1,4 +1,5 @@
 #pragma once
+#include <mutex>
 #include <unordered_map>
 
 #include "UUID.h"
@@ -27,7 +28,12 @@ namespace Akari
 
         UUID LoadModelFromFile(const std::wstring& path, const std::function<bool( float )>& loadingProgress);
 
+        // nullptr for unknown IDs
         std::shared_ptr<Model> GetModelByID(UUID id);
+        // Source file of a model loaded from disk, empty for built-in geometry
+        std::wstring GetModelPath(UUID id) const;
+        // ID of an already loaded model, 0 if the file has not been loaded
+        UUID FindModelByPath(const std::wstring& path) const;
 
         UUID GetCubeID();
         UUID GetSphereID();
@@ -36,6 +42,8 @@ namespace Akari
         ModelManager() = default;
         
         std::unordered_map<UUID, std::shared_ptr<Model>> m_ModelRegistry{};
+        std::unordered_map<UUID, std::wstring> m_ModelPaths{};
+        mutable std::mutex m_PathMutex;
 
         // Default Geometries
         UUID m_CubeID{0};
@@ -97,6 +97,22 @@ public:
      */
     std::shared_ptr<Mesh> GetMesh( size_t index = 0 );
 
+    /**
+     * Get all meshes of this node.
+     */
+    const std::vector<std::shared_ptr<Mesh>>& GetMeshes() const
+    {
+        return m_Meshes;
+    }
+
+    /**
+     * Get the child nodes of this node.
+     */
+    const std::vector<std::shared_ptr<ModelNode>>& GetChildren() const
+    {
+        return m_Children;
+    }
+
     /**
      * Get the AABB for this model node.
      * The AABB is formed from the combination of all mesh AABB's.
@@ -0,0 +1,599 @@
+#include "pch.h"
+#include "Obj.h"
+
+#include "MappedFile.h"
+#include "Timing/Timer.h"
+
+#include <bit>
+#include <charconv>
+#include <ppl.h>
+#include <thread>
+
+namespace Akari::Obj
+{
+    namespace
+    {
+        // Smaller chunks aren't worth a task of their own
+        constexpr size_t MinChunkSize = 1 << 20;
+
+        constexpr uint32_t InvalidIndex = ~0u;
+
+        // Bits of Corner::Relative
+        constexpr uint8_t RelativePosition = 1;
+        constexpr uint8_t RelativeTexCoord = 2;
+        constexpr uint8_t RelativeNormal = 4;
+
+        // A face corner as written, zero based. Negative indices count back from the last vertex read and are stored
+        // relative to the start of the chunk, as a chunk doesn't know how many vertices come before it.
+        struct Corner
+        {
+            int32_t Position;
+            int32_t TexCoord;
+            int32_t Normal;
+            uint8_t Relative;
+        };
+
+        // Indices into the attributes of the whole file, InvalidIndex for attributes the corner doesn't have
+        struct ResolvedCorner
+        {
+            uint32_t Position;
+            uint32_t TexCoord;
+            uint32_t Normal;
+
+            bool operator==(const ResolvedCorner&) const = default;
+        };
+
+        // The faces from Corner on use the group or material Name
+        struct StateChange
+        {
+            bool Material;
+            std::string_view Name;
+            size_t Corner;
+        };
+
+        struct Chunk
+        {
+            std::vector<float> Positions;
+            std::vector<float> TexCoords;
+            std::vector<float> Normals;
+            // Three per triangle
+            std::vector<Corner> Corners;
+            std::vector<StateChange> StateChanges;
+            std::vector<std::string_view> MaterialLibraries;
+            size_t MalformedLines = 0;
+        };
+
+        bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        std::string_view Trim(std::string_view text)
+        {
+            while (!text.empty() && IsSpace(text.front()))
+                text.remove_prefix(1);
+            while (!text.empty() && IsSpace(text.back()))
+                text.remove_suffix(1);
+            return text;
+        }
+
+        // Removes the first whitespace separated token from text and returns it
+        std::string_view NextToken(std::string_view& text)
+        {
+            text = Trim(text);
+            const size_t end = std::min(text.find_first_of(" \t\r"), text.size());
+            const std::string_view token = text.substr(0, end);
+            text = Trim(text.substr(end));
+            return token;
+        }
+
+        // Texture paths are UTF-8 and often written with backslashes
+        std::filesystem::path ToPath(std::string_view text)
+        {
+            std::u8string path(reinterpret_cast<const char8_t*>(text.data()), text.size());
+            std::ranges::replace(path, u8'\\', u8'/');
+            return std::filesystem::path(path);
+        }
+
+        bool ReadFloat(const char*& pos, const char* end, float& value)
+        {
+            while (pos < end && IsSpace(*pos))
+                ++pos;
+            // from_chars doesn't take the leading '+' some exporters write
+            if (pos < end && *pos == '+')
+                ++pos;
+
+            const auto [ptr, error] = std::from_chars(pos, end, value);
+            if (error == std::errc::invalid_argument)
+                return false;
+            // Denormals and overflows
+            if (error == std::errc::result_out_of_range)
+                value = 0.0f;
+
+            pos = ptr;
+            return true;
+        }
+
+        // Appends count values, the ones after the required ones default to zero. A malformed line still appends
+        // its vertex so the indices of the later ones don't shift.
+        bool ReadFloats(const char* pos, const char* end, std::vector<float>& values, uint32_t required, uint32_t count)
+        {
+            bool valid = true;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                float value = 0.0f;
+                if (!ReadFloat(pos, end, value) && i < required)
+                    valid = false;
+                values.push_back(value);
+            }
+
+            return valid;
+        }
+
+        bool ReadIndex(const char*& pos, const char* end, size_t chunkCount, uint8_t relativeBit, int32_t& index, uint8_t& relative)
+        {
+            int32_t value;
+            const auto [ptr, error] = std::from_chars(pos, end, value);
+            if (error != std::errc() || value == 0)
+                return false;
+
+            pos = ptr;
+            if (value > 0)
+            {
+                index = value - 1;
+            }
+            else
+            {
+                index = static_cast<int32_t>(chunkCount) + value;
+                relative |= relativeBit;
+            }
+
+            return true;
+        }
+
+        // Corners are position, position/texcoord, position//normal or position/texcoord/normal.
+        // Polygons are triangulated as fans around their first corner.
+        bool ParseFace(const char* pos, const char* end, Chunk& chunk)
+        {
+            const size_t positionCount = chunk.Positions.size() / 3;
+            const size_t texCoordCount = chunk.TexCoords.size() / 2;
+            const size_t normalCount = chunk.Normals.size() / 3;
+            const size_t start = chunk.Corners.size();
+
+            Corner first{}, previous{};
+            uint32_t count = 0;
+            while (true)
+            {
+                while (pos < end && IsSpace(*pos))
+                    ++pos;
+                if (pos == end)
+                    break;
+
+                Corner corner = { -1, -1, -1, 0 };
+                bool valid = ReadIndex(pos, end, positionCount, RelativePosition, corner.Position, corner.Relative);
+                if (valid && pos < end && *pos == '/')
+                {
+                    ++pos;
+                    if (pos < end && *pos != '/')
+                        valid = ReadIndex(pos, end, texCoordCount, RelativeTexCoord, corner.TexCoord, corner.Relative);
+                    if (valid && pos < end && *pos == '/')
+                    {
+                        ++pos;
+                        valid = ReadIndex(pos, end, normalCount, RelativeNormal, corner.Normal, corner.Relative);
+                    }
+                }
+
+                if (!valid || (pos < end && !IsSpace(*pos)))
+                {
+                    chunk.Corners.resize(start);
+                    return false;
+                }
+
+                if (count == 0)
+                {
+                    first = corner;
+                }
+                else if (count >= 2)
+                {
+                    chunk.Corners.push_back(first);
+                    chunk.Corners.push_back(previous);
+                    chunk.Corners.push_back(corner);
+                }
+
+                previous = corner;
+                ++count;
+            }
+
+            return count >= 3;
+        }
+
+        bool ParseLine(std::string_view line, Chunk& chunk)
+        {
+            const std::string_view keyword = NextToken(line);
+            if (keyword.empty() || keyword.front() == '#')
+                return true;
+
+            const char* pos = line.data();
+            const char* end = line.data() + line.size();
+            if (keyword == "v")
+                return ReadFloats(pos, end, chunk.Positions, 3, 3);
+            if (keyword == "vt")
+                return ReadFloats(pos, end, chunk.TexCoords, 1, 2);
+            if (keyword == "vn")
+                return ReadFloats(pos, end, chunk.Normals, 3, 3);
+            if (keyword == "f")
+                return ParseFace(pos, end, chunk);
+
+            if (keyword == "g" || keyword == "o")
+                chunk.StateChanges.push_back({ false, line, chunk.Corners.size() });
+            else if (keyword == "usemtl")
+                chunk.StateChanges.push_back({ true, line, chunk.Corners.size() });
+            else if (keyword == "mtllib")
+                chunk.MaterialLibraries.push_back(line);
+
+            // Smoothing groups, lines, points and free-form geometry aren't used
+            return true;
+        }
+
+        void ParseChunk(std::string_view text, Chunk& chunk)
+        {
+            size_t lineStart = 0;
+            while (lineStart < text.size())
+            {
+                const size_t lineEnd = std::min(text.find('\n', lineStart), text.size());
+                if (!ParseLine(text.substr(lineStart, lineEnd - lineStart), chunk))
+                    ++chunk.MalformedLines;
+
+                lineStart = lineEnd + 1;
+            }
+        }
+
+        // The file name of a texture statement after its options, -bm sets the bump scale
+        std::string_view ParseTextureStatement(std::string_view text, float& bumpScale)
+        {
+            text = Trim(text);
+            while (text.starts_with('-'))
+            {
+                const std::string_view option = NextToken(text);
+                const uint32_t maxArguments = option == "-o" || option == "-s" || option == "-t" ? 3 : option == "-mm" ? 2 : 1;
+                for (uint32_t i = 0; i < maxArguments && !text.empty(); ++i)
+                {
+                    // Only the first argument is required, the optional ones are numbers
+                    std::string_view rest = text;
+                    const std::string_view argument = NextToken(rest);
+                    float value;
+                    const auto [ptr, error] = std::from_chars(argument.data(), argument.data() + argument.size(), value);
+                    const bool isNumber = error == std::errc() && ptr == argument.data() + argument.size();
+                    if (i > 0 && !isNumber)
+                        break;
+
+                    if (option == "-bm" && isNumber)
+                        bumpScale = value;
+                    text = rest;
+                }
+            }
+
+            return text;
+        }
+
+        size_t Hash(const ResolvedCorner& corner)
+        {
+            const uint64_t hash = (corner.Position * 73856093ull) ^ (corner.TexCoord * 19349663ull) ^ (corner.Normal * 83492791ull);
+            return static_cast<size_t>(hash ^ (hash >> 29));
+        }
+
+        // Deduplicates the corners of a mesh with an open addressing hash table and gathers their attributes
+        void BuildMesh(std::span<const std::pair<size_t, size_t>> ranges, std::span<const ResolvedCorner> corners,
+            std::span<const float> positions, std::span<const float> texCoords, std::span<const float> normals, Mesh& mesh)
+        {
+            size_t cornerCount = 0;
+            for (const auto& [begin, end] : ranges)
+                cornerCount += end - begin;
+
+            // At most half full, probed linearly
+            const size_t tableSize = std::bit_ceil(std::max<size_t>(cornerCount * 2, 16));
+            std::vector<uint32_t> table(tableSize, InvalidIndex);
+            std::vector<ResolvedCorner> vertices;
+            mesh.Indices.reserve(cornerCount);
+
+            for (const auto& [begin, end] : ranges)
+            {
+                for (size_t i = begin; i < end; i += 3)
+                {
+                    // Triangles with indices out of range were marked when the corners were resolved
+                    if (corners[i].Position == InvalidIndex || corners[i + 1].Position == InvalidIndex || corners[i + 2].Position == InvalidIndex)
+                        continue;
+
+                    for (size_t j = i; j < i + 3; ++j)
+                    {
+                        size_t slot = Hash(corners[j]) & (tableSize - 1);
+                        while (table[slot] != InvalidIndex && vertices[table[slot]] != corners[j])
+                            slot = (slot + 1) & (tableSize - 1);
+
+                        if (table[slot] == InvalidIndex)
+                        {
+                            table[slot] = static_cast<uint32_t>(vertices.size());
+                            vertices.push_back(corners[j]);
+                        }
+
+                        mesh.Indices.push_back(table[slot]);
+                    }
+                }
+            }
+
+            const bool hasTexCoords = std::ranges::any_of(vertices, [](const ResolvedCorner& vertex) { return vertex.TexCoord != InvalidIndex; });
+            const bool hasNormals = std::ranges::any_of(vertices, [](const ResolvedCorner& vertex) { return vertex.Normal != InvalidIndex; });
+
+            mesh.Positions.resize(vertices.size() * 3);
+            mesh.TexCoords.resize(hasTexCoords ? vertices.size() * 2 : 0);
+            mesh.Normals.resize(hasNormals ? vertices.size() * 3 : 0);
+            for (size_t i = 0; i < vertices.size(); ++i)
+            {
+                std::copy_n(&positions[vertices[i].Position * 3ull], 3, &mesh.Positions[i * 3]);
+                if (hasTexCoords && vertices[i].TexCoord != InvalidIndex)
+                    std::copy_n(&texCoords[vertices[i].TexCoord * 2ull], 2, &mesh.TexCoords[i * 2]);
+                if (hasNormals && vertices[i].Normal != InvalidIndex)
+                    std::copy_n(&normals[vertices[i].Normal * 3ull], 3, &mesh.Normals[i * 3]);
+            }
+        }
+    }
+
+    bool Asset::Open(const std::filesystem::path& path)
+    {
+        Timer timer;
+        m_FilePaths.push_back(path);
+
+        const MappedFile file(path);
+        if (!file.GetData())
+        {
+            spdlog::error("OBJ {0}: can't read the file", path.string());
+            return false;
+        }
+
+        // Split the file into chunks that end after a line break and parse them in parallel
+        const std::string_view text(file.GetData(), static_cast<size_t>(file.GetSize()));
+        const size_t maxChunks = std::max(std::thread::hardware_concurrency(), 1u) * 4;
+        const size_t chunkCount = std::clamp<size_t>(text.size() / MinChunkSize, 1, maxChunks);
+
+        std::vector<std::string_view> chunkTexts;
+        for (size_t begin = 0, i = 1; begin < text.size(); ++i)
+        {
+            size_t end = text.size();
+            if (i < chunkCount)
+                end = std::min(text.find('\n', std::max(begin, text.size() / chunkCount * i)), text.size() - 1) + 1;
+
+            chunkTexts.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+
+        std::vector<Chunk> chunks(chunkTexts.size());
+        concurrency::parallel_for(size_t(0), chunks.size(), [&](size_t i) { ParseChunk(chunkTexts[i], chunks[i]); });
+
+        const float parseMillis = timer.ElapsedMillis();
+
+        // Where the attributes and corners of every chunk start in those of the whole file
+        struct Offsets
+        {
+            size_t Positions = 0;
+            size_t TexCoords = 0;
+            size_t Normals = 0;
+            size_t Corners = 0;
+        };
+
+        std::vector<Offsets> offsets(chunks.size() + 1);
+        size_t malformedLines = 0;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            offsets[i + 1].Positions = offsets[i].Positions + chunks[i].Positions.size();
+            offsets[i + 1].TexCoords = offsets[i].TexCoords + chunks[i].TexCoords.size();
+            offsets[i + 1].Normals = offsets[i].Normals + chunks[i].Normals.size();
+            offsets[i + 1].Corners = offsets[i].Corners + chunks[i].Corners.size();
+            malformedLines += chunks[i].MalformedLines;
+        }
+
+        const Offsets& totals = offsets.back();
+        if (totals.Positions / 3 >= InvalidIndex || totals.TexCoords / 2 >= InvalidIndex || totals.Normals / 3 >= InvalidIndex)
+        {
+            spdlog::error("OBJ {0}: too many vertices", path.string());
+            return false;
+        }
+
+        // Merge the attributes and resolve the corners to indices into them
+        std::vector<float> positions(totals.Positions);
+        std::vector<float> texCoords(totals.TexCoords);
+        std::vector<float> normals(totals.Normals);
+        std::vector<ResolvedCorner> corners(totals.Corners);
+        concurrency::parallel_for(size_t(0), chunks.size(), [&](size_t i)
+        {
+            const Chunk& chunk = chunks[i];
+            std::ranges::copy(chunk.Positions, positions.begin() + offsets[i].Positions);
+            std::ranges::copy(chunk.TexCoords, texCoords.begin() + offsets[i].TexCoords);
+            std::ranges::copy(chunk.Normals, normals.begin() + offsets[i].Normals);
+
+            auto resolve = [&](int32_t index, bool relative, size_t chunkOffset, size_t count, bool& valid)
+            {
+                if (index < 0 && !relative)
+                    return InvalidIndex;
+
+                const int64_t resolved = relative ? static_cast<int64_t>(chunkOffset) + index : index;
+                if (resolved < 0 || resolved >= static_cast<int64_t>(count))
+                {
+                    valid = false;
+                    return InvalidIndex;
+                }
+
+                return static_cast<uint32_t>(resolved);
+            };
+
+            for (size_t j = 0; j < chunk.Corners.size(); ++j)
+            {
+                const Corner& corner = chunk.Corners[j];
+                bool valid = true;
+                ResolvedCorner& resolved = corners[offsets[i].Corners + j];
+                resolved.Position = resolve(corner.Position, corner.Relative & RelativePosition, offsets[i].Positions / 3, totals.Positions / 3, valid);
+                resolved.TexCoord = resolve(corner.TexCoord, corner.Relative & RelativeTexCoord, offsets[i].TexCoords / 2, totals.TexCoords / 2, valid);
+                resolved.Normal = resolve(corner.Normal, corner.Relative & RelativeNormal, offsets[i].Normals / 3, totals.Normals / 3, valid);
+                if (!valid)
+                    resolved.Position = InvalidIndex;
+            }
+        });
+
+        // The material libraries are small, they are read after the geometry
+        for (const auto& chunk : chunks)
+        {
+            for (const std::string_view library : chunk.MaterialLibraries)
+                LoadMaterialLibrary(path.parent_path(), library);
+        }
+
+        std::unordered_map<std::string_view, int32_t> materialIndices;
+        for (size_t i = 0; i < m_Materials.size(); ++i)
+            materialIndices.try_emplace(m_Materials[i].Name, static_cast<int32_t>(i));
+
+        // Split the faces by group and material, the faces of a group and material share one mesh
+        std::map<std::pair<std::string_view, std::string_view>, size_t> meshIndices;
+        std::vector<std::vector<std::pair<size_t, size_t>>> meshRanges;
+        std::string_view group, material;
+        size_t rangeBegin = 0;
+        auto addRange = [&](size_t rangeEnd)
+        {
+            if (rangeEnd > rangeBegin)
+            {
+                const auto [iter, inserted] = meshIndices.try_emplace({ group, material }, meshRanges.size());
+                if (inserted)
+                    meshRanges.emplace_back();
+                meshRanges[iter->second].emplace_back(rangeBegin, rangeEnd);
+            }
+            rangeBegin = rangeEnd;
+        };
+
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            for (const auto& change : chunks[i].StateChanges)
+            {
+                addRange(offsets[i].Corners + change.Corner);
+                (change.Material ? material : group) = change.Name;
+            }
+        }
+        addRange(totals.Corners);
+
+        m_Meshes.resize(meshRanges.size());
+        for (const auto& [key, index] : meshIndices)
+        {
+            m_Meshes[index].Name = key.first;
+            const auto iter = materialIndices.find(key.second);
+            m_Meshes[index].Material = iter != materialIndices.end() ? iter->second : -1;
+        }
+
+        concurrency::parallel_for(size_t(0), m_Meshes.size(), [&](size_t i)
+        {
+            BuildMesh(meshRanges[i], corners, positions, texCoords, normals, m_Meshes[i]);
+        });
+
+        std::erase_if(m_Meshes, [](const Mesh& mesh) { return mesh.Indices.empty(); });
+
+        if (malformedLines > 0)
+            spdlog::warn("OBJ {0}: skipped {1} malformed lines", path.string(), malformedLines);
+
+        const float totalMillis = timer.ElapsedMillis();
+        spdlog::info("OBJ {0}: {1:.1f} MB in {2} chunks parsed in {3:.2f} ms ({4:.0f} MB/s), {5} meshes merged in {6:.2f} ms",
+            path.filename().string(), text.size() / (1024.0 * 1024.0), chunks.size(), parseMillis,
+            text.size() / (1024.0 * 1024.0) / std::max(parseMillis / 1000.0, 1e-6), m_Meshes.size(), totalMillis - parseMillis);
+
+        return true;
+    }
+
+    bool Asset::LoadMaterialLibrary(const std::filesystem::path& directory, std::string_view fileName)
+    {
+        // Texture paths are relative to the library, they are returned relative to the OBJ file
+        const std::filesystem::path relativePath = ToPath(fileName);
+        const std::filesystem::path textureDirectory = relativePath.parent_path();
+        const std::filesystem::path path = directory / relativePath;
+        m_FilePaths.push_back(path);
+
+        const MappedFile file(path);
+        if (!file.GetData())
+        {
+            spdlog::warn("OBJ: can't read the material library {0}", path.string());
+            return false;
+        }
+
+        const std::string_view text(file.GetData(), static_cast<size_t>(file.GetSize()));
+        bool hasMaterial = false;
+        size_t lineStart = 0;
+        while (lineStart < text.size())
+        {
+            const size_t lineEnd = std::min(text.find('\n', lineStart), text.size());
+            std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+
+            const std::string_view keyword = NextToken(line);
+            if (keyword == "newmtl")
+            {
+                m_Materials.emplace_back().Name = line;
+                hasMaterial = true;
+                continue;
+            }
+
+            // Statements before the first material or comments
+            if (!hasMaterial || keyword.empty() || keyword.front() == '#')
+                continue;
+
+            Material& material = m_Materials.back();
+            const char* pos = line.data();
+            const char* end = line.data() + line.size();
+            auto readVec3 = [&](glm::vec3& value)
+            {
+                glm::vec3 color;
+                if (ReadFloat(pos, end, color.x) && ReadFloat(pos, end, color.y) && ReadFloat(pos, end, color.z))
+                    value = color;
+            };
+            auto readTexture = [&](std::filesystem::path& texture)
+            {
+                const std::string_view file = ParseTextureStatement(line, material.BumpScale);
+                if (!file.empty())
+                    texture = textureDirectory / ToPath(file);
+            };
+
+            float value = 0.0f;
+            if (keyword == "Ka")
+                readVec3(material.Ambient);
+            else if (keyword == "Kd")
+                readVec3(material.Diffuse);
+            else if (keyword == "Ke")
+                readVec3(material.Emissive);
+            else if (keyword == "Ns" && ReadFloat(pos, end, value))
+                material.Shininess = value;
+            else if (keyword == "d" && ReadFloat(pos, end, value))
+                material.Opacity = value;
+            // Transparency, the inverse of the dissolve
+            else if (keyword == "Tr" && ReadFloat(pos, end, value))
+                material.Opacity = 1.0f - value;
+            else if (keyword == "Pr" && ReadFloat(pos, end, value))
+                material.Roughness = value;
+            else if (keyword == "Pm" && ReadFloat(pos, end, value))
+                material.Metallic = value;
+            else if (keyword == "map_Ka")
+                readTexture(material.AmbientTexture);
+            else if (keyword == "map_Kd")
+                readTexture(material.DiffuseTexture);
+            else if (keyword == "map_Ks")
+                readTexture(material.SpecularTexture);
+            else if (keyword == "map_Ns")
+                readTexture(material.ShininessTexture);
+            else if (keyword == "map_Ke")
+                readTexture(material.EmissiveTexture);
+            else if (keyword == "map_d")
+                readTexture(material.OpacityTexture);
+            else if (keyword == "norm" || keyword == "map_Kn")
+                readTexture(material.NormalTexture);
+            else if (keyword == "map_bump" || keyword == "map_Bump" || keyword == "bump")
+                readTexture(material.BumpTexture);
+            else if (keyword == "map_Pr")
+                readTexture(material.RoughnessTexture);
+            else if (keyword == "map_Pm")
+                readTexture(material.MetallicTexture);
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <string_view>
+
+// Wavefront OBJ files with their MTL material libraries.
+// The file is memory mapped and split into line aligned chunks that are parsed in parallel, the chunks are then
+// merged into one mesh per group and material whose vertices are deduplicated with a hash table.
+namespace Akari::Obj
+{
+    struct Mesh
+    {
+        // The name of the group or object the faces belong to
+        std::string Name;
+        // Material index, -1 for faces without a known material
+        int32_t Material = -1;
+
+        // Tightly packed per vertex attributes in the file's right-handed space, texture coordinates have their
+        // origin at the bottom left. Normals and texture coordinates are empty when no face of the mesh has them.
+        std::vector<float> Positions;
+        std::vector<float> Normals;
+        std::vector<float> TexCoords;
+        // Triangle list, polygons are triangulated as fans
+        std::vector<uint32_t> Indices;
+    };
+
+    struct Material
+    {
+        std::string Name;
+        glm::vec3 Ambient = { 0.0f, 0.0f, 0.0f };
+        glm::vec3 Diffuse = { 1.0f, 1.0f, 1.0f };
+        glm::vec3 Emissive = { 0.0f, 0.0f, 0.0f };
+        float Shininess = 0.0f;
+        float Opacity = 1.0f;
+        // Negative when the material doesn't have the PBR extension values
+        float Roughness = -1.0f;
+        float Metallic = -1.0f;
+        float BumpScale = 1.0f;
+
+        // Texture files relative to the directory of the OBJ file, empty when the material doesn't have the texture
+        std::filesystem::path AmbientTexture;
+        std::filesystem::path DiffuseTexture;
+        std::filesystem::path SpecularTexture;
+        std::filesystem::path ShininessTexture;
+        std::filesystem::path EmissiveTexture;
+        std::filesystem::path OpacityTexture;
+        std::filesystem::path NormalTexture;
+        // Either a height map or a normal map, map_bump is used for both
+        std::filesystem::path BumpTexture;
+        std::filesystem::path RoughnessTexture;
+        std::filesystem::path MetallicTexture;
+    };
+
+    class Asset
+    {
+    public:
+        // Parses the file and the material libraries it references, logs why it fails.
+        // Malformed lines are skipped and counted, faces with indices out of range are dropped.
+        bool Open(const std::filesystem::path& path);
+
+        const std::vector<Mesh>& GetMeshes() const { return m_Meshes; }
+        const std::vector<Material>& GetMaterials() const { return m_Materials; }
+        // The OBJ file and the material libraries, texture files are not included
+        const std::vector<std::filesystem::path>& GetFilePaths() const { return m_FilePaths; }
+
+    private:
+        bool LoadMaterialLibrary(const std::filesystem::path& directory, std::string_view fileName);
+
+        std::vector<Mesh> m_Meshes;
+        std::vector<Material> m_Materials;
+        std::vector<std::filesystem::path> m_FilePaths;
+    };
+}
@@ -1,22 +1,25 @@
 #include "pch.h"
 #include "Scene.h"
+
+#include <ppl.h>
+
 #include "SceneObject.h"
-#include "RHI/Renderer.h"
-#include "Camera/EditorCamera.h"
+#include "SceneCommandBuffer.h"
 #include "Components.h"
-#include "Model.h"
-#include "ModelManager.h"
-#include "Visitor.h"
-#include "Layers/ImGuiLayer.h"
-#include "RHI/RenderTarget.h"
 
 namespace Akari
 {
     Scene::Scene(const std::string& name)
     {
-        const auto& rt = Renderer::GetInstance().GetMsaaRenderTarget();
-        m_Camera = std::make_shared<EditorCamera>(45.0f, rt->GetWidth(), rt->GetHeight(), 0.1f, 2000.0f);
-        m_Camera->SetActive(true);
+        m_CommandBuffer = std::make_unique<SceneCommandBuffer>();
+
+        m_Registry.on_construct<NameComponent>().connect<&Scene::OnNameComponentConstruct>(this);
+        m_Registry.on_update<NameComponent>().connect<&Scene::OnNameComponentUpdate>(this);
+        m_Registry.on_destroy<NameComponent>().connect<&Scene::OnNameComponentDestroy>(this);
+        m_Registry.on_construct<ModelComponent>().connect<&Scene::OnModelComponentChange>(this);
+        m_Registry.on_update<ModelComponent>().connect<&Scene::OnModelComponentChange>(this);
+        m_Registry.on_destroy<ModelComponent>().connect<&Scene::OnModelComponentDestroy>(this);
+        m_Registry.on_construct<HierarchyComponent>().connect<&Scene::OnHierarchyComponentConstruct>(this);
     }
 
     Scene::~Scene()
@@ -56,6 +59,37 @@ namespace Akari
         }
     }
 
+    template<typename Func>
+    void Scene::ForEachDescendant(entt::entity root, Func&& func)
+    {
+        entt::entity current = m_Registry.get<HierarchyComponent>(root).FirstChild;
+        while (current != entt::null)
+        {
+            func(current);
+
+            if (const auto firstChild = m_Registry.get<HierarchyComponent>(current).FirstChild; firstChild != entt::null)
+            {
+                current = firstChild;
+                continue;
+            }
+
+            // Climb until a node with an unvisited sibling shows up, stop once back at the root
+            while (current != root)
+            {
+                const auto& hierarchy = m_Registry.get<HierarchyComponent>(current);
+                if (hierarchy.NextSibling != entt::null)
+                {
+                    current = hierarchy.NextSibling;
+                    break;
+                }
+                current = hierarchy.Parent;
+            }
+
+            if (current == root)
+                break;
+        }
+    }
+
     SceneObject Scene::CreateSceneObject(const std::string& name)
     {
         auto sceneObject = SceneObject { m_Registry.create(), this };
@@ -67,10 +101,11 @@ namespace Akari
             sceneObject.AddComponent<NameComponent>(name);
 
         sceneObject.AddComponent<RelationshipComponent>();
+        sceneObject.AddComponent<HierarchyComponent>();
 
         m_SceneObjectIDMap.try_emplace(idComponent.ID, sceneObject);
 
-        SortSceneObjects();
+        MarkHierarchyDirty();
 
         return sceneObject;
     }
@@ -94,26 +129,18 @@ namespace Akari
             entity.AddComponent<NameComponent>(name);
 
         entity.AddComponent<RelationshipComponent>();
+        entity.AddComponent<HierarchyComponent>();
 
         assert(!m_SceneObjectIDMap.contains(uuid));
         m_SceneObjectIDMap[uuid] = entity;
 
-        SortSceneObjects();
+        MarkHierarchyDirty();
 
         return entity;
     }
 
     SceneObject Scene::DuplicateSceneObject(SceneObject object)
     {
-        auto parentNewEntity = [&object, scene = this](SceneObject newEntity)
-        {
-            if (auto parent = object.GetParent(); parent)
-            {
-                newEntity.SetParentUUID(parent.GetUUID());
-                parent.Children().push_back(newEntity.GetUUID());
-            }
-        };
-
         SceneObject newObject;
         if (object.HasComponent<NameComponent>())
             newObject = CreateSceneObject(object.GetComponent<NameComponent>().Name);
@@ -121,49 +148,159 @@ namespace Akari
             newObject = CreateSceneObject();
 
         CopyComponentIfExists<TransformComponent>(newObject.m_EntityHandle, object.m_EntityHandle, m_Registry);
+        newObject.Transform().MarkDirty();
         CopyComponentIfExists<DirectionalLightComponent>(newObject.m_EntityHandle, object.m_EntityHandle, m_Registry);
         CopyComponentIfExists<PointLightComponent>(newObject.m_EntityHandle, object.m_EntityHandle, m_Registry);
         CopyComponentIfExists<ModelComponent>(newObject.m_EntityHandle, object.m_EntityHandle, m_Registry);
+        CopyComponentIfExists<OccluderComponent>(newObject.m_EntityHandle, object.m_EntityHandle, m_Registry);
 
-        auto childIds = object.Children(); // need to take a copy of children here, because the collection is mutated below
-        for (auto childId : childIds)
+        // Take a snapshot, duplicating a child appends to object's child list
+        for (const auto child : object.GetChildren())
         {
-            SceneObject childDuplicate = DuplicateSceneObject(GetSceneObjectWithUUID(childId));
-
-            // At this point childDuplicate is a child of entity, we need to remove it from that entity
-            UnparentSceneObject(childDuplicate, false);
-
-            childDuplicate.SetParentUUID(newObject.GetUUID());
-            newObject.Children().push_back(childDuplicate.GetUUID());
+            // The duplicate starts out as a sibling of child, move it under the new object
+            SceneObject childDuplicate = DuplicateSceneObject(child);
+            childDuplicate.SetParent(newObject);
         }
 
-        parentNewEntity(newObject);
+        if (auto parent = object.GetParent(); parent)
+            newObject.SetParent(parent);
 
         return newObject;
     }
 
-    void Scene::DestroySceneObject(SceneObject object, bool excludeChildren, bool first)
+    void Scene::DestroySceneObject(SceneObject object, bool excludeChildren)
     {
-        if (!excludeChildren)
+        DetachFromParent(object.m_EntityHandle);
+
+        if (excludeChildren)
         {
-            for (size_t i = 0; i < object.Children().size(); i++)
+            while (auto child = object.GetFirstChild())
             {
-                auto childId = object.Children()[i];
-                SceneObject child = GetSceneObjectWithUUID(childId);
-                DestroySceneObject(child, excludeChildren, false);
+                DetachFromParent(child.m_EntityHandle);
+                child.Transform().MarkDirty();
             }
         }
-
-        if (first)
+        else
         {
-            if (auto parent = object.GetParent(); parent)
-                parent.RemoveChild(object);
+            // Collect first, destroying while walking would break the sibling links
+            std::vector<entt::entity> descendants;
+            ForEachDescendant(object.m_EntityHandle, [&](const entt::entity entity)
+            {
+                m_SceneObjectIDMap.erase(m_Registry.get<IDComponent>(entity).ID);
+                descendants.push_back(entity);
+            });
+            m_Registry.destroy(descendants.begin(), descendants.end());
         }
 
         m_SceneObjectIDMap.erase(object.GetUUID());
         m_Registry.destroy(object.m_EntityHandle);
 
-        SortSceneObjects();
+        MarkHierarchyDirty();
+    }
+
+    void Scene::Clear()
+    {
+        m_Registry.clear();
+        m_SceneObjectIDMap.clear();
+        m_NameIndex.Clear();
+        m_BVH.Clear();
+        m_PendingBounds.clear();
+
+        m_FlattenedHierarchy.clear();
+        m_WorldMatrices.clear();
+        m_TransformSpine.clear();
+        m_TransformBatches.clear();
+        MarkHierarchyDirty();
+    }
+
+    void Scene::ExecuteCommandBuffer(SceneCommandBuffer& commandBuffer)
+    {
+        std::vector<SceneCommandBuffer::Command> commands;
+        {
+            std::scoped_lock lock(commandBuffer.m_Mutex);
+            commands.swap(commandBuffer.m_Commands);
+        }
+
+        if (commands.empty())
+            return;
+
+        // Destroyed subtrees are detached and leave the id map right away so later commands no longer
+        // see them, the entities themselves are destroyed once after all commands ran
+        std::vector<entt::entity> destroyedEntities;
+
+        m_SceneObjectIDMap.reserve(m_SceneObjectIDMap.size() + commands.size());
+
+        for (auto& command : commands)
+        {
+            switch (command.Type)
+            {
+            case SceneCommandBuffer::CommandType::Create:
+            {
+                auto sceneObject = CreateSceneObjectWithID(command.Target, command.Name);
+                if (auto parent = TryGetSceneObjectWithUUID(command.Parent); parent)
+                    AttachToParent(sceneObject.m_EntityHandle, parent.m_EntityHandle);
+                break;
+            }
+            case SceneCommandBuffer::CommandType::Destroy:
+            {
+                const auto root = TryGetSceneObjectWithUUID(command.Target);
+                if (!root)
+                    break;
+
+                DetachFromParent(root.m_EntityHandle);
+
+                if (command.ExcludeChildren)
+                {
+                    while (auto child = root.GetFirstChild())
+                    {
+                        DetachFromParent(child.m_EntityHandle);
+                        child.Transform().MarkDirty();
+                    }
+                }
+                else
+                {
+                    ForEachDescendant(root.m_EntityHandle, [&](const entt::entity entity)
+                    {
+                        m_SceneObjectIDMap.erase(m_Registry.get<IDComponent>(entity).ID);
+                        destroyedEntities.push_back(entity);
+                    });
+                }
+
+                m_SceneObjectIDMap.erase(command.Target);
+                destroyedEntities.push_back(root.m_EntityHandle);
+                break;
+            }
+            case SceneCommandBuffer::CommandType::Reparent:
+            {
+                auto sceneObject = TryGetSceneObjectWithUUID(command.Target);
+                if (!sceneObject)
+                    break;
+
+                const auto parent = TryGetSceneObjectWithUUID(command.Parent);
+                if (parent && (parent == sceneObject || parent.IsDescendantOf(sceneObject)))
+                {
+                    spdlog::warn("Ignoring reparent command that would create a cycle in the scene hierarchy");
+                    break;
+                }
+                if (parent)
+                    sceneObject.SetParent(parent);
+                else
+                    UnparentSceneObject(sceneObject, false);
+                break;
+            }
+            case SceneCommandBuffer::CommandType::AddComponent:
+            {
+                if (auto sceneObject = TryGetSceneObjectWithUUID(command.Target); sceneObject)
+                    command.AddComponent(sceneObject);
+                break;
+            }
+            }
+        }
+
+        if (!destroyedEntities.empty())
+            m_Registry.destroy(destroyedEntities.begin(), destroyedEntities.end());
+
+        MarkHierarchyDirty();
     }
 
     SceneObject Scene::GetSceneObjectWithUUID(UUID id) const
@@ -179,22 +316,62 @@ namespace Akari
         return SceneObject {};
     }
 
-    SceneObject Scene::TryGetSceneObjectWithName(const std::string& name)
+    SceneObject Scene::TryGetSceneObjectWithName(std::string_view name)
     {
-        const auto entities = GetAllSceneObjectsWith<NameComponent>();
-        for (const auto e : entities)
-        {
-            if (entities.get<NameComponent>(e).Name == name)
-                return SceneObject(e, const_cast<Scene*>(this));
-        }
+        if (const auto entities = m_NameIndex.Find(name); entities && !entities->empty())
+            return SceneObject(entities->front(), this);
 
         return SceneObject {};
     }
 
+    std::vector<SceneObject> Scene::FindSceneObjectsWithPrefix(std::string_view prefix, size_t maxResults)
+    {
+        std::vector<entt::entity> entities;
+        m_NameIndex.FindWithPrefix(prefix, entities, maxResults);
+
+        std::vector<SceneObject> sceneObjects;
+        sceneObjects.reserve(entities.size());
+        for (const auto entity : entities)
+            sceneObjects.emplace_back(entity, this);
+
+        return sceneObjects;
+    }
+
+    void Scene::OnNameComponentConstruct(entt::registry& registry, entt::entity entity)
+    {
+        m_NameIndex.Add(entity, registry.get<NameComponent>(entity).Name);
+    }
+
+    void Scene::OnNameComponentUpdate(entt::registry& registry, entt::entity entity)
+    {
+        m_NameIndex.Rename(entity, registry.get<NameComponent>(entity).Name);
+    }
+
+    void Scene::OnNameComponentDestroy(entt::registry& registry, entt::entity entity)
+    {
+        m_NameIndex.Remove(entity);
+    }
+
+    void Scene::OnModelComponentChange(entt::registry& registry, entt::entity entity)
+    {
+        m_PendingBounds.insert(entity);
+    }
+
+    void Scene::OnModelComponentDestroy(entt::registry& registry, entt::entity entity)
+    {
+        m_PendingBounds.erase(entity);
+        m_BVH.Remove(entity);
+    }
+
+    void Scene::OnHierarchyComponentConstruct(entt::registry& registry, entt::entity entity)
+    {
+        registry.get<HierarchyComponent>(entity).CreationIndex = m_NextCreationIndex++;
+    }
+
     void Scene::ConvertToLocalSpace(SceneObject sceneObject)
     {
-        const SceneObject parent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-        if (parent.m_Scene == nullptr) return;
+        const SceneObject parent = sceneObject.GetParent();
+        if (!parent) return;
 
         TransformComponent& transComp = sceneObject.Transform();
         const TransformComponent parentTrans = GetWorldSpaceTransform(parent);
@@ -205,8 +382,8 @@ namespace Akari
 
     void Scene::ConvertToWorldSpace(SceneObject sceneObject)
     {
-        const SceneObject parent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-        if (parent.m_Scene == nullptr) return;
+        const SceneObject parent = sceneObject.GetParent();
+        if (!parent) return;
 
         TransformComponent& transComp = sceneObject.Transform();
         const TransformComponent worldSpaceTransform = GetWorldSpaceTransform(sceneObject);
@@ -217,20 +394,21 @@ namespace Akari
 
     glm::mat4 Scene::GetWorldSpaceTransformMatrix(SceneObject sceneObject)
     {
-        glm::mat4 transform(1.0f);
-
-        SceneObject parent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-        if (parent)
-            transform = GetWorldSpaceTransformMatrix(parent);
-
-        return transform * sceneObject.Transform().GetTransform();
+        if (!m_HierarchyDirty)
+            return m_WorldMatrices[sceneObject.GetComponent<HierarchyComponent>().FlattenedIndex];
+
+        // Flattened indices are stale until the next SortSceneObjects()
+        glm::mat4 transform = sceneObject.Transform().GetTransform();
+        for (auto parent = sceneObject.GetParent(); parent; parent = parent.GetParent())
+            transform = parent.Transform().GetTransform() * transform;
+        return transform;
     }
 
     TransformComponent Scene::GetWorldSpaceTransform(SceneObject sceneObject)
     {
         TransformComponent transComp = sceneObject.Transform();
-        const SceneObject parent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-        if (parent.m_Scene != nullptr)
+        const SceneObject parent = sceneObject.GetParent();
+        if (parent)
         {
             const TransformComponent parentTrans = GetWorldSpaceTransform(parent);
             transComp.Translation += parentTrans.Translation;
@@ -247,7 +425,7 @@ namespace Akari
         {
             UnparentSceneObject(parent);
 
-            SceneObject newParent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
+            SceneObject newParent = sceneObject.GetParent();
             if (newParent)
             {
                 UnparentSceneObject(sceneObject);
@@ -256,67 +434,210 @@ namespace Akari
         }
         else
         {
-            SceneObject previousParent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-
-            if (previousParent)
+            if (sceneObject.GetParent())
                 UnparentSceneObject(sceneObject);
         }
 
-        sceneObject.SetParentUUID(parent.GetUUID());
-        parent.Children().push_back(sceneObject.GetUUID());
+        AttachToParent(sceneObject.m_EntityHandle, parent.m_EntityHandle);
 
         ConvertToLocalSpace(sceneObject);
+        sceneObject.Transform().MarkDirty();
+        MarkHierarchyDirty();
     }
 
     void Scene::UnparentSceneObject(SceneObject sceneObject, bool convertToWorldSpace)
     {
-        SceneObject parent = TryGetSceneObjectWithUUID(sceneObject.GetParentUUID());
-        if (!parent)
+        if (!sceneObject.GetParent())
             return;
 
-        auto& parentChildren = parent.Children();
-        parentChildren.erase(std::remove(parentChildren.begin(), parentChildren.end(), sceneObject.GetUUID()), parentChildren.end());
-
         if (convertToWorldSpace)
             ConvertToWorldSpace(sceneObject);
 
-        sceneObject.SetParentUUID(0);
+        DetachFromParent(sceneObject.m_EntityHandle);
+        sceneObject.Transform().MarkDirty();
+        MarkHierarchyDirty();
+    }
+
+    void Scene::AttachToParent(entt::entity entity, entt::entity parent)
+    {
+        auto& hierarchy = m_Registry.get<HierarchyComponent>(entity);
+        auto& parentHierarchy = m_Registry.get<HierarchyComponent>(parent);
+        assert(hierarchy.Parent == entt::null && "Scene object has to be detached before attaching it to a new parent!");
+
+        // Append so children keep the order they were parented in
+        hierarchy.Parent = parent;
+        hierarchy.PrevSibling = parentHierarchy.LastChild;
+        hierarchy.NextSibling = entt::null;
+        if (parentHierarchy.LastChild != entt::null)
+            m_Registry.get<HierarchyComponent>(parentHierarchy.LastChild).NextSibling = entity;
+        else
+            parentHierarchy.FirstChild = entity;
+        parentHierarchy.LastChild = entity;
+        parentHierarchy.ChildCount++;
+
+        m_Registry.get<RelationshipComponent>(entity).ParentHandle = m_Registry.get<IDComponent>(parent).ID;
+        UpdateHierarchyDepth(entity, parentHierarchy.Depth + 1);
     }
 
-    std::shared_ptr<EditorCamera> Scene::GetCamera()
+    void Scene::DetachFromParent(entt::entity entity)
     {
-        return m_Camera;
+        auto& hierarchy = m_Registry.get<HierarchyComponent>(entity);
+        if (hierarchy.Parent == entt::null)
+            return;
+
+        auto& parentHierarchy = m_Registry.get<HierarchyComponent>(hierarchy.Parent);
+        if (hierarchy.PrevSibling != entt::null)
+            m_Registry.get<HierarchyComponent>(hierarchy.PrevSibling).NextSibling = hierarchy.NextSibling;
+        else
+            parentHierarchy.FirstChild = hierarchy.NextSibling;
+
+        if (hierarchy.NextSibling != entt::null)
+            m_Registry.get<HierarchyComponent>(hierarchy.NextSibling).PrevSibling = hierarchy.PrevSibling;
+        else
+            parentHierarchy.LastChild = hierarchy.PrevSibling;
+        parentHierarchy.ChildCount--;
+
+        hierarchy.Parent = entt::null;
+        hierarchy.PrevSibling = entt::null;
+        hierarchy.NextSibling = entt::null;
+
+        m_Registry.get<RelationshipComponent>(entity).ParentHandle = 0;
+        UpdateHierarchyDepth(entity, 0);
     }
 
-    void Scene::OnEvent(Event& event)
+    void Scene::UpdateHierarchyDepth(entt::entity entity, uint32_t depth)
     {
-        if (Renderer::GetInstance().GetImGuiLayer()->m_IsSceneWindowHovered)
+        m_Registry.get<HierarchyComponent>(entity).Depth = depth;
+
+        // Pre-order, so every parent already holds its new depth
+        ForEachDescendant(entity, [this](const entt::entity descendant)
         {
-            m_Camera->OnEvent(event);
-        }
+            auto& hierarchy = m_Registry.get<HierarchyComponent>(descendant);
+            hierarchy.Depth = m_Registry.get<HierarchyComponent>(hierarchy.Parent).Depth + 1;
+        });
     }
 
-    void Scene::Accept(Visitor& visitor)
+    void Scene::UpdateWorldTransforms()
     {
-        visitor.Visit(*this);
-        const auto entities = GetAllSceneObjectsWith<ModelComponent>();
-        for (const auto entity : entities)
+        const auto transforms = GetAllSceneObjectsWith<TransformComponent>();
+        const bool forceUpdate = m_ForceTransformUpdate;
+
+        // Parents precede their children, so a forward sweep over a range sees every parent's final world matrix
+        auto updateRange = [&](const uint32_t begin, const uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                auto& node = m_FlattenedHierarchy[i];
+                auto& transComp = transforms.get<TransformComponent>(node.Entity);
+                const bool hasParent = node.Parent != InvalidHierarchyIndex;
+                node.Dirty = forceUpdate || transComp.Dirty || (hasParent && m_FlattenedHierarchy[node.Parent].Dirty);
+                if (!node.Dirty)
+                    continue;
+
+                if (hasParent)
+                    m_WorldMatrices[i] = m_WorldMatrices[node.Parent] * transComp.GetTransform();
+                else
+                    m_WorldMatrices[i] = transComp.GetTransform();
+                transComp.Dirty = false;
+            }
+        };
+
+        // The spine is in hierarchy order and has to be final before any batch reads it
+        for (const auto index : m_TransformSpine)
+            updateRange(index, index + 1);
+
+        // Batches are disjoint subtrees, each one only touches its own nodes
+        concurrency::parallel_for(size_t(0), m_TransformBatches.size(), [&](const size_t i)
         {
-            SceneObject obj(entity, this);
-            visitor.Visit(obj);
-            const auto & [ModelID] = obj.GetComponent<ModelComponent>();
-            const auto model = ModelManager::GetInstance().GetModelByID(ModelID);
-            model->Accept(visitor);
+            updateRange(m_TransformBatches[i].Begin, m_TransformBatches[i].End);
+        });
+
+        m_ForceTransformUpdate = false;
+    }
+
+    void Scene::BuildTransformBatches()
+    {
+        m_TransformSpine.clear();
+        m_TransformBatches.clear();
+
+        const auto count = static_cast<uint32_t>(m_FlattenedHierarchy.size());
+        uint32_t i = 0;
+        while (i < count)
+        {
+            if (m_FlattenedHierarchy[i].SubtreeSize > TransformBatchSize)
+            {
+                // Too large for one batch, update the node itself serially and split its children
+                m_TransformSpine.push_back(i++);
+                continue;
+            }
+
+            // Merge the following small subtrees into the batch, their parents are spine nodes or none
+            const uint32_t begin = i;
+            i += m_FlattenedHierarchy[i].SubtreeSize;
+            while (i < count && m_FlattenedHierarchy[i].SubtreeSize <= TransformBatchSize - (i - begin))
+                i += m_FlattenedHierarchy[i].SubtreeSize;
+
+            m_TransformBatches.push_back({ begin, i });
         }
     }
 
+    void Scene::UpdateHierarchy()
+    {
+        ExecuteCommandBuffer(*m_CommandBuffer);
+
+        if (m_HierarchyDirty)
+            SortSceneObjects();
+
+        UpdateWorldTransforms();
+    }
+
     void Scene::SortSceneObjects()
     {
-        m_Registry.sort<IDComponent>([&](const auto lhs, const auto rhs)
+        m_FlattenedHierarchy.clear();
+
+        // Creation index first, so sorting the pairs keeps roots in creation order and the hierarchy window stable
+        std::vector<std::pair<uint64_t, entt::entity>> roots;
+        const auto hierarchies = GetAllSceneObjectsWith<HierarchyComponent>();
+        for (const auto entity : hierarchies)
         {
-            auto lhsSceneObject = m_SceneObjectIDMap.find(lhs.ID);
-            auto rhsSceneObject = m_SceneObjectIDMap.find(rhs.ID);
-            return static_cast<uint32_t>(lhsSceneObject->second) < static_cast<uint32_t>(rhsSceneObject->second);
+            if (const auto& hierarchy = hierarchies.get<HierarchyComponent>(entity); hierarchy.Parent == entt::null)
+                roots.emplace_back(hierarchy.CreationIndex, entity);
+        }
+        std::ranges::sort(roots);
+
+        m_FlattenedHierarchy.reserve(hierarchies.size());
+        for (const auto& [creationIndex, root] : roots)
+        {
+            m_Registry.get<HierarchyComponent>(root).FlattenedIndex = static_cast<uint32_t>(m_FlattenedHierarchy.size());
+            m_FlattenedHierarchy.push_back({ root, InvalidHierarchyIndex, 1, true });
+
+            ForEachDescendant(root, [this](const entt::entity entity)
+            {
+                auto& hierarchy = m_Registry.get<HierarchyComponent>(entity);
+                hierarchy.FlattenedIndex = static_cast<uint32_t>(m_FlattenedHierarchy.size());
+                m_FlattenedHierarchy.push_back({ entity, m_Registry.get<HierarchyComponent>(hierarchy.Parent).FlattenedIndex, 1, true });
+            });
+        }
+
+        // Descendants follow their parent, so a backward sweep accumulates subtree sizes
+        for (auto i = m_FlattenedHierarchy.size(); i-- > 0;)
+        {
+            if (const auto parent = m_FlattenedHierarchy[i].Parent; parent != InvalidHierarchyIndex)
+                m_FlattenedHierarchy[parent].SubtreeSize += m_FlattenedHierarchy[i].SubtreeSize;
+        }
+
+        BuildTransformBatches();
+        m_WorldMatrices.resize(m_FlattenedHierarchy.size());
+        m_ForceTransformUpdate = true;
+
+        m_Registry.sort<HierarchyComponent>([](const auto& lhs, const auto& rhs)
+        {
+            return lhs.FlattenedIndex < rhs.FlattenedIndex;
         });
+        m_Registry.sort<RelationshipComponent, HierarchyComponent>();
+        m_Registry.sort<TransformComponent, HierarchyComponent>();
+        m_Registry.sort<IDComponent, HierarchyComponent>();
+
+        m_HierarchyDirty = false;
     }
 }
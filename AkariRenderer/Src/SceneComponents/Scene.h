@@ -1,15 +1,20 @@
 #pragma once
 #include <map>
+#include <unordered_set>
 #include <entt/entt.hpp>
 #include "UUID.h"
+#include "SceneNameIndex.h"
+#include "SceneBVH.h"
 
 namespace Akari
 {
     class Event;
+    class DeltaTime;
     class Model;
     class Visitor;
     class Material;
     class SceneObject;
+    class SceneCommandBuffer;
     class EditorCamera;
     struct TransformComponent;
     
@@ -23,7 +28,15 @@ namespace Akari
         SceneObject CreateChildSceneObject(SceneObject parent, const std::string& name = "Scene Object");
         SceneObject CreateSceneObjectWithID(UUID uuid, const std::string& name = "Scene Object");
         SceneObject DuplicateSceneObject(SceneObject object);
-        void DestroySceneObject(SceneObject object, bool excludeChildren = false, bool first = true);
+        // Destroys the whole subtree, with excludeChildren the direct children are detached and kept as roots
+        void DestroySceneObject(SceneObject object, bool excludeChildren = false);
+        // Destroys every scene object, the camera and pending commands are kept
+        void Clear();
+
+        // Apply every recorded command in one batch and clear the buffer, the hierarchy is re-sorted once afterwards
+        void ExecuteCommandBuffer(SceneCommandBuffer& commandBuffer);
+        // Scene owned command buffer, executed at the start of OnUpdate
+        SceneCommandBuffer& GetCommandBuffer() { return *m_CommandBuffer; }
 
         template<typename... Components>
         auto GetAllSceneObjectsWith()
@@ -37,37 +50,110 @@ namespace Akari
         // return entity with id as specified, or empty entity if cannot be found - caller must check
         SceneObject TryGetSceneObjectWithUUID(UUID id) const;
 
-        // return entity with tag as specified, or empty entity if cannot be found - caller must check
-        SceneObject TryGetSceneObjectWithName(const std::string& name);
+        // return entity with tag as specified, or empty entity if cannot be found - caller must check.
+        // Names aren't unique, for a duplicate name which entity is returned depends on the order they were created and destroyed in
+        SceneObject TryGetSceneObjectWithName(std::string_view name);
+        // return entities whose tag starts with prefix, ordered by tag
+        std::vector<SceneObject> FindSceneObjectsWithPrefix(std::string_view prefix, size_t maxResults = SIZE_MAX);
 
         void ConvertToLocalSpace(SceneObject sceneObject);
         void ConvertToWorldSpace(SceneObject sceneObject);
+        // returns the cached world matrix produced by the last UpdateWorldTransforms(),
+        // composed along the parent chain while the hierarchy awaits re-sorting
         glm::mat4 GetWorldSpaceTransformMatrix(SceneObject sceneObject);
+        // World matrices in flattened hierarchy order, indexed by HierarchyComponent::FlattenedIndex
+        const std::vector<glm::mat4>& GetWorldMatrices() const { return m_WorldMatrices; }
         TransformComponent GetWorldSpaceTransform(SceneObject sceneObject);
+        // World space bounds of every scene object with a loaded model, refreshed by OnUpdate
+        const SceneBVH& GetBVH() const { return m_BVH; }
 
         void ParentSceneObject(SceneObject sceneObject, SceneObject parent);
         void UnparentSceneObject(SceneObject sceneObject, bool convertToWorldSpace = true);
 
         UUID GetUUID() const { return m_SceneID; }
+        // Created on first use with the size of the renderer's scene target
         std::shared_ptr<EditorCamera> GetCamera();
 
+        // Executes deferred commands, re-flattens the hierarchy if it changed, then propagates world transforms
+        void UpdateHierarchy();
+        // Per-frame sync point: UpdateHierarchy, then refits the BVH to the models that moved or finished loading
+        void OnUpdate(DeltaTime ts);
         void OnEvent(Event& event);
         
         void Accept(Visitor& visitor);
         
     private:
+        // Flatten the hierarchy depth-first and sort the registry storage so parents precede their children
         void SortSceneObjects();
+        // Recompute the world matrix of every subtree whose local transform changed since the last call,
+        // independent subtrees are processed in parallel
+        void UpdateWorldTransforms();
+        // Split the flattened hierarchy into contiguous subtree ranges of at most TransformBatchSize nodes
+        void BuildTransformBatches();
+        void MarkHierarchyDirty() { m_HierarchyDirty = true; }
+        // Refit the BVH leaves of moved objects and insert objects whose model became available
+        void UpdateBVH();
+
+        // Keep m_NameIndex in sync, names must be changed through registry.patch to be seen
+        void OnNameComponentConstruct(entt::registry& registry, entt::entity entity);
+        void OnNameComponentUpdate(entt::registry& registry, entt::entity entity);
+        void OnNameComponentDestroy(entt::registry& registry, entt::entity entity);
+        void OnModelComponentChange(entt::registry& registry, entt::entity entity);
+        void OnModelComponentDestroy(entt::registry& registry, entt::entity entity);
+        void OnHierarchyComponentConstruct(entt::registry& registry, entt::entity entity);
+
+        // Link maintenance for HierarchyComponent, the entity must be detached before it is attached again
+        void AttachToParent(entt::entity entity, entt::entity parent);
+        void DetachFromParent(entt::entity entity);
+        void UpdateHierarchyDepth(entt::entity entity, uint32_t depth);
+        // Pre-order walk over all descendants of root (root itself excluded), func must not edit the links
+        template<typename Func>
+        void ForEachDescendant(entt::entity root, Func&& func);
+
+        static constexpr uint32_t InvalidHierarchyIndex = UINT32_MAX;
+
+        static constexpr uint32_t TransformBatchSize = 2048;
+
+        struct FlattenedHierarchyNode
+        {
+            entt::entity Entity;
+            uint32_t Parent; // Index into m_FlattenedHierarchy, InvalidHierarchyIndex for roots
+            uint32_t SubtreeSize; // Node itself plus all descendants, they directly follow it
+            bool Dirty;
+        };
+
+        struct TransformBatch
+        {
+            uint32_t Begin;
+            uint32_t End;
+        };
         
         UUID m_SceneID;
         entt::entity m_SceneEntity = entt::null;
+        // Declared before the registry so it outlives any destroy signal the registry emits
+        SceneNameIndex m_NameIndex;
+        SceneBVH m_BVH;
+        // Model components added or changed since the last UpdateBVH, kept until their model has loaded
+        std::unordered_set<entt::entity> m_PendingBounds;
         entt::registry m_Registry;
 
         std::map<UUID, std::shared_ptr<Model>> m_ModelDic;
         std::map<UUID, std::shared_ptr<Material>> m_MaterialDic;
         std::unordered_map<UUID, SceneObject> m_SceneObjectIDMap;
+        std::vector<FlattenedHierarchyNode> m_FlattenedHierarchy;
+        std::vector<glm::mat4> m_WorldMatrices;
+        // Ancestors of subtrees too large for one batch, updated serially before the batches run
+        std::vector<uint32_t> m_TransformSpine;
+        std::vector<TransformBatch> m_TransformBatches;
+        bool m_HierarchyDirty = false;
+        uint64_t m_NextCreationIndex = 0;
+        // Re-sorting moves nodes around in m_WorldMatrices, so every matrix is recomputed once afterwards
+        bool m_ForceTransformUpdate = false;
 
+        std::unique_ptr<SceneCommandBuffer> m_CommandBuffer;
         std::shared_ptr<EditorCamera> m_Camera;
 
         friend class SceneObject;
+        friend class SceneSerializer;
     };
 }
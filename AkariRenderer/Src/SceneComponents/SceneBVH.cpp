@@ -0,0 +1,405 @@
+#include "pch.h"
+#include "SceneBVH.h"
+
+using namespace DirectX;
+
+namespace Akari
+{
+    static glm::vec3 GetMin(const BoundingBox& box)
+    {
+        return { box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z };
+    }
+
+    static glm::vec3 GetMax(const BoundingBox& box)
+    {
+        return { box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z };
+    }
+
+    static BoundingBox FromMinMax(const glm::vec3& min, const glm::vec3& max)
+    {
+        const glm::vec3 center = (min + max) * 0.5f;
+        const glm::vec3 extents = (max - min) * 0.5f;
+        return BoundingBox({ center.x, center.y, center.z }, { extents.x, extents.y, extents.z });
+    }
+
+    // Half the surface area, only ever compared against other areas
+    static float HalfArea(const glm::vec3& min, const glm::vec3& max)
+    {
+        const glm::vec3 size = max - min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    static float HalfArea(const BoundingBox& box)
+    {
+        return HalfArea(GetMin(box), GetMax(box));
+    }
+
+    static BoundingBox Merge(const BoundingBox& lhs, const BoundingBox& rhs)
+    {
+        return FromMinMax(glm::min(GetMin(lhs), GetMin(rhs)), glm::max(GetMax(lhs), GetMax(rhs)));
+    }
+
+    static bool Equal(const BoundingBox& lhs, const BoundingBox& rhs)
+    {
+        return lhs.Center.x == rhs.Center.x && lhs.Center.y == rhs.Center.y && lhs.Center.z == rhs.Center.z &&
+               lhs.Extents.x == rhs.Extents.x && lhs.Extents.y == rhs.Extents.y && lhs.Extents.z == rhs.Extents.z;
+    }
+
+    void SceneBVH::Insert(entt::entity entity, const BoundingBox& bounds)
+    {
+        assert(!Contains(entity) && "Entity is already in the BVH");
+
+        const int32_t leaf = AllocateNode();
+        m_Nodes[leaf].Bounds = bounds;
+        m_Nodes[leaf].Entity = entity;
+        m_Leaves.emplace(entity, leaf);
+
+        InsertLeaf(leaf);
+        m_ChangesSinceCheck++;
+    }
+
+    void SceneBVH::Update(entt::entity entity, const BoundingBox& bounds)
+    {
+        const auto iter = m_Leaves.find(entity);
+        if (iter == m_Leaves.end())
+        {
+            Insert(entity, bounds);
+            return;
+        }
+
+        m_Nodes[iter->second].Bounds = bounds;
+        Refit(m_Nodes[iter->second].Parent);
+        m_ChangesSinceCheck++;
+    }
+
+    void SceneBVH::Remove(entt::entity entity)
+    {
+        const auto iter = m_Leaves.find(entity);
+        if (iter == m_Leaves.end())
+            return;
+
+        RemoveLeaf(iter->second);
+        FreeNode(iter->second);
+        m_Leaves.erase(iter);
+        m_ChangesSinceCheck++;
+    }
+
+    void SceneBVH::Clear()
+    {
+        m_Nodes.clear();
+        m_FreeNodes.clear();
+        m_Leaves.clear();
+        m_Root = NullNode;
+        m_BuildCost = 0.0f;
+        m_ChangesSinceCheck = 0;
+    }
+
+    void SceneBVH::Optimize()
+    {
+        if (m_Leaves.size() < 2 || m_ChangesSinceCheck < std::max<size_t>(64, m_Leaves.size() / 8))
+            return;
+
+        m_ChangesSinceCheck = 0;
+        if (m_BuildCost == 0.0f || GetCost() > m_BuildCost * RebuildCostRatio)
+            Rebuild();
+    }
+
+    void SceneBVH::Rebuild()
+    {
+        std::vector<BuildItem> items;
+        items.reserve(m_Leaves.size());
+        for (const auto& [entity, leaf] : m_Leaves)
+            items.push_back({ GetMin(m_Nodes[leaf].Bounds), GetMax(m_Nodes[leaf].Bounds), entity });
+
+        m_Nodes.clear();
+        m_FreeNodes.clear();
+        m_Nodes.reserve(items.size() * 2);
+        m_Root = items.empty() ? NullNode : Build(items, NullNode);
+
+        m_BuildCost = GetCost();
+        m_ChangesSinceCheck = 0;
+    }
+
+    float SceneBVH::GetCost() const
+    {
+        if (m_Root == NullNode || m_Nodes[m_Root].IsLeaf())
+            return 0.0f;
+
+        const float rootArea = HalfArea(m_Nodes[m_Root].Bounds);
+        if (rootArea <= 0.0f)
+            return 0.0f;
+
+        // Free nodes are reset and count as leaves
+        float cost = 0.0f;
+        for (const auto& node : m_Nodes)
+        {
+            if (!node.IsLeaf())
+                cost += HalfArea(node.Bounds);
+        }
+
+        return cost / rootArea;
+    }
+
+    DirectX::BoundingBox SceneBVH::GetBounds() const
+    {
+        if (m_Root == NullNode)
+            return DirectX::BoundingBox({ 0, 0, 0 }, { 0, 0, 0 });
+
+        return m_Nodes[m_Root].Bounds;
+    }
+
+    int32_t SceneBVH::AllocateNode()
+    {
+        if (!m_FreeNodes.empty())
+        {
+            const int32_t index = m_FreeNodes.back();
+            m_FreeNodes.pop_back();
+            return index;
+        }
+
+        m_Nodes.emplace_back();
+        return static_cast<int32_t>(m_Nodes.size() - 1);
+    }
+
+    void SceneBVH::FreeNode(int32_t index)
+    {
+        m_Nodes[index] = Node();
+        m_FreeNodes.push_back(index);
+    }
+
+    void SceneBVH::InsertLeaf(int32_t leaf)
+    {
+        if (m_Root == NullNode)
+        {
+            m_Root = leaf;
+            m_Nodes[leaf].Parent = NullNode;
+            return;
+        }
+
+        // Descend towards the sibling that adds the least surface area to the tree
+        const BoundingBox bounds = m_Nodes[leaf].Bounds;
+        int32_t index = m_Root;
+        while (!m_Nodes[index].IsLeaf())
+        {
+            const Node& node = m_Nodes[index];
+            const float area = HalfArea(node.Bounds);
+            const float combinedArea = HalfArea(Merge(node.Bounds, bounds));
+
+            // Pairing with this node creates a parent of the combined size,
+            // going further down still grows this node and every ancestor pays for it
+            const float cost = 2.0f * combinedArea;
+            const float inheritedCost = 2.0f * (combinedArea - area);
+
+            auto childCost = [&](const int32_t child)
+            {
+                const Node& childNode = m_Nodes[child];
+                const float mergedArea = HalfArea(Merge(childNode.Bounds, bounds));
+                return (childNode.IsLeaf() ? mergedArea : mergedArea - HalfArea(childNode.Bounds)) + inheritedCost;
+            };
+
+            const float leftCost = childCost(node.Left);
+            const float rightCost = childCost(node.Right);
+            if (cost < leftCost && cost < rightCost)
+                break;
+
+            index = leftCost < rightCost ? node.Left : node.Right;
+        }
+
+        const int32_t sibling = index;
+        const int32_t oldParent = m_Nodes[sibling].Parent;
+        const int32_t newParent = AllocateNode();
+
+        m_Nodes[newParent].Parent = oldParent;
+        m_Nodes[newParent].Left = sibling;
+        m_Nodes[newParent].Right = leaf;
+        m_Nodes[newParent].Bounds = Merge(m_Nodes[sibling].Bounds, bounds);
+        m_Nodes[sibling].Parent = newParent;
+        m_Nodes[leaf].Parent = newParent;
+
+        if (oldParent == NullNode)
+        {
+            m_Root = newParent;
+            return;
+        }
+
+        if (m_Nodes[oldParent].Left == sibling)
+            m_Nodes[oldParent].Left = newParent;
+        else
+            m_Nodes[oldParent].Right = newParent;
+
+        Refit(oldParent);
+    }
+
+    void SceneBVH::RemoveLeaf(int32_t leaf)
+    {
+        if (leaf == m_Root)
+        {
+            m_Root = NullNode;
+            return;
+        }
+
+        // The sibling takes the place of the parent
+        const int32_t parent = m_Nodes[leaf].Parent;
+        const int32_t grandParent = m_Nodes[parent].Parent;
+        const int32_t sibling = m_Nodes[parent].Left == leaf ? m_Nodes[parent].Right : m_Nodes[parent].Left;
+
+        m_Nodes[sibling].Parent = grandParent;
+        if (grandParent == NullNode)
+        {
+            m_Root = sibling;
+        }
+        else
+        {
+            if (m_Nodes[grandParent].Left == parent)
+                m_Nodes[grandParent].Left = sibling;
+            else
+                m_Nodes[grandParent].Right = sibling;
+
+            Refit(grandParent);
+        }
+
+        FreeNode(parent);
+    }
+
+    void SceneBVH::Refit(int32_t index)
+    {
+        while (index != NullNode)
+        {
+            Node& node = m_Nodes[index];
+            const BoundingBox merged = Merge(m_Nodes[node.Left].Bounds, m_Nodes[node.Right].Bounds);
+            if (Equal(merged, node.Bounds))
+                break;
+
+            node.Bounds = merged;
+            index = node.Parent;
+        }
+    }
+
+    int32_t SceneBVH::Build(std::span<BuildItem> items, int32_t parent)
+    {
+        const int32_t index = AllocateNode();
+        m_Nodes[index].Parent = parent;
+
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (const auto& item : items)
+        {
+            boundsMin = glm::min(boundsMin, item.Min);
+            boundsMax = glm::max(boundsMax, item.Max);
+            centroidMin = glm::min(centroidMin, (item.Min + item.Max) * 0.5f);
+            centroidMax = glm::max(centroidMax, (item.Min + item.Max) * 0.5f);
+        }
+
+        m_Nodes[index].Bounds = FromMinMax(boundsMin, boundsMax);
+
+        if (items.size() == 1)
+        {
+            m_Nodes[index].Entity = items[0].Entity;
+            m_Leaves[items[0].Entity] = index;
+            return index;
+        }
+
+        // Binned SAH, the centroid bounds of every axis are split into BinCount bins
+        // and every bin boundary is evaluated as split plane
+        constexpr int BinCount = 16;
+
+        struct Bin
+        {
+            glm::vec3 Min = glm::vec3(FLT_MAX);
+            glm::vec3 Max = glm::vec3(-FLT_MAX);
+            uint32_t Count = 0;
+        };
+
+        auto binIndex = [&](const BuildItem& item, const int axis)
+        {
+            const float centroid = (item.Min[axis] + item.Max[axis]) * 0.5f;
+            const float scale = BinCount / (centroidMax[axis] - centroidMin[axis]);
+            return std::min(static_cast<int>((centroid - centroidMin[axis]) * scale), BinCount - 1);
+        };
+
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = FLT_MAX;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (centroidMax[axis] <= centroidMin[axis])
+                continue;
+
+            std::array<Bin, BinCount> bins;
+            for (const auto& item : items)
+            {
+                Bin& bin = bins[binIndex(item, axis)];
+                bin.Min = glm::min(bin.Min, item.Min);
+                bin.Max = glm::max(bin.Max, item.Max);
+                bin.Count++;
+            }
+
+            // Area and count right of every split, split i puts bins [0, i) on the left
+            std::array<float, BinCount> rightArea{};
+            std::array<uint32_t, BinCount> rightCount{};
+            Bin right;
+            for (int i = BinCount - 1; i > 0; --i)
+            {
+                right.Min = glm::min(right.Min, bins[i].Min);
+                right.Max = glm::max(right.Max, bins[i].Max);
+                right.Count += bins[i].Count;
+                rightArea[i] = right.Count > 0 ? HalfArea(right.Min, right.Max) : 0.0f;
+                rightCount[i] = right.Count;
+            }
+
+            Bin left;
+            for (int i = 1; i < BinCount; ++i)
+            {
+                left.Min = glm::min(left.Min, bins[i - 1].Min);
+                left.Max = glm::max(left.Max, bins[i - 1].Max);
+                left.Count += bins[i - 1].Count;
+                if (left.Count == 0 || rightCount[i] == 0)
+                    continue;
+
+                const float cost = HalfArea(left.Min, left.Max) * left.Count + rightArea[i] * rightCount[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        size_t split = 0;
+        if (bestAxis >= 0)
+        {
+            const auto middle = std::partition(items.begin(), items.end(), [&](const BuildItem& item)
+            {
+                return binIndex(item, bestAxis) < bestSplit;
+            });
+            split = static_cast<size_t>(middle - items.begin());
+        }
+
+        // Coincident centroids leave nothing to bin, split them in half
+        if (split == 0 || split == items.size())
+            split = items.size() / 2;
+
+        const int32_t left = Build(items.first(split), index);
+        const int32_t right = Build(items.subspan(split), index);
+        m_Nodes[index].Left = left;
+        m_Nodes[index].Right = right;
+
+        return index;
+    }
+
+    bool SceneBVH::IntersectRay(const BoundingBox& box, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance)
+    {
+        // Slab test, the ray is inside the box between the last entry and the first exit
+        const glm::vec3 t0 = (GetMin(box) - origin) * invDirection;
+        const glm::vec3 t1 = (GetMax(box) - origin) * invDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+
+        const float enter = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+        const float exit = std::min({ tFar.x, tFar.y, tFar.z, maxDistance });
+
+        distance = enter;
+        return enter <= exit;
+    }
+}
@@ -0,0 +1,218 @@
+#pragma once
+#include <span>
+#include <DirectXCollision.h>
+#include <entt/entt.hpp>
+
+#include "Math/Frustum.h"
+
+namespace Akari
+{
+    // Dynamic AABB tree over scene entities, one leaf per entity.
+    // Changed bounds are refit in place, new leaves go next to the sibling that grows the tree the least,
+    // and the tree is rebuilt top-down with a binned SAH once refits have degraded it.
+    // Queries only read the tree and may run concurrently with each other.
+    class SceneBVH
+    {
+    public:
+        void Insert(entt::entity entity, const DirectX::BoundingBox& bounds);
+        void Update(entt::entity entity, const DirectX::BoundingBox& bounds);
+        void Remove(entt::entity entity);
+        void Clear();
+
+        bool Contains(entt::entity entity) const { return m_Leaves.contains(entity); }
+        size_t Size() const { return m_Leaves.size(); }
+
+        // Rebuild if the tree got RebuildCostRatio times more expensive than after the last rebuild,
+        // only measured after enough changes to be worth the O(n) cost evaluation
+        void Optimize();
+        void Rebuild();
+        // Surface area heuristic cost: summed area of the internal nodes relative to the root
+        float GetCost() const;
+        // Bounds of every entity in the tree, empty at the origin for an empty tree
+        DirectX::BoundingBox GetBounds() const;
+
+        // func(entity, inside) for every leaf touching the frustum, inside is true if the whole leaf is
+        template<typename Func>
+        void QueryFrustum(const Frustum& frustum, Func&& func) const;
+        // func(entity, distance) for every leaf the ray enters before maxDistance, nearest subtrees first.
+        // func returns the new maxDistance, so closest hit queries prune everything behind their best hit
+        template<typename Func>
+        void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Func&& func) const;
+
+        static constexpr float RebuildCostRatio = 1.3f;
+
+    private:
+        static constexpr int32_t NullNode = -1;
+
+        struct Node
+        {
+            DirectX::BoundingBox Bounds;
+            int32_t Parent = NullNode;
+            int32_t Left = NullNode;
+            int32_t Right = NullNode;
+            entt::entity Entity = entt::null;
+
+            bool IsLeaf() const { return Left == NullNode; }
+        };
+
+        struct BuildItem
+        {
+            glm::vec3 Min;
+            glm::vec3 Max;
+            entt::entity Entity;
+        };
+
+        int32_t AllocateNode();
+        void FreeNode(int32_t index);
+        void InsertLeaf(int32_t leaf);
+        void RemoveLeaf(int32_t leaf);
+        // Recompute bounds from index up to the root, stops once a node no longer changes
+        void Refit(int32_t index);
+        int32_t Build(std::span<BuildItem> items, int32_t parent);
+
+        template<typename Overlaps, typename Func>
+        void Traverse(int32_t start, Overlaps&& overlaps, Func&& func) const;
+        template<typename Func>
+        void ForEachLeaf(int32_t index, Func&& func) const;
+
+        static bool IntersectRay(const DirectX::BoundingBox& box, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance);
+
+        std::vector<Node> m_Nodes;
+        std::vector<int32_t> m_FreeNodes;
+        std::unordered_map<entt::entity, int32_t> m_Leaves;
+        int32_t m_Root = NullNode;
+
+        float m_BuildCost = 0.0f;
+        size_t m_ChangesSinceCheck = 0;
+    };
+
+    template<typename Overlaps, typename Func>
+    void SceneBVH::Traverse(int32_t start, Overlaps&& overlaps, Func&& func) const
+    {
+        if (start == NullNode)
+            return;
+
+        std::vector<int32_t> stack;
+        stack.reserve(64);
+        stack.push_back(start);
+        while (!stack.empty())
+        {
+            const Node& node = m_Nodes[stack.back()];
+            stack.pop_back();
+
+            if (!overlaps(node.Bounds))
+                continue;
+
+            if (node.IsLeaf())
+            {
+                func(node.Entity);
+                continue;
+            }
+
+            stack.push_back(node.Right);
+            stack.push_back(node.Left);
+        }
+    }
+
+    template<typename Func>
+    void SceneBVH::ForEachLeaf(int32_t index, Func&& func) const
+    {
+        Traverse(index, [](const DirectX::BoundingBox&) { return true; }, func);
+    }
+
+    template<typename Func>
+    void SceneBVH::QueryFrustum(const Frustum& frustum, Func&& func) const
+    {
+        if (m_Root == NullNode)
+            return;
+
+        std::vector<int32_t> stack;
+        stack.reserve(64);
+        stack.push_back(m_Root);
+        while (!stack.empty())
+        {
+            const int32_t index = stack.back();
+            stack.pop_back();
+
+            const Node& node = m_Nodes[index];
+            const FrustumTest test = frustum.Test(node.Bounds);
+            if (test == FrustumTest::Outside)
+                continue;
+
+            if (node.IsLeaf())
+            {
+                func(node.Entity, test == FrustumTest::Inside);
+                continue;
+            }
+
+            // A contained subtree needs no further plane tests
+            if (test == FrustumTest::Inside)
+            {
+                ForEachLeaf(index, [&](const entt::entity entity) { func(entity, true); });
+                continue;
+            }
+
+            stack.push_back(node.Right);
+            stack.push_back(node.Left);
+        }
+    }
+
+    template<typename Func>
+    void SceneBVH::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Func&& func) const
+    {
+        if (m_Root == NullNode)
+            return;
+
+        const glm::vec3 invDirection = Math::SafeInverse(direction);
+
+        float distance;
+        if (!IntersectRay(m_Nodes[m_Root].Bounds, origin, invDirection, maxDistance, distance))
+            return;
+
+        // Entry distance is kept with each node, so nodes behind a closer hit are dropped when popped
+        std::vector<std::pair<int32_t, float>> stack;
+        stack.reserve(64);
+        stack.emplace_back(m_Root, distance);
+        while (!stack.empty())
+        {
+            const auto [index, entry] = stack.back();
+            stack.pop_back();
+            if (entry > maxDistance)
+                continue;
+
+            const Node& node = m_Nodes[index];
+            if (node.IsLeaf())
+            {
+                maxDistance = func(node.Entity, entry);
+                continue;
+            }
+
+            float leftDistance, rightDistance;
+            const bool hitLeft = IntersectRay(m_Nodes[node.Left].Bounds, origin, invDirection, maxDistance, leftDistance);
+            const bool hitRight = IntersectRay(m_Nodes[node.Right].Bounds, origin, invDirection, maxDistance, rightDistance);
+
+            // Push the far child first so the near one is visited first
+            if (hitLeft && hitRight)
+            {
+                if (leftDistance < rightDistance)
+                {
+                    stack.emplace_back(node.Right, rightDistance);
+                    stack.emplace_back(node.Left, leftDistance);
+                }
+                else
+                {
+                    stack.emplace_back(node.Left, leftDistance);
+                    stack.emplace_back(node.Right, rightDistance);
+                }
+            }
+            else if (hitLeft)
+            {
+                stack.emplace_back(node.Left, leftDistance);
+            }
+            else if (hitRight)
+            {
+                stack.emplace_back(node.Right, rightDistance);
+            }
+        }
+    }
+}
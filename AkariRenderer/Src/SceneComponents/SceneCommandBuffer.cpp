@@ -0,0 +1,40 @@
+#include "pch.h"
+#include "SceneCommandBuffer.h"
+
+namespace Akari
+{
+    UUID SceneCommandBuffer::CreateSceneObject(const std::string& name, UUID parent)
+    {
+        const UUID id{};
+        Record({ CommandType::Create, id, parent, name, false, nullptr });
+        return id;
+    }
+
+    void SceneCommandBuffer::DestroySceneObject(UUID id, bool excludeChildren)
+    {
+        Record({ CommandType::Destroy, id, 0, {}, excludeChildren, nullptr });
+    }
+
+    void SceneCommandBuffer::ParentSceneObject(UUID id, UUID parent)
+    {
+        Record({ CommandType::Reparent, id, parent, {}, false, nullptr });
+    }
+
+    bool SceneCommandBuffer::IsEmpty() const
+    {
+        std::scoped_lock lock(m_Mutex);
+        return m_Commands.empty();
+    }
+
+    size_t SceneCommandBuffer::GetCommandCount() const
+    {
+        std::scoped_lock lock(m_Mutex);
+        return m_Commands.size();
+    }
+
+    void SceneCommandBuffer::Record(Command&& command)
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_Commands.push_back(std::move(command));
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <mutex>
+
+#include "SceneObject.h"
+
+namespace Akari
+{
+    // Records structural scene changes so they can be filled from any thread and
+    // applied in one batch by Scene::ExecuteCommandBuffer at the frame sync point.
+    class SceneCommandBuffer
+    {
+    public:
+        SceneCommandBuffer() = default;
+        SceneCommandBuffer(const SceneCommandBuffer&) = delete;
+        SceneCommandBuffer& operator=(const SceneCommandBuffer&) = delete;
+
+        // The returned id is reserved immediately and can be referenced by later commands
+        UUID CreateSceneObject(const std::string& name = "Scene Object", UUID parent = 0);
+        void DestroySceneObject(UUID id, bool excludeChildren = false);
+        // Parent 0 detaches the object, the local transform is kept as is
+        void ParentSceneObject(UUID id, UUID parent);
+
+        template<typename T, typename... Args>
+        void AddComponent(UUID id, Args&&... args)
+        {
+            Record({ CommandType::AddComponent, id, 0, {}, false,
+                [... args = std::forward<Args>(args)](SceneObject& object)
+                {
+                    object.AddComponent<T>(args...);
+                }
+            });
+        }
+
+        bool IsEmpty() const;
+        size_t GetCommandCount() const;
+
+    private:
+        enum class CommandType
+        {
+            Create,
+            Destroy,
+            Reparent,
+            AddComponent
+        };
+
+        struct Command
+        {
+            CommandType Type;
+            UUID Target;
+            UUID Parent;
+            std::string Name;
+            bool ExcludeChildren;
+            std::function<void(SceneObject&)> AddComponent;
+        };
+
+        void Record(Command&& command);
+
+        mutable std::mutex m_Mutex;
+        std::vector<Command> m_Commands;
+
+        friend class Scene;
+    };
+}
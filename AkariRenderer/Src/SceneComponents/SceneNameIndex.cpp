@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "SceneNameIndex.h"
+
+namespace Akari
+{
+    void SceneNameIndex::Add(entt::entity entity, std::string_view name)
+    {
+        auto iter = m_Entities.find(name);
+        if (iter == m_Entities.end())
+        {
+            iter = m_Entities.emplace(std::string(name), std::vector<entt::entity>{}).first;
+            m_SortedNames.insert(iter->first);
+        }
+
+        m_EntityNames[entity] = { iter->first, iter->second.size() };
+        iter->second.push_back(entity);
+    }
+
+    void SceneNameIndex::Remove(entt::entity entity)
+    {
+        const auto nameIter = m_EntityNames.find(entity);
+        if (nameIter == m_EntityNames.end())
+            return;
+
+        const auto iter = m_Entities.find(nameIter->second.Name);
+        const size_t slot = nameIter->second.Slot;
+        m_EntityNames.erase(nameIter);
+        assert(iter != m_Entities.end() && iter->second[slot] == entity);
+
+        auto& entities = iter->second;
+        if (slot + 1 != entities.size())
+        {
+            entities[slot] = entities.back();
+            m_EntityNames[entities[slot]].Slot = slot;
+        }
+        entities.pop_back();
+        if (entities.empty())
+        {
+            // The sorted view points into the key, drop it before the key goes away
+            m_SortedNames.erase(iter->first);
+            m_Entities.erase(iter);
+        }
+    }
+
+    void SceneNameIndex::Rename(entt::entity entity, std::string_view name)
+    {
+        if (const auto iter = m_EntityNames.find(entity); iter != m_EntityNames.end() && iter->second.Name == name)
+            return;
+
+        // The new name may be a view into the interned key that Remove() frees, copy it first
+        const std::string newName(name);
+        Remove(entity);
+        Add(entity, newName);
+    }
+
+    void SceneNameIndex::Clear()
+    {
+        m_SortedNames.clear();
+        m_EntityNames.clear();
+        m_Entities.clear();
+    }
+
+    const std::vector<entt::entity>* SceneNameIndex::Find(std::string_view name) const
+    {
+        const auto iter = m_Entities.find(name);
+        return iter != m_Entities.end() ? &iter->second : nullptr;
+    }
+
+    void SceneNameIndex::FindWithPrefix(std::string_view prefix, std::vector<entt::entity>& result, size_t maxResults) const
+    {
+        for (auto iter = m_SortedNames.lower_bound(prefix); iter != m_SortedNames.end() && iter->starts_with(prefix); ++iter)
+        {
+            for (const auto entity : m_Entities.find(*iter)->second)
+            {
+                if (result.size() >= maxResults)
+                    return;
+                result.push_back(entity);
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <set>
+#include <string_view>
+#include <entt/entt.hpp>
+
+namespace Akari
+{
+    // Interned name -> entities lookup kept in sync with NameComponent by the Scene's registry hooks.
+    // Exact lookups hash once, prefix queries only visit the names that actually match.
+    class SceneNameIndex
+    {
+    public:
+        void Add(entt::entity entity, std::string_view name);
+        void Remove(entt::entity entity);
+        void Rename(entt::entity entity, std::string_view name);
+        void Clear();
+
+        // Entities carrying exactly this name in no particular order, nullptr if there are none
+        const std::vector<entt::entity>* Find(std::string_view name) const;
+        // Appends entities whose name starts with prefix, in name order, until maxResults are collected
+        void FindWithPrefix(std::string_view prefix, std::vector<entt::entity>& result, size_t maxResults = SIZE_MAX) const;
+
+    private:
+        struct StringHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+        };
+
+        // Node based map, so keys stay put and can be referenced by the views below
+        std::unordered_map<std::string, std::vector<entt::entity>, StringHash, std::equal_to<>> m_Entities;
+        std::set<std::string_view> m_SortedNames;
+        // Where each entity sits in its name's list, so removal is a swap with the last entity
+        struct EntityName
+        {
+            std::string_view Name;
+            size_t Slot;
+        };
+        std::unordered_map<entt::entity, EntityName> m_EntityNames;
+    };
+}
@@ -63,7 +63,12 @@ namespace Akari
         }
 
         [[nodiscard]] TransformComponent& Transform() const { return m_Scene->m_Registry.get<TransformComponent>(m_EntityHandle); }
-        [[nodiscard]] std::string& Name() const { return m_Scene->m_Registry.get<NameComponent>(m_EntityHandle); }
+        [[nodiscard]] const std::string& Name() const { return m_Scene->m_Registry.get<NameComponent>(m_EntityHandle); }
+        // Goes through patch so the scene's name index sees the change
+        void SetName(const std::string& name)
+        {
+            m_Scene->m_Registry.patch<NameComponent>(m_EntityHandle, [&name](NameComponent& component) { component.Name = name; });
+        }
 
         operator uint32_t () const { return static_cast<uint32_t>(m_EntityHandle); }
         operator entt::entity () const { return m_EntityHandle; }
@@ -81,67 +86,76 @@ namespace Akari
 
         SceneObject GetParent() const
         {
-            return m_Scene->TryGetSceneObjectWithUUID(GetParentUUID());
+            const auto parent = GetComponent<HierarchyComponent>().Parent;
+            return parent != entt::null ? SceneObject(parent, m_Scene) : SceneObject {};
         }
 
+        // Passing an empty SceneObject detaches, the local transform is kept as is
         void SetParent(SceneObject parent)
         {
-            SceneObject currentParent = GetParent();
-            if (currentParent == parent)
+            if (GetParent() == parent)
                 return;
 
-            // If changing parent, remove child from existing parent
-            if (currentParent)
-                currentParent.RemoveChild(*this);
-
-            // Setting to null is okay
-            SetParentUUID(parent.GetUUID());
+            // Refuse to parent an object to itself or one of its descendants
+            if (parent && (parent == *this || IsAncestorOf(parent)))
+                return;
 
+            m_Scene->DetachFromParent(m_EntityHandle);
             if (parent)
-            {
-                auto& parentChildren = parent.Children();
-                UUID uuid = GetUUID();
-                if (std::ranges::find(parentChildren, uuid) == parentChildren.end())
-                    parentChildren.emplace_back(GetUUID());
-            }
+                m_Scene->AttachToParent(m_EntityHandle, parent.m_EntityHandle);
+
+            Transform().MarkDirty();
+            m_Scene->MarkHierarchyDirty();
         }
 
-        void SetParentUUID(UUID parent) { GetComponent<RelationshipComponent>().ParentHandle = parent; }
         UUID GetParentUUID() const { return GetComponent<RelationshipComponent>().ParentHandle; }
-        std::vector<UUID>& Children() { return GetComponent<RelationshipComponent>().Children; }
-        const std::vector<UUID>& Children() const { return GetComponent<RelationshipComponent>().Children; }
 
-        bool RemoveChild(SceneObject child)
+        bool HasChildren() const { return GetComponent<HierarchyComponent>().FirstChild != entt::null; }
+        uint32_t GetChildCount() const { return GetComponent<HierarchyComponent>().ChildCount; }
+        uint32_t GetDepth() const { return GetComponent<HierarchyComponent>().Depth; }
+
+        SceneObject GetFirstChild() const
         {
-            UUID childId = child.GetUUID();
-            std::vector<UUID>& children = Children();
-            const auto it = std::ranges::find(children, childId);
-            if (it != children.end())
-            {
-                children.erase(it);
-                return true;
-            }
+            const auto child = GetComponent<HierarchyComponent>().FirstChild;
+            return child != entt::null ? SceneObject(child, m_Scene) : SceneObject {};
+        }
 
-            return false;
+        SceneObject GetNextSibling() const
+        {
+            const auto sibling = GetComponent<HierarchyComponent>().NextSibling;
+            return sibling != entt::null ? SceneObject(sibling, m_Scene) : SceneObject {};
         }
 
-        bool IsAncestorOf(SceneObject entity) const
+        // Snapshot of the direct children, safe to iterate while the hierarchy is modified
+        std::vector<SceneObject> GetChildren() const
         {
-            const auto& children = Children();
+            std::vector<SceneObject> children;
+            children.reserve(GetChildCount());
+            for (auto child = GetFirstChild(); child; child = child.GetNextSibling())
+                children.push_back(child);
+            return children;
+        }
 
-            if (children.empty())
+        bool RemoveChild(SceneObject child)
+        {
+            if (child.GetComponent<HierarchyComponent>().Parent != m_EntityHandle)
                 return false;
 
-            for (UUID child : children)
-            {
-                if (child == entity.GetUUID())
-                    return true;
-            }
+            child.SetParent({});
+            return true;
+        }
 
-            for (UUID child : children)
+        bool IsAncestorOf(SceneObject entity) const
+        {
+            // Walk up from the candidate, only the depth difference has to be covered
+            const auto& registry = m_Scene->m_Registry;
+            const uint32_t depth = GetComponent<HierarchyComponent>().Depth;
+            const auto* current = &entity.GetComponent<HierarchyComponent>();
+            while (current->Depth > depth)
             {
-                if (m_Scene->GetSceneObjectWithUUID(child).IsAncestorOf(entity))
+                if (current->Parent == m_EntityHandle)
                     return true;
+                current = &registry.get<HierarchyComponent>(current->Parent);
             }
 
             return false;
@@ -0,0 +1,52 @@
+#include "pch.h"
+#include "ScenePicker.h"
+
+#include "Components.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "ModelManager.h"
+#include "Scene.h"
+#include "TriangleBVH.h"
+
+namespace Akari
+{
+    ScenePicker::ScenePicker(Scene& scene)
+        : m_Scene(scene)
+    {
+    }
+
+    std::optional<PickResult> ScenePicker::Pick(const glm::vec3& origin, const glm::vec3& direction) const
+    {
+        auto& modelManager = ModelManager::GetInstance();
+
+        std::optional<PickResult> result;
+        float closest = FLT_MAX;
+        m_Scene.GetBVH().QueryRay(origin, direction, closest, [&](const entt::entity entity, float)
+        {
+            SceneObject object(entity, &m_Scene);
+            const auto model = modelManager.GetModelByID(object.GetComponent<ModelComponent>().ModelID);
+            if (!model)
+                return closest;
+
+            // An affine transform keeps the ray parameter, so mesh space hit distances are world space distances
+            const glm::mat4 inverseWorld = glm::inverse(m_Scene.GetWorldSpaceTransformMatrix(object));
+            const glm::vec3 localOrigin = inverseWorld * glm::vec4(origin, 1.0f);
+            const glm::vec3 localDirection = inverseWorld * glm::vec4(direction, 0.0f);
+
+            for (Mesh* mesh : model->GetFlattenedMeshes())
+            {
+                const TriangleBVH* triangleBVH = mesh->GetTriangleBVH();
+                TriangleBVH::Hit hit;
+                if (!triangleBVH || !triangleBVH->Intersect(localOrigin, localDirection, closest, hit))
+                    continue;
+
+                closest = hit.Distance;
+                result = PickResult{ object, mesh, hit.Triangle, hit.Distance, origin + direction * hit.Distance };
+            }
+
+            return closest;
+        });
+
+        return result;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <optional>
+
+#include "SceneObject.h"
+
+namespace Akari
+{
+    class Mesh;
+    class Scene;
+
+    struct PickResult
+    {
+        SceneObject Object;
+        Mesh* PickedMesh;
+        // Triangle index within the mesh's index list
+        uint32_t Triangle;
+        float Distance;
+        glm::vec3 Position;
+    };
+
+    // Closest triangle hit by a world space ray. Candidate objects come nearest first from the scene BVH,
+    // so objects whose bounds start behind the closest hit are never tested, and each mesh is tested
+    // through its TriangleBVH in mesh space.
+    class ScenePicker
+    {
+    public:
+        explicit ScenePicker(Scene& scene);
+
+        std::optional<PickResult> Pick(const glm::vec3& origin, const glm::vec3& direction) const;
+
+    private:
+        Scene& m_Scene;
+    };
+}
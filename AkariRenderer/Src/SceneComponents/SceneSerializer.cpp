@@ -0,0 +1,474 @@
+#include "pch.h"
+#include "SceneSerializer.h"
+
+#include <span>
+#include <unordered_set>
+
+#include "Scene.h"
+#include "SceneObject.h"
+#include "Components.h"
+#include "MappedFile.h"
+#include "ModelManager.h"
+#include "Timing/Timer.h"
+
+namespace Akari
+{
+    namespace
+    {
+        constexpr uint32_t SceneFileMagic = 'A' | ('K' << 8) | ('S' << 16) | ('C' << 24);
+        constexpr uint64_t SceneBlockAlignment = 64;
+        constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+        // Reserved model path table entries for the ModelManager's built-in geometry
+        constexpr std::string_view CubeModelPath = "<builtin:cube>";
+        constexpr std::string_view SphereModelPath = "<builtin:sphere>";
+
+        enum class SceneBlock : uint32_t
+        {
+            IDs,                    // uint64_t per scene object
+            Parents,                // uint32_t index of the parent scene object, parents precede their children
+            Transforms,             // TransformComponent per scene object
+            NameOffsets,            // uint32_t per scene object + 1, ranges into NameData
+            NameData,               // UTF-8 characters
+            DirectionalLightOwners, // uint32_t scene object index per light
+            DirectionalLights,      // DirectionalLightComponent
+            PointLightOwners,       // uint32_t scene object index per light
+            PointLights,            // PointLightComponent
+            ModelOwners,            // uint32_t scene object index per model
+            Models,                 // uint32_t index into the model path table
+            ModelPathOffsets,       // uint32_t per model path + 1, ranges into ModelPathData
+            ModelPathData,          // UTF-8 characters
+            Count
+        };
+
+        struct SceneFileHeader
+        {
+            uint32_t Magic;
+            uint32_t Version;
+            uint32_t SceneObjectCount;
+            uint32_t BlockCount;
+        };
+
+        struct SceneBlockDesc
+        {
+            uint64_t Offset;
+            uint64_t Count;
+            uint32_t ElementSize;
+            uint32_t Reserved;
+        };
+
+        // The blocks are copied into the registry as is
+        static_assert(std::is_trivially_copyable_v<TransformComponent>);
+        static_assert(std::is_trivially_copyable_v<DirectionalLightComponent>);
+        static_assert(std::is_trivially_copyable_v<PointLightComponent>);
+
+        class SceneFileWriter
+        {
+        public:
+            template<typename T>
+            void Write(SceneBlock block, const std::vector<T>& elements)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                Write(block, elements.data(), elements.size(), sizeof(T));
+            }
+
+            void Write(SceneBlock block, const void* data, size_t count, size_t elementSize)
+            {
+                const uint64_t offset = AlignUp(m_Data.size());
+                m_Data.resize(offset + count * elementSize);
+                if (count > 0)
+                    std::memcpy(m_Data.data() + offset, data, count * elementSize);
+
+                m_Blocks[static_cast<size_t>(block)] = { offset, count, static_cast<uint32_t>(elementSize), 0 };
+            }
+
+            bool Save(const std::filesystem::path& path, uint32_t sceneObjectCount) const
+            {
+                const SceneFileHeader header { SceneFileMagic, SceneSerializer::Version, sceneObjectCount, static_cast<uint32_t>(SceneBlock::Count) };
+
+                // Blocks were laid out relative to the data section, the file stores absolute offsets
+                const uint64_t dataStart = AlignUp(sizeof(SceneFileHeader) + sizeof(m_Blocks));
+                auto blocks = m_Blocks;
+                for (auto& block : blocks)
+                    block.Offset += dataStart;
+
+                std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                if (!file)
+                    return false;
+
+                std::vector<char> prefix(dataStart, 0);
+                std::memcpy(prefix.data(), &header, sizeof(header));
+                std::memcpy(prefix.data() + sizeof(header), blocks.data(), sizeof(blocks));
+                file.write(prefix.data(), static_cast<std::streamsize>(prefix.size()));
+                file.write(m_Data.data(), static_cast<std::streamsize>(m_Data.size()));
+                return file.good();
+            }
+
+        private:
+            static uint64_t AlignUp(uint64_t value)
+            {
+                return (value + SceneBlockAlignment - 1) & ~(SceneBlockAlignment - 1);
+            }
+
+            std::vector<char> m_Data;
+            std::array<SceneBlockDesc, static_cast<size_t>(SceneBlock::Count)> m_Blocks {};
+        };
+
+        class SceneFileReader
+        {
+        public:
+            SceneFileReader(const char* data, uint64_t size) : m_Data(data), m_Size(size) {}
+
+            bool ReadHeader()
+            {
+                if (m_Size < sizeof(SceneFileHeader))
+                    return false;
+
+                std::memcpy(&m_Header, m_Data, sizeof(m_Header));
+                if (m_Header.Magic != SceneFileMagic || m_Header.Version != SceneSerializer::Version ||
+                    m_Header.BlockCount != static_cast<uint32_t>(SceneBlock::Count) ||
+                    m_Size < sizeof(SceneFileHeader) + sizeof(m_Blocks))
+                    return false;
+
+                std::memcpy(m_Blocks.data(), m_Data + sizeof(SceneFileHeader), sizeof(m_Blocks));
+                for (const auto& block : m_Blocks)
+                {
+                    if (block.Offset % SceneBlockAlignment != 0 || block.Offset > m_Size ||
+                        (block.ElementSize != 0 && block.Count > (m_Size - block.Offset) / block.ElementSize))
+                        return false;
+                }
+                return true;
+            }
+
+            const SceneFileHeader& GetHeader() const { return m_Header; }
+
+            // Empty if the block's element size doesn't match T
+            template<typename T>
+            std::span<const T> Get(SceneBlock block) const
+            {
+                const auto& desc = m_Blocks[static_cast<size_t>(block)];
+                if (desc.ElementSize != sizeof(T))
+                    return {};
+                return { reinterpret_cast<const T*>(m_Data + desc.Offset), static_cast<size_t>(desc.Count) };
+            }
+
+            uint64_t GetCount(SceneBlock block) const { return m_Blocks[static_cast<size_t>(block)].Count; }
+            bool HasElementSize(SceneBlock block, size_t elementSize) const { return m_Blocks[static_cast<size_t>(block)].ElementSize == elementSize; }
+
+        private:
+            const char* m_Data;
+            uint64_t m_Size;
+            SceneFileHeader m_Header {};
+            std::array<SceneBlockDesc, static_cast<size_t>(SceneBlock::Count)> m_Blocks {};
+        };
+
+        // Offsets must be non-decreasing and stay inside the character data
+        bool ValidateStringTable(std::span<const uint32_t> offsets, size_t stringCount, size_t dataSize)
+        {
+            if (offsets.size() != stringCount + 1 || offsets[0] != 0 || offsets.back() > dataSize)
+                return false;
+            for (size_t i = 1; i < offsets.size(); ++i)
+            {
+                if (offsets[i] < offsets[i - 1])
+                    return false;
+            }
+            return true;
+        }
+
+        // A scene object can have at most one component of each type
+        bool ValidateOwners(std::span<const uint32_t> owners, size_t componentCount, uint32_t sceneObjectCount)
+        {
+            if (owners.size() != componentCount)
+                return false;
+
+            std::vector<bool> owned(sceneObjectCount, false);
+            for (const uint32_t owner : owners)
+            {
+                if (owner >= sceneObjectCount || owned[owner])
+                    return false;
+                owned[owner] = true;
+            }
+            return true;
+        }
+
+        // Everything that can be checked without the scene the file is loaded into
+        bool ValidateSceneFile(const SceneFileReader& reader)
+        {
+            const uint32_t count = reader.GetHeader().SceneObjectCount;
+            const auto ids = reader.Get<uint64_t>(SceneBlock::IDs);
+            const auto parents = reader.Get<uint32_t>(SceneBlock::Parents);
+            const auto modelPathOffsets = reader.Get<uint32_t>(SceneBlock::ModelPathOffsets);
+            const auto models = reader.Get<uint32_t>(SceneBlock::Models);
+
+            bool valid =
+                ids.size() == count && parents.size() == count && reader.Get<TransformComponent>(SceneBlock::Transforms).size() == count &&
+                reader.HasElementSize(SceneBlock::NameData, sizeof(char)) &&
+                reader.HasElementSize(SceneBlock::ModelPathData, sizeof(char)) &&
+                ValidateStringTable(reader.Get<uint32_t>(SceneBlock::NameOffsets), count, reader.GetCount(SceneBlock::NameData)) &&
+                reader.HasElementSize(SceneBlock::DirectionalLights, sizeof(DirectionalLightComponent)) &&
+                reader.HasElementSize(SceneBlock::PointLights, sizeof(PointLightComponent)) &&
+                ValidateOwners(reader.Get<uint32_t>(SceneBlock::DirectionalLightOwners), reader.GetCount(SceneBlock::DirectionalLights), count) &&
+                ValidateOwners(reader.Get<uint32_t>(SceneBlock::PointLightOwners), reader.GetCount(SceneBlock::PointLights), count) &&
+                ValidateOwners(reader.Get<uint32_t>(SceneBlock::ModelOwners), models.size(), count) &&
+                !modelPathOffsets.empty() && ValidateStringTable(modelPathOffsets, modelPathOffsets.size() - 1, reader.GetCount(SceneBlock::ModelPathData));
+
+            // Two objects with the same ID would collapse into one entry of the scene's ID map
+            std::unordered_set<uint64_t> uniqueIDs;
+            uniqueIDs.reserve(valid ? count : 0);
+            for (uint32_t i = 0; valid && i < count; ++i)
+                valid = (parents[i] == InvalidIndex || parents[i] < i) && uniqueIDs.insert(ids[i]).second;
+
+            const auto modelPathCount = valid ? modelPathOffsets.size() - 1 : 0;
+            return valid && std::ranges::all_of(models, [modelPathCount](const uint32_t model) { return model < modelPathCount; });
+        }
+
+        template<typename T>
+        void AppendComponents(entt::registry& registry, const std::vector<entt::entity>& order, const std::unordered_map<entt::entity, uint32_t>& indices,
+            std::vector<uint32_t>& owners, std::vector<T>& components)
+        {
+            for (const auto entity : order)
+            {
+                if (const auto* component = registry.try_get<T>(entity))
+                {
+                    owners.push_back(indices.at(entity));
+                    components.push_back(*component);
+                }
+            }
+        }
+    }
+
+    SceneSerializer::SceneSerializer(Scene& scene)
+        : m_Scene(scene)
+    {
+    }
+
+    bool SceneSerializer::Serialize(const std::filesystem::path& path)
+    {
+        SCOPE_TIMER("SceneSerializer::Serialize");
+
+        auto& registry = m_Scene.m_Registry;
+
+        // The flattened hierarchy already puts parents before their children
+        if (m_Scene.m_HierarchyDirty)
+            m_Scene.SortSceneObjects();
+
+        const auto& hierarchy = m_Scene.m_FlattenedHierarchy;
+        const auto count = static_cast<uint32_t>(hierarchy.size());
+
+        std::vector<entt::entity> order(count);
+        std::unordered_map<entt::entity, uint32_t> indices;
+        indices.reserve(count);
+
+        std::vector<uint64_t> ids(count);
+        std::vector<uint32_t> parents(count);
+        std::vector<TransformComponent> transforms(count);
+        std::vector<uint32_t> nameOffsets(count + 1, 0);
+        std::string nameData;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto entity = hierarchy[i].Entity;
+            order[i] = entity;
+            indices.emplace(entity, i);
+
+            ids[i] = registry.get<IDComponent>(entity).ID;
+            parents[i] = hierarchy[i].Parent;
+            transforms[i] = registry.get<TransformComponent>(entity);
+            if (const auto* name = registry.try_get<NameComponent>(entity))
+                nameData += name->Name;
+            nameOffsets[i + 1] = static_cast<uint32_t>(nameData.size());
+        }
+
+        std::vector<uint32_t> dirLightOwners, pointLightOwners, modelOwners;
+        std::vector<DirectionalLightComponent> dirLights;
+        std::vector<PointLightComponent> pointLights;
+        AppendComponents(registry, order, indices, dirLightOwners, dirLights);
+        AppendComponents(registry, order, indices, pointLightOwners, pointLights);
+
+        // Model IDs are only valid for this session, store where each model came from instead
+        auto& modelManager = ModelManager::GetInstance();
+        std::unordered_map<UUID, uint32_t> modelIndices;
+        std::vector<uint32_t> models;
+        std::vector<uint32_t> modelPathOffsets { 0 };
+        std::string modelPathData;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto* modelComp = registry.try_get<ModelComponent>(order[i]);
+            if (modelComp == nullptr)
+                continue;
+
+            auto [iter, inserted] = modelIndices.try_emplace(modelComp->ModelID, static_cast<uint32_t>(modelPathOffsets.size() - 1));
+            if (inserted)
+            {
+                if (modelComp->ModelID == modelManager.GetCubeID())
+                    modelPathData += CubeModelPath;
+                else if (modelComp->ModelID == modelManager.GetSphereID())
+                    modelPathData += SphereModelPath;
+                else
+                    modelPathData += ConvertString(modelManager.GetModelPath(modelComp->ModelID));
+                modelPathOffsets.push_back(static_cast<uint32_t>(modelPathData.size()));
+            }
+
+            modelOwners.push_back(i);
+            models.push_back(iter->second);
+        }
+
+        SceneFileWriter writer;
+        writer.Write(SceneBlock::IDs, ids);
+        writer.Write(SceneBlock::Parents, parents);
+        writer.Write(SceneBlock::Transforms, transforms);
+        writer.Write(SceneBlock::NameOffsets, nameOffsets);
+        writer.Write(SceneBlock::NameData, nameData.data(), nameData.size(), sizeof(char));
+        writer.Write(SceneBlock::DirectionalLightOwners, dirLightOwners);
+        writer.Write(SceneBlock::DirectionalLights, dirLights);
+        writer.Write(SceneBlock::PointLightOwners, pointLightOwners);
+        writer.Write(SceneBlock::PointLights, pointLights);
+        writer.Write(SceneBlock::ModelOwners, modelOwners);
+        writer.Write(SceneBlock::Models, models);
+        writer.Write(SceneBlock::ModelPathOffsets, modelPathOffsets);
+        writer.Write(SceneBlock::ModelPathData, modelPathData.data(), modelPathData.size(), sizeof(char));
+
+        if (!writer.Save(path, count))
+        {
+            spdlog::error("Failed to write scene file {0}", path.string());
+            return false;
+        }
+
+#ifdef _DEBUG
+        // Round trip check, the saved file has to pass the loader's validation and give back the same blocks
+        {
+            const MappedFile savedFile(path);
+            SceneFileReader reader(savedFile.GetData(), savedFile.GetSize());
+            assert(savedFile.GetData() != nullptr && reader.ReadHeader() && ValidateSceneFile(reader));
+            assert(std::ranges::equal(reader.Get<uint64_t>(SceneBlock::IDs), ids));
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::Parents), parents));
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::NameOffsets), nameOffsets));
+            assert(std::ranges::equal(reader.Get<char>(SceneBlock::NameData), nameData));
+            assert(std::memcmp(reader.Get<TransformComponent>(SceneBlock::Transforms).data(), transforms.data(), count * sizeof(TransformComponent)) == 0);
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::DirectionalLightOwners), dirLightOwners));
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::PointLightOwners), pointLightOwners));
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::ModelOwners), modelOwners));
+            assert(std::ranges::equal(reader.Get<uint32_t>(SceneBlock::Models), models));
+            assert(std::ranges::equal(reader.Get<char>(SceneBlock::ModelPathData), modelPathData));
+        }
+#endif
+
+        spdlog::info("Saved {0} scene objects to {1}", count, path.string());
+        return true;
+    }
+
+    bool SceneSerializer::Deserialize(const std::filesystem::path& path)
+    {
+        SCOPE_TIMER("SceneSerializer::Deserialize");
+
+        const MappedFile file(path);
+        if (file.GetData() == nullptr)
+        {
+            spdlog::error("Failed to open scene file {0}", path.string());
+            return false;
+        }
+
+        SceneFileReader reader(file.GetData(), file.GetSize());
+        if (!reader.ReadHeader())
+        {
+            spdlog::error("{0} is not a valid scene file of version {1}", path.string(), Version);
+            return false;
+        }
+
+        const uint32_t count = reader.GetHeader().SceneObjectCount;
+        const auto ids = reader.Get<uint64_t>(SceneBlock::IDs);
+        const auto parents = reader.Get<uint32_t>(SceneBlock::Parents);
+        const auto transforms = reader.Get<TransformComponent>(SceneBlock::Transforms);
+        const auto nameOffsets = reader.Get<uint32_t>(SceneBlock::NameOffsets);
+        const auto nameData = reader.Get<char>(SceneBlock::NameData);
+        const auto dirLightOwners = reader.Get<uint32_t>(SceneBlock::DirectionalLightOwners);
+        const auto dirLights = reader.Get<DirectionalLightComponent>(SceneBlock::DirectionalLights);
+        const auto pointLightOwners = reader.Get<uint32_t>(SceneBlock::PointLightOwners);
+        const auto pointLights = reader.Get<PointLightComponent>(SceneBlock::PointLights);
+        const auto modelOwners = reader.Get<uint32_t>(SceneBlock::ModelOwners);
+        const auto models = reader.Get<uint32_t>(SceneBlock::Models);
+        const auto modelPathOffsets = reader.Get<uint32_t>(SceneBlock::ModelPathOffsets);
+        const auto modelPathData = reader.Get<char>(SceneBlock::ModelPathData);
+
+        // Validate everything up front so a broken file never leaves a half loaded scene behind
+        const bool valid = ValidateSceneFile(reader) &&
+            std::ranges::none_of(ids, [this](const uint64_t id) { return m_Scene.m_SceneObjectIDMap.contains(id); });
+        if (!valid)
+        {
+            spdlog::error("Scene file {0} is corrupt or contains scene objects that already exist", path.string());
+            return false;
+        }
+
+        const auto modelPathCount = modelPathOffsets.size() - 1;
+
+        // Resolve the model path table, loading every referenced file once
+        auto& modelManager = ModelManager::GetInstance();
+        std::vector<UUID> modelIDs(modelPathCount, 0);
+        for (size_t i = 0; i < modelPathCount; ++i)
+        {
+            const std::string_view modelPath(modelPathData.data() + modelPathOffsets[i], modelPathOffsets[i + 1] - modelPathOffsets[i]);
+            if (modelPath == CubeModelPath)
+            {
+                modelIDs[i] = modelManager.GetCubeID();
+            }
+            else if (modelPath == SphereModelPath)
+            {
+                modelIDs[i] = modelManager.GetSphereID();
+            }
+            else if (!modelPath.empty())
+            {
+                const auto widePath = ConvertString(std::string(modelPath));
+                modelIDs[i] = modelManager.FindModelByPath(widePath);
+                if (modelIDs[i] == 0)
+                    modelIDs[i] = modelManager.LoadModelFromFile(widePath, [](float) { return true; });
+                if (modelIDs[i] == 0)
+                    spdlog::warn("Scene references model {0} which failed to load", modelPath);
+            }
+        }
+
+        auto& registry = m_Scene.m_Registry;
+
+        std::vector<entt::entity> entities(count);
+        registry.create(entities.begin(), entities.end());
+        registry.insert<TransformComponent>(entities.begin(), entities.end(), transforms.data());
+        registry.insert<RelationshipComponent>(entities.begin(), entities.end());
+        registry.insert<HierarchyComponent>(entities.begin(), entities.end());
+
+        m_Scene.m_SceneObjectIDMap.reserve(m_Scene.m_SceneObjectIDMap.size() + count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto entity = entities[i];
+            registry.emplace<IDComponent>(entity, ids[i]);
+            m_Scene.m_SceneObjectIDMap.try_emplace(ids[i], entity, &m_Scene);
+
+            if (nameOffsets[i + 1] != nameOffsets[i])
+                registry.emplace<NameComponent>(entity, std::string(nameData.data() + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]));
+
+            if (parents[i] != InvalidIndex)
+                m_Scene.AttachToParent(entity, entities[parents[i]]);
+        }
+
+        auto ownersToEntities = [&entities](std::span<const uint32_t> owners)
+        {
+            std::vector<entt::entity> result(owners.size());
+            std::ranges::transform(owners, result.begin(), [&entities](const uint32_t owner) { return entities[owner]; });
+            return result;
+        };
+
+        const auto dirLightEntities = ownersToEntities(dirLightOwners);
+        registry.insert<DirectionalLightComponent>(dirLightEntities.begin(), dirLightEntities.end(), dirLights.data());
+        const auto pointLightEntities = ownersToEntities(pointLightOwners);
+        registry.insert<PointLightComponent>(pointLightEntities.begin(), pointLightEntities.end(), pointLights.data());
+
+        for (size_t i = 0; i < modelOwners.size(); ++i)
+        {
+            if (const UUID modelID = modelIDs[models[i]]; modelID != 0)
+                registry.emplace<ModelComponent>(entities[modelOwners[i]], modelID);
+        }
+
+        m_Scene.MarkHierarchyDirty();
+
+        spdlog::info("Loaded {0} scene objects from {1}", count, path.string());
+        return true;
+    }
+}
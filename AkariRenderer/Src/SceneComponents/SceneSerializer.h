@@ -0,0 +1,27 @@
+#pragma once
+#include <filesystem>
+
+namespace Akari
+{
+    class Scene;
+
+    // Binary scene files (.akscene). Component arrays are stored as aligned, contiguous blocks in
+    // flattened hierarchy order, so loading maps the file and bulk-inserts the blocks into the registry.
+    //
+    // Layout: SceneFileHeader, SceneBlockDesc[SceneBlock::Count], then the blocks at 64 byte aligned offsets.
+    // Models are referenced through a path table, built-in geometry uses reserved names.
+    class SceneSerializer
+    {
+    public:
+        explicit SceneSerializer(Scene& scene);
+
+        bool Serialize(const std::filesystem::path& path);
+        // Appends the file's scene objects to the scene, fails without changes if the file is invalid
+        bool Deserialize(const std::filesystem::path& path);
+
+        static constexpr uint32_t Version = 1;
+
+    private:
+        Scene& m_Scene;
+    };
+}
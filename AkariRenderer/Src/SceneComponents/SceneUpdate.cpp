@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "Scene.h"
+
+#include "SceneObject.h"
+#include "RHI/Renderer.h"
+#include "Camera/EditorCamera.h"
+#include "Components.h"
+#include "Model.h"
+#include "ModelManager.h"
+#include "Visitor.h"
+#include "Layers/ImGuiLayer.h"
+#include "RHI/RenderTarget.h"
+#include "Timing/DeltaTime.h"
+
+// The parts of Scene that reach into the renderer, the model manager and the editor.
+// Scene.cpp stays free of them, so the headless tests can build and drive a scene.
+namespace Akari
+{
+    void Scene::UpdateBVH()
+    {
+        auto& modelManager = ModelManager::GetInstance();
+
+        // False while the model is still loading
+        auto updateBounds = [&](const entt::entity entity)
+        {
+            const auto model = modelManager.GetModelByID(m_Registry.get<ModelComponent>(entity).ModelID);
+            if (!model || model->GetFlattenedNodes().empty())
+                return false;
+
+            const glm::mat4& world = m_WorldMatrices[m_Registry.get<HierarchyComponent>(entity).FlattenedIndex];
+            DirectX::BoundingBox worldBounds;
+            model->GetFlattenedNodes().front().SubtreeAABB.Transform(worldBounds, Math::ToXMMatrix(world));
+
+            m_BVH.Update(entity, worldBounds);
+            return true;
+        };
+
+        // Dirty is set for every node whose world matrix was recomputed this frame
+        for (const auto& node : m_FlattenedHierarchy)
+        {
+            if (node.Dirty && m_BVH.Contains(node.Entity))
+                updateBounds(node.Entity);
+        }
+
+        std::erase_if(m_PendingBounds, updateBounds);
+
+        m_BVH.Optimize();
+    }
+
+    std::shared_ptr<EditorCamera> Scene::GetCamera()
+    {
+        if (!m_Camera)
+        {
+            const auto& rt = Renderer::GetInstance().GetMsaaRenderTarget();
+            m_Camera = std::make_shared<EditorCamera>(45.0f, rt->GetWidth(), rt->GetHeight(), 0.1f, 2000.0f);
+            m_Camera->SetActive(true);
+        }
+
+        return m_Camera;
+    }
+
+    void Scene::OnUpdate(DeltaTime ts)
+    {
+        UpdateHierarchy();
+        UpdateBVH();
+    }
+
+    void Scene::OnEvent(Event& event)
+    {
+        if (Renderer::GetInstance().GetImGuiLayer()->m_IsSceneWindowHovered)
+        {
+            GetCamera()->OnEvent(event);
+        }
+    }
+
+    void Scene::Accept(Visitor& visitor)
+    {
+        visitor.Visit(*this);
+        const auto entities = GetAllSceneObjectsWith<ModelComponent>();
+        for (const auto entity : entities)
+        {
+            SceneObject obj(entity, this);
+            visitor.Visit(obj);
+            const auto & [ModelID] = obj.GetComponent<ModelComponent>();
+            if (const auto model = ModelManager::GetInstance().GetModelByID(ModelID))
+                model->Accept(visitor);
+        }
+    }
+}
@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "TriangleBVH.h"
+
+namespace Akari
+{
+    // Half the surface area, only ever compared against other areas
+    static float HalfArea(const glm::vec3& min, const glm::vec3& max)
+    {
+        const glm::vec3 size = max - min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    TriangleBVH::TriangleBVH(std::span<const glm::vec3> positions, std::span<const uint32_t> indices)
+        : m_Positions(positions.begin(), positions.end()), m_Indices(indices.begin(), indices.end())
+    {
+        const auto triangleCount = static_cast<uint32_t>(m_Indices.size() / 3);
+        if (triangleCount == 0)
+            return;
+
+        // Bounds and centroids are only needed while building
+        std::vector<glm::vec3> triangleMin(triangleCount), triangleMax(triangleCount), centroids(triangleCount);
+        m_TriangleOrder.resize(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; ++i)
+        {
+            const glm::vec3& v0 = m_Positions[m_Indices[i * 3 + 0]];
+            const glm::vec3& v1 = m_Positions[m_Indices[i * 3 + 1]];
+            const glm::vec3& v2 = m_Positions[m_Indices[i * 3 + 2]];
+            triangleMin[i] = glm::min(v0, glm::min(v1, v2));
+            triangleMax[i] = glm::max(v0, glm::max(v1, v2));
+            centroids[i] = (triangleMin[i] + triangleMax[i]) * 0.5f;
+            m_TriangleOrder[i] = i;
+        }
+
+        auto updateBounds = [&](Node& node)
+        {
+            node.Min = glm::vec3(FLT_MAX);
+            node.Max = glm::vec3(-FLT_MAX);
+            for (uint32_t i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; ++i)
+            {
+                node.Min = glm::min(node.Min, triangleMin[m_TriangleOrder[i]]);
+                node.Max = glm::max(node.Max, triangleMax[m_TriangleOrder[i]]);
+            }
+        };
+
+        m_Nodes.reserve(size_t(triangleCount) * 2);
+        m_Nodes.push_back({ {}, 0, {}, triangleCount });
+        updateBounds(m_Nodes[0]);
+
+        // Binned SAH, split top-down with an explicit stack of (node, depth)
+        constexpr int BinCount = 16;
+
+        struct Bin
+        {
+            glm::vec3 Min = glm::vec3(FLT_MAX);
+            glm::vec3 Max = glm::vec3(-FLT_MAX);
+            uint32_t Count = 0;
+        };
+
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.emplace_back(0, 0);
+        while (!stack.empty())
+        {
+            const auto [nodeIndex, depth] = stack.back();
+            stack.pop_back();
+
+            const uint32_t first = m_Nodes[nodeIndex].LeftOrFirst;
+            const uint32_t count = m_Nodes[nodeIndex].Count;
+            if (count <= MaxLeafTriangles || depth + 1 >= MaxDepth)
+                continue;
+
+            glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                centroidMin = glm::min(centroidMin, centroids[m_TriangleOrder[i]]);
+                centroidMax = glm::max(centroidMax, centroids[m_TriangleOrder[i]]);
+            }
+
+            auto binIndex = [&](const uint32_t triangle, const int axis)
+            {
+                const float scale = BinCount / (centroidMax[axis] - centroidMin[axis]);
+                return std::min(static_cast<int>((centroids[triangle][axis] - centroidMin[axis]) * scale), BinCount - 1);
+            };
+
+            int bestAxis = -1;
+            int bestSplit = 0;
+            float bestCost = FLT_MAX;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (centroidMax[axis] <= centroidMin[axis])
+                    continue;
+
+                std::array<Bin, BinCount> bins;
+                for (uint32_t i = first; i < first + count; ++i)
+                {
+                    const uint32_t triangle = m_TriangleOrder[i];
+                    Bin& bin = bins[binIndex(triangle, axis)];
+                    bin.Min = glm::min(bin.Min, triangleMin[triangle]);
+                    bin.Max = glm::max(bin.Max, triangleMax[triangle]);
+                    bin.Count++;
+                }
+
+                // Split i puts bins [0, i) on the left
+                std::array<float, BinCount> rightArea{};
+                std::array<uint32_t, BinCount> rightCount{};
+                Bin right;
+                for (int i = BinCount - 1; i > 0; --i)
+                {
+                    right.Min = glm::min(right.Min, bins[i].Min);
+                    right.Max = glm::max(right.Max, bins[i].Max);
+                    right.Count += bins[i].Count;
+                    rightArea[i] = right.Count > 0 ? HalfArea(right.Min, right.Max) : 0.0f;
+                    rightCount[i] = right.Count;
+                }
+
+                Bin left;
+                for (int i = 1; i < BinCount; ++i)
+                {
+                    left.Min = glm::min(left.Min, bins[i - 1].Min);
+                    left.Max = glm::max(left.Max, bins[i - 1].Max);
+                    left.Count += bins[i - 1].Count;
+                    if (left.Count == 0 || rightCount[i] == 0)
+                        continue;
+
+                    const float cost = HalfArea(left.Min, left.Max) * left.Count + rightArea[i] * rightCount[i];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+
+            uint32_t leftCount = count / 2;
+            if (bestAxis >= 0)
+            {
+                // Keep the node a leaf if no split is cheaper than testing all of its triangles
+                const Node& node = m_Nodes[nodeIndex];
+                if (bestCost >= HalfArea(node.Min, node.Max) * count && count <= MaxLeafTriangles * 4)
+                    continue;
+
+                const auto begin = m_TriangleOrder.begin() + first;
+                const auto middle = std::partition(begin, begin + count, [&](const uint32_t triangle)
+                {
+                    return binIndex(triangle, bestAxis) < bestSplit;
+                });
+                leftCount = static_cast<uint32_t>(middle - begin);
+            }
+            // Coincident centroids leave nothing to bin, the triangles are split in half as they are
+
+            const auto leftIndex = static_cast<uint32_t>(m_Nodes.size());
+            m_Nodes.push_back({ {}, first, {}, leftCount });
+            m_Nodes.push_back({ {}, first + leftCount, {}, count - leftCount });
+            updateBounds(m_Nodes[leftIndex]);
+            updateBounds(m_Nodes[leftIndex + 1]);
+
+            m_Nodes[nodeIndex].LeftOrFirst = leftIndex;
+            m_Nodes[nodeIndex].Count = 0;
+
+            stack.emplace_back(leftIndex, depth + 1);
+            stack.emplace_back(leftIndex + 1, depth + 1);
+        }
+
+        m_Nodes.shrink_to_fit();
+    }
+
+    TriangleBVH::TriangleBVH(std::span<const glm::vec3> positions, std::span<const uint32_t> indices,
+                             std::span<const Node> nodes, std::span<const uint32_t> triangleOrder)
+        : m_Nodes(nodes.begin(), nodes.end()), m_Positions(positions.begin(), positions.end()),
+          m_Indices(indices.begin(), indices.end()), m_TriangleOrder(triangleOrder.begin(), triangleOrder.end())
+    {
+        assert(m_TriangleOrder.size() == m_Indices.size() / 3);
+    }
+
+    bool TriangleBVH::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const
+    {
+        if (m_Nodes.empty())
+            return false;
+
+        const glm::vec3 invDirection = Math::SafeInverse(direction);
+
+        float distance;
+        if (!IntersectBounds(m_Nodes[0], origin, invDirection, maxDistance, distance))
+            return false;
+
+        bool found = false;
+
+        // The far child is pushed at most once per level
+        std::array<std::pair<uint32_t, float>, MaxDepth> stack;
+        uint32_t stackSize = 0;
+        stack[stackSize++] = { 0, distance };
+        while (stackSize > 0)
+        {
+            const auto [nodeIndex, entry] = stack[--stackSize];
+            if (entry > maxDistance)
+                continue;
+
+            const Node& node = m_Nodes[nodeIndex];
+            if (node.Count > 0)
+            {
+                // Moeller-Trumbore, both sides
+                for (uint32_t i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; ++i)
+                {
+                    const uint32_t triangle = m_TriangleOrder[i];
+                    const glm::vec3& v0 = m_Positions[m_Indices[triangle * 3 + 0]];
+                    const glm::vec3 edge1 = m_Positions[m_Indices[triangle * 3 + 1]] - v0;
+                    const glm::vec3 edge2 = m_Positions[m_Indices[triangle * 3 + 2]] - v0;
+
+                    const glm::vec3 p = glm::cross(direction, edge2);
+                    const float determinant = glm::dot(edge1, p);
+                    if (determinant == 0.0f)
+                        continue;
+
+                    const float invDeterminant = 1.0f / determinant;
+                    const glm::vec3 s = origin - v0;
+                    const float u = glm::dot(s, p) * invDeterminant;
+                    if (u < 0.0f || u > 1.0f)
+                        continue;
+
+                    const glm::vec3 q = glm::cross(s, edge1);
+                    const float v = glm::dot(direction, q) * invDeterminant;
+                    if (v < 0.0f || u + v > 1.0f)
+                        continue;
+
+                    const float t = glm::dot(edge2, q) * invDeterminant;
+                    if (t < 0.0f || t > maxDistance)
+                        continue;
+
+                    maxDistance = t;
+                    hit = { t, triangle, u, v };
+                    found = true;
+                }
+                continue;
+            }
+
+            float leftDistance, rightDistance;
+            const bool hitLeft = IntersectBounds(m_Nodes[node.LeftOrFirst], origin, invDirection, maxDistance, leftDistance);
+            const bool hitRight = IntersectBounds(m_Nodes[node.LeftOrFirst + 1], origin, invDirection, maxDistance, rightDistance);
+
+            // Visit the nearer child first so the farther one is likely pruned when popped
+            if (hitLeft && hitRight)
+            {
+                const bool leftFirst = leftDistance <= rightDistance;
+                stack[stackSize++] = leftFirst ? std::pair(node.LeftOrFirst + 1, rightDistance) : std::pair(node.LeftOrFirst, leftDistance);
+                stack[stackSize++] = leftFirst ? std::pair(node.LeftOrFirst, leftDistance) : std::pair(node.LeftOrFirst + 1, rightDistance);
+            }
+            else if (hitLeft)
+            {
+                stack[stackSize++] = { node.LeftOrFirst, leftDistance };
+            }
+            else if (hitRight)
+            {
+                stack[stackSize++] = { node.LeftOrFirst + 1, rightDistance };
+            }
+        }
+
+        return found;
+    }
+
+    DirectX::BoundingBox TriangleBVH::GetBounds() const
+    {
+        if (m_Nodes.empty())
+            return DirectX::BoundingBox({ 0, 0, 0 }, { 0, 0, 0 });
+
+        const glm::vec3 center = (m_Nodes[0].Min + m_Nodes[0].Max) * 0.5f;
+        const glm::vec3 extents = (m_Nodes[0].Max - m_Nodes[0].Min) * 0.5f;
+        return DirectX::BoundingBox({ center.x, center.y, center.z }, { extents.x, extents.y, extents.z });
+    }
+
+    bool TriangleBVH::IntersectBounds(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance)
+    {
+        // Slab test, the ray is inside the box between the last entry and the first exit
+        const glm::vec3 t0 = (node.Min - origin) * invDirection;
+        const glm::vec3 t1 = (node.Max - origin) * invDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+
+        const float enter = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+        const float exit = std::min({ tFar.x, tFar.y, tFar.z, maxDistance });
+
+        distance = enter;
+        return enter <= exit;
+    }
+}
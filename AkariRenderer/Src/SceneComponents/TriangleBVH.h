@@ -0,0 +1,62 @@
+#pragma once
+#include <span>
+#include <DirectXCollision.h>
+
+namespace Akari
+{
+    // Bounding volume hierarchy over the triangles of one mesh, in mesh space, for CPU ray queries.
+    // Built once from the vertex and index data the mesh was created from and read only afterwards.
+    class TriangleBVH
+    {
+    public:
+        struct Hit
+        {
+            float Distance;
+            // Triangle index in the source index list, its indices start at 3 * Triangle
+            uint32_t Triangle;
+            // Barycentric coordinates of the hit point relative to the second and third vertex
+            float U, V;
+        };
+
+        struct Node
+        {
+            glm::vec3 Min;
+            // First triangle of a leaf, or the left child of an inner node with the right child next to it
+            uint32_t LeftOrFirst;
+            glm::vec3 Max;
+            // Triangle count of a leaf, 0 for inner nodes
+            uint32_t Count;
+        };
+
+        TriangleBVH(std::span<const glm::vec3> positions, std::span<const uint32_t> indices);
+        // Restores a BVH from the parts of one built earlier, as stored in the model cache
+        TriangleBVH(std::span<const glm::vec3> positions, std::span<const uint32_t> indices,
+                    std::span<const Node> nodes, std::span<const uint32_t> triangleOrder);
+
+        // Closest hit of origin + t * direction with t in [0, maxDistance], triangles are hit from both sides.
+        // direction does not need to be normalized, distances are in units of its length.
+        bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const;
+
+        DirectX::BoundingBox GetBounds() const;
+        size_t GetTriangleCount() const { return m_TriangleOrder.size(); }
+
+        // The source geometry, also used by the occlusion culling to rasterize occluders
+        std::span<const glm::vec3> GetPositions() const { return m_Positions; }
+        std::span<const uint32_t> GetIndices() const { return m_Indices; }
+        std::span<const Node> GetNodes() const { return m_Nodes; }
+        std::span<const uint32_t> GetTriangleOrder() const { return m_TriangleOrder; }
+
+        static constexpr uint32_t MaxLeafTriangles = 4;
+        // Deeper nodes become leaves regardless of their size, which bounds the traversal stack
+        static constexpr uint32_t MaxDepth = 64;
+
+    private:
+        static bool IntersectBounds(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance);
+
+        std::vector<Node> m_Nodes;
+        std::vector<glm::vec3> m_Positions;
+        std::vector<uint32_t> m_Indices;
+        // Source triangle indices in leaf order, each leaf covers a contiguous range
+        std::vector<uint32_t> m_TriangleOrder;
+    };
+}
@@ -1,10 +1,8 @@
 struct Matrices
 {
-	matrix ModelMatrix;
 	matrix ViewMatrix;
 	matrix ProjectionMatrix;
-	matrix MVP;
-	matrix InverseModelMatrix;
+	matrix ViewProjectionMatrix;
 	matrix InverseViewMatrix;
 };
 
@@ -13,6 +11,37 @@ struct LightProperties
 	uint NumPointLights;
 	uint NumSpotLights;
 	uint NumDirectionalLights;
+
+	uint ClusterCountX;
+	uint ClusterCountY;
+	uint ClusterCountZ;
+	float ClusterDepthScale;
+	float ClusterDepthBias;
+	float2 ClusterTileScale; // Clusters per pixel
+};
+
+struct PointLight
+{
+	float3 Translation;
+	float3 Rotation;
+	float3 Scale;
+	float  Padding[3];
+	float3 Radiance;
+	float Intensity;
+	float LightSize; // For PCSS
+	float MinRadius;
+	float Radius;
+	float Falloff;
+	int CastsShadows;
+	int SoftShadows;
+	float Padding2[2];
+};
+
+// Range of a cluster in LightIndices
+struct LightCluster
+{
+	uint Offset;
+	uint Count;
 };
 
 struct DirectionalLight
@@ -29,6 +58,16 @@ struct DirectionalLight
 	int SoftShadows;
 };
 
+// Cascaded shadows of DirectionalLights[LightIndex]
+struct ShadowProperties
+{
+	matrix ShadowMatrices[4]; // World space to shadow atlas texture coordinates and depth
+	float4 SplitDepths;       // Far view depth of every cascade
+	float4 TexelSizes;        // World size of a shadow map texel
+	uint CascadeCount;        // 0 when no light casts shadows
+	uint LightIndex;
+};
+
 struct MaterialProperties
 {
 	float4 BaseColor;
@@ -81,9 +120,14 @@ struct SurfaceShadingData
 ConstantBuffer<Matrices> MatCB : register(b0, space0);
 ConstantBuffer<MaterialProperties> MaterialCB : register(b0, space1);
 ConstantBuffer<LightProperties> LightPropertiesCB : register(b1);
+ConstantBuffer<ShadowProperties> ShadowCB : register(b2);
 
+StructuredBuffer<PointLight> PointLights : register(t0);
 StructuredBuffer<DirectionalLight> DirectionalLights : register(t2);
 
+StructuredBuffer<LightCluster> LightClusters : register(t0, space2);
+StructuredBuffer<uint> LightIndices : register(t1, space2);
+
 Texture2D BaseColor : register( t3 );
 Texture2D Metallic : register( t4 );
 Texture2D Roughness : register( t5 );
@@ -95,9 +139,11 @@ Texture2D Opacity : register( t10 );
 TextureCube<float4> Skybox : register( t11 );
 TextureCube<float4> SkyboxIrr : register( t12 );
 Texture2D IBLTexture : register( t13 );
+Texture2D ShadowMap : register( t14 );
 
 SamplerState AnisotropicSampler : register(s0);
 SamplerState LinearClampSampler : register(s1);
+SamplerComparisonState ShadowSampler : register(s2);
 
 static const float PI = 3.141592653589793;
 
@@ -322,6 +368,54 @@ SurfaceShadingData GetSurfaceData(VertexShaderOutput psInput)
 	return o;
 }
 
+// Screen tiles count from the top left, depth slices grow exponentially with the view depth
+uint GetClusterIndex(float2 pixel, float viewDepth)
+{
+	uint3 cluster;
+	cluster.xy = min(uint2(pixel * LightPropertiesCB.ClusterTileScale), uint2(LightPropertiesCB.ClusterCountX, LightPropertiesCB.ClusterCountY) - 1);
+	cluster.z = uint(clamp(log(viewDepth) * LightPropertiesCB.ClusterDepthScale + LightPropertiesCB.ClusterDepthBias, 0.0f, LightPropertiesCB.ClusterCountZ - 1));
+	return (cluster.z * LightPropertiesCB.ClusterCountY + cluster.y) * LightPropertiesCB.ClusterCountX + cluster.x;
+}
+
+// 1 where the light reaches the surface, 0 in full shadow
+float GetShadow(float3 positionWS, float3 geometryNormal, float3 lightDir, float viewDepth, bool soft)
+{
+	uint cascade = 0;
+	while (cascade < ShadowCB.CascadeCount && viewDepth > ShadowCB.SplitDepths[cascade])
+		++cascade;
+	if (cascade == ShadowCB.CascadeCount)
+		return 1.0f;
+
+	// Normal offset, surfaces facing away from the light move farther out of their own shadow
+	float NoL = saturate(dot(geometryNormal, lightDir));
+	positionWS += geometryNormal * ShadowCB.TexelSizes[cascade] * (0.5f + 1.5f * (1.0f - NoL));
+	float4 shadowPos = mul(ShadowCB.ShadowMatrices[cascade], float4(positionWS, 1.0f));
+
+	// Filter taps stay inside the cascade's tile of the atlas
+	float2 atlasSize;
+	ShadowMap.GetDimensions(atlasSize.x, atlasSize.y);
+	float2 texel = 1.0f / atlasSize;
+	float2 tileMin = float2(cascade % 2, cascade / 2) * 0.5f + texel * 1.5f;
+	float2 tileMax = tileMin + 0.5f - texel * 3.0f;
+
+	if (!soft)
+		return ShadowMap.SampleCmpLevelZero(ShadowSampler, clamp(shadowPos.xy, tileMin, tileMax), shadowPos.z);
+
+	// 3x3 PCF over bilinear comparisons
+	float visibility = 0.0f;
+	[unroll]
+	for (int y = -1; y <= 1; ++y)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; ++x)
+		{
+			float2 uv = clamp(shadowPos.xy + float2(x, y) * texel, tileMin, tileMax);
+			visibility += ShadowMap.SampleCmpLevelZero(ShadowSampler, uv, shadowPos.z);
+		}
+	}
+	return visibility / 9.0f;
+}
+
 float4 main(VertexShaderOutput psInput) : SV_TARGET
 {
 	SurfaceShadingData surface = GetSurfaceData(psInput);
@@ -330,6 +424,7 @@ float4 main(VertexShaderOutput psInput) : SV_TARGET
 	float3 viewPosWS = MatCB.InverseViewMatrix._14_24_34;
 	float3 viewDir = normalize(viewPosWS - psInput.PositionWS.xyz);
 	float3 col = 0;
+	float viewDepth = mul(MatCB.ViewMatrix, psInput.PositionWS).z;
 	for (uint i = 0; i < LightPropertiesCB.NumDirectionalLights; ++i)
 	{
 		float pitch = DirectionalLights[i].Rotation.x;
@@ -343,10 +438,33 @@ float4 main(VertexShaderOutput psInput) : SV_TARGET
 		float z = sin(pitch) * cos(yaw);
 
 		float3 lightDir = normalize(float3(x, y, z));
+		float3 radiance = DirectionalLights[i].Radiance * DirectionalLights[i].Intensity;
+		if (i == ShadowCB.LightIndex && ShadowCB.CascadeCount > 0)
+		{
+			float shadow = GetShadow(psInput.PositionWS.xyz, normalize(psInput.NormalWS), lightDir, viewDepth, DirectionalLights[i].SoftShadows);
+			radiance *= lerp(1.0f, shadow, DirectionalLights[i].ShadowAmount);
+		}
+
 		col += DirectPBRLighting(surface.BaseColor.rgb,
 			viewDir, lightDir, normalWS, 0.04f,
-			surface.Roughness, surface.Metallic) * DirectionalLights[i].Radiance * DirectionalLights[i].Intensity;
+			surface.Roughness, surface.Metallic) * radiance;
 	}
+
+	LightCluster cluster = LightClusters[GetClusterIndex(psInput.Position.xy, viewDepth)];
+	for (uint j = 0; j < cluster.Count; ++j)
+	{
+		PointLight light = PointLights[LightIndices[cluster.Offset + j]];
+
+		float3 toLight = light.Translation - psInput.PositionWS.xyz;
+		float distance = length(toLight);
+		float attenuation = saturate(1.0f - (distance * distance) / (light.Radius * light.Radius));
+		attenuation *= lerp(attenuation, 1.0f, light.Falloff);
+
+		col += DirectPBRLighting(surface.BaseColor.rgb,
+			viewDir, toLight / max(distance, 1e-4f), normalWS, 0.04f,
+			surface.Roughness, surface.Metallic) * light.Radiance * light.Intensity * attenuation;
+	}
+
 	col += ImageBasedPBRLighting(surface.BaseColor.rgb,
 				viewDir, normalWS, 0.04f,
 				surface.Roughness, surface.Metallic, surface.Occlusion);
@@ -1,22 +1,25 @@
 struct Matrices
 {
-    matrix ModelMatrix;
     matrix ViewMatrix;
     matrix ProjectionMatrix;
-    matrix MVP;
-    matrix InverseModelMatrix;
+    matrix ViewProjectionMatrix;
     matrix InverseViewMatrix;
 };
 
+struct InstanceData
+{
+    matrix ModelMatrix;
+    matrix InverseModelMatrix;
+};
+
 ConstantBuffer<Matrices> MatCB : register(b0, space0);
+StructuredBuffer<InstanceData> Instances : register(t0, space1);
 
-struct VertexPositionNormalTangentBitangentTexture
+struct VertexPositionQTangentTexture
 {
     float3 Position : POSITION;
-    float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
-    float3 Bitangent : BITANGENT;
-    float3 TexCoord : TEXCOORD;
+    float4 TangentFrame : TANGENTFRAME;
+    float2 TexCoord : TEXCOORD;
 };
 
 struct VertexShaderOutput
@@ -29,16 +32,31 @@ struct VertexShaderOutput
     float4 Position    : SV_POSITION;
 };
 
-VertexShaderOutput main(VertexPositionNormalTangentBitangentTexture IN)
+// The tangent frame is a quaternion rotating the X and Z axes onto the tangent and the normal,
+// a negative w flips the bitangent. Mirrors VertexPositionQTangentTexture::Decode.
+void DecodeTangentFrame(float4 q, out float3 normal, out float3 tangent, out float3 bitangent)
+{
+    q = normalize(q);
+    tangent = float3(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y));
+    normal = float3(2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+    bitangent = cross(normal, tangent) * (q.w < 0.0f ? -1.0f : 1.0f);
+}
+
+VertexShaderOutput main(VertexPositionQTangentTexture IN, uint InstanceID : SV_InstanceID)
 {
     VertexShaderOutput OUT;
+
+    float3 normal, tangent, bitangent;
+    DecodeTangentFrame(IN.TangentFrame, normal, tangent, bitangent);
+
+    const InstanceData instance = Instances[InstanceID];
     
-    OUT.Position    = mul(MatCB.MVP, float4(IN.Position, 1.0f));
-    OUT.PositionWS  = mul(MatCB.ModelMatrix, float4(IN.Position, 1.0f));
-    OUT.NormalWS    = mul((float3x3)transpose(MatCB.InverseModelMatrix), IN.Normal);
-    OUT.TangentWS   = mul((float3x3)transpose(MatCB.InverseModelMatrix), IN.Tangent);
-    OUT.BitangentWS = mul((float3x3)transpose(MatCB.InverseModelMatrix), IN.Bitangent);
-    OUT.TexCoord    = IN.TexCoord.xy;
+    OUT.PositionWS  = mul(instance.ModelMatrix, float4(IN.Position, 1.0f));
+    OUT.Position    = mul(MatCB.ViewProjectionMatrix, OUT.PositionWS);
+    OUT.NormalWS    = mul((float3x3)transpose(instance.InverseModelMatrix), normal);
+    OUT.TangentWS   = mul((float3x3)transpose(instance.InverseModelMatrix), tangent);
+    OUT.BitangentWS = mul((float3x3)transpose(instance.InverseModelMatrix), bitangent);
+    OUT.TexCoord    = IN.TexCoord;
 
     return OUT;
 }
@@ -0,0 +1,27 @@
+struct ShadowView
+{
+    matrix ViewProjectionMatrix;
+};
+
+struct InstanceData
+{
+    matrix ModelMatrix;
+    matrix InverseModelMatrix;
+};
+
+ConstantBuffer<ShadowView> ShadowViewCB : register(b0, space0);
+StructuredBuffer<InstanceData> Instances : register(t0, space1);
+
+struct VertexPositionQTangentTexture
+{
+    float3 Position : POSITION;
+    float4 TangentFrame : TANGENTFRAME;
+    float2 TexCoord : TEXCOORD;
+};
+
+// Depth only, the shadow map needs no pixel shader
+float4 main(VertexPositionQTangentTexture IN, uint InstanceID : SV_InstanceID) : SV_POSITION
+{
+    const float4 positionWS = mul(Instances[InstanceID].ModelMatrix, float4(IN.Position, 1.0f));
+    return mul(ShadowViewCB.ViewProjectionMatrix, positionWS);
+}
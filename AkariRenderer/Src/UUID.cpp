@@ -3,12 +3,13 @@
 
 namespace Akari
 {
-    static std::random_device s_RandomDevice;
-    static std::mt19937_64 eng(s_RandomDevice());
-    static std::uniform_int_distribution<uint64_t> s_UniformDistribution;
+    // Every thread has its own engines so UUIDs can be created from worker threads without locking
+    static thread_local std::random_device s_RandomDevice;
+    static thread_local std::mt19937_64 eng(s_RandomDevice());
+    static thread_local std::uniform_int_distribution<uint64_t> s_UniformDistribution;
 
-    static std::mt19937 eng32(s_RandomDevice());
-    static std::uniform_int_distribution<uint32_t> s_UniformDistribution32;
+    static thread_local std::mt19937 eng32(s_RandomDevice());
+    static thread_local std::uniform_int_distribution<uint32_t> s_UniformDistribution32;
 
     UUID::UUID()
         : m_UUID(s_UniformDistribution(eng))
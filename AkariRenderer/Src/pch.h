@@ -30,7 +30,10 @@
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
-#include <DirectXTex.h>
+// The headless tests build without the DirectXTex NuGet package
+#ifndef AKARI_HEADLESS
+    #include <DirectXTex.h>
+#endif
 #include "d3dx12.h"
 #ifdef _DEBUG
     #include <dxgidebug.h>
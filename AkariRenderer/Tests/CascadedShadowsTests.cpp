@@ -0,0 +1,228 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RPI/CascadedShadows.h"
+
+using namespace Akari;
+
+namespace
+{
+    const float VerticalFov = glm::radians(60.0f);
+    constexpr float AspectRatio = 16.0f / 9.0f;
+    constexpr float NearClip = 0.1f;
+    constexpr uint32_t Resolution = 2048;
+    const glm::vec3 LightDirection = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+
+    glm::mat4 GetCameraView(const glm::vec3& position, const glm::vec3& forward)
+    {
+        return glm::lookAt(position, position + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    void Update(CascadedShadows& shadows, const glm::mat4& cameraView, float farClip = 1000.0f)
+    {
+        shadows.Update(cameraView, VerticalFov, AspectRatio, NearClip, farClip, LightDirection, Resolution);
+    }
+
+    // Position of a world point in the texel grid of a cascade's shadow map
+    glm::vec2 GetTexelPosition(const ShadowCascade& cascade, const glm::vec3& position)
+    {
+        const glm::vec4 clip = cascade.ViewProjection * glm::vec4(position, 1.0f);
+        return glm::vec2(clip) * (Resolution * 0.5f);
+    }
+
+    // Largest distance of the coordinates to a whole number
+    float GetTexelFraction(const glm::vec2& texels)
+    {
+        const glm::vec2 fraction = glm::abs(texels - glm::round(texels));
+        return std::max(fraction.x, fraction.y);
+    }
+
+    // Light space bounds of a world box from its corners, [min, max] per axis
+    std::pair<glm::vec3, glm::vec3> GetLightSpaceBounds(const glm::mat4& view, const glm::vec3& center, const glm::vec3& extents)
+    {
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        for (int i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner = center + extents * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+            const glm::vec3 lightSpace = glm::vec3(view * glm::vec4(corner, 1.0f));
+            min = glm::min(min, lightSpace);
+            max = glm::max(max, lightSpace);
+        }
+        return { min, max };
+    }
+}
+
+AKARI_TEST(CascadedShadows, PracticalSplits)
+{
+    CascadedShadows shadows;
+    for (const float farClip : { 1000.0f, 80.0f })
+    {
+        Update(shadows, GetCameraView(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)), farClip);
+        const float shadowDistance = std::min(farClip, CascadedShadows::MaxShadowDistance);
+
+        const auto& cascades = shadows.GetCascades();
+        CHECK(cascades.front().SplitNear == NearClip);
+        CHECK(std::abs(cascades.back().SplitFar - shadowDistance) < 1e-3f * shadowDistance);
+
+        for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+        {
+            const float ratio = static_cast<float>(i + 1) / CascadedShadows::CascadeCount;
+            const float uniformSplit = NearClip + (shadowDistance - NearClip) * ratio;
+            const float logSplit = NearClip * std::pow(shadowDistance / NearClip, ratio);
+            const float expected = CascadedShadows::SplitLambda * logSplit + (1.0f - CascadedShadows::SplitLambda) * uniformSplit;
+
+            CHECK(std::abs(cascades[i].SplitFar - expected) < 1e-4f * expected);
+            CHECK(cascades[i].SplitFar > cascades[i].SplitNear);
+            if (i > 0)
+                CHECK(cascades[i].SplitNear == cascades[i - 1].SplitFar);
+        }
+    }
+}
+
+// Every corner of a frustum slice is inside its cascade's sphere, whichever way the camera looks
+AKARI_TEST(CascadedShadows, SpheresEncloseTheSlices)
+{
+    const float tanHalfFovY = std::tan(VerticalFov * 0.5f);
+    const float tanHalfFovX = tanHalfFovY * AspectRatio;
+
+    CascadedShadows shadows;
+    std::array<float, CascadedShadows::CascadeCount> radii{};
+    for (const glm::vec3& forward : { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, -0.5f, 0.3f), glm::vec3(-0.2f, 0.9f, -1.0f) })
+    {
+        const glm::mat4 view = GetCameraView(glm::vec3(5.0f, 2.0f, -3.0f), glm::normalize(forward));
+        const glm::mat4 inverseView = glm::inverse(view);
+        Update(shadows, view);
+
+        for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+        {
+            const ShadowCascade& cascade = shadows.GetCascades()[i];
+            for (const float depth : { cascade.SplitNear, cascade.SplitFar })
+            {
+                for (int corner = 0; corner < 4; ++corner)
+                {
+                    const glm::vec3 viewPosition((corner & 1 ? 1.0f : -1.0f) * tanHalfFovX * depth, (corner & 2 ? 1.0f : -1.0f) * tanHalfFovY * depth, depth);
+                    const glm::vec3 position = glm::vec3(inverseView * glm::vec4(viewPosition, 1.0f));
+                    CHECK(glm::distance(position, cascade.Center) <= cascade.Radius * 1.0001f);
+                }
+            }
+
+            // Turning the camera must not resize the projection
+            if (radii[i] != 0.0f)
+                CHECK(cascade.Radius == radii[i]);
+            radii[i] = cascade.Radius;
+            CHECK(cascade.TexelSize == 2.0f * cascade.Radius / Resolution);
+        }
+    }
+}
+
+// A moving camera moves the projections by whole texels only, even for moves below a texel,
+// so every world point keeps its place inside its texel
+AKARI_TEST(CascadedShadows, SnapsToTexels)
+{
+    const glm::vec3 forward = glm::normalize(glm::vec3(0.4f, -0.2f, 1.0f));
+    const std::array<glm::vec3, 3> points = { glm::vec3(0.0f), glm::vec3(3.3f, 0.7f, 12.9f), glm::vec3(-21.4f, 4.1f, 40.2f) };
+
+    CascadedShadows shadows;
+    Update(shadows, GetCameraView(glm::vec3(1.0f, 2.0f, 3.0f), forward));
+    const auto previous = shadows.GetCascades();
+
+    bool moved = false;
+    for (const glm::vec3& offset : { glm::vec3(0.013f, 0.0f, 0.0f), glm::vec3(0.4f, 0.05f, 1.7f), glm::vec3(-3.1f, 0.2f, 0.9f) })
+    {
+        Update(shadows, GetCameraView(glm::vec3(1.0f, 2.0f, 3.0f) + offset, forward));
+        for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+        {
+            const ShadowCascade& cascade = shadows.GetCascades()[i];
+
+            // The world origin sits on a texel corner
+            const glm::vec2 origin = GetTexelPosition(cascade, glm::vec3(0.0f));
+            CHECK(GetTexelFraction(origin) < 1e-3f);
+
+            for (const glm::vec3& point : points)
+            {
+                const glm::vec2 shift = GetTexelPosition(cascade, point) - GetTexelPosition(previous[i], point);
+                CHECK(GetTexelFraction(shift) < 1e-2f);
+                moved |= std::max(std::abs(shift.x), std::abs(shift.y)) > 0.5f;
+            }
+        }
+    }
+
+    // Otherwise the whole-texel check proves nothing
+    CHECK(moved);
+}
+
+AKARI_TEST(CascadedShadows, CullsCasters)
+{
+    const glm::mat4 cameraView = GetCameraView(glm::vec3(0.0f, 5.0f, 0.0f), glm::normalize(glm::vec3(0.3f, -0.2f, 1.0f)));
+    CascadedShadows shadows;
+    Update(shadows, cameraView);
+
+    std::mt19937 random(37);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 4.0f);
+
+    std::vector<std::pair<glm::vec3, glm::vec3>> boxes;
+    for (int i = 0; i < 3000; ++i)
+        boxes.emplace_back(glm::vec3(position(random), position(random) * 0.2f, position(random)), glm::vec3(extent(random), extent(random), extent(random)));
+    // Far up towards the light above the first cascade, it still shadows it
+    boxes.emplace_back(shadows.GetCascades()[0].Center - LightDirection * 500.0f, glm::vec3(1.0f));
+
+    BoundsSoA casters;
+    for (const auto& [center, extents] : boxes)
+        casters.Add({ { center.x, center.y, center.z }, { extents.x, extents.y, extents.z } });
+    shadows.CullCasters(casters);
+
+    CHECK(std::ranges::binary_search(shadows.GetCasters(0), static_cast<uint32_t>(boxes.size() - 1)));
+
+    constexpr float margin = 1e-2f;
+    for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+    {
+        const ShadowCascade& cascade = shadows.GetCascades()[i];
+        const auto cascadeCasters = shadows.GetCasters(i);
+        CHECK(!cascadeCasters.empty() && cascadeCasters.size() < boxes.size());
+
+        for (uint32_t c = 0; c < boxes.size(); ++c)
+        {
+            // Overlapping the projection sideways and not behind the cascade, with a margin for rounding
+            const auto [min, max] = GetLightSpaceBounds(cascade.View, boxes[c].first, boxes[c].second);
+            const float radius = cascade.Radius;
+            const bool inside = max.x > -radius + margin && min.x < radius - margin && max.y > -radius + margin && min.y < radius - margin &&
+                                min.z < 2.0f * radius - margin;
+            const bool outside = max.x < -radius - margin || min.x > radius + margin || max.y < -radius - margin || min.y > radius + margin ||
+                                 min.z > 2.0f * radius + margin;
+
+            const bool listed = std::ranges::binary_search(cascadeCasters, c);
+            CHECK(listed || !inside);
+            CHECK(!listed || !outside);
+
+            // The near plane was pulled back far enough for every listed caster
+            if (listed)
+                CHECK((cascade.Projection * glm::vec4(0.0f, 0.0f, min.z, 1.0f)).z >= -1e-4f);
+        }
+    }
+}
+
+AKARI_BENCHMARK(CascadedShadows, CullCasters)
+{
+    std::mt19937 random(41);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 4.0f);
+
+    BoundsSoA casters;
+    for (int i = 0; i < 1'000'000; ++i)
+        casters.Add({ { position(random), position(random) * 0.1f, position(random) }, { extent(random), extent(random), extent(random) } });
+
+    CascadedShadows shadows;
+    Update(shadows, GetCameraView(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    for (const uint32_t threadCount : { 1u, 8u })
+    {
+        Tests::RunWithThreads(threadCount, [&]
+        {
+            const std::string label = "Cull 1M casters, " + std::to_string(threadCount) + " threads";
+            Tests::Measure(label.c_str(), 10, [&] { shadows.CullCasters(casters); });
+        });
+    }
+
+    for (uint32_t i = 0; i < CascadedShadows::CascadeCount; ++i)
+        spdlog::info("  cascade {0}: {1} casters", i, shadows.GetCasters(i).size());
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RPI/DrawBatcher.h"
+#include "RPI/DrawPacketSorter.h"
+
+using namespace Akari;
+
+namespace
+{
+    // The batcher only compares the pointers, distinct addresses stand in for meshes and materials
+    std::array<char, 256> s_Handles;
+
+    Mesh* GetMesh(uint32_t index) { return reinterpret_cast<Mesh*>(&s_Handles[index]); }
+    Material* GetMaterial(uint32_t index) { return reinterpret_cast<Material*>(&s_Handles[128 + index]); }
+
+    void AddPacket(DrawPacketList& packets, uint32_t mesh, uint32_t material, uint8_t lod = 0)
+    {
+        const glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(packets.Size()), 1.0f, 2.0f));
+        packets.Add(world, {}, GetMesh(mesh), GetMaterial(material), 0, DrawPacketFlag_None, lod);
+    }
+
+    bool IsBatch(const DrawBatch& batch, uint32_t mesh, uint32_t material, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount)
+    {
+        return batch.BatchMesh == GetMesh(mesh) && batch.BatchMaterial == GetMaterial(material) && batch.Lod == lod &&
+               batch.FirstInstance == firstInstance && batch.InstanceCount == instanceCount;
+    }
+
+    // Every packet drawn once, by a batch of its mesh, material and level of detail, instances in packet order
+    bool IsConsistent(const DrawBatcher& batcher, const DrawPacketList& packets)
+    {
+        const auto& batches = batcher.GetBatches();
+        const auto& packetIndices = batcher.GetPacketIndices();
+        const auto& instances = batcher.GetInstances();
+        if (packetIndices.size() != packets.Size() || instances.size() != packets.Size())
+            return false;
+
+        std::vector<uint8_t> drawn(packets.Size(), 0);
+        uint32_t nextInstance = 0;
+        for (const DrawBatch& batch : batches)
+        {
+            if (batch.FirstInstance != nextInstance || batch.InstanceCount == 0 || batch.InstanceCount > DrawBatcher::MaxInstancesPerBatch)
+                return false;
+            nextInstance += batch.InstanceCount;
+
+            for (uint32_t instance = batch.FirstInstance; instance < nextInstance; ++instance)
+            {
+                const uint32_t packet = packetIndices[instance];
+                if (packets.Meshes[packet] != batch.BatchMesh || packets.Materials[packet] != batch.BatchMaterial || packets.Lods[packet] != batch.Lod)
+                    return false;
+                if (instance > batch.FirstInstance && packetIndices[instance - 1] >= packet)
+                    return false;
+                if (instances[instance].ModelMatrix != packets.WorldMatrices[packet])
+                    return false;
+                drawn[packet]++;
+            }
+        }
+
+        return nextInstance == packets.Size() && std::ranges::all_of(drawn, [](const uint8_t count) { return count == 1; });
+    }
+}
+
+AKARI_TEST(DrawBatcher, GroupsByMeshLodAndMaterial)
+{
+    DrawPacketList packets;
+    AddPacket(packets, 0, 0);
+    AddPacket(packets, 1, 0);
+    AddPacket(packets, 0, 0);
+    AddPacket(packets, 1, 0, 1);
+    AddPacket(packets, 0, 0);
+    AddPacket(packets, 0, 1);
+    AddPacket(packets, 0, 1);
+
+    DrawBatcher batcher;
+    batcher.Build(packets);
+
+    const auto& batches = batcher.GetBatches();
+    REQUIRE(batches.size() == 4);
+    CHECK(IsBatch(batches[0], 0, 0, 0, 0, 3));
+    CHECK(IsBatch(batches[1], 1, 0, 0, 3, 1));
+    CHECK(IsBatch(batches[2], 1, 0, 1, 4, 1));
+    CHECK(IsBatch(batches[3], 0, 1, 0, 5, 2));
+    CHECK(std::ranges::equal(batcher.GetPacketIndices(), std::vector<uint32_t>{ 0, 2, 4, 1, 3, 5, 6 }));
+    CHECK(IsConsistent(batcher, packets));
+
+    const InstanceData& instance = batcher.GetInstances()[1];
+    CHECK(instance.ModelMatrix[3] == glm::vec4(2.0f, 1.0f, 2.0f, 1.0f));
+    CHECK(instance.InverseModelMatrix[3] == glm::vec4(-2.0f, -1.0f, -2.0f, 1.0f));
+
+    // Building again starts over
+    packets.Clear();
+    batcher.Build(packets);
+    CHECK(batcher.GetBatches().empty() && batcher.GetInstances().empty());
+}
+
+// The lookup only spans a run of the same material, a material seen again starts new batches
+AKARI_TEST(DrawBatcher, SplitsInterleavedMaterials)
+{
+    DrawPacketList packets;
+    AddPacket(packets, 0, 0);
+    AddPacket(packets, 0, 1);
+    AddPacket(packets, 0, 0);
+
+    DrawBatcher batcher;
+    batcher.Build(packets);
+
+    const auto& batches = batcher.GetBatches();
+    REQUIRE(batches.size() == 3);
+    CHECK(IsBatch(batches[0], 0, 0, 0, 0, 1));
+    CHECK(IsBatch(batches[1], 0, 1, 0, 1, 1));
+    CHECK(IsBatch(batches[2], 0, 0, 0, 2, 1));
+}
+
+AKARI_TEST(DrawBatcher, SplitsLargeBatches)
+{
+    constexpr uint32_t maxInstances = DrawBatcher::MaxInstancesPerBatch;
+
+    DrawPacketList packets;
+    for (uint32_t i = 0; i < maxInstances * 2 + 5; ++i)
+        AddPacket(packets, i % 2, 0);
+
+    DrawBatcher batcher;
+    batcher.Build(packets);
+
+    const auto& batches = batcher.GetBatches();
+    REQUIRE(batches.size() == 4);
+    CHECK(IsBatch(batches[0], 0, 0, 0, 0, maxInstances));
+    CHECK(IsBatch(batches[1], 1, 0, 0, maxInstances, maxInstances));
+    CHECK(IsBatch(batches[2], 0, 0, 0, maxInstances * 2, 3));
+    CHECK(IsBatch(batches[3], 1, 0, 0, maxInstances * 2 + 3, 2));
+    CHECK(IsConsistent(batcher, packets));
+}
+
+// 100k packets of 100 meshes and 20 materials, sorted by their keys like in the forward pipeline
+AKARI_BENCHMARK(DrawBatcher, Build100kPackets)
+{
+    std::mt19937 random(23);
+    std::uniform_int_distribution<uint32_t> mesh(0, 99);
+    std::uniform_int_distribution<uint32_t> material(0, 19);
+    std::uniform_int_distribution<uint32_t> lod(0, 2);
+    std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+
+    DrawPacketList packets;
+    for (uint32_t i = 0; i < 100'000; ++i)
+    {
+        const uint32_t materialIndex = material(random);
+        const glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(depth(random), 0.0f, 0.0f));
+        packets.Add(world, {}, GetMesh(mesh(random)), GetMaterial(materialIndex), DrawSortKey::Make(DrawPass_Opaque, 0, materialIndex, world[3].x),
+                    DrawPacketFlag_None, static_cast<uint8_t>(lod(random)));
+    }
+
+    DrawPacketSorter sorter;
+    sorter.Sort(packets);
+
+    DrawBatcher batcher;
+    Tests::Measure("Build 100k packets", 20, [&] { batcher.Build(packets); });
+    CHECK(IsConsistent(batcher, packets));
+    spdlog::info("  {0} batches", batcher.GetBatches().size());
+}
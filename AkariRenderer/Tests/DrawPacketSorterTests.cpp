@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "Test.h"
+
+#include <numeric>
+
+#include "RPI/DrawPacketSorter.h"
+
+using namespace Akari;
+
+namespace
+{
+    // Keys of a single pass with a handful of pipelines and materials, so many keys share their upper bytes
+    std::vector<uint64_t> MakeRandomKeys(size_t count, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<uint32_t> pipeline(0, 7);
+        std::uniform_int_distribution<uint32_t> material(0, 200);
+        std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+
+        std::vector<uint64_t> keys(count);
+        for (auto& key : keys)
+            key = DrawSortKey::Make(DrawPass_Opaque, pipeline(random), material(random), depth(random));
+        return keys;
+    }
+
+    std::vector<uint32_t> StableSortOrder(std::span<const uint64_t> keys)
+    {
+        std::vector<uint32_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::ranges::stable_sort(order, [&](const uint32_t lhs, const uint32_t rhs) { return keys[lhs] < keys[rhs]; });
+        return order;
+    }
+
+    bool MatchesStableSort(DrawPacketSorter& sorter, std::span<const uint64_t> keys)
+    {
+        const auto order = sorter.SortKeys(keys);
+        return std::ranges::equal(order, StableSortOrder(keys));
+    }
+}
+
+AKARI_TEST(DrawPacketSorter, KeyFieldOrder)
+{
+    // Pass first, then pipeline and material, depth last and front to back
+    CHECK(DrawSortKey::Make(0, 5, 5, 100.0f) < DrawSortKey::Make(1, 0, 0, 1.0f));
+    CHECK(DrawSortKey::Make(0, 1, 5, 100.0f) < DrawSortKey::Make(0, 2, 0, 1.0f));
+    CHECK(DrawSortKey::Make(0, 1, 1, 100.0f) < DrawSortKey::Make(0, 1, 2, 1.0f));
+    CHECK(DrawSortKey::Make(0, 1, 1, 1.0f) < DrawSortKey::Make(0, 1, 1, 2.0f));
+    CHECK(DrawSortKey::Make(0, 1, 1, -1.0f) == DrawSortKey::Make(0, 1, 1, 0.0f));
+
+    const uint64_t key = DrawSortKey::Make(2, 37, 12345, 10.0f);
+    CHECK(DrawSortKey::GetPipeline(key) == 37);
+    CHECK(DrawSortKey::GetMaterial(key) == 12345);
+}
+
+AKARI_TEST(DrawPacketSorter, SortKeysMatchesStableSort)
+{
+    DrawPacketSorter sorter;
+    for (const size_t count : { size_t(0), size_t(1), size_t(2), size_t(1000), size_t(100'001) })
+        CHECK(MatchesStableSort(sorter, MakeRandomKeys(count, static_cast<uint32_t>(count))));
+
+    // Every byte differs somewhere, no pass is skipped
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> keys(5000);
+    for (auto& key : keys)
+        key = random();
+    CHECK(MatchesStableSort(sorter, keys));
+
+    // Equal keys keep their order, every pass is skipped
+    keys.assign(300, DrawSortKey::Make(DrawPass_Opaque, 3, 4, 5.0f));
+    CHECK(MatchesStableSort(sorter, keys));
+}
+
+AKARI_TEST(DrawPacketSorter, SortMovesWholePackets)
+{
+    const std::vector<uint64_t> keys = MakeRandomKeys(2000, 7);
+
+    // The translation of every packet records its original index
+    DrawPacketList packets;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+        packets.Add(world, {}, nullptr, nullptr, keys[i], DrawPacketFlag_None, static_cast<uint8_t>(i));
+    }
+
+    DrawPacketSorter sorter;
+    sorter.Sort(packets);
+
+    const auto expected = StableSortOrder(keys);
+    REQUIRE(packets.Size() == keys.size());
+    for (size_t i = 0; i < packets.Size(); ++i)
+    {
+        const auto original = static_cast<uint32_t>(packets.WorldMatrices[i][3].x);
+        CHECK(original == expected[i]);
+        CHECK(packets.SortKeys[i] == keys[original]);
+        CHECK(packets.Lods[i] == static_cast<uint8_t>(original));
+    }
+}
+
+AKARI_BENCHMARK(DrawPacketSorter, Sort1MKeys)
+{
+    const std::vector<uint64_t> keys = MakeRandomKeys(1'000'000, 21);
+    DrawPacketSorter sorter;
+
+    const float radix = Tests::Measure("Radix sort 1M keys", 20, [&] { sorter.SortKeys(keys); });
+
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(keys.size());
+    const float comparison = Tests::Measure("std::sort 1M keys", 20, [&]
+    {
+        for (uint32_t i = 0; i < keys.size(); ++i)
+            pairs[i] = { keys[i], i };
+        std::ranges::sort(pairs);
+    });
+    spdlog::info("  speedup {0:.2f}x", comparison / radix);
+
+    DrawPacketList packets;
+    packets.Reserve(keys.size());
+    for (const uint64_t key : keys)
+        packets.Add(glm::mat4(1.0f), {}, nullptr, nullptr, key);
+    Tests::Measure("Sort 1M packets", 1, [&] { sorter.Sort(packets); });
+    Tests::Measure("Sort 1M sorted packets", 5, [&] { sorter.Sort(packets); });
+}
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "Math/Frustum.h"
+
+using namespace Akari;
+
+namespace
+{
+    // Reversed-Z perspective looking down +z from the origin, the way the editor camera builds it
+    glm::mat4 GetViewProjection()
+    {
+        const glm::mat4 projection = glm::perspectiveFov(glm::radians(60.0f), 1920.0f, 1080.0f, 100.0f, 0.1f);
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        return projection * view;
+    }
+
+    DirectX::BoundingBox MakeBox(const glm::vec3& center, const glm::vec3& extents)
+    {
+        return { { center.x, center.y, center.z }, { extents.x, extents.y, extents.z } };
+    }
+
+    BoundsSoA MakeRandomBoxes(size_t count, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 10.0f);
+
+        BoundsSoA boxes;
+        for (size_t i = 0; i < count; ++i)
+            boxes.Add(MakeBox({ position(random), position(random), position(random) }, { extent(random), extent(random), extent(random) }));
+        return boxes;
+    }
+
+    // Smallest margin of a box to any plane, the SIMD and scalar sums are allowed to round differently there
+    float GetPlaneMargin(const Frustum& frustum, const BoundsSoA& boxes, size_t i)
+    {
+        float margin = std::numeric_limits<float>::max();
+        for (int p = 0; p < Frustum::PlaneCount; ++p)
+        {
+            const glm::vec4& plane = frustum.GetPlane(Frustum::Plane(p));
+            const float distance = plane.x * boxes.CenterX[i] + plane.y * boxes.CenterY[i] + plane.z * boxes.CenterZ[i] + plane.w;
+            const float radius = std::abs(plane.x) * boxes.ExtentX[i] + std::abs(plane.y) * boxes.ExtentY[i] + std::abs(plane.z) * boxes.ExtentZ[i];
+            margin = std::min(margin, std::abs(distance + radius));
+        }
+        return margin;
+    }
+}
+
+AKARI_TEST(FrustumCulling, ClassifiesReversedZ)
+{
+    const Frustum frustum(GetViewProjection());
+
+    CHECK(frustum.Test(MakeBox({ 0.0f, 0.0f, 10.0f }, glm::vec3(1.0f))) == FrustumTest::Inside);
+    CHECK(frustum.Test(MakeBox({ 0.0f, 0.0f, -10.0f }, glm::vec3(1.0f))) == FrustumTest::Outside);
+    CHECK(frustum.Test(MakeBox({ 0.0f, 0.0f, 110.0f }, glm::vec3(1.0f))) == FrustumTest::Outside);
+    CHECK(frustum.Test(MakeBox({ 0.0f, 0.0f, 100.0f }, glm::vec3(1.0f))) == FrustumTest::Intersects);
+    CHECK(frustum.Test(MakeBox({ 0.0f, 0.0f, 0.1f }, glm::vec3(0.05f))) == FrustumTest::Intersects);
+    CHECK(frustum.Test(MakeBox({ 50.0f, 0.0f, 10.0f }, glm::vec3(1.0f))) == FrustumTest::Outside);
+    CHECK(frustum.Test(MakeBox({ 0.0f, -50.0f, 10.0f }, glm::vec3(1.0f))) == FrustumTest::Outside);
+
+    CHECK(frustum.Test(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f) == FrustumTest::Inside);
+    CHECK(frustum.Test(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f) == FrustumTest::Outside);
+    CHECK(frustum.Test(glm::vec3(0.0f, 0.0f, -0.5f), 1.0f) == FrustumTest::Intersects);
+
+    // With reversed Z depth 1 is the near plane and depth 0 the far plane
+    const glm::vec4& nearPlane = frustum.GetPlane(Frustum::Near);
+    const glm::vec4& farPlane = frustum.GetPlane(Frustum::Far);
+    CHECK(nearPlane.z > 0.99f && std::abs(nearPlane.z * 0.1f + nearPlane.w) < 1e-4f);
+    CHECK(farPlane.z < -0.99f && std::abs(farPlane.z * 100.0f + farPlane.w) < 1e-2f);
+
+    const Frustum forwardZ(GetViewProjection(), false);
+    CHECK(forwardZ.GetPlane(Frustum::Near) == farPlane && forwardZ.GetPlane(Frustum::Far) == nearPlane);
+}
+
+// 1001 boxes, so the SIMD loop leaves a tail for the scalar path
+AKARI_TEST(FrustumCulling, SimdMatchesScalar)
+{
+    const Frustum frustum(GetViewProjection());
+    const BoundsSoA boxes = MakeRandomBoxes(1001, 3);
+
+    std::vector<uint8_t> simd(boxes.Size()), scalar(boxes.Size());
+    frustum.Cull(boxes, simd.data());
+    frustum.CullScalar(boxes, scalar.data());
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < boxes.Size(); ++i)
+    {
+        CHECK(simd[i] == scalar[i] || GetPlaneMargin(frustum, boxes, i) < 1e-4f);
+        visibleCount += scalar[i];
+    }
+
+    // Both outcomes have to be covered for the comparison to mean anything
+    CHECK(visibleCount > 0 && visibleCount < boxes.Size());
+}
+
+AKARI_BENCHMARK(FrustumCulling, ScalarVsSimd)
+{
+    const Frustum frustum(GetViewProjection());
+    const BoundsSoA boxes = MakeRandomBoxes(1'000'000, 9);
+    std::vector<uint8_t> visible(boxes.Size());
+
+    const float scalar = Tests::Measure("Scalar 1M boxes", 20, [&] { frustum.CullScalar(boxes, visible.data()); });
+    const float simd = Tests::Measure("SIMD 1M boxes", 20, [&] { frustum.Cull(boxes, visible.data()); });
+    spdlog::info("  speedup {0:.2f}x", scalar / simd);
+}
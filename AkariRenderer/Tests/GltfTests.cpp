@@ -0,0 +1,446 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/Gltf.h"
+#include "SceneComponents/Json.h"
+
+using namespace Akari;
+
+namespace
+{
+    constexpr uint32_t Byte = 5120, UnsignedByte = 5121, Short = 5122, UnsignedShort = 5123, UnsignedInt = 5125, Float = 5126;
+
+    template<typename T>
+    void Append(std::string& data, const T& value)
+    {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // The buffer, buffer views and accessors of a test asset, the rest of the document is added as JSON text
+    class GltfBuilder
+    {
+    public:
+        // Appends values as a new buffer view at a 4 byte aligned offset, returns its index
+        template<typename Range>
+        uint32_t AddView(const Range& values, uint32_t stride = 0)
+        {
+            const auto bytes = std::as_bytes(std::span(values));
+            m_Buffer.resize((m_Buffer.size() + 3) & ~size_t(3));
+            AddJson(m_Views, "{\"buffer\":0,\"byteOffset\":" + std::to_string(m_Buffer.size()) + ",\"byteLength\":" + std::to_string(bytes.size()) +
+                                 (stride > 0 ? ",\"byteStride\":" + std::to_string(stride) : "") + "}");
+            m_Buffer.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            return m_ViewCount++;
+        }
+
+        // view -1 leaves out the buffer view
+        uint32_t AddAccessor(int32_t view, uint32_t componentType, std::string_view type, uint32_t count, uint32_t offset = 0, bool normalized = false)
+        {
+            AddJson(m_Accessors, "{" + (view >= 0 ? "\"bufferView\":" + std::to_string(view) + ",\"byteOffset\":" + std::to_string(offset) + "," : "") +
+                                     "\"componentType\":" + std::to_string(componentType) + ",\"type\":\"" + std::string(type) + "\",\"count\":" +
+                                     std::to_string(count) + (normalized ? ",\"normalized\":true" : "") + "}");
+            return m_AccessorCount++;
+        }
+
+        const std::string& GetBuffer() const { return m_Buffer; }
+
+        // The document with members appended, an empty uri is the binary chunk of a .glb file
+        std::string GetJson(std::string_view members, std::string_view uri) const
+        {
+            return "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{" + (uri.empty() ? std::string() : "\"uri\":\"" + std::string(uri) + "\",") +
+                   "\"byteLength\":" + std::to_string(m_Buffer.size()) + "}],\"bufferViews\":[" + m_Views + "],\"accessors\":[" + m_Accessors + "]" +
+                   std::string(members) + "}";
+        }
+
+    private:
+        static void AddJson(std::string& list, const std::string& json)
+        {
+            list += (list.empty() ? "" : ",") + json;
+        }
+
+        std::string m_Buffer;
+        std::string m_Views;
+        std::string m_Accessors;
+        uint32_t m_ViewCount = 0;
+        uint32_t m_AccessorCount = 0;
+    };
+
+    // The JSON chunk padded with spaces and the binary chunk with zeros, as the specification asks
+    std::string MakeGlb(std::string json, std::string binary, uint32_t version = 2)
+    {
+        json.resize((json.size() + 3) & ~size_t(3), ' ');
+        binary.resize((binary.size() + 3) & ~size_t(3), '\0');
+
+        std::string glb;
+        Append(glb, 0x46546c67u);
+        Append(glb, version);
+        Append(glb, static_cast<uint32_t>(12 + 8 + json.size() + (binary.empty() ? 0 : 8 + binary.size())));
+        Append(glb, static_cast<uint32_t>(json.size()));
+        Append(glb, 0x4e4f534au);
+        glb += json;
+        if (!binary.empty())
+        {
+            Append(glb, static_cast<uint32_t>(binary.size()));
+            Append(glb, 0x004e4942u);
+            glb += binary;
+        }
+        return glb;
+    }
+
+    bool Opens(const std::filesystem::path& path)
+    {
+        const Tests::LogSilencer silencer;
+        return Gltf::Asset().Open(path);
+    }
+
+    template<uint32_t Count>
+    std::vector<float> ReadFloats(const Gltf::Accessor& accessor, float fill = -7.0f)
+    {
+        std::vector<float> values(static_cast<size_t>(accessor.Count) * Count, fill);
+        accessor.ReadFloats(values, Count);
+        return values;
+    }
+
+    std::vector<uint32_t> ReadIndices(const Gltf::Accessor& accessor)
+    {
+        std::vector<uint32_t> indices(accessor.Count);
+        accessor.ReadIndices(indices);
+        return indices;
+    }
+}
+
+AKARI_TEST(Gltf, ParsesJson)
+{
+    JsonValue json;
+    std::string error;
+    REQUIRE(JsonValue::Parse(R"( { "a" : [1, -2.5e3, true, false, null, {}], "b": "x\"\\\/\n\u00e9\ud83d\ude00", "c": {"d": [[]]} } )", json, error));
+    CHECK(json.IsObject() && json.GetSize() == 3);
+    CHECK(json["a"].GetSize() == 6 && json["a"][0].GetInt() == 1 && json["a"][1].GetNumber() == -2500.0);
+    CHECK(json["a"][2].GetBool() && !json["a"][3].GetBool(true) && json["a"][4].IsNull() && json["a"][5].IsObject());
+    CHECK(json["b"].GetString() == "x\"\\/\n\xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(json["c"]["d"][0].IsArray() && json["c"]["d"][0].GetSize() == 0);
+
+    // Missing members and elements and reads of the wrong type give the defaults
+    CHECK(json["missing"]["deeper"][3].IsNull() && json["a"][6].GetInt() == -1 && json["b"].GetNumber(4.0) == 4.0);
+    CHECK(json["a"].GetString("none") == "none" && json.GetElements().empty() && json["a"].GetMembers().empty());
+
+    for (const std::string_view malformed : { "", "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1] 2", "tru", "+1", "nan", "\"open", "\"\\x\"",
+                                              "\"\\u12\"", "\"\\ud83d\"", "\"\\ud83d\\u0041\"", "{1:2}" })
+    {
+        CHECK(!JsonValue::Parse(malformed, json, error) && !error.empty());
+    }
+
+    // Nesting is limited instead of overflowing the stack
+    CHECK(!JsonValue::Parse(std::string(100'000, '['), json, error));
+    CHECK(JsonValue::Parse(std::string(200, '[') + std::string(200, ']'), json, error));
+}
+
+AKARI_TEST(Gltf, ReadsAccessors)
+{
+    const Tests::TempDirectory directory("Gltf");
+
+    struct NormalTexCoord
+    {
+        glm::vec3 Normal;
+        uint16_t TexCoord[2];
+    };
+    const std::array<glm::vec3, 4> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.5f) };
+    const std::array<NormalTexCoord, 4> normalTexCoords = { { { glm::vec3(0.0f, 0.0f, 1.0f), { 0, 0 } },
+                                                              { glm::vec3(0.0f, 1.0f, 0.0f), { 65535, 0 } },
+                                                              { glm::vec3(1.0f, 0.0f, 0.0f), { 0, 32768 } },
+                                                              { glm::vec3(0.0f, 0.0f, -1.0f), { 65535, 65535 } } } };
+    const std::array<int16_t, 4> tangent = { 32767, -32768, 0, -16384 };
+    const std::array<int8_t, 4> bytes = { 127, -128, 64, 0 };
+    const std::array<uint8_t, 6> indices8 = { 0, 1, 2, 2, 1, 3 };
+    const std::array<uint16_t, 6> indices16 = { 0, 1, 2, 2, 1, 3 };
+    const std::array<uint32_t, 6> indices32 = { 0, 1, 2, 2, 1, 3 };
+
+    GltfBuilder builder;
+    const uint32_t interleaved = builder.AddView(normalTexCoords, sizeof(NormalTexCoord));
+    builder.AddAccessor(builder.AddView(positions), Float, "VEC3", 4);
+    builder.AddAccessor(interleaved, Float, "VEC3", 4);
+    builder.AddAccessor(interleaved, UnsignedShort, "VEC2", 4, offsetof(NormalTexCoord, TexCoord), true);
+    builder.AddAccessor(builder.AddView(tangent), Short, "VEC4", 1, 0, true);
+    builder.AddAccessor(builder.AddView(bytes), Byte, "SCALAR", 4);
+    builder.AddAccessor(-1, Float, "VEC3", 3);
+    builder.AddAccessor(builder.AddView(indices8), UnsignedByte, "SCALAR", 6);
+    builder.AddAccessor(builder.AddView(indices16), UnsignedShort, "SCALAR", 6);
+    builder.AddAccessor(builder.AddView(indices32), UnsignedInt, "SCALAR", 6);
+
+    directory.Write("buffer data.bin", builder.GetBuffer());
+    const auto path = directory.Write("asset.gltf", builder.GetJson("", "buffer%20data.bin"));
+
+    Gltf::Asset asset;
+    REQUIRE(asset.Open(path));
+    const auto& accessors = asset.GetAccessors();
+    REQUIRE(accessors.size() == 9);
+    CHECK(asset.GetFilePaths().size() == 2 && asset.GetFilePaths()[1].filename() == "buffer data.bin");
+
+    // Tightly packed floats, and interleaved ones read past the other attribute
+    const auto readPositions = ReadFloats<3>(accessors[0]);
+    CHECK(std::memcmp(readPositions.data(), positions.data(), sizeof(positions)) == 0);
+    const auto normals = ReadFloats<3>(accessors[1]);
+    for (size_t i = 0; i < normalTexCoords.size(); ++i)
+        CHECK(glm::vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]) == normalTexCoords[i].Normal);
+
+    // Normalized integers map to [0, 1] and [-1, 1], the most negative one clamped to -1
+    const auto texCoords = ReadFloats<2>(accessors[2]);
+    CHECK(texCoords[0] == 0.0f && texCoords[2] == 1.0f && std::abs(texCoords[5] - 32768.0f / 65535.0f) < 1e-6f && texCoords[7] == 1.0f);
+    const auto tangents = ReadFloats<4>(accessors[3]);
+    CHECK(tangents[0] == 1.0f && tangents[1] == -1.0f && tangents[2] == 0.0f && std::abs(tangents[3] + 16384.0f / 32767.0f) < 1e-6f);
+    const auto signedBytes = ReadFloats<1>(accessors[4]);
+    CHECK(signedBytes[0] == 127.0f && signedBytes[1] == -128.0f && signedBytes[2] == 64.0f);
+
+    // Components the accessor doesn't have keep the defaults, components it has too many of are dropped
+    const auto paddedPositions = ReadFloats<4>(accessors[0]);
+    CHECK(paddedPositions[3] == -7.0f && paddedPositions[12] == 1.0f && paddedPositions[14] == 0.5f && paddedPositions[15] == -7.0f);
+    const auto texCoordU = ReadFloats<1>(accessors[2]);
+    CHECK(texCoordU[1] == 1.0f && texCoordU[2] == 0.0f);
+
+    // Without a buffer view every element is zero
+    CHECK(!accessors[5].Data && ReadFloats<3>(accessors[5]) == std::vector<float>(9, 0.0f));
+
+    for (size_t i = 6; i < 9; ++i)
+        CHECK(ReadIndices(accessors[i]) == std::vector<uint32_t>(indices32.begin(), indices32.end()));
+}
+
+AKARI_TEST(Gltf, LoadsScene)
+{
+    const Tests::TempDirectory directory("Gltf");
+
+    const std::array<glm::vec3, 3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    GltfBuilder builder;
+    builder.AddAccessor(builder.AddView(positions), Float, "VEC3", 3);
+
+    const std::string members = R"(,
+        "meshes": [{ "name": "Triangle", "primitives": [{ "attributes": { "POSITION": 0 } },
+                                                        { "attributes": { "POSITION": 0, "TEXCOORD_0": 0 }, "indices": -1, "material": 0, "mode": 1 }] }],
+        "materials": [{ "pbrMetallicRoughness": { "baseColorFactor": [0.5, 0.25, 1, 0.75], "metallicFactor": 0.2,
+                                                  "baseColorTexture": { "index": 1 }, "metallicRoughnessTexture": { "index": 0 } },
+                        "normalTexture": { "index": 0, "scale": 2 }, "emissiveFactor": [1, 0.5, 0], "alphaMode": "MASK" },
+                      { "emissiveTexture": { "index": 7 }, "alphaMode": "BLEND" }],
+        "textures": [{ "source": 1 }, { "source": 0 }],
+        "images": [{ "uri": "textures/base%20color.png" }, { "uri": "normal.png" }],
+        "nodes": [{ "name": "Root", "children": [2, 1], "translation": [1, 2, 3], "rotation": [0, 0, 0.7071068, 0.7071068], "scale": [2, 2, 2] },
+                  { "mesh": 0, "matrix": [1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  4, 5, 6, 1] },
+                  { "name": "Empty" },
+                  { "name": "Other scene" }],
+        "scenes": [{ "nodes": [3] }, { "nodes": [0] }],
+        "scene": 1)";
+    directory.Write("buffer.bin", builder.GetBuffer());
+    const auto path = directory.Write("scene.gltf", builder.GetJson(members, "buffer.bin"));
+
+    Gltf::Asset asset;
+    REQUIRE(asset.Open(path));
+
+    REQUIRE(asset.GetMeshes().size() == 1 && asset.GetMeshes()[0].Primitives.size() == 2);
+    const Gltf::Mesh& mesh = asset.GetMeshes()[0];
+    CHECK(mesh.Name == "Triangle" && mesh.Primitives[0].Position == 0 && mesh.Primitives[0].Normal == -1 && mesh.Primitives[0].Indices == -1);
+    CHECK(mesh.Primitives[0].Material == -1 && mesh.Primitives[0].Mode == 4);
+    CHECK(mesh.Primitives[1].TexCoord == 0 && mesh.Primitives[1].Material == 0 && mesh.Primitives[1].Mode == 1);
+
+    // Texture indices are resolved to images, an index past the textures is no texture
+    REQUIRE(asset.GetMaterials().size() == 2);
+    const Gltf::Material& material = asset.GetMaterials()[0];
+    CHECK(material.BaseColorFactor == glm::vec4(0.5f, 0.25f, 1.0f, 0.75f) && material.EmissiveFactor == glm::vec3(1.0f, 0.5f, 0.0f));
+    CHECK(material.MetallicFactor == 0.2f && material.RoughnessFactor == 1.0f && material.NormalScale == 2.0f);
+    CHECK(material.Alpha == Gltf::AlphaMode::Mask && asset.GetMaterials()[1].Alpha == Gltf::AlphaMode::Blend);
+    CHECK(material.BaseColorTexture == 0 && material.MetallicRoughnessTexture == 1 && material.NormalTexture == 1);
+    CHECK(material.OcclusionTexture == -1 && material.EmissiveTexture == -1 && asset.GetMaterials()[1].EmissiveTexture == -1);
+
+    REQUIRE(asset.GetImages().size() == 2);
+    CHECK(asset.GetImages()[0].Path == std::filesystem::path("textures/base color.png") && asset.GetImages()[0].Data.empty());
+
+    // Scaled, rotated about z and translated in that order, for row vectors
+    REQUIRE(asset.GetNodes().size() == 4);
+    const DirectX::XMFLOAT4X4& root = asset.GetNodes()[0].LocalTransform;
+    CHECK(std::abs(root.m[0][0]) < 1e-5f && std::abs(root.m[0][1] - 2.0f) < 1e-5f && std::abs(root.m[1][0] + 2.0f) < 1e-5f);
+    CHECK(root.m[2][2] == 2.0f && root.m[3][0] == 1.0f && root.m[3][1] == 2.0f && root.m[3][2] == 3.0f);
+    CHECK(asset.GetNodes()[0].Children == std::vector<uint32_t>({ 2, 1 }) && asset.GetNodes()[0].Mesh == -1);
+    const DirectX::XMFLOAT4X4& child = asset.GetNodes()[1].LocalTransform;
+    CHECK(child.m[3][0] == 4.0f && child.m[3][1] == 5.0f && child.m[3][2] == 6.0f && child.m[0][3] == 0.0f && asset.GetNodes()[1].Mesh == 0);
+
+    // Only the nodes of the default scene are roots
+    CHECK(asset.GetRootNodes() == std::vector<uint32_t>({ 0 }));
+}
+
+AKARI_TEST(Gltf, LoadsGlb)
+{
+    const Tests::TempDirectory directory("Gltf");
+
+    const std::array<glm::vec3, 3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    const std::array<uint16_t, 3> indices = { 0, 2, 1 };
+    const std::string png = "\x89PNG not really";
+    GltfBuilder builder;
+    builder.AddAccessor(builder.AddView(positions), Float, "VEC3", 3);
+    builder.AddAccessor(builder.AddView(indices), UnsignedShort, "SCALAR", 3);
+    const uint32_t imageView = builder.AddView(png);
+
+    const std::string members = R"(, "meshes": [{ "primitives": [{ "attributes": { "POSITION": 0 }, "indices": 1 }] }],
+                                     "images": [{ "bufferView": )" + std::to_string(imageView) + R"(, "mimeType": "image/png" }],
+                                     "nodes": [{ "mesh": 0 }])";
+    const auto path = directory.Write("scene.glb", MakeGlb(builder.GetJson(members, ""), builder.GetBuffer()));
+
+    Gltf::Asset asset;
+    REQUIRE(asset.Open(path));
+    CHECK(asset.GetFilePaths().size() == 1);
+    CHECK(ReadIndices(asset.GetAccessors()[1]) == std::vector<uint32_t>({ 0, 2, 1 }));
+
+    // Accessors and images point into the mapped binary chunk, nothing is copied
+    REQUIRE(asset.GetImages().size() == 1);
+    const std::span<const std::byte> image = asset.GetImages()[0].Data;
+    CHECK(image.size() == png.size() && std::memcmp(image.data(), png.data(), png.size()) == 0 && asset.GetImages()[0].Path.empty());
+    const ptrdiff_t imageOffset = static_cast<ptrdiff_t>(builder.GetBuffer().find(png));
+    CHECK(image.data() - asset.GetAccessors()[0].Data == imageOffset);
+
+    // Without scenes every node without a parent is a root
+    CHECK(asset.GetRootNodes() == std::vector<uint32_t>({ 0 }));
+}
+
+// Every index and byte range is checked when the asset is opened, so the import never reads past the mapping
+AKARI_TEST(Gltf, RejectsInvalidAssets)
+{
+    const Tests::TempDirectory directory("Gltf");
+
+    const std::array<glm::vec3, 4> positions = {};
+    const std::array<uint32_t, 3> indices = { 0, 1, 2 };
+    GltfBuilder builder;
+    builder.AddAccessor(builder.AddView(positions), Float, "VEC3", 4);
+    builder.AddAccessor(builder.AddView(indices), UnsignedInt, "SCALAR", 3);
+    directory.Write("buffer.bin", builder.GetBuffer());
+
+    const std::string valid = R"(, "materials": [{}], "meshes": [{ "primitives": [{ "attributes": { "POSITION": 0 }, "indices": 1, "material": 0 }] }],
+                                   "nodes": [{ "mesh": 0, "children": [1] }, {}], "scenes": [{ "nodes": [0] }])";
+    const auto opens = [&](std::string_view members, const GltfBuilder& assetBuilder, std::string_view uri = "buffer.bin")
+    {
+        return Opens(directory.Write("asset.gltf", assetBuilder.GetJson(members, uri)));
+    };
+    const auto replaced = [&](std::string_view from, std::string_view to)
+    {
+        std::string members = valid;
+        const size_t offset = members.find(from);
+        assert(offset != std::string::npos);
+        return members.replace(offset, from.size(), to);
+    };
+    REQUIRE(opens(valid, builder));
+
+    // Files
+    CHECK(!Opens(directory / "missing.gltf"));
+    CHECK(!opens(valid, builder, "missing.bin"));
+    CHECK(!opens(valid, builder, "data:application/octet-stream;base64,AAAA"));
+    CHECK(!Opens(directory.Write("asset.gltf", builder.GetJson(valid, "buffer.bin").substr(1))));
+    CHECK(!Opens(directory.Write("asset.gltf", "{\"asset\":{\"version\":\"1.0\"}}")));
+    CHECK(!opens(valid + R"(, "extensionsRequired": ["KHR_mesh_quantization"])", builder));
+    directory.Write("short.bin", std::string_view(builder.GetBuffer()).substr(0, builder.GetBuffer().size() - 1));
+    CHECK(!opens(valid, builder, "short.bin"));
+
+    // Accessors past their buffer view or of a missing one, sparse accessors
+    for (const auto& [view, count, offset] : { std::tuple(0, 5u, 0u), std::tuple(0, 4u, 4u), std::tuple(0, 1u, 64u), std::tuple(2, 1u, 0u) })
+    {
+        GltfBuilder broken = builder;
+        broken.AddAccessor(view, Float, "VEC3", count, offset);
+        CHECK(!opens(valid, broken));
+    }
+    GltfBuilder unknownType = builder;
+    unknownType.AddAccessor(0, Float, "VEC5", 1);
+    CHECK(!opens(valid, unknownType));
+    CHECK(!Opens(directory.Write("asset.gltf", [&]
+    {
+        std::string json = builder.GetJson(valid, "buffer.bin");
+        return json.replace(json.find("\"count\":3"), 9, "\"count\":3,\"sparse\":{\"count\":1}");
+    }())));
+
+    // Primitives with missing accessors or materials, indices that aren't unsigned integers
+    CHECK(!opens(replaced("\"POSITION\": 0", "\"POSITION\": 2"), builder));
+    CHECK(!opens(replaced("\"POSITION\": 0", "\"POSITION\": 0, \"NORMAL\": -2"), builder));
+    CHECK(!opens(replaced("\"indices\": 1", "\"indices\": 0"), builder));
+    CHECK(!opens(replaced("\"material\": 0", "\"material\": 1"), builder));
+
+    // Nodes of missing meshes, cycles, self references and nodes with two parents
+    CHECK(!opens(replaced("\"mesh\": 0", "\"mesh\": 1"), builder));
+    CHECK(!opens(replaced("{}], \"scenes\"", "{}, { \"children\": [3] }, { \"children\": [2] }], \"scenes\""), builder));
+    CHECK(!opens(replaced("\"children\": [1]", "\"children\": [0]"), builder));
+    CHECK(!opens(replaced("\"children\": [1]", "\"children\": [1, 1]"), builder));
+    CHECK(!opens(replaced("\"children\": [1]", "\"children\": [2]"), builder));
+
+    // Missing default scenes, scenes of missing nodes, of nodes with a parent or of the same node twice
+    CHECK(!opens(valid + ", \"scene\": 1", builder));
+    CHECK(!opens(replaced("\"nodes\": [0]", "\"nodes\": [2]"), builder));
+    CHECK(!opens(replaced("\"nodes\": [0]", "\"nodes\": [0, 1]"), builder));
+    CHECK(!opens(replaced("\"nodes\": [0]", "\"nodes\": [0, 0]"), builder));
+
+    // Damaged .glb headers and chunks
+    const std::string glb = MakeGlb(builder.GetJson(valid, ""), builder.GetBuffer());
+    CHECK(Opens(directory.Write("asset.glb", glb)));
+    CHECK(!Opens(directory.Write("asset.glb", MakeGlb(builder.GetJson(valid, ""), builder.GetBuffer(), 1))));
+    CHECK(!Opens(directory.Write("asset.glb", std::string_view(glb).substr(0, glb.size() - 4))));
+    CHECK(!Opens(directory.Write("asset.glb", MakeGlb(builder.GetJson(valid, ""), ""))));
+    std::string patched = glb;
+    patched[16] = 'X';
+    CHECK(!Opens(directory.Write("asset.glb", patched)));
+    patched = glb;
+    std::memcpy(patched.data() + 12, "\xff\xff\xff\x00", 4);
+    CHECK(!Opens(directory.Write("asset.glb", patched)));
+}
+
+// A scanned model sized .glb, 1M vertices and 2M triangles. Opening maps the file and parses the JSON, the import then
+// reads the accessors, which for tightly packed floats and 32 bit indices is a copy out of the mapping.
+AKARI_BENCHMARK(Gltf, LoadLargeGlb)
+{
+    const Tests::TempDirectory directory("Gltf");
+
+    constexpr uint32_t size = 1000;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const glm::vec2 uv(static_cast<float>(x) / (size - 1), static_cast<float>(y) / (size - 1));
+            positions.emplace_back(uv.x, uv.y, std::sin(uv.x * 20.0f) * 0.05f);
+            normals.push_back(glm::normalize(glm::vec3(-std::cos(uv.x * 20.0f), 0.0f, 1.0f)));
+            texCoords.push_back(uv);
+            if (x + 1 < size && y + 1 < size)
+            {
+                const uint32_t v = y * size + x;
+                indices.insert(indices.end(), { v, v + 1, v + size + 1, v, v + size + 1, v + size });
+            }
+        }
+    }
+
+    GltfBuilder builder;
+    builder.AddAccessor(builder.AddView(positions), Float, "VEC3", size * size);
+    builder.AddAccessor(builder.AddView(normals), Float, "VEC3", size * size);
+    builder.AddAccessor(builder.AddView(texCoords), Float, "VEC2", size * size);
+    builder.AddAccessor(builder.AddView(indices), UnsignedInt, "SCALAR", static_cast<uint32_t>(indices.size()));
+    const std::string members = R"(, "meshes": [{ "primitives": [{ "attributes": { "POSITION": 0, "NORMAL": 1, "TEXCOORD_0": 2 }, "indices": 3 }] }],
+                                     "nodes": [{ "mesh": 0 }])";
+    const auto path = directory.Write("large.glb", MakeGlb(builder.GetJson(members, ""), builder.GetBuffer()));
+    const auto megabytes = static_cast<float>(std::filesystem::file_size(path)) / (1 << 20);
+    spdlog::info("  {0:.1f} MB", megabytes);
+
+    Tests::Measure("Open", 20, [&] { Gltf::Asset().Open(path); });
+
+    // Read the way the import reads them
+    std::vector<float> floats(size * size * 3);
+    std::vector<uint32_t> readIndices(indices.size());
+    const float milliseconds = Tests::Measure("Open and read every accessor", 10, [&]
+    {
+        Gltf::Asset asset;
+        asset.Open(path);
+        const auto& accessors = asset.GetAccessors();
+        accessors[0].ReadFloats(floats, 3);
+        accessors[1].ReadFloats(floats, 3);
+        accessors[2].ReadFloats(floats, 2);
+        accessors[3].ReadIndices(readIndices);
+    });
+    spdlog::info("  {0:.0f} MB/s", megabytes / milliseconds * 1000.0f);
+
+    // What a loader that reads the file into memory pays before it parses anything
+    Tests::Measure("Read the file into memory", 10, [&]
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> data(std::filesystem::file_size(path));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    });
+}
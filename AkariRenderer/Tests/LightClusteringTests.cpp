@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RPI/LightClustering.h"
+
+using namespace Akari;
+
+namespace
+{
+    const float VerticalFov = glm::radians(60.0f);
+    constexpr float AspectRatio = 16.0f / 9.0f;
+    constexpr float NearClip = 0.1f;
+    constexpr float FarClip = 200.0f;
+
+    std::vector<PointLight> MakeRandomLights(uint32_t count, float maxRadius, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> lateral(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> depth(-10.0f, 150.0f);
+        std::uniform_real_distribution<float> radius(0.5f, maxRadius);
+
+        std::vector<PointLight> lights(count);
+        for (auto& light : lights)
+        {
+            light.Trans.Translation = glm::vec3(lateral(random), lateral(random), depth(random));
+            light.Props.Radius = radius(random);
+        }
+        return lights;
+    }
+
+    // The cluster Lit_PS looks up for a view space position
+    uint32_t GetClusterIndex(const LightClustering& clustering, const glm::vec3& position)
+    {
+        const float tanHalfFovY = std::tan(VerticalFov * 0.5f);
+        const glm::vec2 ndc(position.x / (position.z * tanHalfFovY * AspectRatio), position.y / (position.z * tanHalfFovY));
+
+        const auto tile = [](const float value, const uint32_t count)
+        {
+            return std::min(static_cast<uint32_t>((value + 1.0f) * 0.5f * count), count - 1);
+        };
+        const float slice = std::log(position.z) * clustering.GetDepthSliceScale() + clustering.GetDepthSliceBias();
+        return LightClustering::GetClusterIndex(tile(ndc.x, LightClustering::ClusterCountX), tile(-ndc.y, LightClustering::ClusterCountY),
+                                                static_cast<uint32_t>(std::clamp(slice, 0.0f, LightClustering::ClusterCountZ - 1.0f)));
+    }
+
+    std::span<const uint32_t> GetClusterLights(const LightClustering& clustering, uint32_t cluster)
+    {
+        const LightCluster& range = clustering.GetClusters()[cluster];
+        return std::span(clustering.GetLightIndices()).subspan(range.Offset, range.Count);
+    }
+
+    // Every light reaching a point inside the frustum has to be in the list of the point's cluster
+    bool FindsLightsAtPoints(const LightClustering& clustering, std::span<const PointLight> lights, const glm::mat4& view, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> logDepth(std::log(NearClip), std::log(FarClip));
+        const float tanHalfFovY = std::tan(VerticalFov * 0.5f);
+
+        for (int i = 0; i < 20'000; ++i)
+        {
+            const float depth = std::exp(logDepth(random));
+            const glm::vec3 position(unit(random) * depth * tanHalfFovY * AspectRatio, unit(random) * depth * tanHalfFovY, depth);
+            const auto clusterLights = GetClusterLights(clustering, GetClusterIndex(clustering, position));
+
+            for (uint32_t light = 0; light < lights.size(); ++light)
+            {
+                // The margin covers the rounding of points on cluster boundaries
+                const glm::vec3 lightPosition = glm::vec3(view * glm::vec4(lights[light].Trans.Translation, 1.0f));
+                if (glm::distance(position, lightPosition) < lights[light].Props.Radius * 0.999f && !std::ranges::binary_search(clusterLights, light))
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+AKARI_TEST(LightClustering, MatchesBruteForce)
+{
+    std::mt19937 random(29);
+    const std::vector<PointLight> lights = MakeRandomLights(300, 8.0f, random);
+
+    // Lights are placed in world space, the camera looks at them from the side
+    const glm::mat4 view = glm::lookAt(glm::vec3(-20.0f, 5.0f, 70.0f), glm::vec3(60.0f, 0.0f, 70.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    LightClustering clustering;
+    for (const glm::mat4& cameraView : { glm::mat4(1.0f), view })
+    {
+        clustering.Build(lights, cameraView, VerticalFov, AspectRatio, NearClip, FarClip);
+        REQUIRE(clustering.GetClusters().size() == LightClustering::ClusterCount);
+
+        // Lists are ascending and not truncated, so nothing may be missing
+        uint32_t maxCount = 0;
+        for (uint32_t cluster = 0; cluster < LightClustering::ClusterCount; ++cluster)
+        {
+            const auto clusterLights = GetClusterLights(clustering, cluster);
+            CHECK(std::ranges::is_sorted(clusterLights));
+            maxCount = std::max(maxCount, static_cast<uint32_t>(clusterLights.size()));
+        }
+        REQUIRE(maxCount < LightClustering::MaxLightsPerCluster);
+        CHECK(maxCount > 0);
+
+        CHECK(FindsLightsAtPoints(clustering, lights, cameraView, random));
+    }
+}
+
+AKARI_TEST(LightClustering, SkipsLightsOutsideTheFrustum)
+{
+    std::vector<PointLight> lights(4);
+    lights[0].Trans.Translation = { 0.0f, 0.0f, -15.0f };
+    lights[1].Trans.Translation = { 0.0f, 0.0f, FarClip + 20.0f };
+    lights[2].Trans.Translation = { 500.0f, 0.0f, 50.0f };
+    lights[3].Trans.Translation = { 0.0f, 0.0f, 50.0f };
+    for (auto& light : lights)
+        light.Props.Radius = 10.0f;
+
+    LightClustering clustering;
+    clustering.Build(lights, glm::mat4(1.0f), VerticalFov, AspectRatio, NearClip, FarClip);
+
+    const auto& indices = clustering.GetLightIndices();
+    CHECK(!indices.empty());
+    CHECK(std::ranges::all_of(indices, [](const uint32_t light) { return light == 3; }));
+    CHECK(std::ranges::binary_search(GetClusterLights(clustering, GetClusterIndex(clustering, { 0.0f, 0.0f, 50.0f })), 3u));
+
+    // A light around the camera reaches every tile of the nearest slice
+    lights.assign(1, {});
+    lights[0].Props.Radius = 1.0f;
+    clustering.Build(lights, glm::mat4(1.0f), VerticalFov, AspectRatio, NearClip, FarClip);
+    for (uint32_t y = 0; y < LightClustering::ClusterCountY; ++y)
+    {
+        for (uint32_t x = 0; x < LightClustering::ClusterCountX; ++x)
+            CHECK(clustering.GetClusters()[LightClustering::GetClusterIndex(x, y, 0)].Count == 1);
+    }
+}
+
+AKARI_BENCHMARK(LightClustering, Build)
+{
+    std::mt19937 random(31);
+    LightClustering clustering;
+
+    for (const uint32_t lightCount : { 256u, 1024u, 4096u })
+    {
+        const std::vector<PointLight> lights = MakeRandomLights(lightCount, 4.0f, random);
+        for (const uint32_t threadCount : { 1u, 8u })
+        {
+            Tests::RunWithThreads(threadCount, [&]
+            {
+                const std::string label = std::to_string(lightCount) + " lights, " + std::to_string(threadCount) + " threads";
+                Tests::Measure(label.c_str(), 20, [&]
+                {
+                    clustering.Build(lights, glm::mat4(1.0f), VerticalFov, AspectRatio, NearClip, FarClip);
+                });
+            });
+        }
+        spdlog::info("  {0} light indices", clustering.GetLightIndices().size());
+    }
+}
@@ -0,0 +1,251 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/MeshOptimizer.h"
+
+using namespace Akari;
+
+namespace
+{
+    struct TestMesh
+    {
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;
+    };
+
+    // size x size quads in the xy plane, triangles shuffled so the input order has no locality
+    TestMesh MakeShuffledGrid(uint32_t size, uint32_t seed)
+    {
+        TestMesh mesh;
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+                mesh.Positions.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.0f);
+        }
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const uint32_t v00 = y * (size + 1) + x, v10 = v00 + 1, v01 = v00 + size + 1, v11 = v01 + 1;
+                triangles.push_back({ v00, v10, v11 });
+                triangles.push_back({ v00, v11, v01 });
+            }
+        }
+
+        std::mt19937 random(seed);
+        std::ranges::shuffle(triangles, random);
+        for (const auto& triangle : triangles)
+            mesh.Indices.insert(mesh.Indices.end(), triangle.begin(), triangle.end());
+        return mesh;
+    }
+
+    // Closed sphere around center facing outwards, the vertices appended to the mesh
+    void AddSphere(TestMesh& mesh, const glm::vec3& center, float radius, uint32_t rings, uint32_t segments)
+    {
+        const auto base = static_cast<uint32_t>(mesh.Positions.size());
+        mesh.Positions.push_back(center + glm::vec3(0.0f, radius, 0.0f));
+        for (uint32_t ring = 1; ring < rings; ++ring)
+        {
+            const float theta = glm::pi<float>() * ring / rings;
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                const float phi = 2.0f * glm::pi<float>() * segment / segments;
+                mesh.Positions.push_back(center + radius * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+            }
+        }
+        mesh.Positions.push_back(center - glm::vec3(0.0f, radius, 0.0f));
+
+        const uint32_t south = static_cast<uint32_t>(mesh.Positions.size()) - 1;
+        auto ringVertex = [&](uint32_t ring, uint32_t segment) { return base + 1 + (ring - 1) * segments + segment % segments; };
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            mesh.Indices.insert(mesh.Indices.end(), { base, ringVertex(1, segment + 1), ringVertex(1, segment) });
+            mesh.Indices.insert(mesh.Indices.end(), { south, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1) });
+            for (uint32_t ring = 1; ring + 1 < rings; ++ring)
+            {
+                const uint32_t v00 = ringVertex(ring, segment), v10 = ringVertex(ring, segment + 1);
+                const uint32_t v01 = ringVertex(ring + 1, segment), v11 = ringVertex(ring + 1, segment + 1);
+                mesh.Indices.insert(mesh.Indices.end(), { v00, v10, v11, v00, v11, v01 });
+            }
+        }
+    }
+
+    // Triangles rotated to start at their smallest index and sorted, equal for the same triangles with the same winding
+    std::vector<std::array<uint32_t, 3>> GetTriangleSet(std::span<const uint32_t> indices)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+            std::ranges::rotate(triangle, std::ranges::min_element(triangle));
+            triangles.push_back(triangle);
+        }
+        std::ranges::sort(triangles);
+        return triangles;
+    }
+}
+
+AKARI_TEST(MeshOptimizer, AnalyzesVertexCache)
+{
+    // A lone triangle transforms all its vertices
+    std::vector<uint32_t> indices = { 0, 1, 2 };
+    MeshOptimizer::VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices, 3);
+    CHECK(stats.TransformedVertices == 3 && stats.Triangles == 1 && stats.Vertices == 3);
+    CHECK(stats.GetAcmr() == 3.0f && stats.GetAtvr() == 1.0f);
+
+    // A quad reuses its diagonal
+    indices = { 0, 1, 2, 2, 1, 3 };
+    stats = MeshOptimizer::AnalyzeVertexCache(indices, 4);
+    CHECK(stats.TransformedVertices == 4 && stats.GetAcmr() == 2.0f);
+
+    // Degenerate triangles of one vertex each, every one a miss
+    indices.clear();
+    for (uint32_t v = 0; v < MeshOptimizer::CacheSize + 2; ++v)
+        indices.insert(indices.end(), { v, v, v });
+    stats = MeshOptimizer::AnalyzeVertexCache(std::span(indices).first(MeshOptimizer::CacheSize * 3), MeshOptimizer::CacheSize + 2);
+    CHECK(stats.TransformedVertices == MeshOptimizer::CacheSize);
+
+    // After CacheSize + 2 misses the last vertex and the one added CacheSize misses ago hit, the one before misses
+    constexpr uint32_t last = MeshOptimizer::CacheSize + 1;
+    indices.insert(indices.end(), { last, last, last, 2, 2, 2, 1, 1, 1 });
+    stats = MeshOptimizer::AnalyzeVertexCache(indices, MeshOptimizer::CacheSize + 2);
+    CHECK(stats.TransformedVertices == MeshOptimizer::CacheSize + 2 + 1);
+    CHECK(stats.Vertices == MeshOptimizer::CacheSize + 2 && stats.GetAtvr() > 1.0f);
+
+    stats.Add(stats);
+    CHECK(stats.Triangles == 2 * (MeshOptimizer::CacheSize + 5));
+    CHECK(MeshOptimizer::AnalyzeVertexCache({}, 0).GetAcmr() == 0.0f);
+}
+
+AKARI_TEST(MeshOptimizer, OptimizesVertexCache)
+{
+    TestMesh grid = MakeShuffledGrid(64, 1);
+    const auto triangles = GetTriangleSet(grid.Indices);
+    const float shuffledAcmr = MeshOptimizer::AnalyzeVertexCache(grid.Indices, grid.Positions.size()).GetAcmr();
+
+    MeshOptimizer::OptimizeVertexCache(grid.Indices, grid.Positions.size());
+    const float optimizedAcmr = MeshOptimizer::AnalyzeVertexCache(grid.Indices, grid.Positions.size()).GetAcmr();
+    CHECK(GetTriangleSet(grid.Indices) == triangles);
+    CHECK(shuffledAcmr > 2.0f);
+    // A regular grid reaches about 0.7 with a 16 entry cache, 0.5 is the limit for an infinite one
+    CHECK(optimizedAcmr < 0.8f);
+
+    // Optimizing an optimized order keeps it
+    std::vector<uint32_t> again = grid.Indices;
+    MeshOptimizer::OptimizeVertexCache(again, grid.Positions.size());
+    CHECK(MeshOptimizer::AnalyzeVertexCache(again, grid.Positions.size()).GetAcmr() <= optimizedAcmr * 1.01f);
+
+    std::vector<uint32_t> empty;
+    MeshOptimizer::OptimizeVertexCache(empty, 0);
+    CHECK(empty.empty());
+}
+
+// A small sphere inside a large one, the triangles of the outer one should be drawn first
+AKARI_TEST(MeshOptimizer, OptimizesOverdraw)
+{
+    TestMesh mesh;
+    AddSphere(mesh, glm::vec3(0.0f), 0.5f, 32, 64);
+    AddSphere(mesh, glm::vec3(0.0f), 2.0f, 32, 64);
+    const auto outerBegin = static_cast<uint32_t>(mesh.Positions.size() / 2);
+    const auto triangles = GetTriangleSet(mesh.Indices);
+
+    MeshOptimizer::OptimizeVertexCache(mesh.Indices, mesh.Positions.size());
+    const float cacheAcmr = MeshOptimizer::AnalyzeVertexCache(mesh.Indices, mesh.Positions.size()).GetAcmr();
+    const bool innerFirst = mesh.Indices[0] < outerBegin;
+
+    MeshOptimizer::OptimizeOverdraw(mesh.Indices, mesh.Positions);
+    CHECK(GetTriangleSet(mesh.Indices) == triangles);
+    CHECK(MeshOptimizer::AnalyzeVertexCache(mesh.Indices, mesh.Positions.size()).GetAcmr() <= cacheAcmr * MeshOptimizer::OverdrawThreshold);
+
+    // Counts outer triangles in the first half, the inner sphere came first in the cache order
+    size_t outerInFirstHalf = 0;
+    const size_t triangleCount = mesh.Indices.size() / 3;
+    for (size_t t = 0; t < triangleCount / 2; ++t)
+        outerInFirstHalf += mesh.Indices[t * 3] >= outerBegin;
+    CHECK(innerFirst);
+    CHECK(outerInFirstHalf > triangleCount / 2 * 9 / 10);
+}
+
+AKARI_TEST(MeshOptimizer, OptimizesVertexFetch)
+{
+    TestMesh grid = MakeShuffledGrid(16, 2);
+    // Unused vertices at both ends
+    grid.Positions.insert(grid.Positions.begin(), glm::vec3(-1.0f));
+    grid.Positions.push_back(glm::vec3(-2.0f));
+    for (uint32_t& index : grid.Indices)
+        index++;
+
+    std::vector<std::array<glm::vec3, 3>> corners;
+    for (const uint32_t index : grid.Indices)
+        corners.push_back({ grid.Positions[index], glm::vec3(static_cast<float>(index)), glm::vec3(0.0f) });
+
+    std::vector<std::array<glm::vec3, 3>> vertices;
+    for (uint32_t v = 0; v < grid.Positions.size(); ++v)
+        vertices.push_back({ grid.Positions[v], glm::vec3(static_cast<float>(v)), glm::vec3(0.0f) });
+
+    MeshOptimizer::OptimizeVertexFetch(std::span(grid.Indices), vertices);
+    CHECK(vertices.size() == grid.Positions.size() - 2);
+
+    // Same corners in the same order, vertices in first use order
+    uint32_t next = 0;
+    bool firstUseOrder = true, sameCorners = true;
+    for (size_t i = 0; i < grid.Indices.size(); ++i)
+    {
+        const uint32_t index = grid.Indices[i];
+        if (index == next)
+            next++;
+        firstUseOrder &= index < next;
+        sameCorners &= vertices[index] == corners[i];
+    }
+    CHECK(firstUseOrder && next == vertices.size());
+    CHECK(sameCorners);
+}
+
+// Imports cache their results, the same input has to give the same output
+AKARI_TEST(MeshOptimizer, IsDeterministic)
+{
+    TestMesh first;
+    AddSphere(first, glm::vec3(1.0f, 2.0f, 3.0f), 1.0f, 24, 48);
+    TestMesh second = first;
+
+    for (TestMesh* mesh : { &first, &second })
+    {
+        MeshOptimizer::OptimizeVertexCache(mesh->Indices, mesh->Positions.size());
+        MeshOptimizer::OptimizeOverdraw(mesh->Indices, mesh->Positions);
+        MeshOptimizer::OptimizeVertexFetch(std::span(mesh->Indices), mesh->Positions);
+    }
+    CHECK(first.Indices == second.Indices);
+    CHECK(first.Positions == second.Positions);
+}
+
+// The import pipeline on 1M shuffled triangles
+AKARI_BENCHMARK(MeshOptimizer, Optimize1MTriangles)
+{
+    const TestMesh shuffled = MakeShuffledGrid(708, 3);
+    TestMesh mesh;
+    spdlog::info("  {0} triangles, ACMR {1:.3f}", shuffled.Indices.size() / 3, MeshOptimizer::AnalyzeVertexCache(shuffled.Indices, shuffled.Positions.size()).GetAcmr());
+
+    Tests::Measure("OptimizeVertexCache", 5, [&]
+    {
+        mesh = shuffled;
+        MeshOptimizer::OptimizeVertexCache(mesh.Indices, mesh.Positions.size());
+    });
+    spdlog::info("  ACMR {0:.3f}", MeshOptimizer::AnalyzeVertexCache(mesh.Indices, mesh.Positions.size()).GetAcmr());
+
+    const std::vector<uint32_t> cacheOptimized = mesh.Indices;
+    Tests::Measure("OptimizeOverdraw", 5, [&]
+    {
+        mesh.Indices = cacheOptimized;
+        MeshOptimizer::OptimizeOverdraw(mesh.Indices, mesh.Positions);
+    });
+    spdlog::info("  ACMR {0:.3f}", MeshOptimizer::AnalyzeVertexCache(mesh.Indices, mesh.Positions.size()).GetAcmr());
+
+    const TestMesh overdrawOptimized = mesh;
+    Tests::Measure("OptimizeVertexFetch", 5, [&]
+    {
+        mesh = overdrawOptimized;
+        MeshOptimizer::OptimizeVertexFetch(std::span(mesh.Indices), mesh.Positions);
+    });
+}
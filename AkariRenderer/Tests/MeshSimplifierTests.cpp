@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/MeshSimplifier.h"
+
+using namespace Akari;
+
+namespace
+{
+    struct TestMesh
+    {
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;
+    };
+
+    // Unit square in the xy plane of size x size quads facing +z. With a seam, the vertices of the middle
+    // column are duplicated and the right half uses the copies, like a UV seam.
+    TestMesh MakeGrid(uint32_t size, bool seam)
+    {
+        TestMesh mesh;
+        const uint32_t seamColumn = size / 2;
+        std::vector<uint32_t> left((size + 1) * (size + 1)), right((size + 1) * (size + 1));
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+            {
+                const uint32_t cell = y * (size + 1) + x;
+                left[cell] = right[cell] = static_cast<uint32_t>(mesh.Positions.size());
+                mesh.Positions.emplace_back(static_cast<float>(x) / size, static_cast<float>(y) / size, 0.0f);
+                if (seam && x == seamColumn)
+                {
+                    right[cell] = static_cast<uint32_t>(mesh.Positions.size());
+                    mesh.Positions.push_back(mesh.Positions.back());
+                }
+            }
+        }
+
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const auto& vertices = x < seamColumn ? left : right;
+                const uint32_t v00 = vertices[y * (size + 1) + x], v10 = vertices[y * (size + 1) + x + 1];
+                const uint32_t v01 = vertices[(y + 1) * (size + 1) + x], v11 = vertices[(y + 1) * (size + 1) + x + 1];
+                mesh.Indices.insert(mesh.Indices.end(), { v00, v10, v11, v00, v11, v01 });
+            }
+        }
+        return mesh;
+    }
+
+    // Latitude and longitude sphere, with the duplicated seam column and pole vertices of a textured sphere
+    TestMesh MakeSphere(uint32_t rings, uint32_t segments, float radius)
+    {
+        TestMesh mesh;
+        for (uint32_t ring = 0; ring <= rings; ++ring)
+        {
+            // Exact poles, sin(pi) in float would spread the pole vertices into a tiny open border
+            const float theta = glm::pi<float>() * ring / rings;
+            const float sinTheta = ring == rings ? 0.0f : std::sin(theta);
+            for (uint32_t segment = 0; segment <= segments; ++segment)
+            {
+                const float phi = 2.0f * glm::pi<float>() * (segment % segments) / segments;
+                mesh.Positions.emplace_back(radius * sinTheta * std::cos(phi), radius * std::cos(theta), radius * sinTheta * std::sin(phi));
+            }
+        }
+
+        for (uint32_t ring = 0; ring < rings; ++ring)
+        {
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                const uint32_t v00 = ring * (segments + 1) + segment, v10 = v00 + 1;
+                const uint32_t v01 = v00 + segments + 1, v11 = v01 + 1;
+                if (ring > 0)
+                    mesh.Indices.insert(mesh.Indices.end(), { v00, v10, v11 });
+                if (ring < rings - 1)
+                    mesh.Indices.insert(mesh.Indices.end(), { v00, v11, v01 });
+            }
+        }
+        return mesh;
+    }
+
+    glm::vec3 GetNormal(const TestMesh& mesh, std::span<const uint32_t> indices, size_t triangle)
+    {
+        const glm::vec3& p0 = mesh.Positions[indices[triangle * 3 + 0]];
+        const glm::vec3& p1 = mesh.Positions[indices[triangle * 3 + 1]];
+        const glm::vec3& p2 = mesh.Positions[indices[triangle * 3 + 2]];
+        return glm::cross(p1 - p0, p2 - p0) * 0.5f;
+    }
+
+    bool IsValidIndexList(const TestMesh& mesh, std::span<const uint32_t> indices)
+    {
+        if (indices.size() % 3 != 0)
+            return false;
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            if (indices[i] >= mesh.Positions.size() || indices[i + 1] >= mesh.Positions.size() || indices[i + 2] >= mesh.Positions.size())
+                return false;
+            if (indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i + 2] == indices[i])
+                return false;
+        }
+        return true;
+    }
+
+    // Area of the triangles of one side of the seam, negative if any of them flipped over
+    float GetPlanarArea(const TestMesh& mesh, std::span<const uint32_t> indices, const std::function<bool(uint32_t)>& isOnSide)
+    {
+        float area = 0.0f;
+        for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle)
+        {
+            if (!isOnSide(indices[triangle * 3]))
+                continue;
+
+            const float triangleArea = GetNormal(mesh, indices, triangle).z;
+            if (triangleArea <= 0.0f)
+                return -1.0f;
+            area += triangleArea;
+        }
+        return area;
+    }
+}
+
+// A flat grid carries no error, it collapses as far as its border allows and keeps covering the square
+AKARI_TEST(MeshSimplifier, CollapsesFlatGrid)
+{
+    const TestMesh grid = MakeGrid(32, false);
+    const MeshSimplifier simplifier(grid.Positions);
+
+    float error;
+    const auto simplified = simplifier.Simplify(grid.Indices, 0, 1e-4f, error);
+    REQUIRE(IsValidIndexList(grid, simplified));
+    CHECK(simplified.size() < grid.Indices.size() / 4);
+    CHECK(error <= 1e-4f);
+    CHECK(std::abs(GetPlanarArea(grid, simplified, [](uint32_t) { return true; }) - 1.0f) < 1e-4f);
+
+    // The target stops the collapses first
+    const auto half = simplifier.Simplify(grid.Indices, grid.Indices.size() / 2, 1.0f, error);
+    CHECK(half.size() <= grid.Indices.size() / 2 && half.size() > grid.Indices.size() / 2 - 12);
+}
+
+// Seam vertices only move along the seam and together with their twin, so both sides still meet
+AKARI_TEST(MeshSimplifier, KeepsSeamsClosed)
+{
+    const TestMesh grid = MakeGrid(32, true);
+    const MeshSimplifier simplifier(grid.Positions);
+
+    float error;
+    const auto simplified = simplifier.Simplify(grid.Indices, 0, 1e-4f, error);
+    REQUIRE(IsValidIndexList(grid, simplified));
+    CHECK(simplified.size() < grid.Indices.size() / 4);
+
+    // Triangles left of the seam only use vertices left of it or the left copies on it
+    std::vector<uint8_t> leftVertices(grid.Positions.size(), 0);
+    for (size_t i = 0; i < grid.Indices.size(); i += 6)
+    {
+        if (grid.Positions[grid.Indices[i + 1]].x <= 0.5f)
+        {
+            for (size_t corner = 0; corner < 6; ++corner)
+                leftVertices[grid.Indices[i + corner]] = 1;
+        }
+    }
+    const auto isLeft = [&](const uint32_t vertex) { return leftVertices[vertex] != 0; };
+    CHECK(std::abs(GetPlanarArea(grid, simplified, isLeft) - 0.5f) < 1e-4f);
+    CHECK(std::abs(GetPlanarArea(grid, simplified, [&](const uint32_t vertex) { return !isLeft(vertex); }) - 0.5f) < 1e-4f);
+
+    // The seam positions used on both sides are the same, no gap opens between them
+    std::vector<float> leftSeam, rightSeam;
+    for (const uint32_t vertex : simplified)
+    {
+        if (grid.Positions[vertex].x == 0.5f)
+            (isLeft(vertex) ? leftSeam : rightSeam).push_back(grid.Positions[vertex].y);
+    }
+    for (auto* seam : { &leftSeam, &rightSeam })
+    {
+        std::ranges::sort(*seam);
+        seam->erase(std::unique(seam->begin(), seam->end()), seam->end());
+    }
+    CHECK(leftSeam == rightSeam);
+    CHECK(leftSeam.size() >= 2 && leftSeam.size() < 33);
+}
+
+AKARI_TEST(MeshSimplifier, BuildsLodChain)
+{
+    constexpr float radius = 2.0f;
+    const TestMesh sphere = MakeSphere(64, 128, radius);
+    const MeshSimplifier simplifier(sphere.Positions);
+    const auto chain = simplifier.BuildLodChain(sphere.Indices);
+
+    REQUIRE(!chain.empty());
+    CHECK(chain.size() <= MeshSimplifier::MaxLodCount - 1);
+
+    size_t previousSize = sphere.Indices.size();
+    float previousError = 0.0f;
+    for (const auto& lod : chain)
+    {
+        REQUIRE(IsValidIndexList(sphere, lod.Indices));
+        CHECK(lod.Indices.size() <= previousSize * MeshSimplifier::MinLodShrink);
+        CHECK(lod.Indices.size() >= MeshSimplifier::MinLodIndexCount);
+        CHECK(lod.Error >= previousError);
+        // The bounds radius is the half diagonal of the cube around the sphere
+        CHECK(lod.Error <= MeshSimplifier::MaxLodError * radius * std::sqrt(3.0f) * 1.0001f);
+
+        // The reported error bounds how far the surface moved, checked at the triangle centers
+        float deviation = 0.0f;
+        for (size_t i = 0; i < lod.Indices.size(); i += 3)
+        {
+            const glm::vec3 center = (sphere.Positions[lod.Indices[i]] + sphere.Positions[lod.Indices[i + 1]] + sphere.Positions[lod.Indices[i + 2]]) / 3.0f;
+            deviation = std::max(deviation, radius - glm::length(center));
+        }
+        CHECK(deviation <= 2.0f * lod.Error + 1e-3f);
+
+        // Every level still faces outwards, slivers along a great circle may lean either way
+        size_t inverted = 0;
+        for (size_t triangle = 0; triangle < lod.Indices.size() / 3; ++triangle)
+        {
+            const glm::vec3 normal = GetNormal(sphere, lod.Indices, triangle);
+            inverted += glm::dot(normal, sphere.Positions[lod.Indices[triangle * 3]]) < -1e-3f * radius * glm::length(normal);
+        }
+        CHECK(inverted == 0);
+
+        previousSize = lod.Indices.size();
+        previousError = lod.Error;
+    }
+}
+
+AKARI_BENCHMARK(MeshSimplifier, BuildLodChain)
+{
+    const TestMesh sphere = MakeSphere(256, 512, 1.0f);
+    const TestMesh grid = MakeGrid(256, true);
+
+    for (const auto& [label, mesh] : { std::pair("Sphere, 262k triangles", &sphere), std::pair("Grid with seam, 131k triangles", &grid) })
+    {
+        std::vector<MeshSimplifier::Lod> chain;
+        Tests::Measure(label, 3, [&] { chain = MeshSimplifier(mesh->Positions).BuildLodChain(mesh->Indices); });
+        for (const auto& lod : chain)
+            spdlog::info("  {0} triangles, error {1:.5f}", lod.Indices.size() / 3, lod.Error);
+    }
+}
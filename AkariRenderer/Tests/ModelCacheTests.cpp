@@ -0,0 +1,292 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RHI/VertexTypes.h"
+#include "SceneComponents/Meshlets.h"
+#include "SceneComponents/ModelCache.h"
+#include "SceneComponents/TriangleBVH.h"
+
+using namespace Akari;
+
+namespace
+{
+    // The parts of an imported mesh that go into the cooked model
+    struct CookedMesh
+    {
+        std::vector<VertexPositionQTangentTexture> Vertices;
+        std::vector<uint32_t> Indices;
+        std::vector<glm::vec3> Positions;
+        std::vector<MeshSimplifier::Lod> Lods;
+        std::unique_ptr<TriangleBVH> BVH;
+        MeshletData Meshlets;
+    };
+
+    // size x size quads facing +z at offset, with a level of detail of every other triangle
+    CookedMesh MakeGridMesh(uint32_t size, const glm::vec3& offset)
+    {
+        CookedMesh mesh;
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+            {
+                const glm::vec3 position = offset + glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+                mesh.Positions.push_back(position);
+                mesh.Vertices.emplace_back(VertexPositionNormalTangentBitangentTexture(
+                    DirectX::XMFLOAT3(position.x, position.y, position.z), DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f),
+                    DirectX::XMFLOAT3(static_cast<float>(x) / size, static_cast<float>(y) / size, 0.0f), DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f),
+                    DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f)));
+            }
+        }
+
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const uint32_t v00 = y * (size + 1) + x, v10 = v00 + 1, v01 = v00 + size + 1, v11 = v01 + 1;
+                mesh.Indices.insert(mesh.Indices.end(), { v00, v10, v11, v00, v11, v01 });
+            }
+        }
+
+        MeshSimplifier::Lod& lod = mesh.Lods.emplace_back();
+        for (size_t i = 0; i < mesh.Indices.size(); i += 6)
+            lod.Indices.insert(lod.Indices.end(), mesh.Indices.begin() + i, mesh.Indices.begin() + i + 3);
+        lod.Error = 0.25f;
+
+        mesh.BVH = std::make_unique<TriangleBVH>(mesh.Positions, mesh.Indices);
+        mesh.Meshlets = BuildMeshlets(mesh.Indices, mesh.Positions);
+        return mesh;
+    }
+
+    void AddMesh(ModelCache::Writer& writer, uint32_t material, const CookedMesh& mesh, bool withBVH = true)
+    {
+        DirectX::BoundingBox aabb;
+        DirectX::BoundingBox::CreateFromPoints(aabb, mesh.Positions.size(), reinterpret_cast<const DirectX::XMFLOAT3*>(mesh.Positions.data()),
+                                               sizeof(glm::vec3));
+        writer.AddMesh(material, aabb, std::as_bytes(std::span(mesh.Vertices)), mesh.Indices, mesh.Lods, withBVH ? mesh.BVH.get() : nullptr,
+                       withBVH ? &mesh.Meshlets : nullptr);
+    }
+
+    // Two materials, two meshes and a root with two children, the second mesh without BVH and meshlets
+    void WriteModel(ModelCache::Writer& writer, std::span<const CookedMesh> meshes)
+    {
+        std::map<Material::TextureType, ModelCache::TextureSource> textures;
+        textures[Material::TextureType::BaseColor] = { "Textures/Base Color.png", true };
+        textures[Material::TextureType::Normal] = { "Textures/normal.dds" };
+        writer.AddMaterial(MaterialProperties(glm::vec4(0.5f, 0.25f, 1.0f, 1.0f), 0.75f), textures);
+        textures.clear();
+        textures[Material::TextureType::Emissive] = { "scene.glb", true, 3 };
+        writer.AddMaterial(MaterialProperties(), textures);
+
+        AddMesh(writer, 1, meshes[0]);
+        AddMesh(writer, 0, meshes[1], false);
+
+        const std::array<uint32_t, 2> bothMeshes = { 0, 1 };
+        const std::array<uint32_t, 1> secondMesh = { 1 };
+        writer.AddNode(DirectX::XMMatrixIdentity(), "Root", -1, {});
+        writer.AddNode(DirectX::XMMatrixTranslation(1.0f, 2.0f, 3.0f), "Child", 0, bothMeshes);
+        writer.AddNode(DirectX::XMMatrixScaling(2.0f, 2.0f, 2.0f), "", 0, secondMesh);
+    }
+
+    template<typename T>
+    bool BlobEquals(const ModelCache::MappedModel& model, const ModelCache::Blob& blob, std::span<const T> expected)
+    {
+        const auto stored = model.Get<T>(blob);
+        return stored.size() == expected.size() && std::memcmp(stored.data(), expected.data(), expected.size_bytes()) == 0;
+    }
+
+    std::string ReadFile(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    template<typename T>
+    void Patch(std::string& file, uint64_t offset, const T& value)
+    {
+        std::memcpy(file.data() + offset, &value, sizeof(T));
+    }
+}
+
+AKARI_TEST(ModelCache, RoundTrips)
+{
+    const Tests::TempDirectory directory("ModelCache");
+    std::array<CookedMesh, 2> meshes = { MakeGridMesh(12, glm::vec3(0.0f)), MakeGridMesh(3, glm::vec3(-5.0f, 0.0f, 1.0f)) };
+
+    ModelCache::Writer writer;
+    WriteModel(writer, meshes);
+    CHECK(writer.GetTexturePaths().size() == 3 && writer.GetTexturePaths()[0] == "Textures/Base Color.png");
+
+    const std::filesystem::path path = directory / "model.akmodel";
+    REQUIRE(writer.Save(path));
+    CHECK(!std::filesystem::exists(directory / "model.akmodel.tmp"));
+
+    ModelCache::MappedModel model;
+    REQUIRE(model.Open(path));
+    const ModelCache::Header& header = model.GetHeader();
+    CHECK(header.VertexStride == sizeof(VertexPositionQTangentTexture));
+
+    const auto materials = model.Get<ModelCache::MaterialRecord>(header.Materials);
+    const auto textures = model.Get<ModelCache::TextureRecord>(header.Textures);
+    REQUIRE(materials.size() == 2 && textures.size() == 3);
+    CHECK(materials[0].Properties.BaseColor == glm::vec4(0.5f, 0.25f, 1.0f, 1.0f) && materials[0].Properties.Roughness == 0.75f);
+    CHECK(materials[0].TextureBegin == 0 && materials[0].TextureCount == 2 && materials[1].TextureBegin == 2);
+    CHECK(textures[0].Type == Material::TextureType::BaseColor && textures[0].SRGB == 1 && textures[0].Image == -1);
+    CHECK(model.GetString(textures[0].Path) == "Textures/Base Color.png");
+    CHECK(textures[1].Type == Material::TextureType::Normal && textures[1].SRGB == 0);
+    CHECK(model.GetString(textures[2].Path) == "scene.glb" && textures[2].Image == 3);
+
+    // The buffers come back byte for byte, at aligned offsets
+    const auto records = model.Get<ModelCache::MeshRecord>(header.Meshes);
+    const auto lods = model.Get<ModelCache::LodRecord>(header.Lods);
+    REQUIRE(records.size() == 2 && lods.size() == 2);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const ModelCache::MeshRecord& record = records[i];
+        const CookedMesh& mesh = meshes[i];
+        CHECK(record.Material == 1 - i);
+        CHECK(record.Vertices.Offset % ModelCache::Alignment == 0 && record.Indices.Offset % ModelCache::Alignment == 0);
+        CHECK(BlobEquals(model, record.Vertices, std::span<const VertexPositionQTangentTexture>(mesh.Vertices)));
+        CHECK(BlobEquals(model, record.Indices, std::span<const uint32_t>(mesh.Indices)));
+        REQUIRE(record.LodCount == 1);
+        CHECK(BlobEquals(model, lods[record.LodBegin].Indices, std::span<const uint32_t>(mesh.Lods[0].Indices)));
+        CHECK(lods[record.LodBegin].Error == 0.25f);
+    }
+
+    // The stored BVH restores one that finds the same hits
+    const ModelCache::MeshRecord& first = records[0];
+    CHECK(BlobEquals(model, first.Positions, meshes[0].BVH->GetPositions()));
+    CHECK(BlobEquals(model, first.BVHNodes, meshes[0].BVH->GetNodes()));
+    CHECK(BlobEquals(model, first.Meshlets, std::span<const Meshlet>(meshes[0].Meshlets.Meshlets)));
+    CHECK(BlobEquals(model, first.MeshletTriangles, std::span<const uint8_t>(meshes[0].Meshlets.Triangles)));
+    const TriangleBVH restored(model.Get<glm::vec3>(first.Positions), model.Get<uint32_t>(first.Indices), model.Get<TriangleBVH::Node>(first.BVHNodes),
+                               model.Get<uint32_t>(first.BVHTriangleOrder));
+    TriangleBVH::Hit expectedHit, hit;
+    REQUIRE(meshes[0].BVH->Intersect(glm::vec3(4.3f, 7.6f, 5.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, expectedHit));
+    REQUIRE(restored.Intersect(glm::vec3(4.3f, 7.6f, 5.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, hit));
+    CHECK(hit.Triangle == expectedHit.Triangle && hit.Distance == expectedHit.Distance);
+    CHECK(records[1].Positions.Size == 0 && records[1].Meshlets.Size == 0);
+
+    const auto nodes = model.Get<ModelCache::NodeRecord>(header.Nodes);
+    const auto nodeMeshes = model.Get<uint32_t>(header.NodeMeshes);
+    REQUIRE(nodes.size() == 3);
+    CHECK(nodes[0].Parent == -1 && nodes[1].Parent == 0 && nodes[2].Parent == 0);
+    CHECK(model.GetString(nodes[0].Name) == "Root" && model.GetString(nodes[1].Name) == "Child" && model.GetString(nodes[2].Name).empty());
+    CHECK(nodes[1].LocalTransform.m[3][0] == 1.0f && nodes[1].LocalTransform.m[3][2] == 3.0f);
+    CHECK(nodes[1].MeshCount == 2 && nodeMeshes[nodes[1].MeshBegin + 1] == 1);
+    CHECK(nodes[2].MeshCount == 1 && nodeMeshes[nodes[2].MeshBegin] == 1);
+}
+
+// A stale or damaged cache is rejected as a whole, so the model is imported again instead
+AKARI_TEST(ModelCache, RejectsDamagedFiles)
+{
+    const Tests::TempDirectory directory("ModelCache");
+    std::array<CookedMesh, 2> meshes = { MakeGridMesh(12, glm::vec3(0.0f)), MakeGridMesh(3, glm::vec3(1.0f)) };
+
+    ModelCache::Writer writer;
+    WriteModel(writer, meshes);
+    const std::filesystem::path path = directory / "model.akmodel";
+    REQUIRE(writer.Save(path));
+    const std::string valid = ReadFile(path);
+
+    ModelCache::MappedModel model;
+    REQUIRE(model.Open(path));
+    const ModelCache::Header header = model.GetHeader();
+    const ModelCache::MeshRecord mesh = model.Get<ModelCache::MeshRecord>(header.Meshes)[0];
+    const ModelCache::LodRecord lod = model.Get<ModelCache::LodRecord>(header.Lods)[mesh.LodBegin];
+    model.Close();
+
+    CHECK(!model.Open(directory / "missing.akmodel"));
+    CHECK(!model.Open(directory.Write("empty.akmodel", "")));
+    CHECK(!model.Open(directory.Write("truncated.akmodel", std::string_view(valid).substr(0, valid.size() - 1))));
+    CHECK(!model.Open(directory.Write("header.akmodel", std::string_view(valid).substr(0, sizeof(ModelCache::Header) - 1))));
+
+    const auto patched = [&](auto&& patch)
+    {
+        std::string file = valid;
+        patch(file);
+        return directory.Write("patched.akmodel", file);
+    };
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, offsetof(ModelCache::Header, Magic), ModelCache::Magic + 1); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, offsetof(ModelCache::Header, Version), ModelCache::Version - 1); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, offsetof(ModelCache::Header, VertexStride), 60u); })));
+
+    // Indices past the vertices, of the mesh, a level of detail and a meshlet
+    const auto vertexCount = static_cast<uint32_t>(meshes[0].Vertices.size());
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, mesh.Indices.Offset + 4, vertexCount); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, lod.Indices.Offset + 8, vertexCount); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, mesh.MeshletVertices.Offset, vertexCount); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, mesh.BVHTriangleOrder.Offset, vertexCount * 2); })));
+
+    // Arrays moved off their alignment or out of the file, a mesh of a missing material
+    const uint64_t meshOffset = header.Meshes.Offset;
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, meshOffset + offsetof(ModelCache::MeshRecord, Vertices), mesh.Vertices.Offset + 4); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, meshOffset + offsetof(ModelCache::MeshRecord, Indices), uint64_t(valid.size())); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, meshOffset + offsetof(ModelCache::MeshRecord, Material), 2u); })));
+
+    // Nodes pointing forward or at missing meshes
+    const uint64_t secondNode = header.Nodes.Offset + sizeof(ModelCache::NodeRecord);
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, secondNode + offsetof(ModelCache::NodeRecord, Parent), 2); })));
+    CHECK(!model.Open(patched([&](std::string& file) { Patch(file, header.NodeMeshes.Offset, 2u); })));
+
+    // Opening again after a failure still works
+    CHECK(model.Open(path));
+}
+
+// A cooked model the size of Sponza, about 260k triangles in 360 meshes. Loading maps the file and validates it,
+// the upload reads the vertices as they are, where an import would encode every vertex first.
+AKARI_BENCHMARK(ModelCache, LoadSponzaSizedModel)
+{
+    const Tests::TempDirectory directory("ModelCache");
+    std::vector<CookedMesh> meshes;
+    for (uint32_t i = 0; i < 360; ++i)
+        meshes.push_back(MakeGridMesh(19, glm::vec3(static_cast<float>(i % 20) * 20.0f, static_cast<float>(i / 20) * 20.0f, 0.0f)));
+
+    const std::filesystem::path path = directory / "sponza.akmodel";
+    Tests::Measure("Cook", 3, [&]
+    {
+        ModelCache::Writer writer;
+        writer.AddMaterial(MaterialProperties(), {});
+        std::vector<uint32_t> nodeMeshes;
+        for (uint32_t i = 0; i < meshes.size(); ++i)
+        {
+            AddMesh(writer, 0, meshes[i]);
+            nodeMeshes.push_back(i);
+        }
+        writer.AddNode(DirectX::XMMatrixIdentity(), "Sponza", -1, nodeMeshes);
+        writer.Save(path);
+    });
+    spdlog::info("  {0} MB", std::filesystem::file_size(path) >> 20);
+
+    ModelCache::MappedModel model;
+    Tests::Measure("Open and validate", 20, [&]
+    {
+        model.Close();
+        model.Open(path);
+    });
+
+    uint64_t checksum = 0;
+    Tests::Measure("Open, validate and read every vertex", 20, [&]
+    {
+        model.Close();
+        model.Open(path);
+        for (const auto& record : model.Get<ModelCache::MeshRecord>(model.GetHeader().Meshes))
+        {
+            for (const auto& vertex : model.Get<VertexPositionQTangentTexture>(record.Vertices))
+                checksum += static_cast<uint16_t>(vertex.TangentFrame.x);
+        }
+    });
+
+    // The per vertex work of an import the cooked model skips
+    std::vector<VertexPositionNormalTangentBitangentTexture> decoded;
+    for (const CookedMesh& mesh : meshes)
+    {
+        for (const auto& vertex : mesh.Vertices)
+            decoded.push_back(vertex.Decode());
+    }
+    Tests::Measure("Encode the vertices instead", 5, [&]
+    {
+        const std::vector<VertexPositionQTangentTexture> encoded(decoded.begin(), decoded.end());
+        checksum += encoded.size();
+    });
+    spdlog::info("  checksum {0}", checksum);
+}
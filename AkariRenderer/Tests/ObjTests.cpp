@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/Obj.h"
+
+using namespace Akari;
+
+namespace
+{
+    constexpr std::string_view Materials = R"(# Two materials
+newmtl Red
+Kd 1 0 0
+Ka 0.1 0.1 0.1
+Ke 0 0 0.5
+Ns 250
+d 0.75
+Pr 0.3
+Pm 1
+map_Kd -s 2 2 1 -clamp on textures\red diffuse.png
+map_bump -bm 0.5 textures/red_bump.png
+norm textures/red_normal.png
+
+newmtl Glass
+Tr 0.9
+map_d glass.png
+)";
+
+    bool Opens(Obj::Asset& asset, const std::filesystem::path& path)
+    {
+        const Tests::LogSilencer silencer;
+        return asset.Open(path);
+    }
+
+    glm::vec3 GetPosition(const Obj::Mesh& mesh, uint32_t vertex)
+    {
+        return glm::vec3(mesh.Positions[vertex * 3], mesh.Positions[vertex * 3 + 1], mesh.Positions[vertex * 3 + 2]);
+    }
+}
+
+AKARI_TEST(Obj, ParsesFaces)
+{
+    const Tests::TempDirectory directory("Obj");
+    directory.Write("materials.mtl", Materials);
+
+    const std::string_view text = R"(# A quad in every corner format, then lines that are malformed or out of range
+mtllib materials.mtl
+o Quad
+v 0 0 0
+v 1 0 0
+v 1 1 0
+v 0 1 0
+vt 0 0
+vt 1 0
+vt 1 1
+vt 0 1
+vn 0 0 1
+usemtl Red
+f 1/1/1 2/2/1 3/3/1 4/4/1
+f -4/-4/-1 -2/-2/-1 -1/-1/-1
+g Plain
+f 1 2 3
+f 1//1 3//1 4//1
+)" "f 1/1\t2/2  3/3\n" R"(usemtl Unknown
+v +2 2e1 -3.5
+v 1 x
+v 3 3 3
+s 1
+f 5 6 7
+f 1 2
+f 0 1 2
+f 1 2 99
+f 1 2 -8
+f 1/ 2 3
+f 1 2 3 x
+o Quad
+usemtl Red
+f 3/3/1 4/4/1 1/1/1)";
+
+    // Line breaks of either kind give the same meshes
+    for (const std::string_view lineBreak : { "\n", "\r\n" })
+    {
+        std::string file;
+        for (const char c : text)
+            file += c == '\n' ? std::string(lineBreak) : std::string(1, c);
+
+        Obj::Asset asset;
+        REQUIRE(Opens(asset, directory.Write("faces.obj", file)));
+        REQUIRE(asset.GetMeshes().size() == 3);
+
+        // The faces of a group and material are merged into one mesh, shared corners into one vertex
+        const Obj::Mesh& quad = asset.GetMeshes()[0];
+        CHECK(quad.Name == "Quad" && quad.Material == 0);
+        CHECK(quad.Indices == std::vector<uint32_t>({ 0, 1, 2, 0, 2, 3, 0, 2, 3, 2, 3, 0 }));
+        CHECK(quad.Positions == std::vector<float>({ 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0 }));
+        CHECK(quad.TexCoords == std::vector<float>({ 0, 0, 1, 0, 1, 1, 0, 1 }));
+        CHECK(quad.Normals.size() == 12 && quad.Normals[2] == 1.0f && quad.Normals[11] == 1.0f);
+
+        // The same position with other attributes is another vertex, missing attributes are zero
+        const Obj::Mesh& plain = asset.GetMeshes()[1];
+        CHECK(plain.Name == "Plain" && plain.Material == 0);
+        CHECK(plain.Indices == std::vector<uint32_t>({ 0, 1, 2, 3, 4, 5, 6, 7, 8 }));
+        REQUIRE(plain.TexCoords.size() == 18 && plain.Normals.size() == 27);
+        CHECK(plain.Normals[2] == 0.0f && plain.Normals[3 * 3 + 2] == 1.0f && plain.TexCoords[7 * 2] == 1.0f && plain.TexCoords[4 * 2] == 0.0f);
+
+        // A malformed vertex still counts, so the indices after it don't shift
+        const Obj::Mesh& unknown = asset.GetMeshes()[2];
+        CHECK(unknown.Name == "Plain" && unknown.Material == -1);
+        CHECK(unknown.Indices == std::vector<uint32_t>({ 0, 1, 2 }) && unknown.TexCoords.empty() && unknown.Normals.empty());
+        CHECK(unknown.Positions == std::vector<float>({ 2, 20, -3.5f, 1, 0, 0, 3, 3, 3 }));
+    }
+}
+
+AKARI_TEST(Obj, ParsesMaterials)
+{
+    const Tests::TempDirectory directory("Obj");
+    std::filesystem::create_directories(directory / "lib");
+    directory.Write("lib/materials.mtl", Materials);
+
+    Obj::Asset asset;
+    REQUIRE(Opens(asset, directory.Write("materials.obj", "mtllib lib/materials.mtl\nmtllib missing.mtl\n")));
+    CHECK(asset.GetMeshes().empty());
+    CHECK(asset.GetFilePaths().size() == 3 && asset.GetFilePaths()[2].filename() == "missing.mtl");
+
+    REQUIRE(asset.GetMaterials().size() == 2);
+    const Obj::Material& red = asset.GetMaterials()[0];
+    CHECK(red.Name == "Red" && red.Diffuse == glm::vec3(1.0f, 0.0f, 0.0f) && red.Ambient == glm::vec3(0.1f) && red.Emissive == glm::vec3(0.0f, 0.0f, 0.5f));
+    CHECK(red.Shininess == 250.0f && red.Opacity == 0.75f && red.Roughness == 0.3f && red.Metallic == 1.0f && red.BumpScale == 0.5f);
+
+    // Texture options are skipped, paths are relative to the OBJ file with forward slashes
+    CHECK(red.DiffuseTexture.generic_string() == "lib/textures/red diffuse.png");
+    CHECK(red.BumpTexture.generic_string() == "lib/textures/red_bump.png");
+    CHECK(red.NormalTexture.generic_string() == "lib/textures/red_normal.png");
+    CHECK(red.SpecularTexture.empty() && red.OpacityTexture.empty());
+
+    const Obj::Material& glass = asset.GetMaterials()[1];
+    CHECK(glass.Name == "Glass" && std::abs(glass.Opacity - 0.1f) < 1e-6f && glass.Diffuse == glm::vec3(1.0f));
+    CHECK(glass.Roughness < 0.0f && glass.Metallic < 0.0f && glass.OpacityTexture.generic_string() == "lib/glass.png");
+
+    CHECK(!Opens(asset, directory / "missing.obj"));
+}
+
+// A file of several MB is split into chunks, the faces reference vertices of the chunk before them both with
+// absolute and with negative indices, and the groups alternate across the chunk boundaries.
+AKARI_TEST(Obj, MatchesAcrossChunks)
+{
+    const Tests::TempDirectory directory("Obj");
+
+    constexpr uint32_t blockCount = 2500, blockSize = 64, groupCount = 5;
+    std::string file;
+    std::vector<std::vector<glm::vec3>> expected(groupCount);
+    uint32_t vertexCount = 0;
+    for (uint32_t block = 0; block < blockCount; ++block)
+    {
+        const uint32_t group = block % groupCount;
+        file += "g Group" + std::to_string(group) + "\n";
+
+        const uint32_t first = vertexCount;
+        for (uint32_t i = 0; i < blockSize; ++i, ++vertexCount)
+            file += "v " + std::to_string(vertexCount) + " " + std::to_string(block) + " 0.25\n";
+
+        for (uint32_t i = 0; i + 1 < blockSize; ++i)
+        {
+            // The third corner is in the block before, which is likely in the chunk before
+            const std::array<uint32_t, 3> corners = { first + i, first + i + 1, block > 0 ? first - 1 - i : first + blockSize - 1 };
+            file += "f";
+            for (uint32_t j = 0; j < 3; ++j)
+            {
+                const int64_t index = (i + j) % 2 == 0 ? corners[j] + 1 : static_cast<int64_t>(corners[j]) - vertexCount;
+                file += " " + std::to_string(index);
+                expected[group].push_back(glm::vec3(static_cast<float>(corners[j]), static_cast<float>(corners[j] / blockSize), 0.25f));
+            }
+            file += "\n";
+        }
+    }
+    REQUIRE(file.size() > (4 << 20));
+
+    Obj::Asset asset;
+    REQUIRE(Opens(asset, directory.Write("chunks.obj", file)));
+    REQUIRE(asset.GetMeshes().size() == groupCount);
+    for (uint32_t group = 0; group < groupCount; ++group)
+    {
+        const Obj::Mesh& mesh = asset.GetMeshes()[group];
+        CHECK(mesh.Name == "Group" + std::to_string(group));
+        REQUIRE(mesh.Indices.size() == expected[group].size());
+
+        uint32_t mismatches = 0;
+        for (size_t i = 0; i < mesh.Indices.size(); ++i)
+            mismatches += GetPosition(mesh, mesh.Indices[i]) == expected[group][i] ? 0 : 1;
+        CHECK(mismatches == 0);
+
+        // Every position is used by one vertex only, as the corners have no other attributes
+        std::vector<float> x;
+        for (size_t i = 0; i < mesh.Positions.size(); i += 3)
+            x.push_back(mesh.Positions[i]);
+        std::ranges::sort(x);
+        CHECK(std::ranges::adjacent_find(x) == x.end());
+    }
+}
+
+// An OBJ file of textured and lit triangles like the common Sponza distribution, scaled up to about 100 MB.
+// Parse throughput is the file size over the whole Open, merging and deduplicating included.
+AKARI_BENCHMARK(Obj, ParseLargeFile)
+{
+    const Tests::TempDirectory directory("Obj");
+
+    std::mt19937 random(53);
+    std::uniform_real_distribution<float> coordinate(-2000.0f, 2000.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::string file;
+    char line[128];
+    uint32_t vertexCount = 0;
+    while (file.size() < (100 << 20))
+    {
+        file += "g Block" + std::to_string(vertexCount / 4096 % 64) + "\nusemtl Material" + std::to_string(vertexCount / 4096 % 25) + "\n";
+        for (uint32_t i = 0; i < 4096; ++i)
+        {
+            file.append(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", coordinate(random), coordinate(random), coordinate(random)));
+            file.append(line, std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", unit(random), unit(random)));
+            file.append(line, std::snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", unit(random), unit(random), unit(random)));
+        }
+
+        // Two triangles per vertex on a strip, so every vertex is shared by six corners
+        for (uint32_t i = 0; i + 2 < 4096; ++i)
+        {
+            const uint32_t v = vertexCount + i + 1;
+            file.append(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", v, v, v, v + 1, v + 1, v + 1, v + 2, v + 2, v + 2));
+            file.append(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", v + 2, v + 2, v + 2, v + 1, v + 1, v + 1, v, v, v));
+        }
+        vertexCount += 4096;
+    }
+
+    const auto path = directory.Write("large.obj", file);
+    const float megabytes = static_cast<float>(file.size()) / (1 << 20);
+    spdlog::info("  {0:.1f} MB, {1} vertices", megabytes, vertexCount);
+    file = {};
+
+    for (const uint32_t threadCount : { 1u, 8u })
+    {
+        Tests::RunWithThreads(threadCount, [&]
+        {
+            const std::string label = "Open, " + std::to_string(threadCount) + " threads";
+            const float milliseconds = Tests::Measure(label.c_str(), 3, [&]
+            {
+                Obj::Asset asset;
+                Opens(asset, path);
+            });
+            spdlog::info("  {0:.0f} MB/s", megabytes / milliseconds * 1000.0f);
+        });
+    }
+}
@@ -0,0 +1,205 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RPI/OcclusionCulling.h"
+
+using namespace Akari;
+
+namespace
+{
+    // 90 degree vertical field of view at twice the width, a view-space point maps to ndc (x / 2z, y / z).
+    // The depth buffer is 320 x 160 pixels for it.
+    constexpr float AspectRatio = 2.0f;
+
+    glm::mat4 GetProjection()
+    {
+        return glm::perspectiveFov(glm::radians(90.0f), AspectRatio, 1.0f, 100.0f, 0.1f);
+    }
+
+    float GetDepth(const glm::vec3& viewPosition)
+    {
+        const glm::vec4 clip = GetProjection() * glm::vec4(viewPosition, 1.0f);
+        return clip.z / clip.w;
+    }
+
+    glm::vec2 GetPixelNdc(const OcclusionCulling& culling, uint32_t x, uint32_t y)
+    {
+        return { (x + 0.5f) / culling.GetWidth() * 2.0f - 1.0f, 1.0f - (y + 0.5f) / culling.GetHeight() * 2.0f };
+    }
+
+    // Pixels inside the quad by more than margin are compared against the depth of the plane under their center,
+    // pixels outside by more than margin must keep the cleared depth. Anything in between may go either way.
+    template<typename GetViewPosition>
+    bool MatchesGolden(const OcclusionCulling& culling, const glm::vec2& halfSize, float margin, GetViewPosition&& getViewPosition)
+    {
+        uint32_t covered = 0;
+        for (uint32_t y = 0; y < culling.GetHeight(); ++y)
+        {
+            for (uint32_t x = 0; x < culling.GetWidth(); ++x)
+            {
+                const glm::vec3 position = getViewPosition(GetPixelNdc(culling, x, y));
+                const float depth = culling.GetDepthBuffer()[size_t(y) * culling.GetWidth() + x];
+
+                const glm::vec2 distance = glm::abs(glm::vec2(position)) - halfSize;
+                if (distance.x < -margin && distance.y < -margin)
+                {
+                    const float expected = GetDepth(position);
+                    if (std::abs(depth - expected) > 1e-4f * expected)
+                        return false;
+                    covered++;
+                }
+                else if ((distance.x > margin || distance.y > margin) && depth != 0.0f)
+                {
+                    return false;
+                }
+            }
+        }
+        return covered > 0;
+    }
+
+    // Closed box of 12 triangles
+    void AddBox(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices, const glm::vec3& center, const glm::vec3& extents)
+    {
+        const auto base = static_cast<uint32_t>(positions.size());
+        for (int i = 0; i < 8; ++i)
+            positions.push_back(center + extents * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f));
+
+        constexpr uint32_t faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+        for (const auto& face : faces)
+        {
+            for (const uint32_t corner : { face[0], face[1], face[2], face[0], face[2], face[3] })
+                indices.push_back(base + corner);
+        }
+    }
+
+    DirectX::BoundingBox MakeBox(const glm::vec3& center, float extent)
+    {
+        return { { center.x, center.y, center.z }, { extent, extent, extent } };
+    }
+}
+
+// Screen-aligned quad at z = 10 spanning ndc [-0.5, 0.5], its edges fall on pixel boundaries
+AKARI_TEST(OcclusionCulling, GoldenDepthParallelQuad)
+{
+    const std::vector<glm::vec3> positions = { { -10.0f, -5.0f, 10.0f }, { 10.0f, -5.0f, 10.0f }, { 10.0f, 5.0f, 10.0f }, { -10.0f, 5.0f, 10.0f } };
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionCulling culling;
+    culling.BeginFrame(GetProjection(), AspectRatio);
+    REQUIRE(culling.GetWidth() == 320 && culling.GetHeight() == 160);
+    culling.AddOccluder(glm::mat4(1.0f), positions, indices);
+    culling.RasterizeOccluders();
+
+    CHECK(MatchesGolden(culling, { 10.0f, 5.0f }, 0.01f, [](const glm::vec2& ndc)
+    {
+        return glm::vec3(ndc.x * 20.0f, ndc.y * 10.0f, 10.0f);
+    }));
+    CHECK(std::ranges::count_if(culling.GetDepthBuffer(), [](const float depth) { return depth > 0.0f; }) == 160 * 80);
+}
+
+// Quad receding from z = 10 on the left to z = 20 on the right, on the plane z = 15 + x / 2.
+// Its depth has to follow the perspective division pixel by pixel.
+AKARI_TEST(OcclusionCulling, GoldenDepthSlantedQuad)
+{
+    const std::vector<glm::vec3> positions = { { -10.0f, -5.0f, 10.0f }, { 10.0f, -5.0f, 20.0f }, { 10.0f, 5.0f, 20.0f }, { -10.0f, 5.0f, 10.0f } };
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+
+    // Moved by the world matrix and back by the view matrix, the quad ends up in view space as listed
+    const glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, 0.0f));
+    const glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 0.0f, 0.0f));
+
+    OcclusionCulling culling;
+    culling.BeginFrame(GetProjection() * view, AspectRatio);
+    culling.AddOccluder(world, positions, indices);
+    culling.RasterizeOccluders();
+
+    // A pixel is about 0.25 units wide at z = 20
+    CHECK(MatchesGolden(culling, { 10.0f, 5.0f }, 0.5f, [](const glm::vec2& ndc)
+    {
+        const float z = 15.0f / (1.0f - ndc.x);
+        return glm::vec3(ndc.x * 2.0f * z, ndc.y * z, z);
+    }));
+}
+
+AKARI_TEST(OcclusionCulling, HidesBoxesBehindOccluders)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    AddBox(positions, indices, { 0.0f, 0.0f, 10.0f }, { 5.0f, 5.0f, 1.0f });
+
+    OcclusionCulling culling;
+    culling.BeginFrame(GetProjection(), AspectRatio);
+
+    // Nothing rasterized, nothing can be hidden
+    culling.RasterizeOccluders();
+    CHECK(culling.IsVisible(MakeBox({ 0.0f, 0.0f, 20.0f }, 1.0f)));
+
+    culling.AddOccluder(glm::mat4(1.0f), positions, indices);
+    culling.RasterizeOccluders();
+    CHECK(culling.GetStats().Occluders == 1 && culling.GetStats().OccluderTriangles == 12);
+
+    CHECK(!culling.IsVisible(MakeBox({ 0.0f, 0.0f, 20.0f }, 1.0f)));
+    CHECK(!culling.IsVisible(MakeBox({ 2.0f, -2.0f, 50.0f }, 3.0f)));
+    CHECK(culling.IsVisible(MakeBox({ 0.0f, 0.0f, 5.0f }, 1.0f)));
+    CHECK(culling.IsVisible(MakeBox({ 0.0f, 0.0f, 10.0f }, 2.0f)));
+    CHECK(culling.IsVisible(MakeBox({ 30.0f, 0.0f, 20.0f }, 1.0f)));
+    CHECK(culling.IsVisible(MakeBox({ 9.0f, 0.0f, 20.0f }, 2.0f)));
+    // Corners behind the camera can't be projected, such boxes are kept
+    CHECK(culling.IsVisible(MakeBox({ 0.0f, 0.0f, 0.0f }, 1.0f)));
+
+    // The next frame starts from a cleared buffer
+    culling.BeginFrame(GetProjection(), AspectRatio);
+    culling.RasterizeOccluders();
+    CHECK(std::ranges::all_of(culling.GetDepthBuffer(), [](const float depth) { return depth == 0.0f; }));
+    CHECK(culling.IsVisible(MakeBox({ 0.0f, 0.0f, 20.0f }, 1.0f)));
+}
+
+// 64 occluders of 170 boxes each, just under the triangle budget of a frame, rasterized on 1 to 8 threads
+AKARI_BENCHMARK(OcclusionCulling, Rasterize)
+{
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> depth(10.0f, 80.0f);
+    std::uniform_real_distribution<float> extent(0.2f, 2.0f);
+
+    std::vector<std::vector<glm::vec3>> positions(OcclusionCulling::MaxOccluders);
+    std::vector<std::vector<uint32_t>> indices(OcclusionCulling::MaxOccluders);
+    for (uint32_t i = 0; i < OcclusionCulling::MaxOccluders; ++i)
+    {
+        for (int j = 0; j < 170; ++j)
+            AddBox(positions[i], indices[i], { position(random), position(random), depth(random) }, glm::vec3(extent(random)));
+    }
+
+    std::vector<DirectX::BoundingBox> boxes;
+    for (int i = 0; i < 100'000; ++i)
+        boxes.push_back(MakeBox({ position(random), position(random), depth(random) + 10.0f }, extent(random)));
+
+    OcclusionCulling culling;
+    float singleThreaded = 0.0f;
+    for (const uint32_t threadCount : { 1u, 2u, 4u, 8u })
+    {
+        Tests::RunWithThreads(threadCount, [&]
+        {
+            const std::string label = "Rasterize 64 occluders, " + std::to_string(threadCount) + " threads";
+            const float milliseconds = Tests::Measure(label.c_str(), 20, [&]
+            {
+                culling.BeginFrame(GetProjection(), AspectRatio);
+                for (uint32_t i = 0; i < OcclusionCulling::MaxOccluders; ++i)
+                    culling.AddOccluder(glm::mat4(1.0f), positions[i], indices[i]);
+                culling.RasterizeOccluders();
+            });
+
+            if (threadCount == 1)
+                singleThreaded = milliseconds;
+            spdlog::info("  speedup {0:.2f}x", singleThreaded / milliseconds);
+        });
+    }
+
+    size_t hidden = 0;
+    Tests::Measure("Test 100k boxes", 5, [&]
+    {
+        for (const auto& box : boxes)
+            hidden += culling.IsVisible(box) ? 0 : 1;
+    });
+    spdlog::info("  {0} triangles, {1} of 100k boxes hidden", culling.GetStats().OccluderTriangles, hidden / 5);
+}
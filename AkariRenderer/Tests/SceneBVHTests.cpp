@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/SceneBVH.h"
+
+using namespace Akari;
+
+namespace
+{
+    struct Item
+    {
+        entt::entity Entity;
+        DirectX::BoundingBox Bounds;
+    };
+
+    DirectX::BoundingBox MakeRandomBox(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+        return { { position(random), position(random), position(random) }, { extent(random), extent(random), extent(random) } };
+    }
+
+    std::vector<Item> MakeRandomItems(uint32_t count, std::mt19937& random)
+    {
+        std::vector<Item> items(count);
+        for (uint32_t i = 0; i < count; ++i)
+            items[i] = { entt::entity(i), MakeRandomBox(random) };
+        return items;
+    }
+
+    // Reference slab test, without the BVH's ordering or pruning
+    bool IntersectRay(const DirectX::BoundingBox& box, const glm::vec3& origin, const glm::vec3& invDirection, float& distance)
+    {
+        const glm::vec3 center(box.Center.x, box.Center.y, box.Center.z);
+        const glm::vec3 extents(box.Extents.x, box.Extents.y, box.Extents.z);
+        const glm::vec3 t0 = (center - extents - origin) * invDirection;
+        const glm::vec3 t1 = (center + extents - origin) * invDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+
+        distance = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+        return distance <= std::min({ tFar.x, tFar.y, tFar.z, std::numeric_limits<float>::max() });
+    }
+
+    bool MatchesFrustumQuery(const SceneBVH& bvh, const std::vector<Item>& items, const Frustum& frustum)
+    {
+        std::unordered_map<entt::entity, bool> found;
+        bool unique = true;
+        bvh.QueryFrustum(frustum, [&](const entt::entity entity, const bool inside)
+        {
+            unique &= found.emplace(entity, inside).second;
+        });
+
+        size_t expected = 0;
+        for (const auto& item : items)
+        {
+            const FrustumTest test = frustum.Test(item.Bounds);
+            if (test == FrustumTest::Outside)
+                continue;
+
+            expected++;
+            const auto iter = found.find(item.Entity);
+            if (iter == found.end() || iter->second != (test == FrustumTest::Inside))
+                return false;
+        }
+        return unique && found.size() == expected;
+    }
+
+    bool MatchesRayQuery(const SceneBVH& bvh, const std::vector<Item>& items, const glm::vec3& origin, const glm::vec3& direction)
+    {
+        const glm::vec3 invDirection = Math::SafeInverse(direction);
+
+        // Every leaf the ray enters when the callback never shortens the ray
+        std::vector<entt::entity> found;
+        bvh.QueryRay(origin, direction, std::numeric_limits<float>::max(), [&](const entt::entity entity, float)
+        {
+            found.push_back(entity);
+            return std::numeric_limits<float>::max();
+        });
+
+        std::vector<entt::entity> expected;
+        float closest = std::numeric_limits<float>::max();
+        for (const auto& item : items)
+        {
+            float distance;
+            if (IntersectRay(item.Bounds, origin, invDirection, distance))
+            {
+                expected.push_back(item.Entity);
+                closest = std::min(closest, distance);
+            }
+        }
+
+        std::ranges::sort(found);
+        std::ranges::sort(expected);
+        if (found != expected)
+            return false;
+
+        // Closest hit query, shortening the ray to every hit
+        float nearest = std::numeric_limits<float>::max();
+        bvh.QueryRay(origin, direction, std::numeric_limits<float>::max(), [&](entt::entity, const float distance)
+        {
+            nearest = std::min(nearest, distance);
+            return nearest;
+        });
+        return nearest == closest;
+    }
+
+    Frustum MakeRandomFrustum(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+        const glm::vec3 eye(position(random), position(random), position(random));
+        const glm::vec3 target(position(random), position(random), position(random));
+        const glm::mat4 projection = glm::perspectiveFov(glm::radians(60.0f), 16.0f, 9.0f, 150.0f, 0.1f);
+        return Frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    bool MatchesQueries(const SceneBVH& bvh, const std::vector<Item>& items, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+        for (int i = 0; i < 20; ++i)
+        {
+            if (!MatchesFrustumQuery(bvh, items, MakeRandomFrustum(random)))
+                return false;
+
+            const glm::vec3 origin(position(random), position(random), position(random));
+            if (!MatchesRayQuery(bvh, items, origin, glm::vec3(direction(random), direction(random), direction(random))))
+                return false;
+        }
+        return true;
+    }
+}
+
+AKARI_TEST(SceneBVH, MatchesBruteForce)
+{
+    std::mt19937 random(11);
+    std::vector<Item> items = MakeRandomItems(2000, random);
+
+    SceneBVH bvh;
+    for (const auto& item : items)
+        bvh.Insert(item.Entity, item.Bounds);
+    REQUIRE(bvh.Size() == items.size());
+    CHECK(MatchesQueries(bvh, items, random));
+
+    // Refit every other leaf, then drop a third of them
+    for (size_t i = 0; i < items.size(); i += 2)
+    {
+        items[i].Bounds = MakeRandomBox(random);
+        bvh.Update(items[i].Entity, items[i].Bounds);
+    }
+    CHECK(MatchesQueries(bvh, items, random));
+
+    for (size_t i = 0; i < items.size(); i += 3)
+        bvh.Remove(items[i].Entity);
+    std::erase_if(items, [&](const Item& item) { return !bvh.Contains(item.Entity); });
+    CHECK(bvh.Size() == items.size());
+    CHECK(MatchesQueries(bvh, items, random));
+
+    bvh.Rebuild();
+    CHECK(bvh.Size() == items.size());
+    CHECK(MatchesQueries(bvh, items, random));
+}
+
+// Refits with scattered bounds degrade the tree, a rebuild brings the cost back down
+AKARI_TEST(SceneBVH, RebuildLowersCost)
+{
+    std::mt19937 random(12);
+    std::vector<Item> items = MakeRandomItems(1000, random);
+
+    SceneBVH bvh;
+    for (const auto& item : items)
+        bvh.Insert(item.Entity, item.Bounds);
+    bvh.Rebuild();
+    const float builtCost = bvh.GetCost();
+
+    for (auto& item : items)
+    {
+        item.Bounds = MakeRandomBox(random);
+        bvh.Update(item.Entity, item.Bounds);
+    }
+    const float refitCost = bvh.GetCost();
+    CHECK(refitCost > builtCost * SceneBVH::RebuildCostRatio);
+
+    bvh.Optimize();
+    CHECK(bvh.GetCost() < refitCost);
+    CHECK(MatchesQueries(bvh, items, random));
+
+    bvh.Clear();
+    CHECK(bvh.Size() == 0);
+    bool visited = false;
+    bvh.QueryFrustum(MakeRandomFrustum(random), [&](entt::entity, bool) { visited = true; });
+    CHECK(!visited);
+}
+
+// A ray starting on a slab plane and parallel to it must not turn into 0 * inf = NaN
+AKARI_TEST(SceneBVH, AxisParallelRay)
+{
+    SceneBVH bvh;
+    bvh.Insert(entt::entity(0), { { 0.0f, 0.0f, 5.0f }, { 1.0f, 1.0f, 1.0f } });
+    bvh.Insert(entt::entity(1), { { 10.0f, 0.0f, 5.0f }, { 1.0f, 1.0f, 1.0f } });
+
+    const auto queryRay = [&](const glm::vec3& origin)
+    {
+        std::vector<std::pair<entt::entity, float>> hits;
+        bvh.QueryRay(origin, { 0.0f, 0.0f, 1.0f }, 100.0f, [&](const entt::entity entity, const float distance)
+        {
+            hits.emplace_back(entity, distance);
+            return 100.0f;
+        });
+        return hits;
+    };
+
+    const auto onPlane = queryRay({ -1.0f, -1.0f, 0.0f });
+    REQUIRE(onPlane.size() == 1);
+    CHECK(onPlane[0].first == entt::entity(0));
+    CHECK(onPlane[0].second == 4.0f);
+
+    const auto throughBox = queryRay({ 10.5f, 0.0f, 0.0f });
+    REQUIRE(throughBox.size() == 1);
+    CHECK(throughBox[0].first == entt::entity(1));
+    CHECK(throughBox[0].second == 4.0f);
+
+    CHECK(queryRay({ 5.0f, 0.0f, 0.0f }).empty());
+}
+
+AKARI_BENCHMARK(SceneBVH, QueriesVsBruteForce)
+{
+    std::mt19937 random(13);
+    std::vector<Item> items = MakeRandomItems(100'000, random);
+
+    SceneBVH bvh;
+    Tests::Measure("Insert 100k leaves", 1, [&]
+    {
+        for (const auto& item : items)
+            bvh.Insert(item.Entity, item.Bounds);
+    });
+    Tests::Measure("Rebuild 100k leaves", 5, [&] { bvh.Rebuild(); });
+    Tests::Measure("Refit 100k leaves", 5, [&]
+    {
+        for (const auto& item : items)
+            bvh.Update(item.Entity, item.Bounds);
+    });
+
+    std::vector<Frustum> frustums;
+    for (int i = 0; i < 100; ++i)
+        frustums.push_back(MakeRandomFrustum(random));
+
+    size_t visibleCount = 0;
+    const float tree = Tests::Measure("BVH frustum query", 100, [&, i = 0]() mutable
+    {
+        bvh.QueryFrustum(frustums[i++ % frustums.size()], [&](entt::entity, bool) { visibleCount++; });
+    });
+    const float linear = Tests::Measure("Linear frustum test", 100, [&, i = 0]() mutable
+    {
+        const Frustum& frustum = frustums[i++ % frustums.size()];
+        for (const auto& item : items)
+            visibleCount += frustum.Test(item.Bounds) != FrustumTest::Outside;
+    });
+    spdlog::info("  speedup {0:.2f}x, {1} visible", linear / tree, visibleCount);
+
+    std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    Tests::Measure("10k closest hit rays", 1, [&]
+    {
+        for (int i = 0; i < 10'000; ++i)
+        {
+            const glm::vec3 origin(position(random), position(random), position(random));
+            bvh.QueryRay(origin, glm::vec3(direction(random), direction(random), direction(random)), 1000.0f,
+                         [](entt::entity, const float distance) { return distance; });
+        }
+    });
+}
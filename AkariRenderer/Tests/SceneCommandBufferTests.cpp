@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "Test.h"
+
+#include <ppl.h>
+
+#include "SceneComponents/Scene.h"
+#include "SceneComponents/SceneCommandBuffer.h"
+
+using namespace Akari;
+
+AKARI_TEST(SceneCommandBuffer, RecordsFromManyThreads)
+{
+    Scene scene;
+    SceneCommandBuffer& commands = scene.GetCommandBuffer();
+
+    constexpr uint32_t threadCount = 8;
+    constexpr uint32_t objectsPerThread = 1000;
+    std::vector<uint64_t> ids(threadCount * objectsPerThread);
+    concurrency::parallel_for(0u, threadCount, [&](const uint32_t thread)
+    {
+        for (uint32_t i = 0; i < objectsPerThread; ++i)
+            ids[thread * objectsPerThread + i] = commands.CreateSceneObject("Spawned");
+    });
+    CHECK(commands.GetCommandCount() == ids.size());
+
+    scene.UpdateHierarchy();
+    CHECK(commands.IsEmpty());
+    for (const uint64_t id : ids)
+        CHECK(scene.TryGetSceneObjectWithUUID(id));
+}
+
+AKARI_TEST(SceneCommandBuffer, PlaysBackInRecordingOrder)
+{
+    Scene scene;
+    SceneCommandBuffer& commands = scene.GetCommandBuffer();
+
+    // Later commands refer to the ids reserved by earlier ones
+    const UUID parent = commands.CreateSceneObject("Parent");
+    const UUID child = commands.CreateSceneObject("Child", parent);
+    const UUID grandchild = commands.CreateSceneObject("Grandchild", child);
+    commands.AddComponent<PointLightComponent>(child);
+    // Would put the parent under its own grandchild, ignored
+    commands.ParentSceneObject(parent, grandchild);
+    scene.UpdateHierarchy();
+
+    const SceneObject parentObject = scene.TryGetSceneObjectWithUUID(parent);
+    const SceneObject childObject = scene.TryGetSceneObjectWithUUID(child);
+    const SceneObject grandchildObject = scene.TryGetSceneObjectWithUUID(grandchild);
+    REQUIRE(parentObject && childObject && grandchildObject);
+    CHECK(!parentObject.GetParent());
+    CHECK(childObject.GetParent() == parentObject);
+    CHECK(grandchildObject.GetParent() == childObject);
+    CHECK(childObject.HasComponent<PointLightComponent>());
+    CHECK(scene.TryGetSceneObjectWithName("Grandchild") == grandchildObject);
+
+    // The grandchild is kept as a root
+    commands.DestroySceneObject(child, true);
+    scene.UpdateHierarchy();
+    CHECK(!scene.TryGetSceneObjectWithUUID(child));
+    REQUIRE(scene.TryGetSceneObjectWithUUID(grandchild));
+    CHECK(!grandchildObject.GetParent());
+    CHECK(parentObject.GetChildCount() == 0);
+
+    // Reparenting and destroying the parent takes the whole subtree along
+    commands.ParentSceneObject(grandchild, parent);
+    commands.DestroySceneObject(parent);
+    scene.UpdateHierarchy();
+    CHECK(!scene.TryGetSceneObjectWithUUID(parent));
+    CHECK(!scene.TryGetSceneObjectWithUUID(grandchild));
+    CHECK(!scene.TryGetSceneObjectWithName("Grandchild"));
+    CHECK(scene.GetAllSceneObjectsWith<IDComponent>().size() == 0);
+}
+
+// Spawns and destroys 100k objects, 1000 roots with 99 children each, through one command buffer playback each
+AKARI_BENCHMARK(SceneCommandBuffer, SpawnAndDestroy100k)
+{
+    constexpr uint32_t rootCount = 1000;
+    constexpr uint32_t childrenPerRoot = 99;
+
+    Scene scene;
+    SceneCommandBuffer& commands = scene.GetCommandBuffer();
+    std::vector<uint64_t> roots(rootCount);
+
+    Tests::Measure("Record 100k creates", 1, [&]
+    {
+        for (uint32_t i = 0; i < rootCount; ++i)
+        {
+            roots[i] = commands.CreateSceneObject("Root");
+            for (uint32_t j = 0; j < childrenPerRoot; ++j)
+                commands.CreateSceneObject("Child", roots[i]);
+        }
+    });
+    Tests::Measure("Play back 100k creates", 1, [&] { scene.UpdateHierarchy(); });
+    CHECK(scene.GetAllSceneObjectsWith<IDComponent>().size() == rootCount * (childrenPerRoot + 1));
+
+    Tests::Measure("Record 1000 subtree destroys", 1, [&]
+    {
+        for (const uint64_t root : roots)
+            commands.DestroySceneObject(root);
+    });
+    Tests::Measure("Play back 100k destroys", 1, [&] { scene.UpdateHierarchy(); });
+    CHECK(scene.GetAllSceneObjectsWith<IDComponent>().size() == 0);
+}
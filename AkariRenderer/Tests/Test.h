@@ -0,0 +1,95 @@
+#pragma once
+#include "Timing/Timer.h"
+
+// Minimal runner of the headless tests. AKARI_TEST cases run by default and fail on any failed CHECK,
+// AKARI_BENCHMARK cases only run with --bench and print their timings.
+namespace Akari::Tests
+{
+    struct TestCase
+    {
+        const char* Suite;
+        const char* Name;
+        void (*Function)();
+        bool Benchmark;
+    };
+
+    std::vector<TestCase>& GetTestCases();
+    void ReportFailure(const char* file, int line, const char* expression);
+
+    struct TestRegistrar
+    {
+        TestRegistrar(const char* suite, const char* name, void (*function)(), bool benchmark)
+        {
+            GetTestCases().push_back({ suite, name, function, benchmark });
+        }
+    };
+
+    // Runs func on a scheduler limited to threadCount workers, for scaling measurements of PPL code
+    void RunWithThreads(uint32_t threadCount, const std::function<void()>& func);
+
+    // An empty directory under the system temp directory for the files of one test, removed with its contents
+    class TempDirectory
+    {
+    public:
+        explicit TempDirectory(std::string_view name);
+        ~TempDirectory();
+
+        TempDirectory(const TempDirectory&) = delete;
+        TempDirectory& operator=(const TempDirectory&) = delete;
+
+        std::filesystem::path operator/(std::string_view fileName) const { return m_Path / fileName; }
+
+        // Writes contents to fileName in the directory and returns its path
+        std::filesystem::path Write(std::string_view fileName, std::string_view contents) const;
+
+    private:
+        std::filesystem::path m_Path;
+    };
+
+    // Turns logging off while it exists, around code that is expected to log errors
+    class LogSilencer
+    {
+    public:
+        LogSilencer()
+            : m_Level(spdlog::get_level())
+        {
+            spdlog::set_level(spdlog::level::off);
+        }
+
+        ~LogSilencer() { spdlog::set_level(m_Level); }
+
+        LogSilencer(const LogSilencer&) = delete;
+        LogSilencer& operator=(const LogSilencer&) = delete;
+
+    private:
+        spdlog::level::level_enum m_Level;
+    };
+
+    // Average milliseconds of one call to func over iterations calls, printed with label
+    template<typename Func>
+    float Measure(const char* label, uint32_t iterations, Func&& func)
+    {
+        Timer timer;
+        for (uint32_t i = 0; i < iterations; ++i)
+            func();
+        const float milliseconds = timer.ElapsedMillis() / float(iterations);
+
+        spdlog::info("  {0}: {1:.3f} ms", label, milliseconds);
+        return milliseconds;
+    }
+}
+
+#define AKARI_TEST_CASE(suite, name, benchmark) \
+    static void suite##_##name(); \
+    static const Akari::Tests::TestRegistrar suite##_##name##_Registrar(#suite, #name, &suite##_##name, benchmark); \
+    static void suite##_##name()
+
+#define AKARI_TEST(suite, name) AKARI_TEST_CASE(suite, name, false)
+#define AKARI_BENCHMARK(suite, name) AKARI_TEST_CASE(suite, name, true)
+
+#define CHECK(expression) \
+    do { if (!(expression)) Akari::Tests::ReportFailure(__FILE__, __LINE__, #expression); } while (false)
+
+// Ends the test case on failure, for checks the rest of the case depends on
+#define REQUIRE(expression) \
+    do { if (!(expression)) { Akari::Tests::ReportFailure(__FILE__, __LINE__, #expression); return; } } while (false)
@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "Test.h"
+
+#include <concrt.h>
+
+namespace Akari::Tests
+{
+    static uint32_t s_FailedChecks = 0;
+
+    std::vector<TestCase>& GetTestCases()
+    {
+        // Function local, the registrars of the other files run during static initialization
+        static std::vector<TestCase> testCases;
+        return testCases;
+    }
+
+    void ReportFailure(const char* file, int line, const char* expression)
+    {
+        spdlog::error("{0}({1}): {2} failed", file, line, expression);
+        ++s_FailedChecks;
+    }
+
+    void RunWithThreads(uint32_t threadCount, const std::function<void()>& func)
+    {
+        const concurrency::SchedulerPolicy policy(2, concurrency::MinConcurrency, 1, concurrency::MaxConcurrency, threadCount);
+        concurrency::CurrentScheduler::Create(policy);
+        func();
+        concurrency::CurrentScheduler::Detach();
+    }
+
+    TempDirectory::TempDirectory(std::string_view name)
+        : m_Path(std::filesystem::temp_directory_path() / "AkariTests" / name)
+    {
+        std::filesystem::remove_all(m_Path);
+        std::filesystem::create_directories(m_Path);
+    }
+
+    TempDirectory::~TempDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(m_Path, error);
+    }
+
+    std::filesystem::path TempDirectory::Write(std::string_view fileName, std::string_view contents) const
+    {
+        const std::filesystem::path path = m_Path / fileName;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        return path;
+    }
+}
+
+// AkariTests [--bench] [suite], runs the tests or with --bench the benchmarks, of one suite or all of them
+int main(int argc, char** argv)
+{
+    using namespace Akari::Tests;
+
+    bool benchmark = false;
+    std::string_view suite;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--bench")
+            benchmark = true;
+        else
+            suite = argv[i];
+    }
+
+    uint32_t ran = 0;
+    uint32_t failed = 0;
+    for (const TestCase& testCase : GetTestCases())
+    {
+        if (testCase.Benchmark != benchmark || (!suite.empty() && suite != testCase.Suite))
+            continue;
+
+        spdlog::info("{0}.{1}", testCase.Suite, testCase.Name);
+        const uint32_t failedChecks = s_FailedChecks;
+        try
+        {
+            testCase.Function();
+        }
+        catch (const std::exception& exception)
+        {
+            spdlog::error("{0}.{1} threw: {2}", testCase.Suite, testCase.Name, exception.what());
+            ++s_FailedChecks;
+        }
+
+        ++ran;
+        if (s_FailedChecks != failedChecks)
+            ++failed;
+    }
+
+    spdlog::info("{0} of {1} passed", ran - failed, ran);
+
+    // Tests matching nothing is a failure too, so a renamed suite can't pass silently. Not every suite has benchmarks
+    return failed == 0 && (ran > 0 || benchmark) ? 0 : 1;
+}
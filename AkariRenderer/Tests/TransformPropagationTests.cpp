@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "SceneComponents/Scene.h"
+#include "SceneComponents/SceneObject.h"
+
+using namespace Akari;
+
+namespace
+{
+    // World matrix composed along the parent chain, the way the propagation must end up
+    glm::mat4 ComposeWorldMatrix(SceneObject object)
+    {
+        glm::mat4 world = object.Transform().GetTransform();
+        for (auto parent = object.GetParent(); parent; parent = parent.GetParent())
+            world = parent.Transform().GetTransform() * world;
+        return world;
+    }
+
+    // Relative to the expected value, the translations of a long chain add up
+    bool IsNear(const glm::mat4& a, const glm::mat4& b, float tolerance)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            for (int row = 0; row < 4; ++row)
+            {
+                if (std::abs(a[column][row] - b[column][row]) > tolerance * std::max(std::abs(b[column][row]), 1.0f))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void SetRandomTransform(SceneObject object, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> offset(-0.01f, 0.01f);
+        auto& transform = object.Transform();
+        transform.SetTranslation({ offset(random), offset(random), offset(random) });
+        transform.SetRotation({ offset(random), offset(random), offset(random) });
+    }
+
+    bool MatchesComposedMatrices(Scene& scene, const std::vector<SceneObject>& objects)
+    {
+        return std::ranges::all_of(objects, [&](const SceneObject object)
+        {
+            return IsNear(scene.GetWorldSpaceTransformMatrix(object), ComposeWorldMatrix(object), 1e-3f);
+        });
+    }
+}
+
+// Small subtrees are merged into parallel batches, a chain and a wide tree larger than a batch go through the spine
+AKARI_TEST(TransformPropagation, MatchesParentChain)
+{
+    Scene scene;
+    std::mt19937 random(5);
+    std::vector<SceneObject> objects;
+
+    auto create = [&](const SceneObject parent)
+    {
+        auto object = parent ? scene.CreateChildSceneObject(parent) : scene.CreateSceneObject();
+        SetRandomTransform(object, random);
+        objects.push_back(object);
+        return object;
+    };
+
+    for (int i = 0; i < 100; ++i)
+    {
+        auto root = create({});
+        for (int j = 0; j < 10; ++j)
+            create(create(root));
+    }
+
+    SceneObject chain = create({});
+    for (int i = 0; i < 2100; ++i)
+        chain = create(chain);
+
+    const SceneObject wideRoot = create({});
+    for (int i = 0; i < 100; ++i)
+    {
+        auto child = create(wideRoot);
+        for (int j = 0; j < 50; ++j)
+            create(child);
+    }
+
+    scene.UpdateHierarchy();
+    CHECK(MatchesComposedMatrices(scene, objects));
+
+    // Only the changed subtrees are recomputed, their descendants have to follow
+    for (size_t i = 0; i < objects.size(); i += 97)
+        SetRandomTransform(objects[i], random);
+    scene.UpdateHierarchy();
+    CHECK(MatchesComposedMatrices(scene, objects));
+
+    // Reparenting re-sorts the hierarchy and recomputes every matrix
+    objects[1].SetParent(chain);
+    wideRoot.GetFirstChild().SetParent({});
+    scene.UpdateHierarchy();
+    CHECK(MatchesComposedMatrices(scene, objects));
+}
+
+// 512k objects in 1024 trees of 16 children with 31 descendants each, every matrix recomputed on 1 to 16 threads
+AKARI_BENCHMARK(TransformPropagation, Scaling)
+{
+    Scene scene;
+    std::vector<SceneObject> roots;
+    for (int i = 0; i < 1024; ++i)
+    {
+        auto root = roots.emplace_back(scene.CreateSceneObject());
+        for (int j = 0; j < 16; ++j)
+        {
+            auto parent = scene.CreateChildSceneObject(root);
+            for (int k = 0; k < 31; ++k)
+                parent = scene.CreateChildSceneObject(parent);
+        }
+    }
+    Tests::Measure("Flatten 512k objects", 1, [&] { scene.UpdateHierarchy(); });
+
+    float singleThreaded = 0.0f;
+    for (const uint32_t threadCount : { 1u, 2u, 4u, 8u, 16u })
+    {
+        Tests::RunWithThreads(threadCount, [&]
+        {
+            const std::string label = std::to_string(threadCount) + " threads";
+            const float milliseconds = Tests::Measure(label.c_str(), 20, [&]
+            {
+                for (auto root : roots)
+                    root.Transform().MarkDirty();
+                scene.UpdateHierarchy();
+            });
+
+            if (threadCount == 1)
+                singleThreaded = milliseconds;
+            spdlog::info("  speedup {0:.2f}x", singleThreaded / milliseconds);
+        });
+    }
+}
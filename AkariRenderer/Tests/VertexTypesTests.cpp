@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "RHI/VertexTypes.h"
+
+using namespace Akari;
+using namespace DirectX;
+
+namespace
+{
+    glm::vec3 ToVec3(const XMFLOAT3& v)
+    {
+        return glm::vec3(v.x, v.y, v.z);
+    }
+
+    // Angle in radians, through atan2 so it stays accurate for tiny angles
+    float GetAngle(const glm::vec3& a, const glm::vec3& b)
+    {
+        return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+    }
+
+    bool IsTexCoordWithinBounds(float encoded, float decoded)
+    {
+        return std::abs(encoded - decoded) <= VertexPositionQTangentTexture::MaxTexCoordError * std::max(std::abs(encoded), 1.0f);
+    }
+
+    VertexPositionNormalTangentBitangentTexture MakeVertex(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent,
+                                                           const glm::vec2& texCoord = glm::vec2(0.25f, 0.75f))
+    {
+        return VertexPositionNormalTangentBitangentTexture(XMFLOAT3(1.0f, -2.0f, 3.5f), XMFLOAT3(normal.x, normal.y, normal.z),
+                                                           XMFLOAT3(texCoord.x, texCoord.y, 0.0f), XMFLOAT3(tangent.x, tangent.y, tangent.z),
+                                                           XMFLOAT3(bitangent.x, bitangent.y, bitangent.z));
+    }
+
+    // Round trips an orthonormal frame, mirrored when the bitangent is flipped
+    bool RoundTrips(const glm::vec3& normal, const glm::vec3& tangent, bool mirrored, const glm::vec2& texCoord = glm::vec2(0.25f, 0.75f))
+    {
+        const glm::vec3 bitangent = glm::cross(normal, tangent) * (mirrored ? -1.0f : 1.0f);
+        const auto vertex = MakeVertex(normal, tangent, bitangent, texCoord);
+        const auto decoded = VertexPositionQTangentTexture(vertex).Decode();
+
+        constexpr float maxError = VertexPositionQTangentTexture::MaxFrameError;
+        return GetAngle(ToVec3(decoded.Normal), normal) <= maxError && GetAngle(ToVec3(decoded.Tangent), tangent) <= maxError &&
+               GetAngle(ToVec3(decoded.Bitangent), bitangent) <= maxError && ToVec3(decoded.Position) == ToVec3(vertex.Position) &&
+               IsTexCoordWithinBounds(texCoord.x, decoded.TexCoord.x) && IsTexCoordWithinBounds(texCoord.y, decoded.TexCoord.y) &&
+               decoded.TexCoord.z == 0.0f;
+    }
+}
+
+AKARI_TEST(VertexTypes, RoundTripsRandomFrames)
+{
+    std::mt19937 random(43);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> texCoord(-40.0f, 40.0f);
+
+    uint32_t failed = 0;
+    for (int i = 0; i < 200'000; ++i)
+    {
+        glm::vec3 normal, tangent;
+        do
+        {
+            normal = glm::vec3(unit(random), unit(random), unit(random));
+            tangent = glm::vec3(unit(random), unit(random), unit(random));
+            tangent -= normal * glm::dot(normal, tangent) / glm::dot(normal, normal);
+        } while (glm::length(normal) < 0.1f || glm::length(tangent) < 0.1f);
+
+        failed += RoundTrips(glm::normalize(normal), glm::normalize(tangent), i % 2 == 1, glm::vec2(texCoord(random), texCoord(random))) ? 0 : 1;
+    }
+    CHECK(failed == 0);
+}
+
+// Rotations by about 180 degrees have w near 0, where its sign has to survive the quantization
+AKARI_TEST(VertexTypes, RoundTripsHalfTurns)
+{
+    for (const bool mirrored : { false, true })
+    {
+        CHECK(RoundTrips(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), mirrored));
+        CHECK(RoundTrips(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), mirrored));
+        CHECK(RoundTrips(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), mirrored));
+        CHECK(RoundTrips(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), mirrored));
+        for (const float offset : { 1e-5f, 1e-4f, 1e-3f, -1e-3f })
+        {
+            CHECK(RoundTrips(glm::vec3(0.0f, 0.0f, -1.0f), glm::normalize(glm::vec3(1.0f, offset, 0.0f)), mirrored));
+            CHECK(RoundTrips(glm::normalize(glm::vec3(offset, 0.0f, -1.0f)), glm::vec3(-1.0f, 0.0f, 0.0f), mirrored));
+        }
+    }
+
+    // The identity frame, w at its largest
+    CHECK(RoundTrips(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), false));
+}
+
+// Importers hand over unnormalized normals, skewed tangents and sometimes none at all
+AKARI_TEST(VertexTypes, RepairsFrames)
+{
+    const glm::vec3 normal = glm::normalize(glm::vec3(0.3f, 0.9f, -0.2f));
+
+    // Scaled and skewed, the decoded frame is the normal and the tangent made perpendicular to it
+    const glm::vec3 tangent = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 0.0f, 1.0f)));
+    auto decoded = VertexPositionQTangentTexture(MakeVertex(normal * 3.0f, tangent * 0.5f + normal * 0.2f, glm::cross(normal, tangent))).Decode();
+    CHECK(GetAngle(ToVec3(decoded.Normal), normal) <= VertexPositionQTangentTexture::MaxFrameError);
+    CHECK(GetAngle(ToVec3(decoded.Tangent), tangent) <= VertexPositionQTangentTexture::MaxFrameError);
+
+    // Without a tangent any perpendicular one will do
+    for (const glm::vec3& n : { normal, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) })
+    {
+        decoded = VertexPositionQTangentTexture(MakeVertex(n, glm::vec3(0.0f), glm::vec3(0.0f))).Decode();
+        CHECK(GetAngle(ToVec3(decoded.Normal), n) <= VertexPositionQTangentTexture::MaxFrameError);
+        CHECK(std::abs(glm::dot(ToVec3(decoded.Tangent), n)) < 1e-3f);
+        CHECK(std::abs(glm::length(ToVec3(decoded.Tangent)) - 1.0f) < 1e-3f);
+    }
+
+    // A tangent along the normal counts as none
+    decoded = VertexPositionQTangentTexture(MakeVertex(normal, normal, glm::vec3(0.0f))).Decode();
+    CHECK(std::abs(glm::dot(ToVec3(decoded.Tangent), normal)) < 1e-3f);
+
+    // Without a normal the frame faces +z
+    decoded = VertexPositionQTangentTexture(MakeVertex(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f))).Decode();
+    CHECK(GetAngle(ToVec3(decoded.Normal), glm::vec3(0.0f, 0.0f, 1.0f)) <= VertexPositionQTangentTexture::MaxFrameError);
+}
+
+AKARI_TEST(VertexTypes, RoundTripsTexCoords)
+{
+    for (const float value : { 0.0f, 1.0f, -1.0f, 0.5f, 1.0f / 3.0f, 0.999f, 7.3f, -123.456f, 2047.0f, 1e-4f })
+    {
+        const auto decoded = VertexPositionQTangentTexture(MakeVertex(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+                                                                      glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(value, -value)))
+                                 .Decode();
+        CHECK(IsTexCoordWithinBounds(value, decoded.TexCoord.x));
+        CHECK(IsTexCoordWithinBounds(-value, decoded.TexCoord.y));
+    }
+}
+
+AKARI_BENCHMARK(VertexTypes, Encode1MVertices)
+{
+    std::mt19937 random(47);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<VertexPositionNormalTangentBitangentTexture> vertices;
+    vertices.reserve(1'000'000);
+    while (vertices.size() < 1'000'000)
+    {
+        const glm::vec3 normal(unit(random), unit(random), unit(random));
+        const glm::vec3 tangent = glm::cross(normal, glm::vec3(unit(random), unit(random), unit(random)));
+        if (glm::length(normal) > 0.1f && glm::length(tangent) > 0.1f)
+            vertices.push_back(MakeVertex(glm::normalize(normal), glm::normalize(tangent), glm::cross(normal, tangent), glm::vec2(unit(random), unit(random))));
+    }
+
+    // Like the import, the vector constructor calls the explicit encoding constructor
+    std::vector<VertexPositionQTangentTexture> encoded;
+    Tests::Measure("Encode 1M vertices", 5, [&] { encoded = std::vector<VertexPositionQTangentTexture>(vertices.begin(), vertices.end()); });
+
+    std::vector<VertexPositionNormalTangentBitangentTexture> decoded(encoded.size());
+    Tests::Measure("Decode 1M vertices", 5, [&]
+    {
+        for (size_t i = 0; i < encoded.size(); ++i)
+            decoded[i] = encoded[i].Decode();
+    });
+    spdlog::info("  {0} MB instead of {1} MB", encoded.size() * sizeof(VertexPositionQTangentTexture) >> 20,
+                 vertices.size() * sizeof(VertexPositionNormalTangentBitangentTexture) >> 20);
+}